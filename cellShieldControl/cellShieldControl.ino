@@ -203,8 +203,9 @@ char* checkForCellShieldInputLineAddChar(char c)
             
             return commandBuffer;
         default:
-            // A normal character: we add it to the current command if we haven't run out of space
-            if (bufferIndex < BUFFER_SIZE)
+            // A normal character: we add it to the current command if we haven't run out of space,
+            // keeping the last byte for the null
+            if (bufferIndex < BUFFER_SIZE - 1)
             {
                 commandBuffer[bufferIndex++] = c;
             }
@@ -224,9 +225,6 @@ char* checkForCellShieldInputLineAddChar(char c)
 // (note that the char* points to an internal buffer and will thus always be the same value)
 char* checkForCellShieldInputLine()
 {
-    static char commandBuffer[BUFFER_SIZE];
-    static int bufferIndex = 0;
-    
     while  (CELL_SHIELD.available())
     {
         int c = CELL_SHIELD.read();
@@ -0,0 +1,247 @@
+#include "ATResponse.h"
+
+// The most fields of a +CREG line: +CREG: n,stat,lac,ci when asked
+#define AT_CREG_MAX_FIELDS 4
+
+// A node of the trie that classifies lines by how they start.
+// Each node matches a run of characters, its children carry on from the end of that run,
+// and its siblings are tried instead of it. Siblings start with different characters,
+// so the first character of a run decides between them, and nothing is ever matched twice.
+struct TrieNode
+{
+    const char* run;
+    // The first child and next sibling, or -1 if there is none
+    int8_t child;
+    int8_t sibling;
+    // The kind of line that starts with everything matched up to and including this run,
+    // or AT_LINE_OTHER if it needs more
+    AtLineKind kind;
+};
+
+static const TrieNode trie[] = {
+    /* 0 */ { "OK", -1, 1, AT_LINE_OK },
+    /* 1 */ { "ERROR", -1, 2, AT_LINE_ERROR },
+    /* 2 */ { "+C", 3, -1, AT_LINE_OTHER },
+    /* 3 */ { "M", 6, 4, AT_LINE_OTHER },
+    /* 4 */ { "REG:", -1, 5, AT_LINE_CREG },
+    /* 5 */ { "OPS:", -1, -1, AT_LINE_COPS },
+    /* 6 */ { "E ERROR:", -1, 7, AT_LINE_CME_ERROR },
+    /* 7 */ { "S ERROR:", -1, 8, AT_LINE_CMS_ERROR },
+    /* 8 */ { "T:", -1, 9, AT_LINE_CMT },
+    /* 9 */ { "GS:", -1, -1, AT_LINE_CMGS }
+};
+
+// Walks the trie over the start of the line
+// Returns the kind of line, leaving position just past its prefix
+static AtLineKind classify(const char* line, size_t length, size_t& position)
+{
+    AtLineKind kind = AT_LINE_OTHER;
+    int8_t node = 0;
+    while (node != -1)
+    {
+        const TrieNode& current = trie[node];
+        if (position < length && line[position] == current.run[0])
+        {
+            size_t matched = 1;
+            while (current.run[matched] && position + matched < length
+                && line[position + matched] == current.run[matched])
+            {
+                matched++;
+            }
+            if (current.run[matched])
+            {
+                // The line starts like this run, but is not it
+                return AT_LINE_OTHER;
+            }
+            position += matched;
+            kind = current.kind;
+            node = current.child;
+        }
+        else
+        {
+            node = current.sibling;
+        }
+    }
+    return kind;
+}
+
+// Moves position past spaces, and past a quote if there is one
+// Returns true if there was a quote
+static bool skipToValue(const char* line, size_t length, size_t& position)
+{
+    while (position < length && line[position] == ' ')
+    {
+        position++;
+    }
+    if (position < length && line[position] == '"')
+    {
+        position++;
+        return true;
+    }
+    return false;
+}
+
+// Moves position just past the next comma
+// Returns false if there is no other comma
+static bool nextField(const char* line, size_t length, size_t& position)
+{
+    while (position < length && line[position] != ',')
+    {
+        position++;
+    }
+    if (position == length)
+    {
+        return false;
+    }
+    position++;
+    return true;
+}
+
+// The value of a digit in the given base, or -1 if it is not one
+static int32_t digitValue(char character, int32_t base)
+{
+    int32_t value = -1;
+    if (character >= '0' && character <= '9')
+    {
+        value = character - '0';
+    }
+    else if (character >= 'A' && character <= 'F')
+    {
+        value = character - 'A' + 10;
+    }
+    else if (character >= 'a' && character <= 'f')
+    {
+        value = character - 'a' + 10;
+    }
+    return value < base ? value : -1;
+}
+
+// Parses a number at position in the given base, leaving position past it.
+// Hexadecimal numbers may start with 0x.
+// Returns the number, or -1 if there is none
+static int32_t parseNumber(const char* line, size_t length, size_t& position, int32_t base)
+{
+    if (base == 16 && position + 1 < length && line[position] == '0'
+        && (line[position + 1] == 'x' || line[position + 1] == 'X'))
+    {
+        position += 2;
+    }
+    if (position == length || digitValue(line[position], base) == -1)
+    {
+        return -1;
+    }
+    int32_t number = 0;
+    int32_t digit;
+    while (position < length && (digit = digitValue(line[position], base)) != -1)
+    {
+        number = number * base + digit;
+        position++;
+    }
+    return number;
+}
+
+// +CREG: stat when n is 1, +CREG: stat,lac,ci when n is 2, and +CREG: n,stat[,lac,ci] when asked.
+// The location area and cell are hex, either quoted or, on some modules, written with 0x.
+static void parseCreg(const char* line, size_t length, size_t position, AtResponse& response)
+{
+    int32_t values[AT_CREG_MAX_FIELDS];
+    int32_t fieldCount = 0;
+    int32_t firstHexField = -1;
+    do
+    {
+        bool quoted = skipToValue(line, length, position);
+        bool hex = quoted || (position + 1 < length && line[position] == '0'
+            && (line[position + 1] == 'x' || line[position + 1] == 'X'));
+        if (hex && firstHexField == -1)
+        {
+            firstHexField = fieldCount;
+        }
+        values[fieldCount++] = parseNumber(line, length, position, hex ? 16 : 10);
+    }
+    while (fieldCount < AT_CREG_MAX_FIELDS && nextField(line, length, position));
+    
+    response.lac = -1;
+    response.cid = -1;
+    if (firstHexField >= 1 && firstHexField + 1 < fieldCount)
+    {
+        response.registration = values[firstHexField - 1];
+        response.lac = values[firstHexField];
+        response.cid = values[firstHexField + 1];
+    }
+    else
+    {
+        // Without a location, two fields are only ever the answer to a question
+        response.registration = values[fieldCount == 2 ? 1 : 0];
+    }
+}
+
+// +COPS: mode,format,"310410", where the first three digits are the country and the rest the network
+static void parseCops(const char* line, size_t length, size_t position, AtResponse& response)
+{
+    response.mcc = -1;
+    response.mnc = -1;
+    response.mncDigits = 0;
+    if (!nextField(line, length, position) || !nextField(line, length, position))
+    {
+        return;
+    }
+    skipToValue(line, length, position);
+    
+    size_t digits = 0;
+    while (position + digits < length && digitValue(line[position + digits], 10) != -1)
+    {
+        digits++;
+    }
+    // A named operator has no codes
+    if (digits < 5)
+    {
+        return;
+    }
+    size_t countryEnd = position + 3;
+    response.mcc = parseNumber(line, countryEnd, position, 10);
+    response.mnc = parseNumber(line, length, position, 10);
+    response.mncDigits = (int32_t)(digits - 3);
+}
+
+AtLineKind parseAtResponse(const char* line, size_t length, AtResponse& response)
+{
+    size_t position = 0;
+    response.kind = classify(line, length, position);
+    
+    switch (response.kind)
+    {
+        case AT_LINE_CME_ERROR:
+        case AT_LINE_CMS_ERROR:
+            // Modules set to verbose errors give text instead of a code, which is -1 here
+            skipToValue(line, length, position);
+            response.errorCode = parseNumber(line, length, position, 10);
+            break;
+        
+        case AT_LINE_CMT:
+            skipToValue(line, length, position);
+            response.sender = line + position;
+            while (position < length && line[position] != '"' && line[position] != ',')
+            {
+                position++;
+            }
+            response.senderLength = line + position - response.sender;
+            break;
+        
+        case AT_LINE_CMGS:
+            skipToValue(line, length, position);
+            response.messageReference = parseNumber(line, length, position, 10);
+            break;
+        
+        case AT_LINE_CREG:
+            parseCreg(line, length, position, response);
+            break;
+        
+        case AT_LINE_COPS:
+            parseCops(line, length, position, response);
+            break;
+        
+        default:
+            break;
+    }
+    return response.kind;
+}
@@ -0,0 +1,67 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef AT_RESPONSE
+#define AT_RESPONSE
+
+// What a line from a cellular module is, going by how it starts
+enum AtLineKind
+{
+    // Anything we have no use for, such as the echo of a command
+    AT_LINE_OTHER,
+    AT_LINE_OK,
+    // A plain ERROR, with no code
+    AT_LINE_ERROR,
+    // +CME ERROR: code, an error of the module or network
+    AT_LINE_CME_ERROR,
+    // +CMS ERROR: code, an error sending or storing a text message
+    AT_LINE_CMS_ERROR,
+    // +CMT: "sender",..., the header of a received text message, whose body is the next line
+    AT_LINE_CMT,
+    // +CMGS: reference, a text message was sent
+    AT_LINE_CMGS,
+    // +CREG: ..., the network registration and location
+    AT_LINE_CREG,
+    // +COPS: ..., the chosen network operator
+    AT_LINE_COPS,
+    
+    AT_LINE_KIND_COUNT
+};
+
+// A line from a cellular module, classified and with its fields parsed.
+// Only the fields of the line's kind are set. Nothing is copied:
+// text fields point into the line, which must outlive the response.
+struct AtResponse
+{
+    AtLineKind kind;
+    
+    // AT_LINE_CME_ERROR and AT_LINE_CMS_ERROR: the error code
+    int32_t errorCode;
+    
+    // AT_LINE_CMT: the phone number the message came from, which is not null terminated
+    const char* sender;
+    size_t senderLength;
+    
+    // AT_LINE_CMGS: the module's reference for the sent message
+    int32_t messageReference;
+    
+    // AT_LINE_CREG: the registration status, and the location area and cell,
+    // which are -1 if the line does not have them
+    int32_t registration;
+    int32_t lac;
+    int32_t cid;
+    
+    // AT_LINE_COPS: the country and network codes of the operator,
+    // which are -1 if the module named the operator instead,
+    // and how many digits the network code was written with, since 01 and 001 are different networks
+    int32_t mcc;
+    int32_t mnc;
+    int32_t mncDigits;
+};
+
+// Classifies a line from a cellular module and parses the fields of its kind, in a single pass over the line.
+// The line is the given length, without its line break, and need not be null terminated.
+// Returns the kind of the line, which is also stored in the response.
+AtLineKind parseAtResponse(const char* line, size_t length, AtResponse& response);
+
+#endif
@@ -0,0 +1,268 @@
+// Times parseAtResponse against the strstr chain cellShieldControl uses, over recorded modem transcripts.
+// Build and run on a host:
+//     g++ -O2 -I. ATResponseBenchmark.cpp ATResponse.cpp -o atbenchmark
+//     ./atbenchmark [transcript...]
+// A transcript is what the module sent, a line per line. Without any, a recording built in here is used.
+#include "ATResponse.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_LINES 100000
+#define MAX_LINE_LENGTH 256
+#define REPEATS 200
+
+// A session with an SM5100B: setup, registration, a received text, and a sent one
+static const char* const recordedTranscript[] = {
+    "+SIND: 1",
+    "+SIND: 10,\"SM\",1,\"FD\",1,\"LD\",1,\"MC\",1,\"RC\",1,\"ME\",1",
+    "AT+SBAND=7",
+    "OK",
+    "AT+CMGF=1",
+    "OK",
+    "AT+CSMP=,,,0",
+    "OK",
+    "AT+CMGD=1,4",
+    "OK",
+    "+SIND: 11",
+    "+SIND: 3",
+    "+SIND: 4",
+    "AT+COPS=0",
+    "OK",
+    "AT+COPS?",
+    "+COPS: 0,2,\"310410\"",
+    "OK",
+    "AT+CNMI=3,3,0,0",
+    "OK",
+    "AT+CREG=2",
+    "OK",
+    "+CREG: 1,0x1395,0xD7D4",
+    "+CMT: \"+15551234567\",\"\",\"12/06/02,14:31:07-20\"",
+    "getinfo",
+    "AT+CMGD=1,4",
+    "OK",
+    "AT+CMGS=\"+15551234567\"",
+    "+CMS ERROR: 313",
+    "AT+CMGS=\"+15551234567\"",
+    "+CME ERROR: 30",
+    "AT+CMGS=\"+15551234567\"",
+    "+CMGS: 17",
+    "OK",
+    "+CREG: 1,0x1395,0xD7D5",
+    "+CREG: 2",
+    "+CREG: 1,\"1395\",\"D7D6\"",
+    "AT+CREG?",
+    "+CREG: 2,1,\"1395\",\"D7D6\"",
+    "OK",
+    "ERROR"
+};
+
+static char* lines[MAX_LINES];
+static size_t lineLengths[MAX_LINES];
+static int lineCount = 0;
+
+static void addLine(const char* line)
+{
+    if (lineCount == MAX_LINES)
+    {
+        return;
+    }
+    size_t length = strlen(line);
+    lines[lineCount] = (char*)malloc(length + 1);
+    memcpy(lines[lineCount], line, length + 1);
+    lineLengths[lineCount] = length;
+    lineCount++;
+}
+
+// Reads a transcript, a line per line
+// Returns false if it cannot be read
+static bool readTranscript(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (!file)
+    {
+        return false;
+    }
+    char line[MAX_LINE_LENGTH];
+    while (fgets(line, sizeof(line), file))
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0])
+        {
+            addLine(line);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+static double nanosecondsNow()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+// What both ways of parsing found, so they can be checked against each other.
+// The strstr chain only understands +CREG: stat,0xlac,0xci and unquoted +COPS codes,
+// so the lac, cid, mcc and mnc differ wherever a module quotes them instead.
+struct Totals
+{
+    long errors;
+    long retries;
+    long texts;
+    long lac;
+    long cid;
+    long mcc;
+    long mnc;
+};
+
+// handleCellShieldCommand, storeLacAndCid and storeMccAndMnc, less the printing,
+// with the codes turned into integers the way a typed result would have them
+static void parseWithStrstr(const char* command, Totals& totals)
+{
+    if (strstr(command, "ERROR"))
+    {
+        if (strstr(command, "CME ERROR: 30") || strstr(command, "CMS ERROR: 313"))
+        {
+            totals.retries++;
+        }
+        else
+        {
+            totals.errors++;
+        }
+    }
+    if (strstr(command, "+CMT"))
+    {
+        char phoneNumber[12];
+        const char* start = strchr(command, '"') + 2;
+        strncpy(phoneNumber, start, 11);
+        phoneNumber[11] = '\0';
+        totals.texts += phoneNumber[0] != '\0';
+    }
+    if (strstr(command, "+CREG"))
+    {
+        if (strlen(command) == 22)
+        {
+            char lacBuffer[5];
+            char cidBuffer[5];
+            const char* lacLocation = strchr(command, ',') + 3;
+            memcpy(lacBuffer, lacLocation, 4);
+            lacBuffer[4] = '\0';
+            memcpy(cidBuffer, lacLocation + 7, 4);
+            cidBuffer[4] = '\0';
+            totals.lac += strtol(lacBuffer, NULL, 16);
+            totals.cid += strtol(cidBuffer, NULL, 16);
+        }
+    }
+    if (strstr(command, "+COPS"))
+    {
+        const char* firstComma = strchr(command, ',');
+        if (firstComma)
+        {
+            char mccBuffer[4];
+            char mncBuffer[4];
+            const char* mccLocation = strchr(firstComma + 1, ',') + 1;
+            memcpy(mccBuffer, mccLocation, 3);
+            mccBuffer[3] = '\0';
+            memcpy(mncBuffer, mccLocation + 3, 3);
+            mncBuffer[3] = '\0';
+            totals.mcc += strtol(mccBuffer, NULL, 10);
+            totals.mnc += strtol(mncBuffer, NULL, 10);
+        }
+    }
+}
+
+static void parseWithTokenizer(const char* line, size_t length, Totals& totals)
+{
+    AtResponse response;
+    switch (parseAtResponse(line, length, response))
+    {
+        case AT_LINE_ERROR:
+            totals.errors++;
+            break;
+        case AT_LINE_CME_ERROR:
+        case AT_LINE_CMS_ERROR:
+            if (response.errorCode == (response.kind == AT_LINE_CME_ERROR ? 30 : 313))
+            {
+                totals.retries++;
+            }
+            else
+            {
+                totals.errors++;
+            }
+            break;
+        case AT_LINE_CMT:
+            totals.texts += response.senderLength > 0;
+            break;
+        case AT_LINE_CREG:
+            if (response.lac != -1)
+            {
+                totals.lac += response.lac;
+                totals.cid += response.cid;
+            }
+            break;
+        case AT_LINE_COPS:
+            if (response.mcc != -1)
+            {
+                totals.mcc += response.mcc;
+                totals.mnc += response.mnc;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void printTotals(const char* name, const Totals& totals, double nanoseconds)
+{
+    printf("%-10s %7.1f ns/line  errors %ld retries %ld texts %ld lac %ld cid %ld mcc %ld mnc %ld\n",
+        name, nanoseconds / ((double)lineCount * REPEATS), totals.errors / REPEATS, totals.retries / REPEATS,
+        totals.texts / REPEATS, totals.lac / REPEATS, totals.cid / REPEATS, totals.mcc / REPEATS, totals.mnc / REPEATS);
+}
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!readTranscript(argv[i]))
+        {
+            fprintf(stderr, "Cannot read %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (lineCount == 0)
+    {
+        for (size_t i = 0; i < sizeof(recordedTranscript) / sizeof(recordedTranscript[0]); i++)
+        {
+            addLine(recordedTranscript[i]);
+        }
+    }
+    printf("%d lines, %d times over\n", lineCount, REPEATS);
+    
+    Totals strstrTotals;
+    memset(&strstrTotals, 0, sizeof(strstrTotals));
+    double start = nanosecondsNow();
+    for (int repeat = 0; repeat < REPEATS; repeat++)
+    {
+        for (int i = 0; i < lineCount; i++)
+        {
+            parseWithStrstr(lines[i], strstrTotals);
+        }
+    }
+    printTotals("strstr", strstrTotals, nanosecondsNow() - start);
+    
+    Totals tokenizerTotals;
+    memset(&tokenizerTotals, 0, sizeof(tokenizerTotals));
+    start = nanosecondsNow();
+    for (int repeat = 0; repeat < REPEATS; repeat++)
+    {
+        for (int i = 0; i < lineCount; i++)
+        {
+            parseWithTokenizer(lines[i], lineLengths[i], tokenizerTotals);
+        }
+    }
+    printTotals("tokenizer", tokenizerTotals, nanosecondsNow() - start);
+    return 0;
+}
@@ -1,36 +1,623 @@
 #include "CellDriver.h"
+#include "SmsPdu.h"
+#include <string.h>
 
-CellDriver::CellDriver(ISerial serial)
+// Ends the body of a text message
+#define CELL_END_OF_TEXT 26
+
+// Cancels a text message the module is prompting for
+#define CELL_ESCAPE 27
+
+// How many octets of a PDU are written at once, as hex
+#define CELL_PDU_CHUNK_OCTETS 16
+
+// What the module says when it has no service yet, and the command is worth trying again later
+#define CELL_CME_NO_SERVICE 30
+#define CELL_CMS_NO_SERVICE 313
+
+// The commands that set the module up, in order
+static const char* const setupCommands[] = {
+    // Text mode for text messages
+    "AT+CMGF=1",
+    // Plain 7-bit text
+    "AT+CSMP=,,,0",
+    // Delete every stored message
+    "AT+CMGD=1,4",
+    // Choose a network automatically, then ask which one it chose
+    "AT+COPS=0",
+    "AT+COPS?",
+    // Pass new text messages straight through as +CMT
+    "AT+CNMI=3,3,0,0",
+    // Report the location area and cell with every +CREG
+    "AT+CREG=2"
+};
+
+// Copies source into destination, cut off to fit and always null terminated
+static void copyString(char* destination, const char* source, size_t bufferSize)
 {
-    
+    if (bufferSize == 0)
+    {
+        return;
+    }
+    size_t length = strlen(source);
+    if (length >= bufferSize)
+    {
+        length = bufferSize - 1;
+    }
+    memcpy(destination, source, length);
+    destination[length] = '\0';
+}
+
+CellDriver::CellDriver(ISerial& serial, uint32_t (*millisecondsNow)(), ISerial* echo)
+    : serial(serial),
+      framer(serial, echo),
+      millisecondsNow(millisecondsNow),
+      started(false),
+      state(STATE_IDLE),
+      waitStartTime(0),
+      waitMilliseconds(0),
+      lastLineTime(0),
+      commandStart(0),
+      commandCount(0),
+      outgoingLength(0),
+      outgoingBinary(false),
+      pduMode(false),
+      recipientCount(0),
+      sendingRecipient(0),
+      awaitingService(false),
+      serviceRetryTime(0),
+      awaitingIncomingText(false),
+      newTextMessage(false),
+      mcc(0),
+      mnc(0),
+      mncDigits(0),
+      lac(0),
+      cid(0),
+      textMessagesSent(0),
+      textMessagesFailed(0)
+{
+    outgoingText[0] = '\0';
+    incomingSender[0] = '\0';
+    incomingText[0] = '\0';
 }
 
 bool CellDriver::readyToSendTextMessage() const
 {
+    // The message cannot change under a recipient it is going out to, even one trying it again,
+    // since the module has already been told who it is for and, in PDU mode, how long it is
+    if (state == STATE_AWAITING_PROMPT || state == STATE_AWAITING_SEND_CONFIRM)
+    {
+        return false;
+    }
     
+    // Recipients that are only waiting to try again do not hold up the next message
+    for (uint8_t i = 0; i < recipientCount; i++)
+    {
+        if (recipients[i].failures == 0)
+        {
+            return false;
+        }
+    }
+    return true;
 }
 
 void CellDriver::queueTextMessage(const char* recipientPhoneNumber, const char* textMessage)
 {
+    queueTextMessage(&recipientPhoneNumber, 1, textMessage);
+}
+
+void CellDriver::queueTextMessage(const char* const recipientPhoneNumbers[], uint8_t recipientCount,
+    const char* textMessage)
+{
+    size_t length = strlen(textMessage);
+    if (length >= sizeof(outgoingText))
+    {
+        length = sizeof(outgoingText) - 1;
+    }
+    queueMessage(recipientPhoneNumbers, recipientCount, (const uint8_t*)textMessage, length, false);
+}
+
+void CellDriver::queueBinaryMessage(const char* const recipientPhoneNumbers[], uint8_t recipientCount,
+    const uint8_t* data, size_t length)
+{
+    if (length > SMS_MAX_USER_DATA)
+    {
+        length = SMS_MAX_USER_DATA;
+    }
+    queueMessage(recipientPhoneNumbers, recipientCount, data, length, true);
+}
+
+void CellDriver::queueMessage(const char* const recipientPhoneNumbers[], uint8_t recipientCount,
+    const uint8_t* data, size_t length, bool binary)
+{
+    if (!readyToSendTextMessage())
+    {
+        return;
+    }
+    
+    // Anyone still waiting to try the last message again gets this one instead, when their time comes,
+    // since it is newer
+    memcpy(outgoingText, data, length);
+    outgoingText[length] = '\0';
+    outgoingLength = length;
+    outgoingBinary = binary;
     
+    uint32_t now = millisecondsNow();
+    for (uint8_t i = 0; i < recipientCount; i++)
+    {
+        const char* phoneNumber = recipientPhoneNumbers[i];
+        bool waiting = false;
+        for (uint8_t j = 0; j < this->recipientCount && !waiting; j++)
+        {
+            waiting = strncmp(recipients[j].phoneNumber, phoneNumber, CELL_PHONE_NUMBER_SIZE - 1) == 0;
+        }
+        if (waiting)
+        {
+            continue;
+        }
+        if (this->recipientCount == CELL_MAX_RECIPIENTS)
+        {
+            textMessagesFailed++;
+            continue;
+        }
+        Recipient& recipient = recipients[this->recipientCount++];
+        copyString(recipient.phoneNumber, phoneNumber, sizeof(recipient.phoneNumber));
+        recipient.failures = 0;
+        recipient.retryTime = now;
+    }
 }
 
 bool CellDriver::update()
 {
+    uint32_t now = millisecondsNow();
+    if (!started)
+    {
+        started = true;
+        lastLineTime = now;
+        queueSetup();
+    }
     
+    newTextMessage = false;
+    readModule(now);
+    
+    // A module that has said nothing for this long has probably been reset, or lost power
+    if (now - lastLineTime >= CELL_SILENCE_TIMEOUT_MILLISECONDS)
+    {
+        lastLineTime = now;
+        queueSetup();
+    }
+    
+    if (now - waitStartTime >= waitMilliseconds)
+    {
+        if (state == STATE_IDLE)
+        {
+            // Commands come first, since text messages may need them done
+            if (commandCount > 0)
+            {
+                sendCommand(now);
+            }
+            else
+            {
+                startText(now);
+            }
+        }
+        else if (state == STATE_AWAITING_RESULT)
+        {
+            retryCommand(now, CELL_COMMAND_GAP_MILLISECONDS);
+        }
+        else
+        {
+            if (state == STATE_AWAITING_PROMPT)
+            {
+                // In case the prompt came and we missed it, get the module out of it
+                serial.writeByte(CELL_ESCAPE);
+            }
+            finishText(false, false, now);
+        }
+    }
+    
+    return newTextMessage;
 }
 
 void CellDriver::getTextMessage(char* destination, size_t bufferSize) const
 {
-    
+    copyString(destination, incomingText, bufferSize);
+}
+
+void CellDriver::getTextMessageSender(char* destination, size_t bufferSize) const
+{
+    copyString(destination, incomingSender, bufferSize);
 }
 
 int32_t CellDriver::getCID() const
 {
-    
+    return cid;
 }
 
 int32_t CellDriver::getMCC() const
 {
+    return mcc;
+}
+
+int32_t CellDriver::getMNC() const
+{
+    return mnc;
+}
+
+int32_t CellDriver::getMNCDigits() const
+{
+    return mncDigits;
+}
+
+int32_t CellDriver::getLAC() const
+{
+    return lac;
+}
+
+uint32_t CellDriver::getTextMessagesSent() const
+{
+    return textMessagesSent;
+}
+
+uint32_t CellDriver::getTextMessagesFailed() const
+{
+    return textMessagesFailed;
+}
+
+uint8_t CellDriver::getTextMessagesPending() const
+{
+    return recipientCount;
+}
+
+bool CellDriver::queueCommand(const char* text, uint8_t retries)
+{
+    if (commandCount == CELL_COMMAND_QUEUE_SIZE)
+    {
+        return false;
+    }
+    Command& command = commands[(commandStart + commandCount) % CELL_COMMAND_QUEUE_SIZE];
+    copyString(command.text, text, sizeof(command.text));
+    command.retriesLeft = retries;
+    commandCount++;
+    return true;
+}
+
+void CellDriver::queueSetup()
+{
+    // Whatever was in progress is abandoned, and the module gets a moment before the first command
+    commandCount = 0;
+    idleFor(millisecondsNow(), CELL_COMMAND_GAP_MILLISECONDS);
+    awaitingIncomingText = false;
+    // The setup puts the module in text mode
+    pduMode = false;
+    
+    for (size_t i = 0; i < sizeof(setupCommands) / sizeof(setupCommands[0]); i++)
+    {
+        queueCommand(setupCommands[i], CELL_COMMAND_RETRIES);
+    }
+}
+
+void CellDriver::readModule(uint32_t now)
+{
+    // Lines too long to keep are handled all the same: the start of a text message is still worth having,
+    // and a cut off result is no result we know of
+    LineView line;
+    while (framer.nextLine(line))
+    {
+        handleLine(line.text, line.length, now);
+    }
+    
+    // The prompt for the body of a text message does not end in a line break
+    if (state == STATE_AWAITING_PROMPT && framer.takePrompt('>'))
+    {
+        if (outgoingBinary)
+        {
+            // The whole PDU goes as hex, a few octets at a time to keep the stack small
+            uint8_t pdu[SMS_MAX_PDU_OCTETS];
+            size_t pduLength = encodeOutgoing(pdu);
+            char hex[2 * CELL_PDU_CHUNK_OCTETS + 1];
+            for (size_t i = 0; i < pduLength; i += CELL_PDU_CHUNK_OCTETS)
+            {
+                size_t chunk = pduLength - i < CELL_PDU_CHUNK_OCTETS ? pduLength - i : CELL_PDU_CHUNK_OCTETS;
+                smsHexFromOctets(pdu + i, chunk, hex);
+                serial.write((const int8_t*)hex, 2 * chunk);
+            }
+        }
+        else
+        {
+            serial.write((const int8_t*)outgoingText, outgoingLength);
+        }
+        serial.writeByte(CELL_END_OF_TEXT);
+        state = STATE_AWAITING_SEND_CONFIRM;
+        waitStartTime = now;
+        waitMilliseconds = CELL_SEND_TIMEOUT_MILLISECONDS;
+    }
+}
+
+void CellDriver::handleLine(const char* line, size_t length, uint32_t now)
+{
+    lastLineTime = now;
+    
+    // The line after a +CMT header is the text message itself
+    if (awaitingIncomingText)
+    {
+        awaitingIncomingText = false;
+        if (incomingSender[0] != '\0')
+        {
+            copyString(incomingText, line, sizeof(incomingText));
+            newTextMessage = true;
+        }
+        else
+        {
+            // In PDU mode the header has no sender, and the line is the whole message in hex.
+            // Commands come as text, so a binary message is of no use to us.
+            uint8_t pdu[SMS_MAX_PDU_OCTETS];
+            SmsMessage message;
+            size_t pduLength = smsOctetsFromHex(line, length, pdu, sizeof(pdu));
+            if (pduLength > 0 && decodeSms(pdu, pduLength, message) && message.encoding == SMS_ENCODING_7BIT)
+            {
+                copyString(incomingSender, message.address, sizeof(incomingSender));
+                copyString(incomingText, (const char*)message.data, sizeof(incomingText));
+                newTextMessage = true;
+            }
+        }
+        
+        // Keep the module's storage from filling up
+        queueCommand("AT+CMGD=1,4", CELL_COMMAND_RETRIES);
+        return;
+    }
+    
+    AtResponse response;
+    parseAtResponse(line, length, response);
+    
+    // News from the module is handled whatever command is in progress
+    ResponseHandler handler = responseHandlers[response.kind];
+    if (handler)
+    {
+        (this->*handler)(response);
+    }
+    
+    if (state == STATE_IDLE)
+    {
+        return;
+    }
     
-}
\ No newline at end of file
+    switch (response.kind)
+    {
+        case AT_LINE_OK:
+            // While prompting, OK is only the module finishing something else
+            if (state == STATE_AWAITING_RESULT)
+            {
+                finishCommand(true, now);
+            }
+            else if (state == STATE_AWAITING_SEND_CONFIRM)
+            {
+                finishText(true, false, now);
+            }
+            break;
+        
+        case AT_LINE_ERROR:
+        case AT_LINE_CME_ERROR:
+        case AT_LINE_CMS_ERROR:
+        {
+            bool noService = response.kind != AT_LINE_ERROR && response.errorCode ==
+                (response.kind == AT_LINE_CME_ERROR ? CELL_CME_NO_SERVICE : CELL_CMS_NO_SERVICE);
+            if (state == STATE_AWAITING_RESULT)
+            {
+                retryCommand(now, noService ? CELL_NO_SERVICE_BACKOFF_MILLISECONDS : CELL_COMMAND_GAP_MILLISECONDS);
+            }
+            else
+            {
+                finishText(false, noService, now);
+            }
+            break;
+        }
+        
+        default:
+            break;
+    }
+}
+
+// Indexed by the kind of line
+const CellDriver::ResponseHandler CellDriver::responseHandlers[AT_LINE_KIND_COUNT] = {
+    /* AT_LINE_OTHER */ NULL,
+    /* AT_LINE_OK */ NULL,
+    /* AT_LINE_ERROR */ NULL,
+    /* AT_LINE_CME_ERROR */ NULL,
+    /* AT_LINE_CMS_ERROR */ NULL,
+    /* AT_LINE_CMT */ &CellDriver::handleIncomingText,
+    /* AT_LINE_CMGS */ NULL,
+    /* AT_LINE_CREG */ &CellDriver::handleRegistration,
+    /* AT_LINE_COPS */ &CellDriver::handleOperator
+};
+
+void CellDriver::handleIncomingText(const AtResponse& response)
+{
+    size_t length = response.senderLength;
+    if (length >= sizeof(incomingSender))
+    {
+        length = sizeof(incomingSender) - 1;
+    }
+    memcpy(incomingSender, response.sender, length);
+    incomingSender[length] = '\0';
+    awaitingIncomingText = true;
+}
+
+void CellDriver::handleRegistration(const AtResponse& response)
+{
+    // Only some +CREG lines say where we are
+    if (response.lac != -1)
+    {
+        lac = response.lac;
+        cid = response.cid;
+    }
+}
+
+void CellDriver::handleOperator(const AtResponse& response)
+{
+    // A named operator has no codes
+    if (response.mcc != -1)
+    {
+        mcc = response.mcc;
+        mnc = response.mnc;
+        mncDigits = response.mncDigits;
+    }
+}
+
+void CellDriver::finishCommand(bool succeeded, uint32_t now)
+{
+    if (!succeeded)
+    {
+        // The module is not in the state we need it in, so set it up again
+        queueSetup();
+        return;
+    }
+    
+    commandStart = (commandStart + 1) % CELL_COMMAND_QUEUE_SIZE;
+    commandCount--;
+    idleFor(now, CELL_COMMAND_GAP_MILLISECONDS);
+}
+
+void CellDriver::retryCommand(uint32_t now, uint32_t delayMilliseconds)
+{
+    Command& command = commands[commandStart];
+    if (command.retriesLeft == 0)
+    {
+        finishCommand(false, now);
+        return;
+    }
+    command.retriesLeft--;
+    idleFor(now, delayMilliseconds);
+}
+
+void CellDriver::sendCommand(uint32_t now)
+{
+    const Command& command = commands[commandStart];
+    serial.write((const int8_t*)command.text, strlen(command.text));
+    serial.writeByte('\r');
+    
+    state = STATE_AWAITING_RESULT;
+    waitStartTime = now;
+    waitMilliseconds = CELL_COMMAND_TIMEOUT_MILLISECONDS;
+}
+
+bool CellDriver::startText(uint32_t now)
+{
+    if (awaitingService)
+    {
+        if ((int32_t)(now - serviceRetryTime) < 0)
+        {
+            return false;
+        }
+        awaitingService = false;
+    }
+    
+    // The first recipient that is due, so that one who keeps failing does not hold up the rest
+    for (uint8_t i = 0; i < recipientCount; i++)
+    {
+        if ((int32_t)(now - recipients[i].retryTime) >= 0)
+        {
+            // Switch the module to the mode the message goes out in first
+            if (outgoingBinary != pduMode)
+            {
+                if (queueCommand(outgoingBinary ? "AT+CMGF=0" : "AT+CMGF=1", CELL_COMMAND_RETRIES))
+                {
+                    pduMode = outgoingBinary;
+                }
+                return false;
+            }
+            
+            sendingRecipient = i;
+            if (outgoingBinary)
+            {
+                // In PDU mode the module wants the length of the PDU, not the recipient
+                uint8_t pdu[SMS_MAX_PDU_OCTETS];
+                size_t pduLength = encodeOutgoing(pdu);
+                if (pduLength == 0)
+                {
+                    // Trying again will not make the number any better
+                    recipients[i].failures = CELL_TEXT_RETRIES;
+                    finishText(false, false, now);
+                    return false;
+                }
+                size_t transferLength = smsTransferLength(pdu, pduLength);
+                char digits[3] = { (char)('0' + transferLength / 100), (char)('0' + transferLength / 10 % 10),
+                    (char)('0' + transferLength % 10) };
+                // It is at most three digits, without leading zeros
+                size_t skip = transferLength < 10 ? 2 : transferLength < 100 ? 1 : 0;
+                serial.write((const int8_t*)"AT+CMGS=", 8);
+                serial.write((const int8_t*)digits + skip, 3 - skip);
+                serial.writeByte('\r');
+            }
+            else
+            {
+                const char* phoneNumber = recipients[i].phoneNumber;
+                serial.write((const int8_t*)"AT+CMGS=\"", 9);
+                serial.write((const int8_t*)phoneNumber, strlen(phoneNumber));
+                serial.write((const int8_t*)"\"\r", 2);
+            }
+            
+            state = STATE_AWAITING_PROMPT;
+            waitStartTime = now;
+            waitMilliseconds = CELL_COMMAND_TIMEOUT_MILLISECONDS;
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t CellDriver::encodeOutgoing(uint8_t* pdu) const
+{
+    return encodeSmsBinary(pdu, recipients[sendingRecipient].phoneNumber, (const uint8_t*)outgoingText,
+        outgoingLength);
+}
+
+void CellDriver::finishText(bool succeeded, bool noService, uint32_t now)
+{
+    Recipient& recipient = recipients[sendingRecipient];
+    bool done = true;
+    if (succeeded)
+    {
+        textMessagesSent++;
+    }
+    else if (noService)
+    {
+        // That is no fault of the recipient, and everyone has to wait for it
+        awaitingService = true;
+        serviceRetryTime = now + CELL_NO_SERVICE_BACKOFF_MILLISECONDS;
+        done = false;
+    }
+    else if (recipient.failures == CELL_TEXT_RETRIES)
+    {
+        textMessagesFailed++;
+    }
+    else
+    {
+        uint32_t backoff = CELL_TEXT_BACKOFF_MILLISECONDS << recipient.failures;
+        if (backoff > CELL_TEXT_MAX_BACKOFF_MILLISECONDS)
+        {
+            backoff = CELL_TEXT_MAX_BACKOFF_MILLISECONDS;
+        }
+        recipient.failures++;
+        recipient.retryTime = now + backoff;
+        done = false;
+    }
+    
+    if (done)
+    {
+        // Keep the rest in order
+        recipientCount--;
+        for (uint8_t i = sendingRecipient; i < recipientCount; i++)
+        {
+            recipients[i] = recipients[i + 1];
+        }
+    }
+    idleFor(now, CELL_TEXT_GAP_MILLISECONDS);
+}
+
+void CellDriver::idleFor(uint32_t now, uint32_t milliseconds)
+{
+    state = STATE_IDLE;
+    waitStartTime = now;
+    waitMilliseconds = milliseconds;
+}
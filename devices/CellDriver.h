@@ -1,8 +1,54 @@
+#include "ATResponse.h"
 #include "ISerial.h"
+#include "LineFramer.h"
 
 #ifndef CELL_DRIVER
 #define CELL_DRIVER
 
+// The longest line from the module that is kept whole, including the null byte. Longer lines are cut off.
+#define CELL_LINE_SIZE 256
+
+// How much of what the module sends is buffered while it is split into lines
+#define CELL_LINE_BUFFER_SIZE 512
+
+// The most commands that may wait to be sent to the module at once
+#define CELL_COMMAND_QUEUE_SIZE 12
+
+// The longest command, including the null byte
+#define CELL_COMMAND_SIZE 40
+
+// Phone numbers, including the null byte
+#define CELL_PHONE_NUMBER_SIZE 20
+
+// Text messages, including the null byte, which also holds the 140 octets of a binary message
+#define CELL_TEXT_SIZE 161
+
+// How long the module gets to answer a command, and to confirm a text message it is sending
+#define CELL_COMMAND_TIMEOUT_MILLISECONDS 1000UL
+#define CELL_SEND_TIMEOUT_MILLISECONDS 10000UL
+
+// How many times a command is sent again after a timeout or an error, before giving up on it,
+// and the same for a text message to each recipient
+#define CELL_COMMAND_RETRIES 3
+#define CELL_TEXT_RETRIES 5
+
+// The most recipients a text message may be queued for at once
+#define CELL_MAX_RECIPIENTS 8
+
+// How long to wait after a finished command before the next one, which the module likes,
+// and after a sent text message before the next, which it does not need
+#define CELL_COMMAND_GAP_MILLISECONDS 500UL
+#define CELL_TEXT_GAP_MILLISECONDS 100UL
+
+// How long to wait before trying a text message again after it fails for lack of service,
+// which holds up every recipient, and after it fails for one recipient, which doubles with each failure
+#define CELL_NO_SERVICE_BACKOFF_MILLISECONDS 1000UL
+#define CELL_TEXT_BACKOFF_MILLISECONDS 2000UL
+#define CELL_TEXT_MAX_BACKOFF_MILLISECONDS 60000UL
+
+// If the module sends nothing at all for this long, it is set up again from scratch
+#define CELL_SILENCE_TIMEOUT_MILLISECONDS (5UL * 60 * 1000)
+
 // Controls a serially connected cellular module
 class CellDriver
 {
@@ -15,18 +61,40 @@ class CellDriver
 	*/
     
     // Sets up this cell driver to communicate with the physical cellular module through the given serial device.
-    CellDriver(ISerial serial);
+    // The driver keeps a reference to the serial device, which must outlive it.
+    // millisecondsNow gives the time in milliseconds, such as Arduino's millis, and may wrap around.
+    // If echo is given, everything the module sends is also written to it, for watching the conversation.
+    // Nothing is sent until the first update.
+    CellDriver(ISerial& serial, uint32_t (*millisecondsNow)(), ISerial* echo = NULL);
     
     // True if this driver is ready to send another text message.
-    // This would be false if last queued message has not been sent yet.
+    // This would be false if last queued message has not been sent yet,
+    // to anyone not already waiting out a backoff after failing,
+    // or while it is going out to anyone, including someone trying it again.
     bool readyToSendTextMessage() const;
     
     // Starts the process of sending a text message to the cellular module.
     // This function should be asynchronous (that, is, it does not wait on the module's response.)
+    // The number and message are copied, cut off if they are too long.
+    // Does nothing if the driver is not ready to send another text message.
     void queueTextMessage(const char* recipientPhoneNumber, const char* textMessage);
     
+    // Starts sending the same text message to each of the given recipients, like queueTextMessage.
+    // The messages go out back to back, in order. A recipient whose message fails is tried again
+    // after a backoff, while the others carry on, and gets any newer message queued meanwhile instead.
+    // Recipients past CELL_MAX_RECIPIENTS count as failed.
+    void queueTextMessage(const char* const recipientPhoneNumbers[], uint8_t recipientCount, const char* textMessage);
+    
+    // Starts sending the given octets as a binary text message to each of the given recipients,
+    // like queueTextMessage. It goes out in PDU mode, and fits 140 octets, such as packed TelemetryRecords,
+    // where a text message fits 160 characters of 7 bits. Data past 140 octets is cut off.
+    void queueBinaryMessage(const char* const recipientPhoneNumbers[], uint8_t recipientCount,
+        const uint8_t* data, size_t length);
+    
     // Does incremental work on sending or receiving text messages.
     // This function should be called periodically.
+    // It never waits on the module: it handles whatever the module has already sent,
+    // and sends whatever is due, then returns.
     // Returns true if a new text message has just been made avaialable.
     bool update();
     
@@ -34,6 +102,9 @@ class CellDriver
     // guaranteeing that the destination string is null terminated.
     void getTextMessage(char* destination, size_t bufferSize) const;
     
+    // Copies the phone number the last received text message came from, like getTextMessage.
+    void getTextMessageSender(char* destination, size_t bufferSize) const;
+    
     // Gets the latest value from the module.
     int32_t getCID() const;
     
@@ -41,11 +112,154 @@ class CellDriver
     int32_t getMCC() const;
     
     // And whatever other relevant codes exist for triangulating location or something like that.
+    int32_t getMNC() const;
+    // The number of digits the MNC is written with, 2 or 3, since 01 and 001 are different networks
+    int32_t getMNCDigits() const;
+    int32_t getLAC() const;
+    
+    // The number of text messages sent, and given up on after all their retries
+    uint32_t getTextMessagesSent() const;
+    uint32_t getTextMessagesFailed() const;
+    
+    // The number of recipients text messages are still to be sent to, including those waiting out a backoff
+    uint8_t getTextMessagesPending() const;
 
 	private:
 
-	// Your code here
+	// What the driver is waiting on
+	enum State
+	{
+		// Nothing; the next command goes out once the gap after the last one has passed
+		STATE_IDLE,
+		// The final result of a command
+		STATE_AWAITING_RESULT,
+		// The > prompt for the body of a text message, after AT+CMGS
+		STATE_AWAITING_PROMPT,
+		// The +CMGS and OK that confirm a text message was sent
+		STATE_AWAITING_SEND_CONFIRM
+	};
+
+	struct Command
+	{
+		char text[CELL_COMMAND_SIZE];
+		uint8_t retriesLeft;
+	};
+
+	// Someone the queued text message is still to be sent to
+	struct Recipient
+	{
+		char phoneNumber[CELL_PHONE_NUMBER_SIZE];
+		// How many times sending to them has failed, and when to try them again
+		uint8_t failures;
+		uint32_t retryTime;
+	};
+
+	// Queues the given text or binary message for the given recipients
+	void queueMessage(const char* const recipientPhoneNumbers[], uint8_t recipientCount,
+		const uint8_t* data, size_t length, bool binary);
+
+	// Queues a command to be sent after those already queued
+	// Returns false if there is no room
+	bool queueCommand(const char* text, uint8_t retries);
+
+	// Empties the queue and queues the commands that set the module up.
+	// The text message carries on afterwards.
+	void queueSetup();
+
+	// Reads everything the module has sent, handling each whole line
+	void readModule(uint32_t now);
+
+	// Handles a whole line from the module, as the result of the current command or as news from the module
+	void handleLine(const char* line, size_t length, uint32_t now);
+
+	// Handle the lines that are news from the module, whatever command is in progress
+	typedef void (CellDriver::*ResponseHandler)(const AtResponse& response);
+	static const ResponseHandler responseHandlers[AT_LINE_KIND_COUNT];
+
+	// +CMT: the next line is a text message from this sender
+	void handleIncomingText(const AtResponse& response);
+
+	// +CREG: where we are
+	void handleRegistration(const AtResponse& response);
+
+	// +COPS: whose network we are on
+	void handleOperator(const AtResponse& response);
+
+	// Finishes the current command, successfully or not
+	void finishCommand(bool succeeded, uint32_t now);
+
+	// Sends the current command again, or gives up on it if it has no retries left
+	void retryCommand(uint32_t now, uint32_t delayMilliseconds);
+
+	// Sends the command at the front of the queue
+	void sendCommand(uint32_t now);
+
+	// Starts sending the text message to the first recipient that is due
+	// Returns false if none is
+	bool startText(uint32_t now);
+
+	// Builds the PDU of the binary message for the current recipient
+	// Returns its length, or 0 if their phone number will not do
+	size_t encodeOutgoing(uint8_t* pdu) const;
+
+	// Finishes sending the text message to the current recipient, successfully or not
+	void finishText(bool succeeded, bool noService, uint32_t now);
+
+	// Waits for the given time while idle
+	void idleFor(uint32_t now, uint32_t milliseconds);
+
+	// The serial device the module is connected through
+	ISerial& serial;
+
+	// Splits what the module sends into lines
+	LineFramer<CELL_LINE_BUFFER_SIZE, CELL_LINE_SIZE - 1> framer;
+
+	uint32_t (*millisecondsNow)();
+
+	// Whether update has been called yet, which sets the module up
+	bool started;
+
+	State state;
+	// When the current wait started, and how long it may last
+	uint32_t waitStartTime;
+	uint32_t waitMilliseconds;
+	// When the module last sent a whole line
+	uint32_t lastLineTime;
+
+	// The commands still to be sent, the front one being the one in progress while not idle
+	Command commands[CELL_COMMAND_QUEUE_SIZE];
+	uint8_t commandStart;
+	uint8_t commandCount;
+
+	// The text message being sent, and who it is still to be sent to, in order
+	char outgoingText[CELL_TEXT_SIZE];
+	// How long it is, and whether it is binary, which is sent in PDU mode
+	size_t outgoingLength;
+	bool outgoingBinary;
+	// Whether the module has been told to use PDU mode, rather than text mode
+	bool pduMode;
+	Recipient recipients[CELL_MAX_RECIPIENTS];
+	uint8_t recipientCount;
+	// The recipient being sent to while awaiting the prompt or the confirmation
+	uint8_t sendingRecipient;
+	// Until when nothing is sent for lack of service
+	bool awaitingService;
+	uint32_t serviceRetryTime;
+
+	// A +CMT header means the next line is the body of a received text message
+	bool awaitingIncomingText;
+	char incomingSender[CELL_PHONE_NUMBER_SIZE];
+	char incomingText[CELL_TEXT_SIZE];
+	bool newTextMessage;
+
+	int32_t mcc;
+	int32_t mnc;
+	int32_t mncDigits;
+	int32_t lac;
+	int32_t cid;
 
+	uint32_t textMessagesSent;
+	uint32_t textMessagesFailed;
 };
 
 #endif
@@ -0,0 +1,128 @@
+// Runs CellDriver against a simulated cellular module, on simulated time, and measures how many
+// text messages a minute it gets out to a list of recipients.
+// Build and run on a host:
+//     g++ -O2 -I. CellDriverFanoutTest.cpp CellDriver.cpp ATResponse.cpp SmsPdu.cpp SimulatedModem.cpp SimulatedLine.cpp -o fanouttest
+//     ./fanouttest
+// Each case is run twice: broadcasting to every recipient at once with the fan-out,
+// and queueing one recipient at a time, waiting for each to be sent or given up on, the way the sketch sends.
+// Then it checks that a message queued while a retry is going out does not change the one going out.
+#include "CellDriver.h"
+#include "SimulatedModem.h"
+#include <stdio.h>
+
+// How long each case runs for, and how often update is called
+#define RUN_MILLISECONDS (30UL * 60 * 1000)
+#define TICK_MILLISECONDS 10
+
+// How long the case that queues messages during a retry runs for
+#define RETRY_RUN_MILLISECONDS (2UL * 60 * 1000)
+
+// The baud rate the sketch talks to the module at
+#define CELL_BAUD_RATE 28800
+
+static uint32_t simulatedNow = 0;
+
+static uint32_t millisecondsNow()
+{
+    return simulatedNow;
+}
+
+static const char* const recipients[] = {
+    "12033470933", "14018649488", "14015550101", "14015550102", "14015550103", "14015550104", "14015550105"
+};
+static const uint8_t recipientCount = sizeof(recipients) / sizeof(recipients[0]);
+
+// Runs a case, and prints the messages a minute it managed
+static void run(const char* name, const SimulatedModemTrouble& trouble, bool fanOut)
+{
+    simulatedNow = 0;
+    SimulatedModem modem(millisecondsNow, CELL_BAUD_RATE);
+    modem.setTrouble(trouble);
+    CellDriver driver(modem, millisecondsNow);
+    
+    uint32_t broadcasts = 0;
+    uint8_t nextRecipient = recipientCount;
+    while (simulatedNow < RUN_MILLISECONDS)
+    {
+        driver.update();
+        if (fanOut && driver.readyToSendTextMessage())
+        {
+            driver.queueTextMessage(recipients, recipientCount, "Balloon at 41.31N 72.92W, 18200 m");
+            broadcasts++;
+        }
+        else if (!fanOut && driver.getTextMessagesPending() == 0)
+        {
+            if (nextRecipient == recipientCount)
+            {
+                nextRecipient = 0;
+                broadcasts++;
+            }
+            driver.queueTextMessage(recipients[nextRecipient++], "Balloon at 41.31N 72.92W, 18200 m");
+        }
+        simulatedNow += TICK_MILLISECONDS;
+    }
+    
+    double minutes = RUN_MILLISECONDS / 60000.0;
+    printf("%-24s %-10s %6.1f messages/minute  %4u sent  %3u given up  %3u broadcasts started\n",
+        name, fanOut ? "fan-out" : "one by one", driver.getTextMessagesSent() / minutes,
+        driver.getTextMessagesSent(), driver.getTextMessagesFailed(), broadcasts);
+}
+
+// Queues a new message whenever the driver is ready and the modem has been sent another command since,
+// while the first send fails and has to be tried again, so that the retry is going out while the next message
+// would be queued. Text messages and binary ones of two lengths take turns, so a message swapped in under
+// the retry would go out in the wrong mode, or as a PDU of another length than AT+CMGS gave.
+// Returns true if messages were sent and the modem rejected none of them.
+static bool queueDuringRetry()
+{
+    simulatedNow = 0;
+    SimulatedModem modem(millisecondsNow, CELL_BAUD_RATE);
+    modem.script("AT+CMGS", "\r\n+CMS ERROR: 500\r\n");
+    CellDriver driver(modem, millisecondsNow);
+    
+    const uint8_t shortData[10] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+    const uint8_t longData[20] = { 0 };
+    uint32_t queued = 0;
+    uint32_t commandsWhenQueued = 0;
+    while (simulatedNow < RETRY_RUN_MILLISECONDS)
+    {
+        driver.update();
+        if (driver.readyToSendTextMessage() && (queued == 0 || modem.getCommandsReceived() != commandsWhenQueued))
+        {
+            if (queued % 3 == 0)
+            {
+                driver.queueTextMessage(recipients, 1, "Balloon at 41.31N 72.92W, 18200 m");
+            }
+            else
+            {
+                driver.queueBinaryMessage(recipients, 1, queued % 3 == 1 ? shortData : longData,
+                    queued % 3 == 1 ? sizeof(shortData) : sizeof(longData));
+            }
+            queued++;
+            commandsWhenQueued = modem.getCommandsReceived();
+        }
+        simulatedNow += TICK_MILLISECONDS;
+    }
+    return driver.getTextMessagesSent() > 0 && modem.getTextsRejected() == 0;
+}
+
+int main()
+{
+    SimulatedModemTrouble clean = { 0, NULL, 0, 0 };
+    SimulatedModemTrouble lossy = { 10, NULL, 0, 0 };
+    SimulatedModemTrouble badRecipient = { 0, "14015550103", 0, 0 };
+    SimulatedModemTrouble outages = { 5, "14015550103", 2UL * 60 * 1000, 20UL * 1000 };
+    
+    printf("%d recipients, %lu simulated minutes each\n", recipientCount, RUN_MILLISECONDS / 60000);
+    for (int fanOut = 1; fanOut >= 0; fanOut--)
+    {
+        run("clean", clean, fanOut);
+        run("10% failures", lossy, fanOut);
+        run("one bad recipient", badRecipient, fanOut);
+        run("bad recipient, outages", outages, fanOut);
+    }
+    
+    bool passed = queueDuringRetry();
+    printf("\n%s: a message queued while a retry is going out waits for it\n", passed ? "pass" : "FAIL");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,445 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef FIXED_POINT
+#define FIXED_POINT
+
+// The raw types a FixedPoint can be kept in, each with the largest value it may hold
+// and a wider type that products and sums are worked out in before they are saturated
+template <typename Raw>
+struct FixedPointRaw;
+
+template <>
+struct FixedPointRaw<int16_t>
+{
+    typedef int32_t Wide;
+    // INT16_MAX and INT32_MAX are not there in C++ before C++11 without __STDC_LIMIT_MACROS
+    static const int16_t largest = 0x7FFF;
+};
+
+template <>
+struct FixedPointRaw<int32_t>
+{
+    typedef int64_t Wide;
+    static const int32_t largest = 0x7FFFFFFF;
+};
+
+// The number of digits after the decimal point of a power of ten scale, so FixedPointDigits<1000>::value is 3.
+// A scale that is not a power of ten does not compile.
+template <int32_t Scale>
+struct FixedPointDigits
+{
+    typedef char scaleIsAPowerOfTen[Scale % 10 == 0 ? 1 : -1];
+    enum { value = 1 + FixedPointDigits<Scale / 10>::value };
+};
+
+template <>
+struct FixedPointDigits<1>
+{
+    enum { value = 0 };
+};
+
+// A factor to change the units of a FixedPoint by, such as from knots to meters/second
+struct UnitRatio
+{
+    int32_t numerator;
+    int32_t denominator;
+};
+
+const UnitRatio knotsToMetersPerSecond = { 463, 900 };
+const UnitRatio kilometersPerHourToMetersPerSecond = { 5, 18 };
+const UnitRatio feetToMeters = { 381, 1250 };
+const UnitRatio minutesToDegrees = { 1, 60 };
+const UnitRatio degreesToMinutes = { 60, 1 };
+
+// A number with its decimal point fixed at the Scale place, kept as a whole number of 1/Scale,
+// so 21.5 at a Scale of 1000 is kept as 21500. Arithmetic is all on whole numbers,
+// so nothing needs floating point, which the AVR has to do in software.
+// Results that do not fit saturate at the largest or smallest value, instead of wrapping around.
+// The raw value below the smallest (INT32_MIN for an int32_t) is kept for missing values,
+// such as a reading that could not be taken, and anything worked out from one is missing too.
+// Scale is a power of ten, up to the most the raw type can hold.
+// The Scale and its digits are worked out when compiling; there is no constexpr before C++11,
+// so the values themselves are made when the program runs, by inline functions.
+template <typename Raw, int32_t Scale>
+class FixedPoint
+{
+    public:
+    
+    typedef typename FixedPointRaw<Raw>::Wide Wide;
+    
+    enum { scale = Scale, digits = FixedPointDigits<Scale>::value };
+    
+    // Zero
+    FixedPoint()
+        : raw(0)
+    {
+    }
+    
+    // The number with the given raw value, so fromRaw(21500) is 21.5 at a Scale of 1000
+    static FixedPoint fromRaw(Raw raw)
+    {
+        FixedPoint value;
+        value.raw = raw;
+        return value;
+    }
+    
+    // The given whole number
+    static FixedPoint fromInteger(Wide whole)
+    {
+        return fromWide(whole * Scale);
+    }
+    
+    // numerator / denominator, rounded to the nearest 1/Scale, or missing if denominator is 0
+    static FixedPoint fromRatio(Wide numerator, Wide denominator)
+    {
+        if (denominator == 0)
+        {
+            return missing();
+        }
+        return fromWide(divideRounded(numerator * Scale, denominator));
+    }
+    
+    // A value that could not be had
+    static FixedPoint missing()
+    {
+        return fromRaw((Raw)(-FixedPointRaw<Raw>::largest - 1));
+    }
+    
+    // The largest and smallest values, which results saturate at
+    static FixedPoint largest()
+    {
+        return fromRaw(FixedPointRaw<Raw>::largest);
+    }
+    
+    static FixedPoint smallest()
+    {
+        return fromRaw(-FixedPointRaw<Raw>::largest);
+    }
+    
+    Raw getRaw() const
+    {
+        return raw;
+    }
+    
+    bool isMissing() const
+    {
+        return raw == missing().raw;
+    }
+    
+    // The whole part, cut toward zero
+    Raw getInteger() const
+    {
+        return raw / Scale;
+    }
+    
+    FixedPoint operator+(const FixedPoint& other) const
+    {
+        if (isMissing() || other.isMissing())
+        {
+            return missing();
+        }
+        return fromWide((Wide)raw + other.raw);
+    }
+    
+    FixedPoint operator-(const FixedPoint& other) const
+    {
+        if (isMissing() || other.isMissing())
+        {
+            return missing();
+        }
+        return fromWide((Wide)raw - other.raw);
+    }
+    
+    FixedPoint operator-() const
+    {
+        // The smallest value is the negative of the largest, so only missing values cannot be negated
+        return isMissing() ? missing() : fromRaw(-raw);
+    }
+    
+    // Rounded to the nearest 1/Scale
+    FixedPoint operator*(const FixedPoint& other) const
+    {
+        if (isMissing() || other.isMissing())
+        {
+            return missing();
+        }
+        return fromWide(divideRounded((Wide)raw * other.raw, Scale));
+    }
+    
+    // Rounded to the nearest 1/Scale, or missing if other is 0
+    FixedPoint operator/(const FixedPoint& other) const
+    {
+        if (isMissing() || other.isMissing() || other.raw == 0)
+        {
+            return missing();
+        }
+        return fromWide(divideRounded((Wide)raw * Scale, other.raw));
+    }
+    
+    FixedPoint& operator+=(const FixedPoint& other)
+    {
+        return *this = *this + other;
+    }
+    
+    FixedPoint& operator-=(const FixedPoint& other)
+    {
+        return *this = *this - other;
+    }
+    
+    // Missing values equal each other, and are less than any other value
+    bool operator==(const FixedPoint& other) const
+    {
+        return raw == other.raw;
+    }
+    
+    bool operator!=(const FixedPoint& other) const
+    {
+        return raw != other.raw;
+    }
+    
+    bool operator<(const FixedPoint& other) const
+    {
+        return raw < other.raw;
+    }
+    
+    bool operator<=(const FixedPoint& other) const
+    {
+        return raw <= other.raw;
+    }
+    
+    bool operator>(const FixedPoint& other) const
+    {
+        return raw > other.raw;
+    }
+    
+    bool operator>=(const FixedPoint& other) const
+    {
+        return raw >= other.raw;
+    }
+    
+    // Changes the units, such as scaledBy(knotsToMetersPerSecond), rounded to the nearest 1/Scale
+    FixedPoint scaledBy(const UnitRatio& ratio) const
+    {
+        if (isMissing() || ratio.denominator == 0)
+        {
+            return missing();
+        }
+        return fromWide(divideRounded((Wide)raw * ratio.numerator, ratio.denominator));
+    }
+    
+    // The same value at another scale, such as more decimal places for working in, or fewer to send
+    template <int32_t OtherScale>
+    FixedPoint<Raw, OtherScale> rescaled() const
+    {
+        typedef FixedPoint<Raw, OtherScale> Other;
+        if (isMissing())
+        {
+            return Other::missing();
+        }
+        if (OtherScale >= Scale)
+        {
+            return Other::fromWide((Wide)raw * (OtherScale / Scale));
+        }
+        // Kept from dividing by 0 when compiling the branch above
+        return Other::fromWide(divideRounded(raw, Scale / OtherScale > 0 ? Scale / OtherScale : 1));
+    }
+    
+    // Parses a decimal number, such as -12.345, from text, which need not end after it.
+    // Digits past the Scale place are rounded, and numbers too large to hold saturate.
+    // There is no floating point and no division, only a multiply by 10 for each digit.
+    // Returns the character after the number, or NULL if text does not start with one,
+    // in which case value is left alone.
+    static const char* parse(const char* text, FixedPoint& value)
+    {
+        const char* character = text;
+        bool negative = *character == '-';
+        if (*character == '-' || *character == '+')
+        {
+            character++;
+        }
+        
+        // Past this, the whole part cannot fit whatever the fraction is, so stop adding digits to it
+        const Wide tooLarge = (Wide)FixedPointRaw<Raw>::largest / Scale + 1;
+        Wide whole = 0;
+        bool anyDigits = false;
+        for (; *character >= '0' && *character <= '9'; character++)
+        {
+            anyDigits = true;
+            if (whole < tooLarge)
+            {
+                whole = whole * 10 + (*character - '0');
+            }
+        }
+        
+        Wide fraction = 0;
+        if (*character == '.')
+        {
+            character++;
+            int32_t place = 0;
+            for (; *character >= '0' && *character <= '9'; character++, place++)
+            {
+                anyDigits = true;
+                if (place < digits)
+                {
+                    fraction = fraction * 10 + (*character - '0');
+                }
+                else if (place == digits && *character >= '5')
+                {
+                    // Half a place up or more rounds away from zero
+                    fraction++;
+                }
+            }
+            // Fewer digits than the Scale has places
+            for (; place < digits; place++)
+            {
+                fraction *= 10;
+            }
+        }
+        if (!anyDigits)
+        {
+            return NULL;
+        }
+        
+        Wide total = whole * Scale + fraction;
+        value = fromWide(negative ? -total : total);
+        return character;
+    }
+    
+    // Writes the number into destination as decimal text, such as -12.345, with the given number of places
+    // after the decimal point (rounded), up to all of those the Scale has, and none at all for 0.
+    // Digits are found by subtracting powers of ten, not by dividing, which the AVR does slowly.
+    // Missing values are written as nothing.
+    // Returns the number of characters written, not including the null byte, or 0 if they do not fit.
+    size_t format(char* destination, size_t size, int32_t places = digits) const
+    {
+        if (size == 0)
+        {
+            return 0;
+        }
+        destination[0] = '\0';
+        if (isMissing())
+        {
+            return 0;
+        }
+        if (places > digits)
+        {
+            places = digits;
+        }
+        if (places < 0)
+        {
+            places = 0;
+        }
+        
+        static const uint32_t powersOfTen[] =
+        {
+            1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL, 10000UL, 1000UL, 100UL, 10UL, 1UL
+        };
+        const int32_t powerCount = sizeof(powersOfTen) / sizeof(powersOfTen[0]);
+        
+        // The largest raw value, rounded up, is still well within a uint32_t
+        uint32_t magnitude = raw < 0 ? (uint32_t)(-(Wide)raw) : (uint32_t)raw;
+        if (places < digits)
+        {
+            magnitude += 5 * powersOfTen[powerCount - digits + places];
+        }
+        
+        char text[16];
+        size_t length = 0;
+        if (raw < 0)
+        {
+            text[length++] = '-';
+        }
+        // The power of ten of the units digit, and of the last digit to be written
+        const int32_t units = powerCount - 1 - digits;
+        const int32_t last = units + places;
+        bool started = false;
+        bool anyNonZero = false;
+        for (int32_t power = 0; power <= last; power++)
+        {
+            char digit = '0';
+            while (magnitude >= powersOfTen[power])
+            {
+                magnitude -= powersOfTen[power];
+                digit++;
+            }
+            if (power == units + 1)
+            {
+                text[length++] = '.';
+            }
+            // Leading zeros are left off, but there is always a units digit
+            if (started || digit != '0' || power >= units)
+            {
+                started = true;
+                anyNonZero = anyNonZero || digit != '0';
+                text[length++] = digit;
+            }
+        }
+        
+        // A negative number that rounded to zero
+        if (raw < 0 && !anyNonZero)
+        {
+            for (size_t i = 1; i < length; i++)
+            {
+                text[i - 1] = text[i];
+            }
+            length--;
+        }
+        if (length >= size)
+        {
+            return 0;
+        }
+        for (size_t i = 0; i < length; i++)
+        {
+            destination[i] = text[i];
+        }
+        destination[length] = '\0';
+        return length;
+    }
+    
+    // Saturates a wider value into the range of the raw type, which leaves out the missing value.
+    // Public only so that FixedPoints of other scales can make one.
+    static FixedPoint fromWide(Wide value)
+    {
+        if (value > FixedPointRaw<Raw>::largest)
+        {
+            return largest();
+        }
+        if (value < -(Wide)FixedPointRaw<Raw>::largest)
+        {
+            return smallest();
+        }
+        return fromRaw((Raw)value);
+    }
+    
+    private:
+    
+    // numerator / denominator, rounded half away from zero.
+    // The AVR divides 64-bit numbers with a slow libgcc call, so when both fit in 30 bits,
+    // as most products of readings do, the division is done in 32 bits.
+    static Wide divideRounded(Wide numerator, Wide denominator)
+    {
+        if (denominator < 0)
+        {
+            numerator = -numerator;
+            denominator = -denominator;
+        }
+        const Wide narrow = 0x3FFFFFFF;
+        if (numerator >= -narrow && numerator <= narrow && denominator <= narrow)
+        {
+            int32_t narrowNumerator = (int32_t)numerator;
+            int32_t narrowDenominator = (int32_t)denominator;
+            int32_t narrowHalf = narrowDenominator / 2;
+            return (narrowNumerator < 0 ? narrowNumerator - narrowHalf : narrowNumerator + narrowHalf) / narrowDenominator;
+        }
+        Wide half = denominator / 2;
+        return (numerator < 0 ? numerator - half : numerator + half) / denominator;
+    }
+    
+    Raw raw;
+};
+
+// The fixed point the device interfaces give their readings in, with the decimal point fixed at the 1000s place
+typedef FixedPoint<int32_t, 1000> Fixed1000;
+
+#endif
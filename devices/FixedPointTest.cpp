@@ -0,0 +1,264 @@
+// Checks FixedPoint's arithmetic, parsing and formatting, and the decoders that read with it,
+// then times parsing and formatting against the C library's floating point.
+// Build and run on a host:
+//     g++ -O2 -I. FixedPointTest.cpp NmeaSentence.cpp GPSDecoder.cpp IMUDecoder.cpp SimulatedNmea.cpp
+//         SimulatedLine.cpp -o fixedpointtest
+//     ./fixedpointtest
+#include "FixedPoint.h"
+#include "GPSDecoder.h"
+#include "IMUDecoder.h"
+#include "SimulatedNmea.h"
+#include "HostTest.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TIMED_NUMBERS 1000000
+
+// Parses text, giving missing if it is not a number
+static Fixed1000 parsed(const char* text)
+{
+    Fixed1000 value = Fixed1000::missing();
+    Fixed1000::parse(text, value);
+    return value;
+}
+
+// Formats a value into a buffer kept until the next call
+static const char* formatted(Fixed1000 value, int32_t places = Fixed1000::digits)
+{
+    static char text[20];
+    value.format(text, sizeof(text), places);
+    return text;
+}
+
+static void testArithmetic()
+{
+    Fixed1000 a = Fixed1000::fromRaw(21500);
+    Fixed1000 b = Fixed1000::fromInteger(-2);
+    check((a + b).getRaw() == 19500 && (a - b).getRaw() == 23500, "adds and subtracts");
+    check((a * b).getRaw() == -43000 && (a / b).getRaw() == -10750, "multiplies and divides");
+    check((Fixed1000::fromRaw(1) * Fixed1000::fromRaw(500)).getRaw() == 1, "products round to the nearest");
+    check((Fixed1000::fromRaw(1000001) * Fixed1000::fromRaw(1500)).getRaw() == 1500002
+        && (Fixed1000::fromRaw(-1000001) * Fixed1000::fromRaw(1500)).getRaw() == -1500002,
+        "products too wide for 32 bits round the same way");
+    check(Fixed1000::fromRatio(1, 3).getRaw() == 333 && Fixed1000::fromRatio(-2, 3).getRaw() == -667,
+        "ratios round half away from zero");
+    check(Fixed1000::largest() + a == Fixed1000::largest(), "sums saturate at the largest");
+    check(Fixed1000::smallest() - a == Fixed1000::smallest(), "differences saturate at the smallest");
+    check(Fixed1000::largest() * b == Fixed1000::smallest(), "products saturate");
+    check(!(Fixed1000::smallest() - a).isMissing(), "saturating never makes a missing value");
+    check((a / Fixed1000()).isMissing(), "dividing by zero is missing");
+    check((Fixed1000::missing() + a).isMissing() && (-Fixed1000::missing()).isMissing(),
+        "anything worked out from a missing value is missing");
+    check(Fixed1000::missing() < Fixed1000::smallest(), "missing values sort first");
+    
+    FixedPoint<int16_t, 100> small = FixedPoint<int16_t, 100>::fromInteger(300);
+    check((small + small).getRaw() == INT16_MAX, "narrow raw types saturate too");
+}
+
+static void testParse()
+{
+    check(parsed("12.345").getRaw() == 12345 && parsed("-0.5").getRaw() == -500, "parses decimals");
+    check(parsed("+7").getRaw() == 7000 && parsed(".25").getRaw() == 250 && parsed("3.").getRaw() == 3000,
+        "parses signs and bare points");
+    check(parsed("1.0005").getRaw() == 1001 && parsed("-1.0005").getRaw() == -1001
+        && parsed("1.00049999").getRaw() == 1000, "rounds digits past the scale");
+    check(parsed("99999999999").getRaw() == INT32_MAX && parsed("-99999999999").getRaw() == -INT32_MAX,
+        "saturates numbers too large to hold");
+    check(parsed("").isMissing() && parsed("-").isMissing() && parsed("abc").isMissing() && parsed(".").isMissing(),
+        "what is not a number is missing");
+    
+    Fixed1000 value;
+    const char* end = Fixed1000::parse("-01.5,N", value);
+    check(end && *end == ',' && value.getRaw() == -1500, "stops at the end of the number");
+}
+
+static void testFormat()
+{
+    check(strcmp(formatted(Fixed1000::fromRaw(21500)), "21.500") == 0, "formats every place");
+    check(strcmp(formatted(Fixed1000::fromRaw(21550), 1), "21.6") == 0
+        && strcmp(formatted(Fixed1000::fromRaw(-21550), 1), "-21.6") == 0, "rounds to fewer places");
+    check(strcmp(formatted(Fixed1000::fromRaw(-7), 0), "0") == 0 && strcmp(formatted(Fixed1000::fromRaw(-7)), "-0.007") == 0,
+        "leaves the sign off what rounds to zero");
+    check(strcmp(formatted(Fixed1000::fromRaw(999999), 2), "1000.00") == 0, "carries rounding into the whole part");
+    check(strcmp(formatted(Fixed1000::largest()), "2147483.647") == 0
+        && strcmp(formatted(Fixed1000::smallest()), "-2147483.647") == 0, "formats the extremes");
+    check(strcmp(formatted(Fixed1000::missing()), "") == 0, "missing values are formatted as nothing");
+    
+    char text[6];
+    check(Fixed1000::fromRaw(123456).format(text, sizeof(text)) == 0 && text[0] == '\0',
+        "writes nothing if it does not fit");
+    check(Fixed1000::fromRaw(123456).format(text, sizeof(text), 1) == 5 && strcmp(text, "123.5") == 0,
+        "writes what fits exactly");
+    
+    // Every value survives being formatted and parsed again
+    bool roundTrips = true;
+    uint32_t seed = 1;
+    for (int32_t i = 0; i < 100000 && roundTrips; i++)
+    {
+        Fixed1000 value = Fixed1000::fromRaw((int32_t)simulatedRandom(seed) - (int32_t)simulatedRandom(seed));
+        if (!value.isMissing())
+        {
+            roundTrips = parsed(formatted(value)) == value;
+        }
+    }
+    check(roundTrips, "formatting and parsing round trip");
+}
+
+static void testConversions()
+{
+    check(parsed("10").scaledBy(knotsToMetersPerSecond).getRaw() == 5144, "knots to meters/second");
+    check(parsed("36").scaledBy(kilometersPerHourToMetersPerSecond).getRaw() == 10000, "km/h to meters/second");
+    check(parsed("1000").scaledBy(feetToMeters).getRaw() == 304800, "feet to meters");
+    check(parsed("0.5").scaledBy(degreesToMinutes).getRaw() == 30000, "degrees to minutes");
+    
+    FixedPoint<int32_t, 100000> minutes;
+    FixedPoint<int32_t, 100000>::parse("18.60000", minutes);
+    check(minutes.scaledBy(minutesToDegrees).rescaled<1000>().getRaw() == 310, "minutes to degrees, at a coarser scale");
+    check(parsed("1.5").rescaled<1000000>().getRaw() == 1500000, "to a finer scale");
+    check(parsed("3000").rescaled<1000000>().getRaw() == INT32_MAX, "a finer scale saturates");
+}
+
+// The simulated devices are read as fast as they can go, so they need no clock
+static uint32_t millisecondsNow()
+{
+    return 0;
+}
+
+// Passes a sentence with the given body to a decoder, adding the $, the line break,
+// and the checksum, or a wrong one if asked.
+// Returns true if the decoder was updated.
+template <typename Decoder>
+static bool decodeSentence(Decoder& decoder, const char* body, bool badChecksum = false)
+{
+    uint8_t checksum = 0;
+    for (const char* character = body; *character; character++)
+    {
+        checksum ^= (uint8_t)*character;
+    }
+    char sentence[SIMULATED_SENTENCE_SIZE];
+    snprintf(sentence, sizeof(sentence), "$%s*%02X\r\n", body, (unsigned)(uint8_t)(checksum + badChecksum));
+    bool updated = false;
+    for (const char* character = sentence; *character; character++)
+    {
+        updated = decoder.decodeByte(*character) || updated;
+    }
+    return updated;
+}
+
+static void testDecoders()
+{
+    GPSDecoder gps;
+    check(gps.getLatitude().isMissing() && gps.getSpeed().isMissing(), "nothing before the first sentence");
+    const char* fix = "GPGGA,123519,4807.038,N,01131.000,W,1,08,0.9,545.4,M,46.9,M,,";
+    check(!decodeSentence(gps, fix, true), "a bad checksum is not believed");
+    check(decodeSentence(gps, fix), "a good sentence updates");
+    check(gps.getLatitude().getRaw() == 48117 && gps.getLongitude().getRaw() == -11517,
+        "degrees and minutes become degrees");
+    check(gps.getAltitude().getRaw() == 545400 && gps.getSatelliteCount() == 8 && gps.getHDOP().getRaw() == 900,
+        "altitude, satellites and HDOP");
+    decodeSentence(gps, "GPVTG,054.7,T,034.4,M,005.5,N,010.2,K");
+    check(gps.getTrueHeading().getRaw() == 54700 && gps.getMagneticHeading().getRaw() == 34400
+        && gps.getSpeed().getRaw() == 2829, "headings, and speed from knots");
+    decodeSentence(gps, "GPGGA,123520,,,,,0,03,9.9,,,,,,");
+    check(gps.getLatitude().getRaw() == 48117 && gps.getSatelliteCount() == 3, "a lost fix keeps the last position");
+    
+    IMUDecoder imu;
+    check(decodeSentence(imu, "VNYMR,-120.483,+002.133,-001.234,+0.4000,-0.1000,+0.9000,"
+        "+00.101,-00.202,-09.810,+0.000100,-0.000100,+0.052360"), "a reading updates the IMU");
+    check(imu.getYaw().getRaw() == -120483 && imu.getPitch().getRaw() == 2133 && imu.getRoll().getRaw() == -1234,
+        "attitude");
+    check(imu.getAccelerationX().getRaw() == 101 && imu.getAccelerationZ().getRaw() == -9810, "acceleration");
+    
+    // A simulated flight, through the decoders instead of the sketch's parser
+    SimulatedGps simulatedGps(millisecondsNow, 0, 0);
+    simulatedGps.setPosition(41310, -72920, 30000);
+    SimulatedImu simulatedImu(millisecondsNow, 0, 0);
+    int8_t chunk[256];
+    uint32_t fixes = 0;
+    uint32_t readings = 0;
+    for (int32_t i = 0; i < 100; i++)
+    {
+        size_t count = simulatedGps.read(chunk, sizeof(chunk));
+        for (size_t j = 0; j < count; j++)
+        {
+            fixes += gps.decodeByte(chunk[j]);
+        }
+        count = simulatedImu.read(chunk, sizeof(chunk));
+        for (size_t j = 0; j < count; j++)
+        {
+            readings += imu.decodeByte(chunk[j]);
+        }
+    }
+    check(fixes > 50 && gps.getLatitude().getRaw() == 41310 && gps.getLongitude().getRaw() == -72920
+        && gps.getAltitude().getRaw() == 30000, "decodes the simulated GPS");
+    check(readings > 50 && !imu.getYaw().isMissing(), "decodes the simulated IMU");
+}
+
+static double secondsSince(clock_t start)
+{
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+// Times parsing and formatting numbers the size of those in NMEA sentences
+static void timeParsing()
+{
+    static char texts[TIMED_NUMBERS][16];
+    uint32_t seed = 1;
+    for (int32_t i = 0; i < TIMED_NUMBERS; i++)
+    {
+        Fixed1000::fromRaw((int32_t)(simulatedRandom(seed) % 20000000) - 10000000).format(texts[i], sizeof(texts[i]));
+    }
+    
+    int64_t fixedSum = 0;
+    clock_t start = clock();
+    for (int32_t i = 0; i < TIMED_NUMBERS; i++)
+    {
+        Fixed1000 value;
+        Fixed1000::parse(texts[i], value);
+        fixedSum += value.getRaw();
+    }
+    double fixedParse = secondsSince(start);
+    
+    double doubleSum = 0;
+    start = clock();
+    for (int32_t i = 0; i < TIMED_NUMBERS; i++)
+    {
+        doubleSum += strtod(texts[i], NULL);
+    }
+    double doubleParse = secondsSince(start);
+    
+    char text[16];
+    size_t lengths = 0;
+    start = clock();
+    for (int32_t i = 0; i < TIMED_NUMBERS; i++)
+    {
+        lengths += Fixed1000::fromRaw((int32_t)(fixedSum + i)).format(text, sizeof(text));
+    }
+    double fixedFormat = secondsSince(start);
+    
+    start = clock();
+    for (int32_t i = 0; i < TIMED_NUMBERS; i++)
+    {
+        lengths += snprintf(text, sizeof(text), "%.3f", (fixedSum + i) / 1000.0);
+    }
+    double doubleFormat = secondsSince(start);
+    
+    printf("parse: %.1f ns each, strtod %.1f ns; format: %.1f ns each, snprintf %.1f ns (%lld %.0f %u)\n",
+        fixedParse * 1e9 / TIMED_NUMBERS, doubleParse * 1e9 / TIMED_NUMBERS,
+        fixedFormat * 1e9 / TIMED_NUMBERS, doubleFormat * 1e9 / TIMED_NUMBERS,
+        (long long)fixedSum, doubleSum, (unsigned)lengths);
+}
+
+int main()
+{
+    testArithmetic();
+    testParse();
+    testFormat();
+    testConversions();
+    testDecoders();
+    timeParsing();
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
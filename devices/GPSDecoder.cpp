@@ -1,56 +1,166 @@
 #include "GPSDecoder.h"
 
-int32_t GPSDecoder::getLatitude() const
+// Fields of $GPGGA: time, latitude and hemisphere, longitude and hemisphere, fix quality,
+// satellites, HDOP, and altitude and its units
+#define GGA_LATITUDE 2
+#define GGA_LONGITUDE 4
+#define GGA_QUALITY 6
+#define GGA_SATELLITES 7
+#define GGA_HDOP 8
+#define GGA_ALTITUDE 9
+
+// Fields of $GPRMC: time, status (A for a fix), latitude and longitude as in $GPGGA,
+// speed in knots, and course from true north
+#define RMC_STATUS 2
+#define RMC_LATITUDE 3
+#define RMC_LONGITUDE 5
+#define RMC_SPEED 7
+#define RMC_COURSE 8
+
+// Fields of $GPVTG: course from true north and T, course from magnetic north and M,
+// speed in knots and N, and speed in km/h and K
+#define VTG_TRUE_COURSE 1
+#define VTG_MAGNETIC_COURSE 3
+#define VTG_SPEED 5
+
+GPSDecoder::GPSDecoder()
+    : latitude(Fixed1000::missing()),
+      longitude(Fixed1000::missing()),
+      altitude(Fixed1000::missing()),
+      satelliteCount(0),
+      trueHeading(Fixed1000::missing()),
+      magneticHeading(Fixed1000::missing()),
+      speed(Fixed1000::missing()),
+      hdop(Fixed1000::missing())
 {
-    // Your code here
-
 }
 
-int32_t GPSDecoder::getLongitude() const
+Fixed1000 GPSDecoder::getLatitude() const
 {
-    // Your code here
-
+    return latitude;
 }
 
-int32_t GPSDecoder::getAltitude() const
+Fixed1000 GPSDecoder::getLongitude() const
 {
-    // Your code here
+    return longitude;
+}
 
+Fixed1000 GPSDecoder::getAltitude() const
+{
+    return altitude;
 }
 
 int8_t GPSDecoder::getSatelliteCount() const
 {
-    // Your code here
-
+    return satelliteCount;
 }
 
-int32_t GPSDecoder::getTrueHeading() const
+Fixed1000 GPSDecoder::getTrueHeading() const
 {
-    // Your code here
-
+    return trueHeading;
 }
 
-int32_t GPSDecoder::getMagneticHeading() const
+Fixed1000 GPSDecoder::getMagneticHeading() const
 {
-    // Your code here
-
+    return magneticHeading;
 }
 
-int32_t GPSDecoder::getSpeed() const
+Fixed1000 GPSDecoder::getSpeed() const
 {
-    // Your code here
+    return speed;
+}
 
+Fixed1000 GPSDecoder::getHDOP() const
+{
+    return hdop;
 }
 
-int32_t GPSDecoder::getHDOP() const
+bool GPSDecoder::decodeByte(int8_t newByte)
 {
-    // Your code here
+    if (!sentence.decodeByte(newByte))
+    {
+        return false;
+    }
+    if (sentence.hasType("GGA"))
+    {
+        decodeFix();
+    }
+    else if (sentence.hasType("RMC"))
+    {
+        decodeRecommended();
+    }
+    else if (sentence.hasType("VTG"))
+    {
+        decodeTrack();
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
 
+void GPSDecoder::decodeFix()
+{
+    Fixed1000 satellites = sentence.getNumber<int32_t, 1000>(GGA_SATELLITES);
+    satelliteCount = satellites.isMissing() ? 0 : (int8_t)satellites.getInteger();
+    hdop = sentence.getNumber<int32_t, 1000>(GGA_HDOP);
+    
+    // Without a fix, the position is left as it last was
+    const char* quality = sentence.getField(GGA_QUALITY);
+    if (quality[0] == '\0' || quality[0] == '0')
+    {
+        return;
+    }
+    latitude = parseAngle(sentence.getField(GGA_LATITUDE), sentence.getField(GGA_LATITUDE + 1), 'S');
+    longitude = parseAngle(sentence.getField(GGA_LONGITUDE), sentence.getField(GGA_LONGITUDE + 1), 'W');
+    // Meters, which are millimeters at this scale
+    altitude = sentence.getNumber<int32_t, 1000>(GGA_ALTITUDE);
 }
 
-bool decodeByte(int8_t newByte)
+void GPSDecoder::decodeRecommended()
 {
+    if (sentence.getField(RMC_STATUS)[0] != 'A')
+    {
+        return;
+    }
+    latitude = parseAngle(sentence.getField(RMC_LATITUDE), sentence.getField(RMC_LATITUDE + 1), 'S');
+    longitude = parseAngle(sentence.getField(RMC_LONGITUDE), sentence.getField(RMC_LONGITUDE + 1), 'W');
+    speed = sentence.getNumber<int32_t, 1000>(RMC_SPEED).scaledBy(knotsToMetersPerSecond);
+    trueHeading = sentence.getNumber<int32_t, 1000>(RMC_COURSE);
+}
 
+void GPSDecoder::decodeTrack()
+{
+    trueHeading = sentence.getNumber<int32_t, 1000>(VTG_TRUE_COURSE);
+    magneticHeading = sentence.getNumber<int32_t, 1000>(VTG_MAGNETIC_COURSE);
+    speed = sentence.getNumber<int32_t, 1000>(VTG_SPEED).scaledBy(knotsToMetersPerSecond);
 }
 
-    // Your code here
+Fixed1000 GPSDecoder::parseAngle(const char* angle, const char* hemisphere, char negative)
+{
+    // The minutes are the two digits before the decimal point, and the degrees are whatever comes before them
+    uint8_t wholeDigits = 0;
+    while (angle[wholeDigits] >= '0' && angle[wholeDigits] <= '9')
+    {
+        wholeDigits++;
+    }
+    if (wholeDigits < 3)
+    {
+        return Fixed1000::missing();
+    }
+    int32_t degrees = 0;
+    for (uint8_t i = 0; i < wholeDigits - 2; i++)
+    {
+        degrees = degrees * 10 + (angle[i] - '0');
+    }
+    
+    // Worked in hundred-thousandths, to keep the fractions of a minute the GPS gives
+    FixedPoint<int32_t, 100000> minutes;
+    if (!FixedPoint<int32_t, 100000>::parse(angle + wholeDigits - 2, minutes))
+    {
+        return Fixed1000::missing();
+    }
+    Fixed1000 value = Fixed1000::fromInteger(degrees) + minutes.scaledBy(minutesToDegrees).rescaled<1000>();
+    return hemisphere[0] == negative ? -value : value;
+}
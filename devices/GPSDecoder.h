@@ -1,52 +1,100 @@
+#include "SerialPort.h"
+#include "NmeaSentence.h"
+
 #ifndef GPS_DECODER
 #define GPS_DECODER
 
+// The most bytes decodeFrom reads from its port at a time
+#define GPS_DECODE_CHUNK_SIZE 64
+
 // Decodes bytes obtained from the GPS so that relevant details may be accessed.
 class GPSDecoder
 {
     public:
-
+    
     /*
     Make use of int32_t, int16_t, int8_t (32-bits, 16-bits, or 8-bits) 
     instead of int, short, or char. 
     This will ensure that the length of the integer is always the same on different platforms.
     */
-
+    
+    // Every value is missing until a sentence with it has been decoded.
+    GPSDecoder();
+    
     // Value returned has the decimal point fixed at the 1000s place.
     // Note that it is not in degrees.minutes form, but the numbers
     // following the decimal point are a fraction of a degree.
-    int32_t getLatitude() const;
-
+    Fixed1000 getLatitude() const;
+    
     // Value returned has the decimal point fixed at the 1000s place.
     // Note that it is not in degrees.minutes form, but the numbers
     // following the decimal point are a fraction of a degree.
-    int32_t getLongitude() const;
-
+    Fixed1000 getLongitude() const;
+    
     // In millimeters. (Alternatively fixed-point meters, with the decimal at the 1000s place).
-    int32_t getAltitude() const;
-
+    Fixed1000 getAltitude() const;
+    
     int8_t getSatelliteCount() const;
-
+    
     // In degrees. From true-north.
-    int32_t getTrueHeading() const;
-
+    Fixed1000 getTrueHeading() const;
+    
     // In degrees. From magnetic-north.
-    int32_t getMagneticHeading() const;
-
-    // In millimeters/second.
-    int32_t getSpeed() const;
-
+    Fixed1000 getMagneticHeading() const;
+    
+    // In meters/second, so the raw value is in millimeters/second.
+    Fixed1000 getSpeed() const;
+    
     // Horizontal Degrees of Precision
-    int32_t getHDOP() const;
+    Fixed1000 getHDOP() const;
     
     // Passes the GPSDecoder an additional byte from the the GPS's output stream
     // to decode.
     // Returns true if the GPSDecoder has updated its parameters.
 	bool decodeByte(int8_t newByte);
 
+	// Reads every byte the port already has available, a chunk at a time, and decodes them.
+	// Templated on the port, so that its reads are inlined here rather than dispatched per byte.
+	// Returns true if the GPSDecoder has updated its parameters.
+	template <typename Impl>
+	bool decodeFrom(SerialPort<Impl>& port)
+	{
+		int8_t chunk[GPS_DECODE_CHUNK_SIZE];
+		bool updated = false;
+		size_t count;
+		while ((count = port.read(chunk, GPS_DECODE_CHUNK_SIZE)) > 0)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				if (decodeByte(chunk[i]))
+				{
+					updated = true;
+				}
+			}
+		}
+		return updated;
+	}
+    
     private:
-
-    // Your code here
+    
+    // Decodes the fields of the sentence it has
+    void decodeFix();
+    void decodeRecommended();
+    void decodeTrack();
+    
+    // Reads an angle given the NMEA way, as degrees and minutes (ddmm.mmmm or dddmm.mmmm),
+    // negative if hemisphere is the given letter, such as S or W
+    static Fixed1000 parseAngle(const char* angle, const char* hemisphere, char negative);
+    
+    NmeaSentence sentence;
+    Fixed1000 latitude;
+    Fixed1000 longitude;
+    Fixed1000 altitude;
+    int8_t satelliteCount;
+    Fixed1000 trueHeading;
+    Fixed1000 magneticHeading;
+    Fixed1000 speed;
+    Fixed1000 hdop;
 
 };
 
@@ -0,0 +1,72 @@
+#include "GpioEdgeSampler.h"
+
+uint32_t gpioMicrosecondsNow()
+{
+    struct timespec now;
+    gpioClockNow(&now);
+    return (uint32_t)((uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000);
+}
+
+GpioEdgeSampler::GpioEdgeSampler(const GpioBackend* backend)
+    : backend(backend),
+      pinCount(0),
+      edgeCount(0)
+{
+}
+
+GpioEdgeSampler::~GpioEdgeSampler()
+{
+    for (uint8_t i = 0; i < pinCount; i++)
+    {
+        backend->closePin(pins[i]);
+    }
+}
+
+bool GpioEdgeSampler::addPin(const char* pin, PWMSensor& sensor)
+{
+    if (pinCount == GPIO_EDGE_SAMPLER_MAX_PINS || backend->openPin(pin) != 0)
+    {
+        return false;
+    }
+    bool level;
+    if (backend->setInput(pin) != 0 || backend->readPin(pin, &level) != 0)
+    {
+        backend->closePin(pin);
+        return false;
+    }
+    pins[pinCount] = pin;
+    sensors[pinCount] = &sensor;
+    // Whatever the pin is at to begin with is not an edge
+    levels[pinCount] = level;
+    pinCount++;
+    return true;
+}
+
+int32_t GpioEdgeSampler::sample()
+{
+    int32_t edges = 0;
+    for (uint8_t i = 0; i < pinCount; i++)
+    {
+        // Timed by the read that first sees it, so every edge is late by up to the time between samples,
+        // and the two edges of a pulse by about the same
+        uint32_t now = gpioMicrosecondsNow();
+        bool level;
+        if (backend->readPin(pins[i], &level) != 0)
+        {
+            return -1;
+        }
+        if (level != levels[i])
+        {
+            levels[i] = level;
+            sensors[i]->handleEdge(level, now);
+            edges++;
+        }
+    }
+    edgeCount += edges;
+    return edges;
+}
+
+uint32_t GpioEdgeSampler::getEdgeCount() const
+{
+    return edgeCount;
+}
@@ -0,0 +1,57 @@
+#include "PWMSensor.h"
+
+extern "C"
+{
+#include "GeneralPurposeIO.h"
+}
+
+#ifndef GPIO_EDGE_SAMPLER
+#define GPIO_EDGE_SAMPLER
+
+// The most pins one sampler watches
+#define GPIO_EDGE_SAMPLER_MAX_PINS 8
+
+// Gives the time in microseconds on the gpio clock (see gpioUseClock), the way Arduino's micros does,
+// for PWMSensors whose edges come from a GpioEdgeSampler
+uint32_t gpioMicrosecondsNow();
+
+// Watches pins on a Linux host through one of gpioSoftwareSerial's backends, and passes each change
+// of a pin's level to its PWMSensor, timed by the gpio clock, as a pin change interrupt would on an Arduino.
+// With the simulator backend, PWM code runs against simulated wires on the virtual clock.
+// Every pin is read once a sample, so an edge is timed to within the time between samples.
+class GpioEdgeSampler
+{
+    public:
+    
+    explicit GpioEdgeSampler(const GpioBackend* backend);
+    
+    // Closes every pin the sampler opened
+    ~GpioEdgeSampler();
+    
+    // Opens the given pin as an input, and passes its edges to sensor from now on.
+    // The pin name is kept by reference, and must outlive the sampler.
+    // Returns false if the pin cannot be opened, or there are already GPIO_EDGE_SAMPLER_MAX_PINS.
+    bool addPin(const char* pin, PWMSensor& sensor);
+    
+    // Reads every pin once, passing on any edges.
+    // Returns the number of edges, or -1 if a pin could not be read.
+    int32_t sample();
+    
+    // The number of edges passed on since the sampler started
+    uint32_t getEdgeCount() const;
+    
+    private:
+    
+    // Not copyable, since it owns the pins it opened
+    GpioEdgeSampler(const GpioEdgeSampler&);
+    GpioEdgeSampler& operator=(const GpioEdgeSampler&);
+    
+    const GpioBackend* backend;
+    const char* pins[GPIO_EDGE_SAMPLER_MAX_PINS];
+    PWMSensor* sensors[GPIO_EDGE_SAMPLER_MAX_PINS];
+    bool levels[GPIO_EDGE_SAMPLER_MAX_PINS];
+    uint8_t pinCount;
+    uint32_t edgeCount;
+};
+
+#endif
@@ -0,0 +1,21 @@
+#include <stdio.h>
+
+#ifndef HOST_TEST
+#define HOST_TEST
+
+// What the host tests share. Each test is a single file built into its own program, and includes this once.
+
+// The number of checks that have failed, for main to report and return
+static int failures = 0;
+
+// Prints whether a check passed, with what it checked, and counts it if it failed
+static void check(bool passed, const char* what)
+{
+    printf("%s: %s\n", passed ? "pass" : "FAIL", what);
+    if (!passed)
+    {
+        failures++;
+    }
+}
+
+#endif
@@ -1,16 +1,16 @@
 #include "HumiditySensor.h"
 
 HumiditySensor::HumiditySensor()
+    : relativeHumidity(Fixed1000::missing())
 {
-    
 }
 
-int32_t HumiditySensor::getRelativeHumidity() const
+Fixed1000 HumiditySensor::getRelativeHumidity() const
 {
-    
+    return relativeHumidity;
 }
 
-int32_t HumiditySensor::readRelativeHumidity()
+Fixed1000 HumiditySensor::readRelativeHumidity()
 {
-    
+    return relativeHumidity;
 }
\ No newline at end of file
@@ -1,3 +1,5 @@
+#include "FixedPoint.h"
+
 #ifndef HUMIDITY_SENSOR
 #define HUMIDITY_SENSOR
 
@@ -5,7 +7,7 @@
 class HumiditySensor
 {
     public:
-
+    
     /*
     Make use of int32_t, int16_t, int8_t (32-bits, 16-bits, or 8-bits) 
     instead of int, short, or char.
@@ -19,18 +21,19 @@ class HumiditySensor
     // Value returned has the decimal point fixed at the 1000s place.
     // Value is in percentage, so 100% would be 100 _to the left_ of the decimal point.
     // Returns the last value read by the sensor.
-    int32_t getRelativeHumidity() const;
+    Fixed1000 getRelativeHumidity() const;
     
     // Value returned has the decimal point fixed at the 1000s place.
     // Value is in percentage, so 100% would be 100 _to the left_ of the decimal point.
     // Queries the sensor to determine its current humidity.
     // If the query is taking too long, the query should be cut off,
-    // and INT32_MIN returned.
-    int32_t readRelativeHumidity();
-
+    // and missing (INT32_MIN) returned.
+    Fixed1000 readRelativeHumidity();
+    
     private:
-
-    // Your code here
+    
+    // There is no humidity probe on the payload yet, so this stays missing until there is one
+    Fixed1000 relativeHumidity;
 
 };
 
@@ -1,67 +1,95 @@
 #include "IMUDecoder.h"
 
-int32_t IMUDecoder::getYaw() const
+// Fields of $VNYMR: yaw, pitch and roll, the magnetic field, acceleration, and angular rates, each in x, y and z
+#define VNYMR_YAW 1
+#define VNYMR_PITCH 2
+#define VNYMR_ROLL 3
+#define VNYMR_ACCELERATION_X 7
+#define VNYMR_ACCELERATION_Y 8
+#define VNYMR_ACCELERATION_Z 9
+#define VNYMR_FIELD_COUNT 13
+
+IMUDecoder::IMUDecoder()
+    : yaw(Fixed1000::missing()),
+      pitch(Fixed1000::missing()),
+      roll(Fixed1000::missing()),
+      accelerationX(Fixed1000::missing()),
+      accelerationY(Fixed1000::missing()),
+      accelerationZ(Fixed1000::missing())
 {
-
 }
 
-int32_t IMUDecoder::getPitch() const
+Fixed1000 IMUDecoder::getYaw() const
 {
-
+    return yaw;
 }
 
-int32_t IMUDecoder::getRoll() const
+Fixed1000 IMUDecoder::getPitch() const
 {
-
+    return pitch;
 }
 
-int32_t IMUDecoder::getAccelerationX() const
+Fixed1000 IMUDecoder::getRoll() const
 {
-
+    return roll;
 }
 
-int32_t IMUDecoder::getAccelerationY() const
+Fixed1000 IMUDecoder::getAccelerationX() const
 {
-
+    return accelerationX;
 }
 
-int32_t IMUDecoder::getAccelerationZ() const
+Fixed1000 IMUDecoder::getAccelerationY() const
 {
-
+    return accelerationY;
 }
 
-int32_t IMUDecoder::getIntegratedVelocityX() const
+Fixed1000 IMUDecoder::getAccelerationZ() const
 {
-
+    return accelerationZ;
 }
 
-int32_t IMUDecoder::getIntegratedVelocityY() const
+Fixed1000 IMUDecoder::getIntegratedVelocityX() const
 {
-
+    return Fixed1000::missing();
 }
 
-int32_t IMUDecoder::getIntegratedVelocityZ() const
+Fixed1000 IMUDecoder::getIntegratedVelocityY() const
 {
-
+    return Fixed1000::missing();
 }
 
-int32_t IMUDecoder::getIntegratedPositionX() const
+Fixed1000 IMUDecoder::getIntegratedVelocityZ() const
 {
-
+    return Fixed1000::missing();
 }
 
-int32_t IMUDecoder::getIntegratedPositionY() const
+Fixed1000 IMUDecoder::getIntegratedPositionX() const
 {
-
+    return Fixed1000::missing();
 }
 
-int32_t IMUDecoder::getIntegratedPositionZ() const
+Fixed1000 IMUDecoder::getIntegratedPositionY() const
 {
+    return Fixed1000::missing();
+}
 
+Fixed1000 IMUDecoder::getIntegratedPositionZ() const
+{
+    return Fixed1000::missing();
 }
 
 bool IMUDecoder::decodeByte(int8_t newByte)
 {
-
+    if (!sentence.decodeByte(newByte) || !sentence.is("VNYMR") || sentence.getFieldCount() < VNYMR_FIELD_COUNT)
+    {
+        return false;
+    }
+    yaw = sentence.getNumber<int32_t, 1000>(VNYMR_YAW);
+    pitch = sentence.getNumber<int32_t, 1000>(VNYMR_PITCH);
+    roll = sentence.getNumber<int32_t, 1000>(VNYMR_ROLL);
+    accelerationX = sentence.getNumber<int32_t, 1000>(VNYMR_ACCELERATION_X);
+    accelerationY = sentence.getNumber<int32_t, 1000>(VNYMR_ACCELERATION_Y);
+    accelerationZ = sentence.getNumber<int32_t, 1000>(VNYMR_ACCELERATION_Z);
+    return true;
 }
-
@@ -1,6 +1,12 @@
+#include "SerialPort.h"
+#include "NmeaSentence.h"
+
 #ifndef IMU_DECODER
 #define IMU_DECODER
 
+// The most bytes decodeFrom reads from its port at a time
+#define IMU_DECODE_CHUNK_SIZE 64
+
 // Decodes bytes obtained from the Inertial Measurement Unit (IMU) so that relevant details may be accessed.
 class IMUDecoder
 {
@@ -12,62 +18,96 @@ class IMUDecoder
 	This will ensure that the length of the integer is always the same on different platforms.
 	*/
 
+	// Every value is missing until a $VNYMR reading has been decoded.
+	IMUDecoder();
+
 	// Value returned has the decimal point fixed at the 1000s place.
 	// In degrees.
-	int32_t getYaw() const;
+	Fixed1000 getYaw() const;
 
 	// Value returned has the decimal point fixed at the 1000s place.
 	// In degrees.
-	int32_t getPitch() const;
+	Fixed1000 getPitch() const;
 
 	// Value returned has the decimal point fixed at the 1000s place.
 	// In degrees.
-	int32_t getRoll() const;
+	Fixed1000 getRoll() const;
 
 	// Value returned has the decimal point fixed at the 1000s place.
 	// In meters/second^2.
-	int32_t getAccelerationX() const;
+	Fixed1000 getAccelerationX() const;
 
 	// Value returned has the decimal point fixed at the 1000s place.
 	// In meters/second^2.
-	int32_t getAccelerationY() const;
+	Fixed1000 getAccelerationY() const;
 
 	// Value returned has the decimal point fixed at the 1000s place.
 	// In meters/second^2.
-	int32_t getAccelerationZ() const;
+	Fixed1000 getAccelerationZ() const;
+
+	// The integrated values are missing for now. Taking gravity out of the acceleration first
+	// needs the attitude turned into a rotation, which wants trigonometry not yet done in fixed point.
 
 	// Value returned has the decimal point fixed at the 1000s place.
 	// In meters/second. An approximation calculated from acceleration.
-	int32_t getIntegratedVelocityX() const;
-
+	Fixed1000 getIntegratedVelocityX() const;
+    
     // Value returned has the decimal point fixed at the 1000s place.
 	// In meters/second. An approximation calculated from acceleration.
-	int32_t getIntegratedVelocityY() const;
+	Fixed1000 getIntegratedVelocityY() const;
 
 	// Value returned has the decimal point fixed at the 1000s place.
 	// In meters/second. An approximation calculated from acceleration.
-	int32_t getIntegratedVelocityZ() const;
+	Fixed1000 getIntegratedVelocityZ() const;
 
 	// Value returned has the decimal point fixed at the 1000s place.
 	// In meters/second. An approximation calculated from acceleration.
-	int32_t getIntegratedPositionX() const;
+	Fixed1000 getIntegratedPositionX() const;
 
 	// Value returned has the decimal point fixed at the 1000s place.
 	// In meters/second. An approximation calculated from acceleration.
-	int32_t getIntegratedPositionY() const;
+	Fixed1000 getIntegratedPositionY() const;
 
 	// Value returned has the decimal point fixed at the 1000s place.
 	// In meters/second. An approximation calculated from acceleration.
-	int32_t getIntegratedPositionZ() const;
-	
+	Fixed1000 getIntegratedPositionZ() const;
+    
     // Passes the IMUDecoder an additional byte from the the IMU's output stream
     // to decode.
     // Returns true if the IMUDecoder has updated its parameters.
 	bool decodeByte(int8_t newByte);
 
+	// Reads every byte the port already has available, a chunk at a time, and decodes them.
+	// Templated on the port, so that its reads are inlined here rather than dispatched per byte.
+	// Returns true if the IMUDecoder has updated its parameters.
+	template <typename Impl>
+	bool decodeFrom(SerialPort<Impl>& port)
+	{
+		int8_t chunk[IMU_DECODE_CHUNK_SIZE];
+		bool updated = false;
+		size_t count;
+		while ((count = port.read(chunk, IMU_DECODE_CHUNK_SIZE)) > 0)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				if (decodeByte(chunk[i]))
+				{
+					updated = true;
+				}
+			}
+		}
+		return updated;
+	}
+
 	private:
 
-	// Your code here
+	NmeaSentence sentence;
+	Fixed1000 yaw;
+	Fixed1000 pitch;
+	Fixed1000 roll;
+	Fixed1000 accelerationX;
+	Fixed1000 accelerationY;
+	Fixed1000 accelerationZ;
 
 };
 
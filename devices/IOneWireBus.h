@@ -0,0 +1,43 @@
+#include "CppInterfaces.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef I_ONE_WIRE_BUS
+#define I_ONE_WIRE_BUS
+
+// The length of a 1-Wire ROM code: family, serial number, and CRC
+#define ONE_WIRE_ADDRESS_SIZE 8
+
+DeclareInterface(IOneWireBus)
+    // Sends a reset pulse to every device on the bus.
+    // Returns true if any device answered with a presence pulse.
+    virtual bool reset() = 0;
+    
+    // Addresses the device with the given ROM code for the next command,
+    // or every device at once if address is NULL.
+    virtual void select(const uint8_t* address) = 0;
+    
+    // Writes a single byte to the addressed devices.
+    virtual void writeByte(uint8_t value) = 0;
+    
+    // Reads a single byte from the addressed device.
+    virtual uint8_t readByte() = 0;
+EndInterface
+
+// The Dallas/Maxim CRC-8 (x^8 + x^5 + x^4 + 1) of count bytes, as at the end of ROM codes and scratchpads.
+// The CRC of a block that ends with its own CRC is 0.
+inline uint8_t oneWireCrc8(const uint8_t* data, size_t count)
+{
+    uint8_t crc = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = crc & 0x01 ? (crc >> 1) ^ 0x8C : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+#endif
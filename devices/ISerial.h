@@ -1,4 +1,9 @@
 #include "CppInterfaces.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef I_SERIAL
+#define I_SERIAL
 
 DeclareInterface(ISerial)
     // Writes a single byte to this serial byte stream.
@@ -7,4 +12,46 @@ DeclareInterface(ISerial)
     // Reads a single byte from this serial byte stream,
     // returning -1 if there is no further data available.
     virtual int32_t readByte() = 0;
-EndInterface
\ No newline at end of file
+    
+    // Reads up to count bytes that are already available into destination,
+    // without waiting for more.
+    // Returns the number of bytes read.
+    // Ports that can move a whole block at once should override this,
+    // so that a block costs one virtual call instead of one per byte.
+    virtual size_t read(int8_t* destination, size_t count)
+    {
+        size_t bytesRead = 0;
+        while (bytesRead < count)
+        {
+            int32_t value = readByte();
+            if (value == -1)
+            {
+                break;
+            }
+            destination[bytesRead++] = (int8_t)value;
+        }
+        return bytesRead;
+    }
+    
+    // Writes up to count bytes from source to this serial byte stream.
+    // Returns the number of bytes written, which is less than count
+    // once the stream cannot take any more.
+    virtual size_t write(const int8_t* source, size_t count)
+    {
+        size_t bytesWritten = 0;
+        while (bytesWritten < count && writeByte(source[bytesWritten]))
+        {
+            bytesWritten++;
+        }
+        return bytesWritten;
+    }
+    
+    // Returns the number of bytes that can be read right away.
+    // Ports that cannot tell return 0, and read still gets whatever there is.
+    virtual size_t available()
+    {
+        return 0;
+    }
+EndInterface
+
+#endif
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include "ISerial.h"
+#include <string.h>
+
+#ifndef LINE_FRAMER
+#define LINE_FRAMER
+
+// A whole line, as handed out by LineFramer::nextLine.
+// It points into the framer's buffer, so it is only good until the next call to nextLine.
+struct LineView
+{
+    // The line, without its line break, and null terminated
+    const char* text;
+    size_t length;
+    // The line was longer than the framer keeps, and this is only its start.
+    // The rest of it is dropped.
+    bool truncated;
+};
+
+// Splits what a serial device sends into lines, ended by carriage returns, line feeds or both.
+// Blank lines are skipped.
+// The device is read in bulk, straight into a ring buffer. When the ring runs out at the end,
+// only the unfinished line is moved back to the start, so every line handed out is in one piece
+// and is never copied. Lines longer than MaxLineLength are handed out cut short, marked as such,
+// and the rest of them is dropped up to the line break, so they never run into the next line.
+// MaxLineLength must be less than Capacity.
+template <size_t Capacity, size_t MaxLineLength = Capacity / 2>
+class LineFramer
+{
+    public:
+    
+    // Frames what is read from input. If echo is given, everything read is also written to it,
+    // a whole read at a time, for watching the conversation.
+    explicit LineFramer(ISerial& input, ISerial* echo = NULL)
+        : input(input),
+          echo(echo),
+          start(0),
+          scan(0),
+          end(0),
+          discarding(false),
+          oversizeLines(0)
+    {
+    }
+    
+    // Gets the next whole line, reading whatever the device already has if need be, but never waiting on it.
+    // Call it until it returns false to drain the device.
+    // Returns true if there is a line, or false if the device has nothing more for now.
+    bool nextLine(LineView& line)
+    {
+        for (;;)
+        {
+            while (scan < end)
+            {
+                char character = buffer[scan];
+                if (character == '\r' || character == '\n')
+                {
+                    size_t lineStart = start;
+                    size_t length = scan - start;
+                    buffer[scan] = '\0';
+                    scan++;
+                    start = scan;
+                    
+                    // This is the end of a line that has already been handed out cut short,
+                    // or a blank line between two others
+                    if (discarding || length == 0)
+                    {
+                        discarding = false;
+                        continue;
+                    }
+                    line.text = buffer + lineStart;
+                    line.length = length;
+                    line.truncated = false;
+                    return true;
+                }
+                scan++;
+                
+                if (discarding)
+                {
+                    // Drop it as we go, so the room can be used again
+                    start = scan;
+                }
+                else if (scan - start > MaxLineLength)
+                {
+                    // The byte after the part we keep is dropped anyway, so it makes room for the null
+                    buffer[start + MaxLineLength] = '\0';
+                    line.text = buffer + start;
+                    line.length = MaxLineLength;
+                    line.truncated = true;
+                    oversizeLines++;
+                    discarding = true;
+                    start = scan;
+                    return true;
+                }
+            }
+            
+            if (!readMore())
+            {
+                return false;
+            }
+        }
+    }
+    
+    // Takes a prompt that is not followed by a line break, such as the > a module gives before the body of a text message,
+    // if the unfinished line starts with it. A single space after the prompt is taken with it.
+    // Returns true if the prompt was there.
+    bool takePrompt(char prompt)
+    {
+        if (discarding || start == end || buffer[start] != prompt)
+        {
+            return false;
+        }
+        start++;
+        if (start < end && buffer[start] == ' ')
+        {
+            start++;
+        }
+        if (scan < start)
+        {
+            scan = start;
+        }
+        return true;
+    }
+    
+    // The number of lines that have been too long, and cut short
+    uint32_t getOversizeLineCount() const
+    {
+        return oversizeLines;
+    }
+    
+    private:
+    
+    // Reads as much as the device has and there is room for after the unfinished line
+    // Returns false if the device had nothing
+    bool readMore()
+    {
+        if (start == end)
+        {
+            // Nothing is unfinished, so start again at the start
+            start = 0;
+            scan = 0;
+            end = 0;
+        }
+        else if (end == Capacity)
+        {
+            // The unfinished line is never longer than MaxLineLength, so this leaves room
+            size_t unfinished = end - start;
+            memmove(buffer, buffer + start, unfinished);
+            scan -= start;
+            start = 0;
+            end = unfinished;
+        }
+        
+        size_t count = input.read((int8_t*)buffer + end, Capacity - end);
+        if (count == 0)
+        {
+            return false;
+        }
+        if (echo)
+        {
+            echo->write((const int8_t*)buffer + end, count);
+        }
+        end += count;
+        return true;
+    }
+    
+    ISerial& input;
+    ISerial* echo;
+    
+    char buffer[Capacity];
+    
+    // The unfinished line starts at start, and has been looked through for a line break up to scan.
+    // What has been read ends at end.
+    size_t start;
+    size_t scan;
+    size_t end;
+    
+    // Dropping the rest of a line that was too long
+    bool discarding;
+    
+    uint32_t oversizeLines;
+};
+
+#endif
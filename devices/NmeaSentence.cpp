@@ -0,0 +1,113 @@
+#include "NmeaSentence.h"
+#include <string.h>
+
+NmeaSentence::NmeaSentence()
+    : length(0),
+      gathering(false),
+      fieldCount(0)
+{
+    sentence[0] = '\0';
+}
+
+bool NmeaSentence::decodeByte(int8_t newByte)
+{
+    char character = (char)newByte;
+    if (character == '$')
+    {
+        // Wherever it is, a $ starts a new sentence, so that one cut short is dropped
+        length = 0;
+        fieldCount = 0;
+        gathering = true;
+        return false;
+    }
+    if (!gathering)
+    {
+        return false;
+    }
+    if (character == '\r' || character == '\n')
+    {
+        gathering = false;
+        sentence[length] = '\0';
+        return finish();
+    }
+    if (length == NMEA_SENTENCE_SIZE - 1)
+    {
+        // Too long to be a sentence, so it is noise
+        gathering = false;
+        return false;
+    }
+    sentence[length++] = character;
+    return false;
+}
+
+uint8_t NmeaSentence::getFieldCount() const
+{
+    return fieldCount;
+}
+
+const char* NmeaSentence::getField(uint8_t index) const
+{
+    return index < fieldCount ? sentence + fields[index] : "";
+}
+
+bool NmeaSentence::is(const char* name) const
+{
+    return fieldCount > 0 && strcmp(sentence, name) == 0;
+}
+
+bool NmeaSentence::hasType(const char* type) const
+{
+    // Two letters of talker, then the type
+    return fieldCount > 0 && strlen(sentence) == 2 + strlen(type) && strcmp(sentence + 2, type) == 0;
+}
+
+// The value of a hexadecimal digit, or -1 if it is not one
+static int8_t hexValue(char digit)
+{
+    if (digit >= '0' && digit <= '9')
+    {
+        return digit - '0';
+    }
+    if (digit >= 'A' && digit <= 'F')
+    {
+        return digit - 'A' + 10;
+    }
+    if (digit >= 'a' && digit <= 'f')
+    {
+        return digit - 'a' + 10;
+    }
+    return -1;
+}
+
+bool NmeaSentence::finish()
+{
+    // The checksum is every character between the $ and the * exclusive-ored together
+    uint8_t checksum = 0;
+    uint8_t star = 0;
+    while (star < length && sentence[star] != '*')
+    {
+        checksum ^= (uint8_t)sentence[star++];
+    }
+    if (star + 3 != length || hexValue(sentence[star + 1]) < 0 || hexValue(sentence[star + 2]) < 0
+        || (hexValue(sentence[star + 1]) << 4 | hexValue(sentence[star + 2])) != checksum)
+    {
+        return false;
+    }
+    sentence[star] = '\0';
+    
+    fields[0] = 0;
+    fieldCount = 1;
+    for (uint8_t i = 0; i < star; i++)
+    {
+        if (sentence[i] == ',')
+        {
+            sentence[i] = '\0';
+            if (fieldCount == NMEA_MAX_FIELDS)
+            {
+                break;
+            }
+            fields[fieldCount++] = i + 1;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,58 @@
+#include "FixedPoint.h"
+
+#ifndef NMEA_SENTENCE
+#define NMEA_SENTENCE
+
+// The longest sentence NMEA 0183 allows, from the $ to the line break, and then some for chatty devices
+#define NMEA_SENTENCE_SIZE 128
+
+// The most fields a sentence is split into, the first of which is its name
+#define NMEA_MAX_FIELDS 24
+
+// Gathers NMEA 0183 sentences ($NAME,field,...*hh) a byte at a time, checks them,
+// and splits them into their fields in place, for the GPS and IMU decoders.
+class NmeaSentence
+{
+    public:
+    
+    NmeaSentence();
+    
+    // Takes the next byte from the device.
+    // Returns true once a whole sentence has come with a good checksum, when its fields may be looked at
+    // until the next byte is taken.
+    bool decodeByte(int8_t newByte);
+    
+    // The number of fields, including the name
+    uint8_t getFieldCount() const;
+    
+    // A field's text, or an empty string if the sentence does not have that many fields
+    const char* getField(uint8_t index) const;
+    
+    // Returns true if the sentence is the named one, such as "GPGGA"
+    bool is(const char* name) const;
+    
+    // Returns true if the sentence is of the given type from any talker, such as "GGA" for $GPGGA or $GNGGA
+    bool hasType(const char* type) const;
+    
+    // Parses a field as a number, giving missing if it is empty or not a number
+    template <typename Raw, int32_t Scale>
+    FixedPoint<Raw, Scale> getNumber(uint8_t index) const
+    {
+        FixedPoint<Raw, Scale> value = FixedPoint<Raw, Scale>::missing();
+        FixedPoint<Raw, Scale>::parse(getField(index), value);
+        return value;
+    }
+    
+    private:
+    
+    // Checks the checksum and splits the fields
+    bool finish();
+    
+    char sentence[NMEA_SENTENCE_SIZE];
+    uint8_t length;
+    bool gathering;
+    uint8_t fields[NMEA_MAX_FIELDS];
+    uint8_t fieldCount;
+};
+
+#endif
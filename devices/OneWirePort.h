@@ -0,0 +1,58 @@
+#include "IOneWireBus.h"
+
+#ifndef ONE_WIRE_PORT
+#define ONE_WIRE_PORT
+
+// Wraps a 1-Wire bus driver with the Arduino OneWire library's methods (reset, select, skip, write, read)
+// as an IOneWireBus, so that the device drivers need not include the library themselves.
+//     OneWire oneWire(5);
+//     OneWirePort<OneWire> oneWireBus(oneWire);
+template <typename Impl>
+class OneWirePort : public IOneWireBus
+{
+    public:
+    
+    explicit OneWirePort(Impl& bus)
+        : bus(bus)
+    {
+    }
+    
+    bool reset()
+    {
+        return bus.reset() != 0;
+    }
+    
+    void select(const uint8_t* address)
+    {
+        if (address)
+        {
+            bus.select(address);
+        }
+        else
+        {
+            bus.skip();
+        }
+    }
+    
+    void writeByte(uint8_t value)
+    {
+        bus.write(value);
+    }
+    
+    uint8_t readByte()
+    {
+        return bus.read();
+    }
+    
+    // The bus itself, for anything else it offers
+    Impl& getBus()
+    {
+        return bus;
+    }
+    
+    private:
+    
+    Impl& bus;
+};
+
+#endif
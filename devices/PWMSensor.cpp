@@ -1,16 +1,97 @@
 #include "PWMSensor.h"
+#include "ServoDriver.h"
 
-PWMSensor::PWMSensor()
+PWMSensor::PWMSensor(uint32_t (*microsecondsNow)())
+    : microsecondsNow(microsecondsNow),
+      riseTime(0),
+      high(false),
+      lastPulseRise(0),
+      pulseWidth(0),
+      period(0),
+      lastPulseTime(0),
+      pulseCount(0),
+      glitchCount(0),
+      angle(Fixed1000::missing())
 {
-    
 }
 
-int32_t PWMSensor::getAngle() const
+void PWMSensor::handleEdge(bool high, uint32_t microseconds)
 {
+    if (high)
+    {
+        // Two rises in a row mean the fall between them was missed, so the newer rise starts the pulse
+        riseTime = microseconds;
+        this->high = true;
+        return;
+    }
+    if (!this->high)
+    {
+        return;
+    }
+    this->high = false;
     
+    uint32_t width = microseconds - riseTime;
+    if (width < PWM_MIN_PULSE_MICROSECONDS || width > PWM_MAX_PULSE_MICROSECONDS)
+    {
+        glitchCount++;
+        return;
+    }
+    // The period spans two believed pulses, so that a glitch does not cut one short,
+    // and is not measured across a lost signal
+    period = pulseCount > 0 ? riseTime - lastPulseRise : 0;
+    if (period > PWM_TIMEOUT_MICROSECONDS)
+    {
+        period = 0;
+    }
+    lastPulseRise = riseTime;
+    pulseWidth = width;
+    lastPulseTime = microseconds;
+    pulseCount++;
 }
 
-int32_t PWMSensor::readAngle()
+Fixed1000 PWMSensor::getAngle() const
 {
-    
-}
\ No newline at end of file
+    return angle;
+}
+
+Fixed1000 PWMSensor::readAngle()
+{
+    if (pulseCount == 0 || microsecondsNow() - lastPulseTime > PWM_TIMEOUT_MICROSECONDS)
+    {
+        angle = Fixed1000::missing();
+        return angle;
+    }
+    // Not clamped to the servo's travel, so a transmitter trimmed past it reads as it is
+    angle = Fixed1000::fromRatio(((int32_t)pulseWidth - SERVO_MIN_PULSE_MICROSECONDS) * SERVO_MAX_DEGREES,
+        SERVO_MAX_PULSE_MICROSECONDS - SERVO_MIN_PULSE_MICROSECONDS);
+    return angle;
+}
+
+Fixed1000 PWMSensor::getDutyCycle() const
+{
+    if (period == 0)
+    {
+        return Fixed1000::missing();
+    }
+    return Fixed1000::fromRatio((int32_t)pulseWidth * 100, period);
+}
+
+uint32_t PWMSensor::getPulseWidth() const
+{
+    return pulseWidth;
+}
+
+uint32_t PWMSensor::getPeriod() const
+{
+    return period;
+}
+
+uint32_t PWMSensor::getPulseCount() const
+{
+    return pulseCount;
+}
+
+uint32_t PWMSensor::getGlitchCount() const
+{
+    return glitchCount;
+}
@@ -1,37 +1,84 @@
+#include "FixedPoint.h"
+
 #ifndef PWM_SENSOR
 #define PWM_SENSOR
 
+// Pulses shorter or longer than these are glitches on the line, and are not believed
+#define PWM_MIN_PULSE_MICROSECONDS 500
+#define PWM_MAX_PULSE_MICROSECONDS 2500
+
+// How long the signal may go without a pulse before readAngle gives up on it: three frames
+#define PWM_TIMEOUT_MICROSECONDS 60000
+
 // Measures the duty-cycle of a 50hz PWM signal, as used with hobbyist servos and radio controls.
 // Reports this measurement as an angle in degrees as it would control a hobbyist servo.
+// It measures from the times of the signal's edges, which are given to it as they happen,
+// from a pin change interrupt or anything that watches the pin, so nothing waits on a pulse
+// and one loop can read any number of channels.
 class PWMSensor
 {
     public:
-
+    
     /*
     Make use of int32_t, int16_t, int8_t (32-bits, 16-bits, or 8-bits) 
     instead of int, short, or char.
     This will ensure that the length of the integer is always the same on different platforms.
     */
     
-    // You will likely want to give this constructor parameters that distinguish this specific sensor
-    // from any other one.
-    PWMSensor();
+    // microsecondsNow gives the time on the same clock as the edges, such as Arduino's micros.
+    PWMSensor(uint32_t (*microsecondsNow)());
+    
+    // Takes an edge of the signal, rising if high is true, at the given time in microseconds.
+    // If this is called from an interrupt, the other methods should be called with interrupts off,
+    // since the measurements take more than one instruction to read on an 8-bit processor.
+    void handleEdge(bool high, uint32_t microseconds);
     
     // Value returned has the decimal point fixed at the 1000s place.
-    // Value is in degrees, interpreting the PWM 
+    // Value is in degrees, interpreting the PWM as ServoDriver sends it:
+    // SERVO_MIN_PULSE_MICROSECONDS is 0 degrees and SERVO_MAX_PULSE_MICROSECONDS is SERVO_MAX_DEGREES.
     // Returns the last value read by the sensor.
-    int32_t getAngle() const;
+    Fixed1000 getAngle() const;
+    
+    // Value returned has the decimal point fixed at the 1000s place.
+    // Value is in degrees, as getAngle.
+    // Works out the angle from the last pulse.
+    // If there has not been a pulse for PWM_TIMEOUT_MICROSECONDS,
+    // the signal is taken to be lost, and missing (INT32_MIN) returned.
+    Fixed1000 readAngle();
     
     // Value returned has the decimal point fixed at the 1000s place.
     // Value is in percentage, so 100% would be 100 _to the left_ of the decimal point.
-    // Queries the sensor to determine its current humidity.
-    // If the query is taking too long, the query should be cut off,
-    // and INT32_MIN returned.
-    int32_t readAngle();
-
+    // The share of the last period that the signal was high,
+    // or missing if there has not yet been a whole period.
+    Fixed1000 getDutyCycle() const;
+    
+    // The width of the last pulse, and the time from the start of one pulse to the next,
+    // in microseconds, or 0 if there has not been one yet
+    uint32_t getPulseWidth() const;
+    uint32_t getPeriod() const;
+    
+    // The number of pulses measured, and of pulses not believed
+    uint32_t getPulseCount() const;
+    uint32_t getGlitchCount() const;
+    
     private:
-
-    // Your code here
+    
+    uint32_t (*microsecondsNow)();
+    
+    // When the signal last rose, if it is high now
+    uint32_t riseTime;
+    bool high;
+    // When the last believed pulse rose, for its period to the next one
+    uint32_t lastPulseRise;
+    
+    uint32_t pulseWidth;
+    uint32_t period;
+    // When the last believed pulse ended
+    uint32_t lastPulseTime;
+    uint32_t pulseCount;
+    uint32_t glitchCount;
+    
+    Fixed1000 angle;
 
 };
 
@@ -0,0 +1,100 @@
+#include "PtySerial.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+uint32_t hostMillisecondsNow()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)(now.tv_sec * 1000UL + now.tv_nsec / 1000000L);
+}
+
+PtySerial::PtySerial()
+    : fileDescriptor(-1)
+{
+    path[0] = '\0';
+}
+
+PtySerial::~PtySerial()
+{
+    if (fileDescriptor != -1)
+    {
+        close(fileDescriptor);
+    }
+}
+
+bool PtySerial::open()
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (master == -1)
+    {
+        return false;
+    }
+    const char* name = grantpt(master) == 0 && unlockpt(master) == 0 ? ptsname(master) : NULL;
+    if (!name || strlen(name) >= sizeof(path))
+    {
+        close(master);
+        return false;
+    }
+    
+    // Raw mode, so bytes go through as they are, with no echo or line editing,
+    // set on our end since the other may not be opened for a while
+    struct termios settings;
+    if (tcgetattr(master, &settings) == 0)
+    {
+        cfmakeraw(&settings);
+        tcsetattr(master, TCSANOW, &settings);
+    }
+    
+    if (fileDescriptor != -1)
+    {
+        close(fileDescriptor);
+    }
+    fileDescriptor = master;
+    strcpy(path, name);
+    return true;
+}
+
+const char* PtySerial::getPath() const
+{
+    return path;
+}
+
+bool PtySerial::writeByte(int8_t value)
+{
+    return write(&value, 1) == 1;
+}
+
+int32_t PtySerial::readByte()
+{
+    int8_t value;
+    return read(&value, 1) == 1 ? (uint8_t)value : -1;
+}
+
+size_t PtySerial::read(int8_t* destination, size_t count)
+{
+    // Nothing to read, and no one on the other end yet, look the same to the caller
+    ssize_t bytesRead = fileDescriptor == -1 ? -1 : ::read(fileDescriptor, destination, count);
+    return bytesRead > 0 ? (size_t)bytesRead : 0;
+}
+
+size_t PtySerial::write(const int8_t* source, size_t count)
+{
+    ssize_t bytesWritten = fileDescriptor == -1 ? -1 : ::write(fileDescriptor, source, count);
+    return bytesWritten > 0 ? (size_t)bytesWritten : 0;
+}
+
+size_t PtySerial::available()
+{
+    int bytes = 0;
+    if (fileDescriptor == -1 || ioctl(fileDescriptor, FIONREAD, &bytes) == -1)
+    {
+        return 0;
+    }
+    return (size_t)bytes;
+}
@@ -0,0 +1,48 @@
+#include "ISerial.h"
+
+#ifndef PTY_SERIAL
+#define PTY_SERIAL
+
+// The longest path of a pty's other end, including the null byte
+#define PTY_PATH_SIZE 64
+
+// Gives the time in milliseconds on a Linux host, the way Arduino's millis does, for running drivers
+// and simulated devices in real time
+uint32_t hostMillisecondsNow();
+
+// A serial device on a Linux host backed by a pseudo-terminal, so that programs outside this one,
+// such as the tag and NMEA ingest daemons or a terminal, can open the other end like any /dev/tty*.
+// Join it to a simulated device with a SerialBridge to expose the device.
+// Reads never wait, and writes take what the pty has room for.
+class PtySerial : public ISerial
+{
+    public:
+    
+    PtySerial();
+    ~PtySerial();
+    
+    // Opens a new pty, in raw mode.
+    // Returns false if the host cannot.
+    bool open();
+    
+    // The path of the other end, such as /dev/pts/3, for the program to open
+    const char* getPath() const;
+    
+    bool writeByte(int8_t value);
+    int32_t readByte();
+    size_t read(int8_t* destination, size_t count);
+    size_t write(const int8_t* source, size_t count);
+    size_t available();
+    
+    private:
+    
+    // Not copyable, since it owns the pty
+    PtySerial(const PtySerial&);
+    PtySerial& operator=(const PtySerial&);
+    
+    // This program's end, or -1 if it is not open
+    int32_t fileDescriptor;
+    char path[PTY_PATH_SIZE];
+};
+
+#endif
@@ -0,0 +1,93 @@
+#include "SerialPipe.h"
+
+SerialPipe::End::End(SimulatedLine& incoming, SimulatedLine& outgoing)
+    : incoming(incoming),
+      outgoing(outgoing)
+{
+}
+
+bool SerialPipe::End::writeByte(int8_t value)
+{
+    char character = (char)value;
+    return outgoing.send(&character, 1);
+}
+
+int32_t SerialPipe::End::readByte()
+{
+    int8_t value;
+    return incoming.read(&value, 1) ? (uint8_t)value : -1;
+}
+
+size_t SerialPipe::End::read(int8_t* destination, size_t count)
+{
+    return incoming.read(destination, count);
+}
+
+size_t SerialPipe::End::write(const int8_t* source, size_t count)
+{
+    // Take what fits, as a real port's transmit buffer would
+    size_t room = outgoing.getRoom();
+    if (count > room)
+    {
+        count = room;
+    }
+    outgoing.send((const char*)source, count);
+    return count;
+}
+
+size_t SerialPipe::End::available()
+{
+    return incoming.available();
+}
+
+SerialPipe::SerialPipe(uint32_t (*millisecondsNow)(), uint32_t baudRate)
+    : forward(millisecondsNow, baudRate),
+      backward(millisecondsNow, baudRate),
+      endZero(backward, forward),
+      endOne(forward, backward)
+{
+}
+
+SerialPipe::End& SerialPipe::getEnd(uint8_t end)
+{
+    return end == 0 ? endZero : endOne;
+}
+
+SerialBridge::SerialBridge(ISerial& first, ISerial& second)
+    : first(first),
+      second(second)
+{
+    fromFirst.start = fromFirst.count = 0;
+    fromSecond.start = fromSecond.count = 0;
+}
+
+size_t SerialBridge::update()
+{
+    return carry(first, second, fromFirst) + carry(second, first, fromSecond);
+}
+
+size_t SerialBridge::carry(ISerial& from, ISerial& to, Carry& held)
+{
+    size_t carried = 0;
+    while (true)
+    {
+        if (held.count == 0)
+        {
+            held.start = 0;
+            held.count = from.read(held.bytes, SERIAL_BRIDGE_CHUNK_SIZE);
+            if (held.count == 0)
+            {
+                return carried;
+            }
+        }
+        size_t written = to.write(held.bytes + held.start, held.count);
+        held.start += written;
+        held.count -= written;
+        carried += written;
+        if (held.count > 0)
+        {
+            // The other side is full for now
+            return carried;
+        }
+    }
+}
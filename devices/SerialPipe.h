@@ -0,0 +1,83 @@
+#include "ISerial.h"
+#include "SimulatedLine.h"
+
+#ifndef SERIAL_PIPE
+#define SERIAL_PIPE
+
+// How many bytes a bridge carries over at a time
+#define SERIAL_BRIDGE_CHUNK_SIZE 64
+
+// An in-process serial connection between two pieces of code that each expect an ISerial,
+// such as a sketch's transceiver code and a base station's, or a driver and a simulated device.
+// What is written to one end can be read from the other, as fast as the baud rate allows (0 for no limit).
+class SerialPipe
+{
+    public:
+    
+    // One end of the pipe
+    class End : public ISerial
+    {
+        public:
+        
+        End(SimulatedLine& incoming, SimulatedLine& outgoing);
+        
+        bool writeByte(int8_t value);
+        int32_t readByte();
+        size_t read(int8_t* destination, size_t count);
+        size_t write(const int8_t* source, size_t count);
+        size_t available();
+        
+        private:
+        
+        SimulatedLine& incoming;
+        SimulatedLine& outgoing;
+    };
+    
+    SerialPipe(uint32_t (*millisecondsNow)(), uint32_t baudRate);
+    
+    // The two ends, 0 and 1
+    End& getEnd(uint8_t end);
+    
+    private:
+    
+    // From end 0 to end 1, and back
+    SimulatedLine forward;
+    SimulatedLine backward;
+    
+    End endZero;
+    End endOne;
+};
+
+// Joins two serial devices, such as a simulated device and a pty, by carrying over whatever either one
+// has to read into the other, each time it is updated.
+// What the receiving side cannot take yet is held on to until it can.
+class SerialBridge
+{
+    public:
+    
+    SerialBridge(ISerial& first, ISerial& second);
+    
+    // Carries over what is available each way.
+    // Returns the number of bytes carried.
+    size_t update();
+    
+    private:
+    
+    // Bytes read from a side that the other has not taken yet
+    struct Carry
+    {
+        int8_t bytes[SERIAL_BRIDGE_CHUNK_SIZE];
+        size_t start;
+        size_t count;
+    };
+    
+    // Carries over what from has to to
+    static size_t carry(ISerial& from, ISerial& to, Carry& held);
+    
+    ISerial& first;
+    ISerial& second;
+    Carry fromFirst;
+    Carry fromSecond;
+};
+
+#endif
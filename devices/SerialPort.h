@@ -0,0 +1,73 @@
+#include "ISerial.h"
+
+#ifndef SERIAL_PORT
+#define SERIAL_PORT
+
+// Wraps a concrete serial port (a class implementing ISerial) for code that is templated on its port,
+// such as GPSDecoder::decodeFrom. Every call names Impl's own method, so it is not dispatched
+// through the vtable and the compiler is free to inline it into the decoder.
+// Impl must be the concrete class itself: calling ISerial's pure methods this way does not link.
+// Impl must also have its own bulk read and write, not only ISerial's, which would move a byte
+// at a time through the virtual readByte and writeByte; a port without them does not compile.
+template <typename Impl>
+class SerialPort
+{
+    public:
+    
+    explicit SerialPort(Impl& port)
+        : port(port)
+    {
+    }
+    
+    // Writes a single byte to the port.
+    bool writeByte(int8_t value)
+    {
+        return port.Impl::writeByte(value);
+    }
+    
+    // Reads a single byte from the port, returning -1 if there is no further data available.
+    int32_t readByte()
+    {
+        return port.Impl::readByte();
+    }
+    
+    // Reads up to count bytes that are already available into destination.
+    // Returns the number of bytes read.
+    size_t read(int8_t* destination, size_t count)
+    {
+        return port.Impl::read(destination, count);
+    }
+    
+    // Writes up to count bytes from source to the port.
+    // Returns the number of bytes written.
+    size_t write(const int8_t* source, size_t count)
+    {
+        return port.Impl::write(source, count);
+    }
+    
+    // Returns the number of bytes that can be read right away.
+    size_t available()
+    {
+        return port.Impl::available();
+    }
+    
+    // The port itself, for anything else it offers
+    Impl& getPort()
+    {
+        return port;
+    }
+    
+    private:
+    
+    // Which class the read and write that Impl has come from, by the size they return
+    static char ownRead(size_t (Impl::*)(int8_t*, size_t));
+    static long ownRead(size_t (ISerial::*)(int8_t*, size_t));
+    static char ownWrite(size_t (Impl::*)(const int8_t*, size_t));
+    static long ownWrite(size_t (ISerial::*)(const int8_t*, size_t));
+    typedef char implHasItsOwnRead[sizeof(ownRead(&Impl::read)) == 1 ? 1 : -1];
+    typedef char implHasItsOwnWrite[sizeof(ownWrite(&Impl::write)) == 1 ? 1 : -1];
+    
+    Impl& port;
+};
+
+#endif
\ No newline at end of file
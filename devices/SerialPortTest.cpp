@@ -0,0 +1,121 @@
+// Checks that GPSDecoder and IMUDecoder read through SerialPort a chunk at a time,
+// with the port's own bulk read, and never a byte at a time through readByte.
+// Build and run on a host:
+//     g++ -I. SerialPortTest.cpp NmeaSentence.cpp GPSDecoder.cpp IMUDecoder.cpp -o serialporttest
+//     ./serialporttest
+#include "SerialPort.h"
+#include "GPSDecoder.h"
+#include "IMUDecoder.h"
+#include "HostTest.h"
+#include <stdio.h>
+#include <string.h>
+
+// The most a port holds to be read
+#define PORT_SIZE 1024
+
+// A port that reads from text it is given, and counts how it is read
+class TextPort : public ISerial
+{
+    public:
+    
+    TextPort()
+        : length(0),
+          position(0),
+          byteReads(0),
+          bulkReads(0)
+    {
+    }
+    
+    // Adds an NMEA sentence with the given body, working out its checksum
+    void addSentence(const char* body)
+    {
+        uint8_t checksum = 0;
+        for (const char* character = body; *character; character++)
+        {
+            checksum ^= (uint8_t)*character;
+        }
+        length += snprintf(text + length, sizeof(text) - length, "$%s*%02X\r\n", body, (unsigned)checksum);
+    }
+    
+    bool writeByte(int8_t value)
+    {
+        (void)value;
+        return true;
+    }
+    
+    int32_t readByte()
+    {
+        byteReads++;
+        return position < length ? (int32_t)(uint8_t)text[position++] : -1;
+    }
+    
+    size_t read(int8_t* destination, size_t count)
+    {
+        bulkReads++;
+        size_t bytesRead = length - position < count ? length - position : count;
+        memcpy(destination, text + position, bytesRead);
+        position += bytesRead;
+        return bytesRead;
+    }
+    
+    size_t write(const int8_t* source, size_t count)
+    {
+        (void)source;
+        return count;
+    }
+    
+    size_t available()
+    {
+        return length - position;
+    }
+    
+    size_t getLength() const
+    {
+        return length;
+    }
+    
+    uint32_t getByteReads() const
+    {
+        return byteReads;
+    }
+    
+    uint32_t getBulkReads() const
+    {
+        return bulkReads;
+    }
+    
+    private:
+    
+    char text[PORT_SIZE];
+    size_t length;
+    size_t position;
+    uint32_t byteReads;
+    uint32_t bulkReads;
+};
+
+int main()
+{
+    TextPort gpsPort;
+    gpsPort.addSentence("GPGGA,123519,4807.038,N,01131.000,W,1,08,0.9,545.4,M,46.9,M,,");
+    gpsPort.addSentence("GPVTG,054.7,T,034.4,M,005.5,N,010.2,K");
+    SerialPort<TextPort> gpsSerial(gpsPort);
+    GPSDecoder gps;
+    check(gps.decodeFrom(gpsSerial) && gps.getLatitude().getRaw() == 48117 && gps.getSpeed().getRaw() == 2829,
+        "the GPS decodes what it reads through the port");
+    // Every chunk, and the empty read that ends them
+    uint32_t chunks = (gpsPort.getLength() + GPS_DECODE_CHUNK_SIZE - 1) / GPS_DECODE_CHUNK_SIZE + 1;
+    check(gpsPort.getBulkReads() == chunks && gpsPort.getByteReads() == 0, "the GPS reads a chunk at a time");
+    check(!gps.decodeFrom(gpsSerial), "the GPS reads nothing more once the port is empty");
+    
+    TextPort imuPort;
+    imuPort.addSentence("VNYMR,-120.483,+002.133,-001.234,+0.4000,-0.1000,+0.9000,"
+        "+00.101,-00.202,-09.810,+0.000100,-0.000100,+0.052360");
+    SerialPort<TextPort> imuSerial(imuPort);
+    IMUDecoder imu;
+    check(imu.decodeFrom(imuSerial) && imu.getYaw().getRaw() == -120483, "the IMU decodes what it reads through the port");
+    chunks = (imuPort.getLength() + IMU_DECODE_CHUNK_SIZE - 1) / IMU_DECODE_CHUNK_SIZE + 1;
+    check(imuPort.getBulkReads() == chunks && imuPort.getByteReads() == 0, "the IMU reads a chunk at a time");
+    
+    printf("\n%d failures\n", failures);
+    return failures ? 1 : 0;
+}
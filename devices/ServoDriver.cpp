@@ -1,16 +1,106 @@
 #include "ServoDriver.h"
 
-ServoDriver::ServoDriver()
+// Keeps the compiler from moving memory accesses across it. frameReady is volatile but the frames are not,
+// so without it the frame could be written after frameReady is set, while step may be swapping it in.
+// The AVR does not reorder memory accesses itself, so nothing more is needed there.
+#define SERVO_COMPILER_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+ServoDriver::ServoDriver(void (*writePin)(uint8_t channel, bool high), uint8_t channelCount)
+    : writePin(writePin),
+      channelCount(channelCount > SERVO_MAX_CHANNELS ? SERVO_MAX_CHANNELS : channelCount),
+      activeFrame(0),
+      frameReady(false),
+      nextEnd(0)
 {
-    
+    for (uint8_t i = 0; i < this->channelCount; i++)
+    {
+        angles[i] = 0;
+        frames[0].channels[i] = i;
+        frames[0].widths[i] = SERVO_MIN_PULSE_MICROSECONDS;
+    }
+    nextEnd = this->channelCount;
 }
 
-void ServoDriver::setAngle(int16_t degrees)
+void ServoDriver::setAngle(uint8_t channel, int16_t degrees)
 {
+    if (channel >= channelCount)
+    {
+        return;
+    }
+    angles[channel] = degrees < 0 ? 0 : degrees > SERVO_MAX_DEGREES ? SERVO_MAX_DEGREES : degrees;
+    
+    // Once frameReady is clear, step leaves the other frame alone, so it can be rebuilt
+    frameReady = false;
+    SERVO_COMPILER_BARRIER();
+    Frame& frame = frames[1 - activeFrame];
     
+    // Sorted by insertion, which is as quick as anything for a handful of channels
+    for (uint8_t i = 0; i < channelCount; i++)
+    {
+        uint16_t width = getPulseWidth(i);
+        uint8_t position = i;
+        while (position > 0 && frame.widths[position - 1] > width)
+        {
+            frame.channels[position] = frame.channels[position - 1];
+            frame.widths[position] = frame.widths[position - 1];
+            position--;
+        }
+        frame.channels[position] = i;
+        frame.widths[position] = width;
+    }
+    SERVO_COMPILER_BARRIER();
+    frameReady = true;
+}
+
+int16_t ServoDriver::getAngle(uint8_t channel) const
+{
+    return channel < channelCount ? angles[channel] : 0;
 }
 
-int16_t ServoDriver::getAngle() const
+uint16_t ServoDriver::getPulseWidth(uint8_t channel) const
 {
+    return SERVO_MIN_PULSE_MICROSECONDS
+        + (uint16_t)((int32_t)getAngle(channel) * (SERVO_MAX_PULSE_MICROSECONDS - SERVO_MIN_PULSE_MICROSECONDS)
+            / SERVO_MAX_DEGREES);
+}
+
+uint32_t ServoDriver::step()
+{
+    if (channelCount == 0)
+    {
+        return SERVO_FRAME_MICROSECONDS;
+    }
     
-}
\ No newline at end of file
+    if (nextEnd == channelCount)
+    {
+        // The top of a frame, and the only time the frames may be swapped
+        if (frameReady)
+        {
+            activeFrame = 1 - activeFrame;
+            frameReady = false;
+        }
+        // The frame is only read once frameReady has been
+        SERVO_COMPILER_BARRIER();
+        const Frame& frame = frames[activeFrame];
+        for (uint8_t i = 0; i < channelCount; i++)
+        {
+            writePin(frame.channels[i], true);
+        }
+        nextEnd = 0;
+        return frame.widths[0];
+    }
+    
+    // Every pulse as wide as the next one ends now
+    const Frame& frame = frames[activeFrame];
+    uint16_t now = frame.widths[nextEnd];
+    while (nextEnd < channelCount && frame.widths[nextEnd] == now)
+    {
+        writePin(frame.channels[nextEnd], false);
+        nextEnd++;
+    }
+    if (nextEnd < channelCount)
+    {
+        return frame.widths[nextEnd] - now;
+    }
+    return SERVO_FRAME_MICROSECONDS - now;
+}
@@ -1,7 +1,22 @@
+#include <stdint.h>
+
 #ifndef SERVO_DRIVER
 #define SERVO_DRIVER
 
-// Controls a single servo motor (of the hobbyist PWM type)
+// The most servos one driver controls
+#define SERVO_MAX_CHANNELS 8
+
+// Servos take a pulse every 20ms, 1ms long at one end of their travel and 2ms at the other
+#define SERVO_FRAME_MICROSECONDS 20000
+#define SERVO_MIN_PULSE_MICROSECONDS 1000
+#define SERVO_MAX_PULSE_MICROSECONDS 2000
+#define SERVO_MAX_DEGREES 180
+
+// Controls several servo motors (of the hobbyist PWM type) from a single timer.
+// Every channel's pulse starts together at the top of a 20ms frame, and the frame is kept sorted by
+// pulse width, so that the pulses end in order: the timer only ever needs setting for the next end.
+// step does whatever is due and says how long until it is due again, so an interrupt walks a whole
+// frame in one timer, with channelCount + 1 interrupts a frame at most, and nothing in between.
 class ServoDriver
 {
 	public:
@@ -12,20 +27,47 @@ class ServoDriver
 	This will ensure that the length of the integer is always the same on different platforms.
 	*/
     
-    // You will likely want to give this constructor parameters that distinguish this specific motor
-    // from any other one.
-    ServoDriver();
+    // writePin sets a channel's pin high or low, such as with digitalWrite on the pin of that channel.
+    // Every channel starts at 0 degrees.
+    ServoDriver(void (*writePin)(uint8_t channel, bool high), uint8_t channelCount);
+
+	// Sets the angle of the given servo motor to the given number of degrees, from 0 to SERVO_MAX_DEGREES.
+	// It takes effect from the start of the next frame.
+	// Not to be called from the interrupt that calls step.
+	void setAngle(uint8_t channel, int16_t degrees);
+    
+    // Returns the angle that the given motor was last set to.
+	int16_t getAngle(uint8_t channel) const;
 
-	// Sets the angle of this servo motor to the given number of degrees.
-	void setAngle(int16_t degrees);
-	
-    // Returns the angle that this motor was last set to.
-	int16_t getAngle() const;
+	// Returns the width of the pulses the given motor is sent for its angle, in microseconds.
+	uint16_t getPulseWidth(uint8_t channel) const;
+
+	// Sets or clears the pins whose time has come, starting a new frame once the last pulse is done.
+	// Returns the number of microseconds until it should be called again.
+	// Call from a timer interrupt, setting the timer again by what it returns.
+	uint32_t step();
 
 
 	private:
 
-	// Your code here
+	// The channels in the order their pulses end, with the width of each
+	struct Frame
+	{
+	    uint8_t channels[SERVO_MAX_CHANNELS];
+	    uint16_t widths[SERVO_MAX_CHANNELS];
+	};
+
+	void (*writePin)(uint8_t channel, bool high);
+	uint8_t channelCount;
+	int16_t angles[SERVO_MAX_CHANNELS];
+
+	// step walks one frame while setAngle builds the other, and they are swapped between frames
+	Frame frames[2];
+	volatile uint8_t activeFrame;
+	volatile bool frameReady;
+
+	// The next pulse in the active frame to end, which is channelCount between frames
+	uint8_t nextEnd;
 
 };
 
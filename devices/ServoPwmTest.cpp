@@ -0,0 +1,267 @@
+// Checks the frames ServoDriver walks and the pulses PWMSensor measures,
+// then loops servo pulses back into PWMSensors over the gpio simulator's wires, on its virtual clock.
+// Build and run on a host:
+//     gcc -std=c99 -c ../gpioSoftwareSerial/GeneralPurposeIO*.c ../gpioSoftwareSerial/nonstdio.c
+//         ../gpioSoftwareSerial/formattedstring.c ../gpioSoftwareSerial/exitmalloc.c
+//     g++ -I. -I../gpioSoftwareSerial ServoPwmTest.cpp ServoDriver.cpp PWMSensor.cpp GpioEdgeSampler.cpp
+//         GeneralPurposeIO*.o nonstdio.o formattedstring.o exitmalloc.o -lpthread -lrt -o servopwmtest
+//     ./servopwmtest
+#include "ServoDriver.h"
+#include "PWMSensor.h"
+#include "GpioEdgeSampler.h"
+#include "HostTest.h"
+
+extern "C"
+{
+#include "GeneralPurposeIOSim.h"
+}
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHANNEL_COUNT 4
+
+// How often the loopback reads the pins, as a busy host loop or a fast backend would
+#define SAMPLE_NANOSECONDS 5000L
+
+// The frame test's clock, and what each channel's pin did on it
+static uint32_t simulatedMicroseconds = 0;
+static uint32_t riseTimes[CHANNEL_COUNT];
+static uint32_t fallTimes[CHANNEL_COUNT];
+static uint8_t fallOrder[CHANNEL_COUNT];
+static uint8_t fallCount = 0;
+
+static uint32_t microsecondsNow()
+{
+    return simulatedMicroseconds;
+}
+
+static void recordPin(uint8_t channel, bool high)
+{
+    if (high)
+    {
+        riseTimes[channel] = simulatedMicroseconds;
+    }
+    else
+    {
+        fallTimes[channel] = simulatedMicroseconds;
+        fallOrder[fallCount++ % CHANNEL_COUNT] = channel;
+    }
+}
+
+// Walks the driver through a frame, as its timer would, returning the number of steps it took
+static int32_t walkFrame(ServoDriver& driver)
+{
+    int32_t steps = 0;
+    uint32_t frameStart = simulatedMicroseconds;
+    fallCount = 0;
+    do
+    {
+        simulatedMicroseconds += driver.step();
+        steps++;
+    }
+    while (simulatedMicroseconds - frameStart < SERVO_FRAME_MICROSECONDS);
+    return steps;
+}
+
+static void testFrames()
+{
+    ServoDriver driver(recordPin, CHANNEL_COUNT);
+    driver.setAngle(0, 90);
+    driver.setAngle(1, 0);
+    driver.setAngle(2, 200);
+    driver.setAngle(3, 45);
+    check(driver.getAngle(2) == SERVO_MAX_DEGREES, "angles past the servo's travel are held at its end");
+    
+    int32_t steps = walkFrame(driver);
+    check(steps == CHANNEL_COUNT + 1, "a frame takes a step for its start and one for each end");
+    check(simulatedMicroseconds == SERVO_FRAME_MICROSECONDS, "frames are 20ms");
+    uint32_t expected[CHANNEL_COUNT] = { 1500, 1000, 2000, 1250 };
+    bool widthsRight = true;
+    for (uint8_t i = 0; i < CHANNEL_COUNT; i++)
+    {
+        widthsRight = widthsRight && fallTimes[i] - riseTimes[i] == expected[i]
+            && driver.getPulseWidth(i) == expected[i];
+    }
+    check(widthsRight, "every pulse is as wide as its angle");
+    check(fallOrder[0] == 1 && fallOrder[1] == 3 && fallOrder[2] == 0 && fallOrder[3] == 2,
+        "pulses end narrowest first");
+    
+    // A change partway through a frame waits for the next one
+    simulatedMicroseconds += driver.step();
+    driver.setAngle(1, 90);
+    driver.setAngle(3, 90);
+    while (simulatedMicroseconds % SERVO_FRAME_MICROSECONDS != 0)
+    {
+        simulatedMicroseconds += driver.step();
+    }
+    check(fallTimes[1] - riseTimes[1] == 1000, "a frame under way keeps its widths");
+    steps = walkFrame(driver);
+    check(fallTimes[1] - riseTimes[1] == 1500 && fallTimes[3] - riseTimes[3] == 1500,
+        "the next frame has the new widths");
+    // Three pulses of 1.5ms and one of 2ms
+    check(steps == 3, "pulses of the same width end in one step");
+}
+
+static void testPulses()
+{
+    simulatedMicroseconds = 0;
+    PWMSensor sensor(microsecondsNow);
+    check(sensor.readAngle().isMissing(), "no angle before the first pulse");
+    
+    for (uint32_t frame = 0; frame < 3; frame++)
+    {
+        sensor.handleEdge(true, frame * 20000);
+        sensor.handleEdge(false, frame * 20000 + 1500);
+    }
+    simulatedMicroseconds = 2 * 20000 + 1500;
+    check(sensor.readAngle().getRaw() == 90000, "a 1.5ms pulse is 90 degrees");
+    check(sensor.getDutyCycle().getRaw() == 7500 && sensor.getPeriod() == 20000, "a 1.5ms pulse in 20ms is 7.5%");
+    
+    // A spike between pulses is not one
+    sensor.handleEdge(true, 3 * 20000 - 5000);
+    sensor.handleEdge(false, 3 * 20000 - 4990);
+    sensor.handleEdge(true, 3 * 20000);
+    sensor.handleEdge(false, 3 * 20000 + 1250);
+    simulatedMicroseconds = 3 * 20000 + 1250;
+    check(sensor.getGlitchCount() == 1 && sensor.readAngle().getRaw() == 45000, "glitches are not believed");
+    check(sensor.getPeriod() == 20000, "a glitch does not cut the period short");
+    
+    // A missed fall leaves a rise on its own, and the next rise starts the pulse
+    sensor.handleEdge(true, 4 * 20000);
+    sensor.handleEdge(true, 5 * 20000);
+    sensor.handleEdge(false, 5 * 20000 + 2000);
+    simulatedMicroseconds = 5 * 20000 + 2000;
+    check(sensor.readAngle().getRaw() == 180000, "a pulse after a missed fall");
+    
+    simulatedMicroseconds += PWM_TIMEOUT_MICROSECONDS + 1;
+    check(sensor.readAngle().isMissing() && sensor.getAngle().isMissing(), "a lost signal gives a missing angle");
+    sensor.handleEdge(true, simulatedMicroseconds);
+    sensor.handleEdge(false, simulatedMicroseconds + 1500);
+    check(sensor.getDutyCycle().isMissing(), "the period is not measured across a lost signal");
+}
+
+static const char* const servoPins[CHANNEL_COUNT] = { "servo0", "servo1", "servo2", "servo3" };
+static const char* const receiverPins[CHANNEL_COUNT] = { "rc0", "rc1", "rc2", "rc3" };
+
+static void writeServoPin(uint8_t channel, bool high)
+{
+    gpioSimBackend.writePin(servoPins[channel], high);
+}
+
+static void addNanoseconds(struct timespec& time, long nanoseconds)
+{
+    time.tv_nsec += nanoseconds;
+    time.tv_sec += time.tv_nsec / 1000000000L;
+    time.tv_nsec %= 1000000000L;
+}
+
+static bool isBefore(const struct timespec& first, const struct timespec& second)
+{
+    return first.tv_sec < second.tv_sec || (first.tv_sec == second.tv_sec && first.tv_nsec < second.tv_nsec);
+}
+
+// Runs the servos and the sampler together on the virtual clock for the given number of frames,
+// stepping the servos whenever their timer comes due and sampling in between.
+// Returns the largest error of any channel's angle once it has settled, in thousandths of a degree.
+static int32_t loopBack(ServoDriver& driver, GpioEdgeSampler& sampler, PWMSensor* sensors, uint32_t frames)
+{
+    struct timespec now;
+    gpioClockNow(&now);
+    struct timespec nextStep = now;
+    struct timespec nextSample = now;
+    struct timespec end = now;
+    addNanoseconds(end, (long)frames * SERVO_FRAME_MICROSECONDS * 1000);
+    int32_t largestError = 0;
+    
+    while (isBefore(nextSample, end))
+    {
+        if (!isBefore(nextSample, nextStep))
+        {
+            gpioClockSleepUntil(&nextStep);
+            addNanoseconds(nextStep, (long)driver.step() * 1000);
+            continue;
+        }
+        gpioClockSleepUntil(&nextSample);
+        if (sampler.sample() < 0)
+        {
+            return INT32_MAX;
+        }
+        addNanoseconds(nextSample, SAMPLE_NANOSECONDS);
+    }
+    
+    for (uint8_t i = 0; i < CHANNEL_COUNT; i++)
+    {
+        int32_t error = labs(sensors[i].readAngle().getRaw() - driver.getAngle(i) * 1000);
+        if (error > largestError)
+        {
+            largestError = error;
+        }
+    }
+    return largestError;
+}
+
+static void testLoopBack()
+{
+    // Wires that are a little late and a little noisy in their timing, as real ones are
+    GpioSimConfig config = GpioSimConfig();
+    config.jitterNanoseconds = 1000;
+    config.callNanoseconds = 50;
+    config.seed = 7;
+    gpioSimConfigure(&config);
+    gpioUseClock(&gpioSimBackend);
+    
+    GpioEdgeSampler sampler(&gpioSimBackend);
+    PWMSensor sensors[CHANNEL_COUNT] = { PWMSensor(gpioMicrosecondsNow), PWMSensor(gpioMicrosecondsNow),
+        PWMSensor(gpioMicrosecondsNow), PWMSensor(gpioMicrosecondsNow) };
+    bool pinsReady = true;
+    for (uint8_t i = 0; i < CHANNEL_COUNT; i++)
+    {
+        pinsReady = pinsReady && gpioSimBackend.openPin(servoPins[i]) == 0
+            && gpioSimBackend.setOutputLow(servoPins[i]) == 0
+            && gpioSimConnect(servoPins[i], receiverPins[i]) == 0
+            && sampler.addPin(receiverPins[i], sensors[i]);
+    }
+    check(pinsReady, "the simulated pins are connected");
+    
+    ServoDriver driver(writeServoPin, CHANNEL_COUNT);
+    int16_t angles[CHANNEL_COUNT] = { 30, 150, 90, 90 };
+    for (uint8_t i = 0; i < CHANNEL_COUNT; i++)
+    {
+        driver.setAngle(i, angles[i]);
+    }
+    int32_t error = loopBack(driver, sampler, sensors, 5);
+    printf("largest error after 5 frames: %.3f degrees, from %u edges\n", error / 1000.0,
+        (unsigned)sampler.getEdgeCount());
+    // The edges are timed to within a sample and a little jitter, of 180 degrees a millisecond
+    check(error <= 1500, "every channel reads back what it was sent");
+    check(sensors[0].getPeriod() >= 19990 && sensors[0].getPeriod() <= 20010, "the period is 20ms");
+    
+    driver.setAngle(0, 180);
+    driver.setAngle(3, 0);
+    error = loopBack(driver, sampler, sensors, 3);
+    check(error <= 1500, "channels follow new angles");
+    
+    // Sampling with the servos stopped
+    struct timespec now;
+    gpioClockNow(&now);
+    struct timespec end = now;
+    addNanoseconds(end, (PWM_TIMEOUT_MICROSECONDS + 1000) * 1000L);
+    while (isBefore(now, end))
+    {
+        sampler.sample();
+        addNanoseconds(now, SAMPLE_NANOSECONDS);
+        gpioClockSleepUntil(&now);
+    }
+    check(sensors[1].readAngle().isMissing(), "stopped servos read as a lost signal");
+    check(sensors[0].getGlitchCount() == 0, "no glitches on a clean wire");
+}
+
+int main()
+{
+    testFrames();
+    testPulses();
+    testLoopBack();
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
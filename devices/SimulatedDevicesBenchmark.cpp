@@ -0,0 +1,344 @@
+// Runs the balloon's decoding and control code against simulated devices on a host:
+// first at the baud and sentence rates the balloon uses, on simulated time, to see what share of the time
+// the decoding takes and that nothing is lost, then with every device saturating its decoder,
+// to see how fast each decoder can go.
+// Build and run on a host (the sketch code needs -fpermissive, as the Arduino IDE gives it):
+//     g++ -O2 -fpermissive -I. -I../reconMission SimulatedDevicesBenchmark.cpp SimulatedLine.cpp SimulatedModem.cpp SimulatedNmea.cpp SimulatedXBee.cpp SerialPipe.cpp PtySerial.cpp CellDriver.cpp ATResponse.cpp SmsPdu.cpp ../reconMission/gpsimu.cpp ../reconMission/transceiverPacketParse.cpp -o simbench
+//     ./simbench
+// With --pty, it instead puts the simulated GPS, IMU and XBee on ptys in real time, and prints their paths,
+// for the ingest daemons or a terminal to open.
+#include "CellDriver.h"
+#include "PtySerial.h"
+#include "SerialPipe.h"
+#include "SimulatedModem.h"
+#include "SimulatedNmea.h"
+#include "SimulatedXBee.h"
+#include "gpsimu.h"
+#include "transceiverPacketParse.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// The rates the balloon runs its devices at
+#define GPS_BAUD_RATE 4800
+#define GPS_FIXES_PER_SECOND 1
+#define IMU_BAUD_RATE 115200
+#define IMU_READINGS_PER_SECOND 40
+#define TRANSCEIVER_BAUD_RATE 9600
+#define BASE_TAGS_PER_SECOND 2
+#define CELL_BAUD_RATE 28800
+
+// How long the realistic run lasts, and how often the loop goes around
+#define FLIGHT_MILLISECONDS (10UL * 60 * 1000)
+#define LOOP_MILLISECONDS 1
+
+// How often the loop asks the GPS for its velocity, sends telemetry to the base station,
+// and texts it to the ground
+#define VELOCITY_REQUEST_MILLISECONDS 10000
+#define TELEMETRY_MILLISECONDS 1000
+#define TEXT_MILLISECONDS 60000
+
+// How many bytes each decoder gets when saturated
+#define SATURATING_BYTES (16UL * 1024 * 1024)
+
+// How much of a saturating device's output is recorded to play back to its decoder
+#define PLAYBACK_SIZE (1024UL * 1024)
+
+// How much the loop reads at a time
+#define READ_CHUNK_SIZE 64
+
+static uint32_t simulatedNow = 0;
+
+static uint32_t millisecondsNow()
+{
+    return simulatedNow;
+}
+
+// The processor time this program has used, in seconds
+static double cpuSeconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// What the loop has decoded
+struct Decoded
+{
+    uint32_t bytes;
+    uint32_t gpsFixes;
+    uint32_t imuReadings;
+    uint32_t baseTags;
+};
+
+// What the decoders decode into
+static GpsData gpsData;
+static ImuData imuData;
+static TransceiverPacketParseData packetData;
+
+static bool decodeGpsByte(uint8_t value)
+{
+    return parseGps((char)value, &gpsData);
+}
+
+static bool decodeImuByte(uint8_t value)
+{
+    return parseImu((char)value, &imuData);
+}
+
+static bool decodeTransceiverByte(uint8_t value)
+{
+    return parseTransceiverByte(value, &packetData);
+}
+
+// Reads what a device has available and decodes it, the way reconMission's loop does, but a chunk at a time.
+// Whatever arrives meanwhile waits for the next time around, as it does on the balloon.
+static void drain(ISerial& device, bool (*decodeByte)(uint8_t), uint32_t& decodedCount, uint32_t& bytes)
+{
+    int8_t chunk[READ_CHUNK_SIZE];
+    size_t remaining = device.available();
+    while (remaining > 0)
+    {
+        size_t count = device.read(chunk, remaining < sizeof(chunk) ? remaining : sizeof(chunk));
+        if (count == 0)
+        {
+            break;
+        }
+        remaining -= count;
+        bytes += count;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (decodeByte((uint8_t)chunk[i]))
+            {
+                decodedCount++;
+            }
+        }
+    }
+}
+
+// Sends a tag to the base station as an XBee transmit request, as sendTransceiverPacketTag does
+static void sendTransceiverTag(ISerial& transceiver, const char* tag, const char* data)
+{
+    size_t dataLength = strlen(data);
+    size_t length = 5 + 2 + dataLength;
+    int8_t header[] = { 0x7E, (int8_t)(length >> 8), (int8_t)length, 0x01, 0x00, (int8_t)0xFF, (int8_t)0xFF, 0x00 };
+    transceiver.write(header, sizeof(header));
+    transceiver.write((const int8_t*)tag, 2);
+    transceiver.write((const int8_t*)data, dataLength);
+    uint8_t sum = 0x01 + 0xFF + 0xFF + tag[0] + tag[1];
+    for (size_t i = 0; i < dataLength; i++)
+    {
+        sum += (uint8_t)data[i];
+    }
+    transceiver.writeByte((int8_t)(0xFF - sum));
+}
+
+// Flies for a while with every device at the balloon's rates
+static void runRealistic()
+{
+    simulatedNow = 0;
+    SimulatedGps gps(millisecondsNow, GPS_BAUD_RATE, GPS_FIXES_PER_SECOND);
+    gps.setPosition(41310, -72920, 30000);
+    gps.setVelocity(4000, -1500, 5000);
+    SimulatedImu imu(millisecondsNow, IMU_BAUD_RATE, IMU_READINGS_PER_SECOND);
+    SimulatedXBee transceiver(millisecondsNow, TRANSCEIVER_BAUD_RATE);
+    transceiver.setTraffic("BS", "41.310,-72.920", BASE_TAGS_PER_SECOND);
+    SimulatedModem modem(millisecondsNow, CELL_BAUD_RATE);
+    CellDriver cell(modem, millisecondsNow);
+    const char* const recipients[] = { "12033470933", "14018649488", "14015550101" };
+    
+    Decoded decoded = { 0, 0, 0, 0 };
+    memset(&packetData, 0, sizeof(packetData));
+    double loopSeconds = 0;
+    uint32_t worstLoopMicroseconds = 0;
+    for (simulatedNow = 0; simulatedNow < FLIGHT_MILLISECONDS; simulatedNow += LOOP_MILLISECONDS)
+    {
+        double start = cpuSeconds();
+        drain(transceiver, decodeTransceiverByte, decoded.baseTags, decoded.bytes);
+        drain(gps, decodeGpsByte, decoded.gpsFixes, decoded.bytes);
+        drain(imu, decodeImuByte, decoded.imuReadings, decoded.bytes);
+        cell.update();
+        
+        if (simulatedNow % VELOCITY_REQUEST_MILLISECONDS == 0)
+        {
+            gps.write((const int8_t*)GPS_VELOCITY_REQUEST, strlen(GPS_VELOCITY_REQUEST));
+        }
+        if (simulatedNow % TELEMETRY_MILLISECONDS == 0)
+        {
+            sendTransceiverTag(transceiver, "LA", "41.310");
+        }
+        if (simulatedNow % TEXT_MILLISECONDS == 0 && cell.readyToSendTextMessage())
+        {
+            cell.queueTextMessage(recipients, 3, "Lat: 41.310\nLong: -72.920\nALIVE!");
+        }
+        
+        double elapsed = cpuSeconds() - start;
+        loopSeconds += elapsed;
+        if (elapsed * 1e6 > worstLoopMicroseconds)
+        {
+            worstLoopMicroseconds = (uint32_t)(elapsed * 1e6);
+        }
+    }
+    
+    double flightSeconds = FLIGHT_MILLISECONDS / 1000.0;
+    printf("Realistic rates, %.0f simulated minutes, a loop every %d ms\n", flightSeconds / 60, LOOP_MILLISECONDS);
+    printf("  GPS          %5u of %5u fixes decoded\n", decoded.gpsFixes, gps.getSentencesSent());
+    printf("  IMU          %5u of %5u readings decoded\n", decoded.imuReadings, imu.getSentencesSent());
+    printf("  transceiver  %5u of %5u base station tags decoded, %u of %u telemetry tags checked out\n",
+        decoded.baseTags, transceiver.getFramesSent(), transceiver.getRequestsReceived(),
+        (unsigned)(FLIGHT_MILLISECONDS / TELEMETRY_MILLISECONDS));
+    printf("  cell         %5u text messages sent, %u failed\n", cell.getTextMessagesSent(), cell.getTextMessagesFailed());
+    printf("  %.1f KB decoded, using %.3f%% of the time on this host, the slowest loop %u us\n\n",
+        decoded.bytes / 1024.0, 100 * loopSeconds / flightSeconds, worstLoopMicroseconds);
+}
+
+// A recording of what a device sent, played back over and over, so that decoders are timed without the device.
+// The seam where it starts over spoils a sentence or frame each time around.
+class Playback : public ISerial
+{
+    public:
+    
+    explicit Playback(ISerial& device)
+        : position(0)
+    {
+        size_t recorded = 0;
+        while (recorded < PLAYBACK_SIZE)
+        {
+            recorded += device.read((int8_t*)recording + recorded, PLAYBACK_SIZE - recorded);
+        }
+    }
+    
+    bool writeByte(int8_t)
+    {
+        return true;
+    }
+    
+    int32_t readByte()
+    {
+        int8_t value;
+        return read(&value, 1) ? (uint8_t)value : -1;
+    }
+    
+    size_t read(int8_t* destination, size_t count)
+    {
+        if (count > PLAYBACK_SIZE - position)
+        {
+            count = PLAYBACK_SIZE - position;
+        }
+        memcpy(destination, recording + position, count);
+        position = (position + count) % PLAYBACK_SIZE;
+        return count;
+    }
+    
+    // As much as a serial port's buffer would hold
+    size_t available()
+    {
+        return SIMULATED_LINE_CAPACITY;
+    }
+    
+    private:
+    
+    static char recording[PLAYBACK_SIZE];
+    size_t position;
+};
+
+char Playback::recording[PLAYBACK_SIZE];
+
+// Times a decoder on SATURATING_BYTES of what a saturating device sends
+static void printSaturated(const char* name, ISerial& device, bool (*decodeByte)(uint8_t), const char* what)
+{
+    Playback playback(device);
+    uint32_t decodedCount = 0;
+    uint32_t bytes = 0;
+    double start = cpuSeconds();
+    while (bytes < SATURATING_BYTES)
+    {
+        drain(playback, decodeByte, decodedCount, bytes);
+    }
+    double seconds = cpuSeconds() - start;
+    printf("  %-30s %7.1f MB/s %6.1f ns/byte  %8u %s\n", name, bytes / seconds / 1e6, seconds * 1e9 / bytes,
+        decodedCount, what);
+}
+
+// Gives each decoder as much as it can take
+static void runSaturating()
+{
+    simulatedNow = 0;
+    printf("Saturating, %lu MB each\n", SATURATING_BYTES / (1024 * 1024));
+    
+    SimulatedGps gps(millisecondsNow, 0, 0);
+    printSaturated("GPS ($GPGGA)", gps, decodeGpsByte, "fixes");
+    
+    SimulatedImu imu(millisecondsNow, 0, 0);
+    printSaturated("IMU ($VNYMR)", imu, decodeImuByte, "readings");
+    
+    SimulatedImu noisyImu(millisecondsNow, 0, 0);
+    noisyImu.setCorruptionPercent(10);
+    printSaturated("IMU, 10% corrupted", noisyImu, decodeImuByte, "readings");
+    
+    SimulatedXBee transceiver(millisecondsNow, 0);
+    transceiver.setTraffic("MS", "A base station message of about this length", 0);
+    memset(&packetData, 0, sizeof(packetData));
+    printSaturated("transceiver (XBee API frames)", transceiver, decodeTransceiverByte, "tags");
+    
+    // The module's news, written into a pipe as fast as the driver reads it
+    SerialPipe pipe(millisecondsNow, 0);
+    CellDriver cell(pipe.getEnd(1), millisecondsNow);
+    const char* news = "\r\n+CREG: 1,\"1395\",\"D7D4\"\r\n";
+    size_t newsLength = strlen(news);
+    uint32_t bytes = 0;
+    double start = cpuSeconds();
+    while (bytes < SATURATING_BYTES)
+    {
+        while (pipe.getEnd(0).write((const int8_t*)news, newsLength) == newsLength)
+        {
+            bytes += newsLength;
+        }
+        cell.update();
+    }
+    double seconds = cpuSeconds() - start;
+    printf("  %-30s %7.1f MB/s %6.1f ns/byte  %8u %s\n", "cell (+CREG through a pipe)", bytes / seconds / 1e6,
+        seconds * 1e9 / bytes, (unsigned)(bytes / newsLength), "lines, pipe included");
+}
+
+// Puts the simulated devices on ptys in real time, until stopped
+static void runPtys()
+{
+    SimulatedGps gps(hostMillisecondsNow, GPS_BAUD_RATE, GPS_FIXES_PER_SECOND);
+    SimulatedImu imu(hostMillisecondsNow, IMU_BAUD_RATE, IMU_READINGS_PER_SECOND);
+    SimulatedXBee transceiver(hostMillisecondsNow, TRANSCEIVER_BAUD_RATE);
+    transceiver.setTraffic("BS", "41.310,-72.920", BASE_TAGS_PER_SECOND);
+    
+    PtySerial gpsPty, imuPty, transceiverPty;
+    if (!gpsPty.open() || !imuPty.open() || !transceiverPty.open())
+    {
+        fprintf(stderr, "Could not open the ptys\n");
+        return;
+    }
+    printf("GPS on %s\nIMU on %s\ntransceiver on %s\n", gpsPty.getPath(), imuPty.getPath(), transceiverPty.getPath());
+    fflush(stdout);
+    
+    SerialBridge gpsBridge(gps, gpsPty);
+    SerialBridge imuBridge(imu, imuPty);
+    SerialBridge transceiverBridge(transceiver, transceiverPty);
+    while (true)
+    {
+        gpsBridge.update();
+        imuBridge.update();
+        transceiverBridge.update();
+        usleep(LOOP_MILLISECONDS * 1000);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--pty") == 0)
+    {
+        runPtys();
+        return 1;
+    }
+    runRealistic();
+    runSaturating();
+    return 0;
+}
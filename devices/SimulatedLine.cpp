@@ -0,0 +1,116 @@
+#include "SimulatedLine.h"
+#include <string.h>
+
+// A serial byte takes a start bit, eight data bits, and a stop bit
+#define SIMULATED_BITS_PER_BYTE 10
+
+uint32_t simulatedRandom(uint32_t& seed)
+{
+    // The constants from Numerical Recipes, with the low bits, which repeat quickly, thrown away
+    seed = seed * 1664525UL + 1013904223UL;
+    return seed >> 8;
+}
+
+SimulatedLine::SimulatedLine(uint32_t (*millisecondsNow)(), uint32_t baudRate)
+    : millisecondsNow(millisecondsNow),
+      baudRate(baudRate),
+      start(0),
+      count(0),
+      arrived(0),
+      lastTime(millisecondsNow()),
+      partialMilliBytes(0),
+      bytesDropped(0)
+{
+}
+
+bool SimulatedLine::send(const char* text, size_t length)
+{
+    advance();
+    if (length > SIMULATED_LINE_CAPACITY - count)
+    {
+        bytesDropped += length;
+        return false;
+    }
+    
+    // An idle line starts sending now, not whenever it last had something to send
+    if (count == 0)
+    {
+        partialMilliBytes = 0;
+    }
+    for (size_t i = 0; i < length; i++)
+    {
+        buffer[(start + count++) % SIMULATED_LINE_CAPACITY] = text[i];
+    }
+    if (baudRate == 0)
+    {
+        arrived = count;
+    }
+    return true;
+}
+
+bool SimulatedLine::send(const char* text)
+{
+    return send(text, strlen(text));
+}
+
+size_t SimulatedLine::read(int8_t* destination, size_t count)
+{
+    advance();
+    if (count > arrived)
+    {
+        count = arrived;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        destination[i] = (int8_t)buffer[start];
+        start = (start + 1) % SIMULATED_LINE_CAPACITY;
+    }
+    this->count -= count;
+    arrived -= count;
+    return count;
+}
+
+size_t SimulatedLine::available()
+{
+    advance();
+    return arrived;
+}
+
+size_t SimulatedLine::getRoom() const
+{
+    return SIMULATED_LINE_CAPACITY - count;
+}
+
+uint32_t SimulatedLine::getBytesDropped() const
+{
+    return bytesDropped;
+}
+
+uint32_t SimulatedLine::getBaudRate() const
+{
+    return baudRate;
+}
+
+void SimulatedLine::advance()
+{
+    uint32_t now = millisecondsNow();
+    uint32_t elapsed = now - lastTime;
+    lastTime = now;
+    if (baudRate == 0 || arrived == count)
+    {
+        return;
+    }
+    
+    // Bytes a second are baudRate / 10, which is as many thousandths of a byte a millisecond.
+    // A long enough wait lets everything across, which also keeps this from overflowing.
+    if (elapsed >= 1000UL * SIMULATED_BITS_PER_BYTE * SIMULATED_LINE_CAPACITY / baudRate + 1)
+    {
+        arrived = count;
+        partialMilliBytes = 0;
+        return;
+    }
+    partialMilliBytes += elapsed * baudRate / SIMULATED_BITS_PER_BYTE;
+    size_t bytes = partialMilliBytes / 1000;
+    partialMilliBytes %= 1000;
+    arrived = bytes < count - arrived ? arrived + bytes : count;
+}
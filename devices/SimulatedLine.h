@@ -0,0 +1,67 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef SIMULATED_LINE
+#define SIMULATED_LINE
+
+// How many bytes a simulated line holds that have been sent but not yet read
+#define SIMULATED_LINE_CAPACITY 1024
+
+// Gives the next number from a simple pseudo-random sequence, which is the same for the same seed on every host,
+// so that simulations can be run again exactly
+uint32_t simulatedRandom(uint32_t& seed);
+
+// One direction of a simulated serial connection, for the simulated devices to send through.
+// Bytes sent go into a buffer, and can only be read as fast as the baud rate lets them across,
+// ten bits to a byte, by the time millisecondsNow gives.
+// A baud rate of 0 lets everything across at once, for saturating whatever reads it.
+class SimulatedLine
+{
+    public:
+    
+    SimulatedLine(uint32_t (*millisecondsNow)(), uint32_t baudRate);
+    
+    // Adds bytes to the line, all or none of them.
+    // Returns false if there is not room for them, the way a real device's buffer overflows.
+    bool send(const char* text, size_t length);
+    
+    // Adds a null terminated string to the line, like send.
+    bool send(const char* text);
+    
+    // Reads up to count bytes that have made it across into destination.
+    // Returns the number of bytes read.
+    size_t read(int8_t* destination, size_t count);
+    
+    // Returns the number of bytes that have made it across and can be read right away.
+    size_t available();
+    
+    // Returns how many more bytes there is room to send.
+    size_t getRoom() const;
+    
+    // Returns the number of bytes that did not fit, and were never sent
+    uint32_t getBytesDropped() const;
+    
+    uint32_t getBaudRate() const;
+    
+    private:
+    
+    // Lets across whatever the time since the last call allows
+    void advance();
+    
+    uint32_t (*millisecondsNow)();
+    uint32_t baudRate;
+    
+    char buffer[SIMULATED_LINE_CAPACITY];
+    size_t start;
+    size_t count;
+    
+    // How many of the buffered bytes have made it across
+    size_t arrived;
+    // When the line was last advanced, and thousandths of a byte that were on their way then
+    uint32_t lastTime;
+    uint32_t partialMilliBytes;
+    
+    uint32_t bytesDropped;
+};
+
+#endif
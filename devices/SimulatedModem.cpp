@@ -0,0 +1,314 @@
+#include "SimulatedModem.h"
+#include "SmsPdu.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Ends the body of a text message, and cancels it
+#define SIMULATED_MODEM_END_OF_TEXT 26
+#define SIMULATED_MODEM_ESCAPE 27
+
+SimulatedModem::SimulatedModem(uint32_t (*millisecondsNow)(), uint32_t baudRate, uint32_t seed)
+    : millisecondsNow(millisecondsNow),
+      line(millisecondsNow, baudRate),
+      seed(seed),
+      answerMilliseconds(SIMULATED_MODEM_ANSWER_MILLISECONDS),
+      promptMilliseconds(SIMULATED_MODEM_PROMPT_MILLISECONDS),
+      sendMilliseconds(SIMULATED_MODEM_SEND_MILLISECONDS),
+      sendJitterMilliseconds(SIMULATED_MODEM_SEND_JITTER_MILLISECONDS),
+      mcc(310),
+      mnc(410),
+      lac(0x1395),
+      cid(0xD7D4),
+      inputLength(0),
+      takingText(false),
+      pduMode(false),
+      transferLength(0),
+      pendingCount(0),
+      scriptedCount(0),
+      messageReference(0),
+      commandsReceived(0),
+      textsSent(0),
+      textsRejected(0)
+{
+    SimulatedModemTrouble none = { 0, NULL, 0, 0 };
+    trouble = none;
+    recipient[0] = '\0';
+    lastText[0] = '\0';
+}
+
+void SimulatedModem::setTrouble(const SimulatedModemTrouble& trouble)
+{
+    this->trouble = trouble;
+}
+
+void SimulatedModem::setDelays(uint32_t answerMilliseconds, uint32_t promptMilliseconds,
+    uint32_t sendMilliseconds, uint32_t sendJitterMilliseconds)
+{
+    this->answerMilliseconds = answerMilliseconds;
+    this->promptMilliseconds = promptMilliseconds;
+    this->sendMilliseconds = sendMilliseconds;
+    this->sendJitterMilliseconds = sendJitterMilliseconds;
+}
+
+void SimulatedModem::setOperator(int32_t mcc, int32_t mnc)
+{
+    this->mcc = mcc;
+    this->mnc = mnc;
+}
+
+bool SimulatedModem::script(const char* commandPrefix, const char* reply)
+{
+    if (scriptedCount == SIMULATED_MODEM_SCRIPT_SIZE)
+    {
+        return false;
+    }
+    ScriptedReply& scripted = scriptedReplies[scriptedCount++];
+    snprintf(scripted.commandPrefix, sizeof(scripted.commandPrefix), "%s", commandPrefix);
+    snprintf(scripted.reply, sizeof(scripted.reply), "%s", reply);
+    return true;
+}
+
+void SimulatedModem::receiveTextMessage(const char* senderPhoneNumber, const char* text)
+{
+    char news[SIMULATED_MODEM_OUTPUT_SIZE];
+    if (pduMode)
+    {
+        // A real module passes on an SMS-DELIVER, with the service centre and a timestamp.
+        // An SMS-SUBMIT from the sender carries the same, and decodes the same way.
+        uint8_t pdu[SMS_MAX_PDU_OCTETS];
+        char hex[2 * SMS_MAX_PDU_OCTETS + 1];
+        size_t length = encodeSmsText(pdu, senderPhoneNumber, text);
+        if (length == 0)
+        {
+            return;
+        }
+        smsHexFromOctets(pdu, length, hex);
+        snprintf(news, sizeof(news), "\r\n+CMT: ,%u\r\n%s\r\n", (unsigned)smsTransferLength(pdu, length), hex);
+    }
+    else
+    {
+        snprintf(news, sizeof(news), "\r\n+CMT: \"%s\",,\"12/04/21,10:30:00-16\"\r\n%s\r\n", senderPhoneNumber, text);
+    }
+    say(0, news);
+}
+
+void SimulatedModem::moveToCell(int32_t lac, int32_t cid)
+{
+    this->lac = lac;
+    this->cid = cid;
+    char news[SIMULATED_MODEM_OUTPUT_SIZE];
+    snprintf(news, sizeof(news), "\r\n+CREG: 1,\"%04X\",\"%04X\"\r\n", (unsigned)lac, (unsigned)cid);
+    say(0, news);
+}
+
+bool SimulatedModem::writeByte(int8_t value)
+{
+    char character = (char)value;
+    if (takingText)
+    {
+        if (character == SIMULATED_MODEM_END_OF_TEXT)
+        {
+            takingText = false;
+            input[inputLength] = '\0';
+            inputLength = 0;
+            finishText();
+        }
+        else if (character == SIMULATED_MODEM_ESCAPE)
+        {
+            takingText = false;
+            inputLength = 0;
+        }
+        else if (inputLength < SIMULATED_MODEM_INPUT_SIZE - 1)
+        {
+            input[inputLength++] = character;
+        }
+        return true;
+    }
+    if (character == '\r')
+    {
+        input[inputLength] = '\0';
+        inputLength = 0;
+        handleCommand();
+    }
+    else if (character != '\n' && inputLength < SIMULATED_MODEM_INPUT_SIZE - 1)
+    {
+        input[inputLength++] = character;
+    }
+    return true;
+}
+
+int32_t SimulatedModem::readByte()
+{
+    int8_t value;
+    return read(&value, 1) ? (uint8_t)value : -1;
+}
+
+size_t SimulatedModem::read(int8_t* destination, size_t count)
+{
+    speak();
+    return line.read(destination, count);
+}
+
+size_t SimulatedModem::available()
+{
+    speak();
+    return line.available();
+}
+
+uint32_t SimulatedModem::getCommandsReceived() const
+{
+    return commandsReceived;
+}
+
+uint32_t SimulatedModem::getTextsSent() const
+{
+    return textsSent;
+}
+
+uint32_t SimulatedModem::getTextsRejected() const
+{
+    return textsRejected;
+}
+
+const char* SimulatedModem::getLastRecipient() const
+{
+    return recipient;
+}
+
+const char* SimulatedModem::getLastText() const
+{
+    return lastText;
+}
+
+bool SimulatedModem::hasService() const
+{
+    return trouble.outagePeriodMilliseconds == 0
+        || millisecondsNow() % trouble.outagePeriodMilliseconds >= trouble.outageMilliseconds;
+}
+
+void SimulatedModem::say(uint32_t delay, const char* text)
+{
+    if (pendingCount == SIMULATED_MODEM_PENDING_COUNT)
+    {
+        return;
+    }
+    PendingOutput& output = pending[pendingCount++];
+    output.time = millisecondsNow() + delay;
+    if (pendingCount > 1 && (int32_t)(output.time - pending[pendingCount - 2].time) < 0)
+    {
+        output.time = pending[pendingCount - 2].time;
+    }
+    snprintf(output.text, sizeof(output.text), "%s", text);
+}
+
+void SimulatedModem::speak()
+{
+    uint32_t now = millisecondsNow();
+    uint8_t spoken = 0;
+    while (spoken < pendingCount && (int32_t)(now - pending[spoken].time) >= 0
+        && line.send(pending[spoken].text))
+    {
+        spoken++;
+    }
+    if (spoken > 0)
+    {
+        pendingCount -= spoken;
+        memmove(pending, pending + spoken, pendingCount * sizeof(PendingOutput));
+    }
+}
+
+void SimulatedModem::handleCommand()
+{
+    if (strncmp(input, "AT", 2) != 0)
+    {
+        return;
+    }
+    commandsReceived++;
+    
+    for (uint8_t i = 0; i < scriptedCount; i++)
+    {
+        if (strncmp(input, scriptedReplies[i].commandPrefix, strlen(scriptedReplies[i].commandPrefix)) == 0)
+        {
+            say(answerMilliseconds, scriptedReplies[i].reply);
+            scriptedCount--;
+            memmove(scriptedReplies + i, scriptedReplies + i + 1, (scriptedCount - i) * sizeof(ScriptedReply));
+            return;
+        }
+    }
+    
+    char reply[SIMULATED_MODEM_OUTPUT_SIZE];
+    if (strncmp(input, "AT+CMGS=", 8) == 0)
+    {
+        if (!hasService())
+        {
+            say(answerMilliseconds, "\r\n+CME ERROR: 30\r\n");
+            return;
+        }
+        // In text mode the recipient comes now, and in PDU mode inside the PDU, which has to be as long as said now
+        recipient[0] = '\0';
+        transferLength = pduMode ? (size_t)strtoul(input + 8, NULL, 10) : 0;
+        if (!pduMode)
+        {
+            const char* number = input[8] == '"' ? input + 9 : input + 8;
+            size_t length = strcspn(number, "\"");
+            if (length >= sizeof(recipient))
+            {
+                length = sizeof(recipient) - 1;
+            }
+            memcpy(recipient, number, length);
+            recipient[length] = '\0';
+        }
+        takingText = true;
+        say(promptMilliseconds, "\r\n> ");
+    }
+    else if (strncmp(input, "AT+CMGF=", 8) == 0)
+    {
+        pduMode = input[8] == '0';
+        say(answerMilliseconds, "\r\nOK\r\n");
+    }
+    else if (strcmp(input, "AT+COPS?") == 0)
+    {
+        snprintf(reply, sizeof(reply), "\r\n+COPS: 0,2,\"%03d%02d\"\r\n\r\nOK\r\n", (int)mcc, (int)mnc);
+        say(answerMilliseconds, reply);
+    }
+    else if (strcmp(input, "AT+CREG?") == 0)
+    {
+        snprintf(reply, sizeof(reply), "\r\n+CREG: 2,1,\"%04X\",\"%04X\"\r\n\r\nOK\r\n", (unsigned)lac, (unsigned)cid);
+        say(answerMilliseconds, reply);
+    }
+    else
+    {
+        say(answerMilliseconds, "\r\nOK\r\n");
+    }
+}
+
+void SimulatedModem::finishText()
+{
+    snprintf(lastText, sizeof(lastText), "%s", input);
+    if (pduMode)
+    {
+        uint8_t pdu[SMS_MAX_PDU_OCTETS];
+        SmsMessage message;
+        size_t length = smsOctetsFromHex(input, strlen(input), pdu, sizeof(pdu));
+        if (length == 0 || smsTransferLength(pdu, length) != transferLength || !decodeSms(pdu, length, message))
+        {
+            say(answerMilliseconds, "\r\n+CMS ERROR: 304\r\n");
+            textsRejected++;
+            return;
+        }
+        snprintf(recipient, sizeof(recipient), "%s", message.address);
+    }
+    
+    uint32_t delay = sendMilliseconds + (sendJitterMilliseconds ? simulatedRandom(seed) % sendJitterMilliseconds : 0);
+    bool rejected = trouble.badRecipient && strcmp(recipient, trouble.badRecipient) == 0;
+    if (rejected || (int32_t)(simulatedRandom(seed) % 100) < trouble.failurePercent)
+    {
+        say(delay, "\r\n+CMS ERROR: 500\r\n");
+        return;
+    }
+    char confirmation[SIMULATED_MODEM_OUTPUT_SIZE];
+    snprintf(confirmation, sizeof(confirmation), "\r\n+CMGS: %d\r\n\r\nOK\r\n", (int)(++messageReference % 256));
+    say(delay, confirmation);
+    textsSent++;
+}
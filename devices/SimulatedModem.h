@@ -0,0 +1,157 @@
+#include "ISerial.h"
+#include "SimulatedLine.h"
+
+#ifndef SIMULATED_MODEM
+#define SIMULATED_MODEM
+
+// The most replies and news the modem can have waiting to be said at once
+#define SIMULATED_MODEM_PENDING_COUNT 32
+
+// The longest reply, and the longest command or text message body it takes, including the null byte.
+// Both have room for a whole PDU in hex.
+#define SIMULATED_MODEM_OUTPUT_SIZE 400
+#define SIMULATED_MODEM_INPUT_SIZE 400
+
+// The most scripted replies waiting to be used at once
+#define SIMULATED_MODEM_SCRIPT_SIZE 8
+
+// The longest command prefix a scripted reply matches, including the null byte
+#define SIMULATED_MODEM_PREFIX_SIZE 24
+
+// The longest phone number, including the null byte
+#define SIMULATED_MODEM_PHONE_NUMBER_SIZE 24
+
+// How long the modem takes: to answer a plain command, to prompt for a text message,
+// and to send one, give or take up to the jitter
+#define SIMULATED_MODEM_ANSWER_MILLISECONDS 20
+#define SIMULATED_MODEM_PROMPT_MILLISECONDS 50
+#define SIMULATED_MODEM_SEND_MILLISECONDS 2500
+#define SIMULATED_MODEM_SEND_JITTER_MILLISECONDS 1500
+
+// The ways the modem misbehaves
+struct SimulatedModemTrouble
+{
+    // The chance in a hundred that a text message fails
+    int32_t failurePercent;
+    // A recipient the network rejects every time, or NULL
+    const char* badRecipient;
+    // Every period, the modem loses service for the given time, unless the period is 0
+    uint32_t outagePeriodMilliseconds;
+    uint32_t outageMilliseconds;
+};
+
+// A cellular module that answers AT commands as an SM5100B does, for running CellDriver on a host.
+// It takes text messages in text mode (AT+CMGF=1) and in PDU mode (AT+CMGF=0), where it rejects a PDU
+// of another length than AT+CMGS gave, answers AT+COPS? and AT+CREG?,
+// sends +CMT and +CREG news when told to, and says OK to anything else.
+// Replies come after made up delays by the time millisecondsNow gives, at the given baud rate (0 for no limit).
+class SimulatedModem : public ISerial
+{
+    public:
+    
+    SimulatedModem(uint32_t (*millisecondsNow)(), uint32_t baudRate, uint32_t seed = 1);
+    
+    void setTrouble(const SimulatedModemTrouble& trouble);
+    
+    // Sets how long the modem takes, in place of the defaults above
+    void setDelays(uint32_t answerMilliseconds, uint32_t promptMilliseconds,
+        uint32_t sendMilliseconds, uint32_t sendJitterMilliseconds);
+    
+    // The network the modem is on, as AT+COPS? gives it
+    void setOperator(int32_t mcc, int32_t mnc);
+    
+    // Makes the next command starting with commandPrefix get the given reply, such as "\r\nERROR\r\n",
+    // in place of the usual one. Each scripted reply is used once, in the order they were scripted.
+    // Returns false if there are too many waiting.
+    bool script(const char* commandPrefix, const char* reply);
+    
+    // Has a text message arrive from the given sender, passed on as +CMT in whichever mode the modem is in
+    void receiveTextMessage(const char* senderPhoneNumber, const char* text);
+    
+    // Moves the modem to another cell, and says so with +CREG
+    void moveToCell(int32_t lac, int32_t cid);
+    
+    bool writeByte(int8_t value);
+    int32_t readByte();
+    size_t read(int8_t* destination, size_t count);
+    size_t available();
+    
+    // The number of commands the modem has been sent, not counting text message bodies
+    uint32_t getCommandsReceived() const;
+    
+    // The number of text messages sent successfully
+    uint32_t getTextsSent() const;
+    
+    // The number of PDUs rejected for not decoding, or for being another length than AT+CMGS gave
+    uint32_t getTextsRejected() const;
+    
+    // The recipient and body of the last text message taken, whether it was sent or not.
+    // The body of a binary message is in hex.
+    const char* getLastRecipient() const;
+    const char* getLastText() const;
+    
+    private:
+    
+    // Something the modem will say, once its time comes
+    struct PendingOutput
+    {
+        uint32_t time;
+        char text[SIMULATED_MODEM_OUTPUT_SIZE];
+    };
+    
+    struct ScriptedReply
+    {
+        char commandPrefix[SIMULATED_MODEM_PREFIX_SIZE];
+        char reply[SIMULATED_MODEM_OUTPUT_SIZE];
+    };
+    
+    bool hasService() const;
+    
+    // Says something after the given delay, after anything already due
+    void say(uint32_t delay, const char* text);
+    
+    // Moves what is due onto the line
+    void speak();
+    
+    void handleCommand();
+    
+    // Takes the body of a text message, once it is ended
+    void finishText();
+    
+    uint32_t (*millisecondsNow)();
+    SimulatedLine line;
+    uint32_t seed;
+    
+    SimulatedModemTrouble trouble;
+    uint32_t answerMilliseconds;
+    uint32_t promptMilliseconds;
+    uint32_t sendMilliseconds;
+    uint32_t sendJitterMilliseconds;
+    int32_t mcc;
+    int32_t mnc;
+    int32_t lac;
+    int32_t cid;
+    
+    char input[SIMULATED_MODEM_INPUT_SIZE];
+    size_t inputLength;
+    // Between the prompt and the end of the text message
+    bool takingText;
+    bool pduMode;
+    // The length of the PDU, without the service centre, that AT+CMGS said was coming in PDU mode
+    size_t transferLength;
+    char recipient[SIMULATED_MODEM_PHONE_NUMBER_SIZE];
+    char lastText[SIMULATED_MODEM_INPUT_SIZE];
+    
+    PendingOutput pending[SIMULATED_MODEM_PENDING_COUNT];
+    uint8_t pendingCount;
+    
+    ScriptedReply scriptedReplies[SIMULATED_MODEM_SCRIPT_SIZE];
+    uint8_t scriptedCount;
+    
+    int32_t messageReference;
+    uint32_t commandsReceived;
+    uint32_t textsSent;
+    uint32_t textsRejected;
+};
+
+#endif
@@ -0,0 +1,257 @@
+#include "SimulatedNmea.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// What GPS_VELOCITY_REQUEST asks for, without its $ and checksum
+#define SIMULATED_GPS_VELOCITY_REQUEST "PTNLQTF"
+
+// Meters in a degree of latitude, and of longitude at the equator
+#define SIMULATED_METERS_PER_DEGREE 111320.0
+
+#define SIMULATED_PI 3.14159265358979
+
+SimulatedSentenceSource::SimulatedSentenceSource(uint32_t (*millisecondsNow)(), uint32_t baudRate,
+    uint32_t sentencesPerSecond, uint32_t seed)
+    : seed(seed),
+      millisecondsNow(millisecondsNow),
+      line(millisecondsNow, baudRate),
+      sentencesPerSecond(sentencesPerSecond),
+      corruptionPercent(0),
+      startTime(millisecondsNow()),
+      sequence(0),
+      inputLength(0),
+      sentencesSent(0),
+      sentencesDropped(0)
+{
+}
+
+SimulatedSentenceSource::~SimulatedSentenceSource()
+{
+}
+
+void SimulatedSentenceSource::setCorruptionPercent(int32_t percent)
+{
+    corruptionPercent = percent;
+}
+
+bool SimulatedSentenceSource::writeByte(int8_t value)
+{
+    char character = (char)value;
+    if (character == '$')
+    {
+        inputLength = 0;
+    }
+    else if (character == '\r' || character == '\n')
+    {
+        // Leave off the checksum, which a real device would check
+        input[inputLength] = '\0';
+        char* star = strchr(input, '*');
+        if (star)
+        {
+            *star = '\0';
+        }
+        if (inputLength > 0)
+        {
+            handleSentence(input, (millisecondsNow() - startTime) / 1000.0);
+        }
+        inputLength = 0;
+    }
+    else if (inputLength < SIMULATED_SENTENCE_INPUT_SIZE - 1)
+    {
+        input[inputLength++] = character;
+    }
+    return true;
+}
+
+int32_t SimulatedSentenceSource::readByte()
+{
+    int8_t value;
+    return read(&value, 1) ? (uint8_t)value : -1;
+}
+
+size_t SimulatedSentenceSource::read(int8_t* destination, size_t count)
+{
+    generate();
+    return line.read(destination, count);
+}
+
+size_t SimulatedSentenceSource::available()
+{
+    generate();
+    return line.available();
+}
+
+uint32_t SimulatedSentenceSource::getSentencesSent() const
+{
+    return sentencesSent;
+}
+
+uint32_t SimulatedSentenceSource::getSentencesDropped() const
+{
+    return sentencesDropped;
+}
+
+void SimulatedSentenceSource::handleSentence(const char*, double)
+{
+}
+
+void SimulatedSentenceSource::sendSentence(const char* body)
+{
+    // The checksum is every character between the $ and the * exclusive-ored together
+    uint8_t checksum = 0;
+    for (const char* character = body; *character; character++)
+    {
+        checksum ^= (uint8_t)*character;
+    }
+    char sentence[SIMULATED_SENTENCE_SIZE];
+    int32_t length = snprintf(sentence, sizeof(sentence), "$%s*%02X\r\n", body, checksum);
+    if (length < 0 || length >= (int32_t)sizeof(sentence))
+    {
+        return;
+    }
+    
+    if ((int32_t)(simulatedRandom(seed) % 100) < corruptionPercent)
+    {
+        // Anything between the $ and the *, so that the sentence still looks whole
+        sentence[1 + simulatedRandom(seed) % strlen(body)] ^= 0x01;
+    }
+    
+    if (line.send(sentence, length))
+    {
+        sentencesSent++;
+    }
+    else
+    {
+        sentencesDropped++;
+    }
+}
+
+void SimulatedSentenceSource::generate()
+{
+    char body[SIMULATED_SENTENCE_SIZE];
+    if (sentencesPerSecond == 0)
+    {
+        // As fast as there is room, with the time moving on a millisecond a sentence
+        while (line.getRoom() >= SIMULATED_SENTENCE_SIZE)
+        {
+            formatSentence(body, sizeof(body), sequence++ / 1000.0);
+            sendSentence(body);
+        }
+        return;
+    }
+    
+    uint32_t elapsed = millisecondsNow() - startTime;
+    uint32_t due = (uint32_t)((uint64_t)elapsed * sentencesPerSecond / 1000) + 1;
+    while (sequence < due)
+    {
+        formatSentence(body, sizeof(body), (double)sequence / sentencesPerSecond);
+        sendSentence(body);
+        sequence++;
+    }
+}
+
+SimulatedGps::SimulatedGps(uint32_t (*millisecondsNow)(), uint32_t baudRate, uint32_t sentencesPerSecond,
+    uint32_t seed)
+    : SimulatedSentenceSource(millisecondsNow, baudRate, sentencesPerSecond, seed),
+      latitude(41.31),
+      longitude(-72.92),
+      altitude(30.0),
+      east(0),
+      north(0),
+      up(0)
+{
+}
+
+void SimulatedGps::setPosition(int32_t latitude, int32_t longitude, int32_t altitude)
+{
+    this->latitude = latitude / 1000.0;
+    this->longitude = longitude / 1000.0;
+    this->altitude = altitude / 1000.0;
+}
+
+void SimulatedGps::setVelocity(int32_t east, int32_t north, int32_t up)
+{
+    this->east = east / 1000.0;
+    this->north = north / 1000.0;
+    this->up = up / 1000.0;
+}
+
+// Writes an angle the NMEA way: degrees and minutes, ddmm.mmm or dddmm.mmm, then the hemisphere
+static void formatAngle(char* destination, size_t size, double degrees, int32_t degreeDigits,
+    char positive, char negative)
+{
+    char hemisphere = degrees < 0 ? negative : positive;
+    degrees = fabs(degrees);
+    int32_t whole = (int32_t)degrees;
+    double minutes = (degrees - whole) * 60;
+    snprintf(destination, size, "%0*d%06.3f,%c", (int)degreeDigits, (int)whole, minutes, hemisphere);
+}
+
+void SimulatedGps::formatSentence(char* destination, size_t size, double seconds)
+{
+    double latitude, longitude, altitude;
+    getPosition(seconds, latitude, longitude, altitude);
+    char latitudeText[20];
+    char longitudeText[20];
+    formatAngle(latitudeText, sizeof(latitudeText), latitude, 2, 'N', 'S');
+    formatAngle(longitudeText, sizeof(longitudeText), longitude, 3, 'E', 'W');
+    
+    // The flight starts at noon
+    uint32_t time = 12 * 3600 + (uint32_t)seconds;
+    int32_t satellites = 6 + simulatedRandom(seed) % 5;
+    snprintf(destination, size, "GPGGA,%02u%02u%02u,%s,%s,1,%02d,%.1f,%.1f,M,-34.2,M,,",
+        (unsigned)(time / 3600 % 24), (unsigned)(time / 60 % 60), (unsigned)(time % 60),
+        latitudeText, longitudeText, (int)satellites, 0.8 + (simulatedRandom(seed) % 10) / 10.0, altitude);
+}
+
+void SimulatedGps::handleSentence(const char* sentence, double seconds)
+{
+    if (strcmp(sentence, SIMULATED_GPS_VELOCITY_REQUEST) != 0)
+    {
+        return;
+    }
+    double latitude, longitude, altitude;
+    getPosition(seconds, latitude, longitude, altitude);
+    char latitudeText[20];
+    char longitudeText[20];
+    formatAngle(latitudeText, sizeof(latitudeText), latitude, 4, 'N', 'S');
+    formatAngle(longitudeText, sizeof(longitudeText), longitude, 5, 'E', 'W');
+    uint32_t time = 12 * 3600 + (uint32_t)seconds;
+    char body[SIMULATED_SENTENCE_SIZE];
+    snprintf(body, sizeof(body), "PTNLRRF,A,1,%02u%02u%02u,08,1,%s,%s,%.1f,%.2f,%.2f,%.2f",
+        (unsigned)(time / 3600 % 24), (unsigned)(time / 60 % 60), (unsigned)(time % 60),
+        latitudeText, longitudeText, altitude, east, north, up);
+    sendSentence(body);
+}
+
+void SimulatedGps::getPosition(double seconds, double& latitude, double& longitude, double& altitude) const
+{
+    latitude = this->latitude + north * seconds / SIMULATED_METERS_PER_DEGREE;
+    longitude = this->longitude
+        + east * seconds / (SIMULATED_METERS_PER_DEGREE * cos(this->latitude * SIMULATED_PI / 180));
+    altitude = this->altitude + up * seconds;
+}
+
+SimulatedImu::SimulatedImu(uint32_t (*millisecondsNow)(), uint32_t baudRate, uint32_t sentencesPerSecond,
+    uint32_t seed)
+    : SimulatedSentenceSource(millisecondsNow, baudRate, sentencesPerSecond, seed)
+{
+}
+
+void SimulatedImu::formatSentence(char* destination, size_t size, double seconds)
+{
+    // A slow spin, a pendulum swing of a few seconds, and some vibration
+    double yaw = fmod(seconds * 3.0, 360.0) - 180.0;
+    double pitch = 8.0 * sin(2 * SIMULATED_PI * seconds / 4.5);
+    double roll = 5.0 * cos(2 * SIMULATED_PI * seconds / 3.7);
+    double noise = ((int32_t)(simulatedRandom(seed) % 2001) - 1000) / 10000.0;
+    double accelerationX = -9.81 * sin(pitch * SIMULATED_PI / 180) + noise;
+    double accelerationY = 9.81 * sin(roll * SIMULATED_PI / 180) - noise;
+    double accelerationZ = -9.81 * cos(pitch * SIMULATED_PI / 180) * cos(roll * SIMULATED_PI / 180) + noise;
+    snprintf(destination, size,
+        "VNYMR,%+08.3f,%+08.3f,%+08.3f,%+07.4f,%+07.4f,%+07.4f,%+07.3f,%+07.3f,%+07.3f,%+09.6f,%+09.6f,%+09.6f",
+        yaw, pitch, roll, 0.4 * cos(yaw * SIMULATED_PI / 180), -0.4 * sin(yaw * SIMULATED_PI / 180), 0.9,
+        accelerationX, accelerationY, accelerationZ, noise / 100, -noise / 100, 3.0 * SIMULATED_PI / 180);
+}
@@ -0,0 +1,123 @@
+#include "ISerial.h"
+#include "SimulatedLine.h"
+
+#ifndef SIMULATED_NMEA
+#define SIMULATED_NMEA
+
+// The longest sentence, including the $, checksum, line break and null byte
+#define SIMULATED_SENTENCE_SIZE 160
+
+// The longest sentence taken from whatever reads the device, including the null byte
+#define SIMULATED_SENTENCE_INPUT_SIZE 82
+
+// A device that sends NMEA 0183 sentences at a steady rate, such as a GPS or the IMU.
+// Sentences are made as their time comes, by the time millisecondsNow gives, and go out at the baud rate.
+// A rate of 0 sentences a second keeps the line full, and with a baud rate of 0, as full as it is read,
+// for saturating a decoder. A sentence whose time comes while the line is full is dropped,
+// as it would be when a real device's reader falls behind.
+class SimulatedSentenceSource : public ISerial
+{
+    public:
+    
+    SimulatedSentenceSource(uint32_t (*millisecondsNow)(), uint32_t baudRate, uint32_t sentencesPerSecond,
+        uint32_t seed);
+    virtual ~SimulatedSentenceSource();
+    
+    // Has the given share of sentences, in a hundred, go out with a character changed,
+    // so that their checksums do not match
+    void setCorruptionPercent(int32_t percent);
+    
+    // Takes sentences sent to the device, such as requests and settings
+    bool writeByte(int8_t value);
+    
+    int32_t readByte();
+    size_t read(int8_t* destination, size_t count);
+    size_t available();
+    
+    uint32_t getSentencesSent() const;
+    uint32_t getSentencesDropped() const;
+    
+    protected:
+    
+    // Writes the body of the next steady sentence, between the $ and the *, into destination.
+    // seconds is how long the device has been running when it is sent.
+    virtual void formatSentence(char* destination, size_t size, double seconds) = 0;
+    
+    // Handles a sentence sent to the device, without its $ or checksum
+    virtual void handleSentence(const char* sentence, double seconds);
+    
+    // Sends a sentence with the given body, adding the $, the checksum and the line break
+    void sendSentence(const char* body);
+    
+    uint32_t seed;
+    
+    private:
+    
+    // Makes the sentences whose time has come
+    void generate();
+    
+    uint32_t (*millisecondsNow)();
+    SimulatedLine line;
+    uint32_t sentencesPerSecond;
+    int32_t corruptionPercent;
+    
+    uint32_t startTime;
+    // The number of steady sentences that have come due
+    uint32_t sequence;
+    
+    char input[SIMULATED_SENTENCE_INPUT_SIZE];
+    size_t inputLength;
+    
+    uint32_t sentencesSent;
+    uint32_t sentencesDropped;
+};
+
+// A Trimble GPS that sends $GPGGA fixes, and a $PTNLRRF with its velocity whenever it is sent GPS_VELOCITY_REQUEST.
+// The balloon moves from where it is put at the velocity it is given.
+// 4800 baud and a fix a second are what it does on the balloon.
+class SimulatedGps : public SimulatedSentenceSource
+{
+    public:
+    
+    SimulatedGps(uint32_t (*millisecondsNow)(), uint32_t baudRate, uint32_t sentencesPerSecond, uint32_t seed = 1);
+    
+    // Where the balloon starts, in degrees with the decimal point fixed at the 1000s place,
+    // and millimeters, as GPSDecoder gives them
+    void setPosition(int32_t latitude, int32_t longitude, int32_t altitude);
+    
+    // How fast the balloon moves, in millimeters a second
+    void setVelocity(int32_t east, int32_t north, int32_t up);
+    
+    protected:
+    
+    void formatSentence(char* destination, size_t size, double seconds);
+    void handleSentence(const char* sentence, double seconds);
+    
+    private:
+    
+    // Where the balloon is after the given time, in degrees and meters
+    void getPosition(double seconds, double& latitude, double& longitude, double& altitude) const;
+    
+    double latitude;
+    double longitude;
+    double altitude;
+    double east;
+    double north;
+    double up;
+};
+
+// A VectorNav IMU that sends $VNYMR attitude, magnetic, acceleration and angular rate readings,
+// swinging the way a payload under a balloon does.
+// 115200 baud and 40 readings a second are what it does on the balloon.
+class SimulatedImu : public SimulatedSentenceSource
+{
+    public:
+    
+    SimulatedImu(uint32_t (*millisecondsNow)(), uint32_t baudRate, uint32_t sentencesPerSecond, uint32_t seed = 1);
+    
+    protected:
+    
+    void formatSentence(char* destination, size_t size, double seconds);
+};
+
+#endif
@@ -0,0 +1,219 @@
+#include "SimulatedXBee.h"
+#include <string.h>
+
+#define XBEE_DELIMITER 0x7E
+
+// API identifiers
+#define XBEE_TRANSMIT_REQUEST 0x01
+#define XBEE_RECEIVE_PACKET 0x81
+#define XBEE_TRANSMIT_STATUS 0x89
+
+// The bytes of a transmit request before its data: API identifier, frame ID, destination, and options
+#define XBEE_REQUEST_HEADER_SIZE 5
+
+// Copies a string of up to size - 1 characters, always null terminated
+static void copyText(char* destination, const char* source, size_t length, size_t size)
+{
+    if (length >= size)
+    {
+        length = size - 1;
+    }
+    memcpy(destination, source, length);
+    destination[length] = '\0';
+}
+
+SimulatedXBee::SimulatedXBee(uint32_t (*millisecondsNow)(), uint32_t baudRate)
+    : millisecondsNow(millisecondsNow),
+      line(millisecondsNow, baudRate),
+      framesPerSecond(0),
+      trafficOn(false),
+      trafficStartTime(0),
+      trafficSequence(0),
+      frameLength(0),
+      framesSent(0),
+      framesDropped(0),
+      requestsReceived(0),
+      badFrames(0)
+{
+    trafficTag[0] = '\0';
+    trafficData[0] = '\0';
+    lastTag[0] = '\0';
+    lastData[0] = '\0';
+}
+
+bool SimulatedXBee::receive(const char* tag, const char* data, uint8_t signalStrength, uint16_t sourceAddress)
+{
+    size_t dataLength = strlen(data);
+    if (dataLength >= SIMULATED_XBEE_DATA_SIZE)
+    {
+        dataLength = SIMULATED_XBEE_DATA_SIZE - 1;
+    }
+    // API identifier, source address, signal strength, options, then the tag and data
+    size_t length = 5 + 2 + dataLength;
+    char packet[3 + 5 + 2 + SIMULATED_XBEE_DATA_SIZE + 1];
+    packet[0] = (char)XBEE_DELIMITER;
+    packet[1] = (char)(length >> 8);
+    packet[2] = (char)length;
+    packet[3] = (char)XBEE_RECEIVE_PACKET;
+    packet[4] = (char)(sourceAddress >> 8);
+    packet[5] = (char)sourceAddress;
+    packet[6] = (char)signalStrength;
+    packet[7] = 0;
+    packet[8] = tag[0];
+    packet[9] = tag[1];
+    memcpy(packet + 10, data, dataLength);
+    
+    // The checksum makes the bytes after the length add up to 0xFF
+    uint8_t sum = 0;
+    for (size_t i = 3; i < 3 + length; i++)
+    {
+        sum += (uint8_t)packet[i];
+    }
+    packet[3 + length] = (char)(0xFF - sum);
+    
+    if (!line.send(packet, 3 + length + 1))
+    {
+        framesDropped++;
+        return false;
+    }
+    framesSent++;
+    return true;
+}
+
+void SimulatedXBee::setTraffic(const char* tag, const char* data, uint32_t framesPerSecond)
+{
+    copyText(trafficTag, tag, 2, sizeof(trafficTag));
+    copyText(trafficData, data, strlen(data), sizeof(trafficData));
+    this->framesPerSecond = framesPerSecond;
+    trafficOn = true;
+    trafficStartTime = millisecondsNow();
+    trafficSequence = 0;
+}
+
+bool SimulatedXBee::writeByte(int8_t value)
+{
+    uint8_t byte = (uint8_t)value;
+    if (frameLength == 0 && byte != XBEE_DELIMITER)
+    {
+        // Between frames
+        return true;
+    }
+    if (frameLength == SIMULATED_XBEE_FRAME_SIZE)
+    {
+        badFrames++;
+        frameLength = 0;
+        return true;
+    }
+    frame[frameLength++] = byte;
+    if (frameLength >= 3 && frameLength == 3 + (size_t)(frame[1] << 8 | frame[2]) + 1)
+    {
+        handleFrame();
+        frameLength = 0;
+    }
+    return true;
+}
+
+int32_t SimulatedXBee::readByte()
+{
+    int8_t value;
+    return read(&value, 1) ? (uint8_t)value : -1;
+}
+
+size_t SimulatedXBee::read(int8_t* destination, size_t count)
+{
+    generate();
+    return line.read(destination, count);
+}
+
+size_t SimulatedXBee::available()
+{
+    generate();
+    return line.available();
+}
+
+uint32_t SimulatedXBee::getFramesSent() const
+{
+    return framesSent;
+}
+
+uint32_t SimulatedXBee::getFramesDropped() const
+{
+    return framesDropped;
+}
+
+uint32_t SimulatedXBee::getRequestsReceived() const
+{
+    return requestsReceived;
+}
+
+uint32_t SimulatedXBee::getBadFrames() const
+{
+    return badFrames;
+}
+
+const char* SimulatedXBee::getLastTag() const
+{
+    return lastTag;
+}
+
+const char* SimulatedXBee::getLastData() const
+{
+    return lastData;
+}
+
+void SimulatedXBee::generate()
+{
+    if (!trafficOn)
+    {
+        return;
+    }
+    if (framesPerSecond == 0)
+    {
+        // A frame is at most a few more bytes than its data
+        while (line.getRoom() >= 3 + 7 + strlen(trafficData) + 1)
+        {
+            receive(trafficTag, trafficData);
+        }
+        return;
+    }
+    uint32_t elapsed = millisecondsNow() - trafficStartTime;
+    uint32_t due = (uint32_t)((uint64_t)elapsed * framesPerSecond / 1000) + 1;
+    for (; trafficSequence < due; trafficSequence++)
+    {
+        receive(trafficTag, trafficData);
+    }
+}
+
+void SimulatedXBee::handleFrame()
+{
+    size_t length = frame[1] << 8 | frame[2];
+    uint8_t sum = 0;
+    for (size_t i = 3; i < 3 + length + 1; i++)
+    {
+        sum += frame[i];
+    }
+    if (sum != 0xFF || length < XBEE_REQUEST_HEADER_SIZE + 2)
+    {
+        badFrames++;
+        return;
+    }
+    if (frame[3] != XBEE_TRANSMIT_REQUEST)
+    {
+        // Commands to the XBee itself, which are no concern of the link
+        return;
+    }
+    
+    requestsReceived++;
+    const char* payload = (const char*)frame + 3 + XBEE_REQUEST_HEADER_SIZE;
+    copyText(lastTag, payload, 2, sizeof(lastTag));
+    copyText(lastData, payload + 2, length - XBEE_REQUEST_HEADER_SIZE - 2, sizeof(lastData));
+    
+    // A frame ID of 0 asks for no status
+    uint8_t frameId = frame[4];
+    if (frameId != 0)
+    {
+        char status[] = { (char)XBEE_DELIMITER, 0, 3, (char)XBEE_TRANSMIT_STATUS, (char)frameId, 0, 0 };
+        status[6] = (char)(0xFF - (uint8_t)(XBEE_TRANSMIT_STATUS + frameId));
+        line.send(status, sizeof(status));
+    }
+}
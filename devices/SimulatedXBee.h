@@ -0,0 +1,78 @@
+#include "ISerial.h"
+#include "SimulatedLine.h"
+
+#ifndef SIMULATED_XBEE
+#define SIMULATED_XBEE
+
+// The longest frame the peer takes, from the delimiter through the checksum
+#define SIMULATED_XBEE_FRAME_SIZE 600
+
+// The longest tag data the peer sends or keeps, including the null byte
+#define SIMULATED_XBEE_DATA_SIZE 513
+
+// An XBee in API mode, linked to a base station, for running transceiver code on a host.
+// It passes what the base station sends on as receive packets (API identifier 0x81), with a tag and data
+// in each, the way transceiverPacketParse reads them. It takes transmit requests (0x01), such as
+// sendTransceiverPacketTag makes, checks them, and answers with a transmit status (0x89) if they ask for one.
+// Frames go out by the time millisecondsNow gives, at the given baud rate (0 for no limit).
+class SimulatedXBee : public ISerial
+{
+    public:
+    
+    SimulatedXBee(uint32_t (*millisecondsNow)(), uint32_t baudRate);
+    
+    // Has the base station send a tag, heard at the given signal strength (-dBm)
+    // Returns false if the line is full
+    bool receive(const char* tag, const char* data, uint8_t signalStrength = 40, uint16_t sourceAddress = 0x0001);
+    
+    // Has the base station send the given tag steadily, at the given rate.
+    // A rate of 0 keeps the line full, for saturating a decoder.
+    void setTraffic(const char* tag, const char* data, uint32_t framesPerSecond);
+    
+    bool writeByte(int8_t value);
+    int32_t readByte();
+    size_t read(int8_t* destination, size_t count);
+    size_t available();
+    
+    // The number of frames the base station has sent, and those that did not fit on the line
+    uint32_t getFramesSent() const;
+    uint32_t getFramesDropped() const;
+    
+    // The number of transmit requests taken, and frames that were cut short or failed their checksum
+    uint32_t getRequestsReceived() const;
+    uint32_t getBadFrames() const;
+    
+    // The tag and data of the last transmit request
+    const char* getLastTag() const;
+    const char* getLastData() const;
+    
+    private:
+    
+    // Sends the steady traffic whose time has come
+    void generate();
+    
+    // Handles a whole frame from the device
+    void handleFrame();
+    
+    uint32_t (*millisecondsNow)();
+    SimulatedLine line;
+    
+    char trafficTag[3];
+    char trafficData[SIMULATED_XBEE_DATA_SIZE];
+    uint32_t framesPerSecond;
+    bool trafficOn;
+    uint32_t trafficStartTime;
+    uint32_t trafficSequence;
+    
+    uint8_t frame[SIMULATED_XBEE_FRAME_SIZE];
+    size_t frameLength;
+    
+    uint32_t framesSent;
+    uint32_t framesDropped;
+    uint32_t requestsReceived;
+    uint32_t badFrames;
+    char lastTag[3];
+    char lastData[SIMULATED_XBEE_DATA_SIZE];
+};
+
+#endif
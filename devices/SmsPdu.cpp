@@ -0,0 +1,453 @@
+#include "SmsPdu.h"
+#include <string.h>
+
+// The message types in the low two bits of the first octet
+#define SMS_TYPE_MASK 0x03
+#define SMS_TYPE_DELIVER 0x00
+#define SMS_TYPE_SUBMIT 0x01
+
+// The first octet of what we send: SMS-SUBMIT, with a relative validity period
+#define SMS_SUBMIT_FIRST_OCTET 0x11
+
+// Other bits of the first octet: how the validity period is given (SMS-SUBMIT),
+// and whether the user data starts with a header
+#define SMS_VALIDITY_FORMAT_MASK 0x18
+#define SMS_VALIDITY_RELATIVE 0x10
+#define SMS_USER_DATA_HEADER 0x40
+
+// A day: telemetry older than that is not worth delivering
+#define SMS_VALIDITY_ONE_DAY 0xA7
+
+// Types of number: international, as with a +, or whatever the network takes it for
+#define SMS_ADDRESS_INTERNATIONAL 0x91
+#define SMS_ADDRESS_UNKNOWN 0x81
+
+// The septet that switches to the extension table for the next one
+#define GSM_ESCAPE 0x1B
+
+// What characters outside the GSM alphabet, and the other way around, become
+#define GSM_REPLACEMENT 0x3F
+
+// The ASCII characters that are in the GSM extension table, and their septets after the escape
+static const char extensionCharacters[] = "\f^{}\\[~]|";
+static const uint8_t extensionSeptets[] = { 0x0A, 0x14, 0x28, 0x29, 0x2F, 0x3C, 0x3D, 0x3E, 0x40 };
+
+// Finds the septet for an ASCII character in the GSM default alphabet.
+// The ASCII letters, digits, and most punctuation are where they are in ASCII.
+// Returns the septet, GSM_ESCAPE if the character is in the extension table, or GSM_REPLACEMENT if it is in neither
+static uint8_t gsmFromAscii(char character, uint8_t& extension)
+{
+    switch (character)
+    {
+        case '@':
+            return 0x00;
+        case '$':
+            return 0x02;
+        case '_':
+            return 0x11;
+        case '\n':
+        case '\r':
+            return (uint8_t)character;
+        default:
+            break;
+    }
+    const char* found = character ? strchr(extensionCharacters, character) : NULL;
+    if (found)
+    {
+        extension = extensionSeptets[found - extensionCharacters];
+        return GSM_ESCAPE;
+    }
+    if ((character >= ' ' && character <= '?' && character != '$')
+        || (character >= 'A' && character <= 'Z') || (character >= 'a' && character <= 'z'))
+    {
+        return (uint8_t)character;
+    }
+    return GSM_REPLACEMENT;
+}
+
+// Finds the ASCII character for a septet, or for a septet after the escape if escaped is true
+static char asciiFromGsm(uint8_t septet, bool escaped)
+{
+    if (escaped)
+    {
+        for (size_t i = 0; i < sizeof(extensionSeptets); i++)
+        {
+            if (extensionSeptets[i] == septet)
+            {
+                return extensionCharacters[i];
+            }
+        }
+        return GSM_REPLACEMENT;
+    }
+    switch (septet)
+    {
+        case 0x00:
+            return '@';
+        case 0x02:
+            return '$';
+        case 0x11:
+            return '_';
+        case '\n':
+        case '\r':
+            return (char)septet;
+        default:
+            break;
+    }
+    // 0x24 is the currency sign, and 0x40 an inverted exclamation mark
+    if ((septet >= ' ' && septet <= '?' && septet != 0x24)
+        || (septet >= 'A' && septet <= 'Z') || (septet >= 'a' && septet <= 'z'))
+    {
+        return (char)septet;
+    }
+    return GSM_REPLACEMENT;
+}
+
+// Writes a phone number as an address: its length in digits, its type, and its digits in swapped pairs
+// Returns the number of octets written, or 0 if it is not a phone number
+static size_t encodeAddress(uint8_t* destination, const char* phoneNumber)
+{
+    uint8_t type = SMS_ADDRESS_UNKNOWN;
+    if (*phoneNumber == '+')
+    {
+        type = SMS_ADDRESS_INTERNATIONAL;
+        phoneNumber++;
+    }
+    size_t digits = strlen(phoneNumber);
+    if (digits == 0 || digits > SMS_MAX_ADDRESS_DIGITS)
+    {
+        return 0;
+    }
+    
+    destination[0] = (uint8_t)digits;
+    destination[1] = type;
+    for (size_t i = 0; i < digits; i++)
+    {
+        if (phoneNumber[i] < '0' || phoneNumber[i] > '9')
+        {
+            return 0;
+        }
+        uint8_t digit = phoneNumber[i] - '0';
+        uint8_t& octet = destination[2 + i / 2];
+        // The first digit of each pair goes in the low nibble, and an odd one out is padded with F
+        octet = i % 2 ? (octet & 0x0F) | (digit << 4) : 0xF0 | digit;
+    }
+    return 2 + (digits + 1) / 2;
+}
+
+// Reads an address into a phone number
+// Returns the number of octets read, or 0 if it runs past the end
+static size_t decodeAddress(const uint8_t* source, size_t available, char* phoneNumber)
+{
+    if (available < 2)
+    {
+        return 0;
+    }
+    size_t digits = source[0];
+    size_t octets = 2 + (digits + 1) / 2;
+    if (octets > available || digits > SMS_MAX_ADDRESS_DIGITS)
+    {
+        return 0;
+    }
+    
+    // Alphanumeric senders are 7-bit text, which is no use as a number to answer,
+    // and is kept as the digits it happens to make
+    if (source[1] == SMS_ADDRESS_INTERNATIONAL)
+    {
+        *phoneNumber++ = '+';
+    }
+    for (size_t i = 0; i < digits; i++)
+    {
+        uint8_t octet = source[2 + i / 2];
+        uint8_t digit = i % 2 ? octet >> 4 : octet & 0x0F;
+        *phoneNumber++ = digit < 10 ? '0' + digit : GSM_REPLACEMENT;
+    }
+    *phoneNumber = '\0';
+    return octets;
+}
+
+// Packs septets into octets, eight septets to seven octets, least significant bits first,
+// starting fillBits into the first octet
+// Returns the number of octets
+static size_t packSeptets(const uint8_t* septets, size_t count, uint8_t* octets, size_t fillBits)
+{
+    size_t bits = fillBits + count * 7;
+    size_t octetCount = (bits + 7) / 8;
+    memset(octets, 0, octetCount);
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t bit = fillBits + i * 7;
+        uint16_t shifted = (uint16_t)(septets[i] & 0x7F) << (bit % 8);
+        octets[bit / 8] |= (uint8_t)shifted;
+        if (bit % 8 > 1)
+        {
+            octets[bit / 8 + 1] |= (uint8_t)(shifted >> 8);
+        }
+    }
+    return octetCount;
+}
+
+// Unpacks count septets from octets, starting fillBits into the first octet
+static void unpackSeptets(const uint8_t* octets, size_t count, uint8_t* septets, size_t fillBits)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t bit = fillBits + i * 7;
+        uint16_t pair = octets[bit / 8];
+        if (bit % 8 > 1)
+        {
+            pair |= (uint16_t)octets[bit / 8 + 1] << 8;
+        }
+        septets[i] = (pair >> (bit % 8)) & 0x7F;
+    }
+}
+
+// Writes everything of an SMS-SUBMIT up to the user data length
+// Returns the number of octets written, or 0 if the recipient is not a phone number
+static size_t encodeSubmitHeader(uint8_t* pdu, const char* recipientPhoneNumber, SmsEncoding encoding)
+{
+    size_t length = 0;
+    // No service centre address: the module's own is used
+    pdu[length++] = 0x00;
+    pdu[length++] = SMS_SUBMIT_FIRST_OCTET;
+    // The module fills in the message reference
+    pdu[length++] = 0x00;
+    size_t addressLength = encodeAddress(pdu + length, recipientPhoneNumber);
+    if (addressLength == 0)
+    {
+        return 0;
+    }
+    length += addressLength;
+    // No protocol in particular
+    pdu[length++] = 0x00;
+    pdu[length++] = (uint8_t)encoding;
+    pdu[length++] = SMS_VALIDITY_ONE_DAY;
+    return length;
+}
+
+size_t encodeSmsText(uint8_t* pdu, const char* recipientPhoneNumber, const char* text)
+{
+    size_t length = encodeSubmitHeader(pdu, recipientPhoneNumber, SMS_ENCODING_7BIT);
+    if (length == 0)
+    {
+        return 0;
+    }
+    
+    uint8_t septets[SMS_MAX_SEPTETS];
+    size_t septetCount = 0;
+    for (; *text; text++)
+    {
+        uint8_t extension = 0;
+        uint8_t septet = gsmFromAscii(*text, extension);
+        size_t needed = septet == GSM_ESCAPE ? 2 : 1;
+        if (septetCount + needed > SMS_MAX_SEPTETS)
+        {
+            break;
+        }
+        septets[septetCount++] = septet;
+        if (septet == GSM_ESCAPE)
+        {
+            septets[septetCount++] = extension;
+        }
+    }
+    
+    // The user data length of 7-bit text is in septets
+    pdu[length++] = (uint8_t)septetCount;
+    length += packSeptets(septets, septetCount, pdu + length, 0);
+    return length;
+}
+
+size_t encodeSmsBinary(uint8_t* pdu, const char* recipientPhoneNumber, const uint8_t* data, size_t length)
+{
+    size_t pduLength = encodeSubmitHeader(pdu, recipientPhoneNumber, SMS_ENCODING_8BIT);
+    if (pduLength == 0)
+    {
+        return 0;
+    }
+    if (length > SMS_MAX_USER_DATA)
+    {
+        length = SMS_MAX_USER_DATA;
+    }
+    pdu[pduLength++] = (uint8_t)length;
+    memcpy(pdu + pduLength, data, length);
+    return pduLength + length;
+}
+
+size_t smsTransferLength(const uint8_t* pdu, size_t length)
+{
+    return length - 1 - pdu[0];
+}
+
+bool decodeSms(const uint8_t* pdu, size_t length, SmsMessage& message)
+{
+    // Skip the service centre address, which is given in octets, unlike the others
+    size_t position = 1 + (length > 0 ? pdu[0] : 0);
+    if (position >= length)
+    {
+        return false;
+    }
+    
+    uint8_t firstOctet = pdu[position++];
+    uint8_t type = firstOctet & SMS_TYPE_MASK;
+    if (type == SMS_TYPE_SUBMIT)
+    {
+        // The message reference
+        position++;
+    }
+    else if (type != SMS_TYPE_DELIVER)
+    {
+        return false;
+    }
+    
+    size_t addressLength = decodeAddress(pdu + position, position < length ? length - position : 0, message.address);
+    if (addressLength == 0)
+    {
+        return false;
+    }
+    position += addressLength;
+    
+    // The protocol identifier, then the data coding scheme
+    if (position + 2 > length)
+    {
+        return false;
+    }
+    position++;
+    uint8_t coding = pdu[position++];
+    bool eightBit;
+    if ((coding & 0xC0) == 0x00)
+    {
+        // The general coding group: the alphabet is in bits 3 and 2
+        uint8_t alphabet = coding & 0x0C;
+        if (alphabet != 0x00 && alphabet != 0x04)
+        {
+            return false;
+        }
+        eightBit = alphabet == 0x04;
+    }
+    else if ((coding & 0xF0) == 0xF0)
+    {
+        // The message class group: the alphabet is in bit 2
+        eightBit = (coding & 0x04) != 0;
+    }
+    else
+    {
+        return false;
+    }
+    message.encoding = eightBit ? SMS_ENCODING_8BIT : SMS_ENCODING_7BIT;
+    
+    if (type == SMS_TYPE_DELIVER)
+    {
+        // The service centre's timestamp
+        position += 7;
+    }
+    else if ((firstOctet & SMS_VALIDITY_FORMAT_MASK) == SMS_VALIDITY_RELATIVE)
+    {
+        position += 1;
+    }
+    else if (firstOctet & SMS_VALIDITY_FORMAT_MASK)
+    {
+        // Absolute and enhanced validity periods
+        position += 7;
+    }
+    if (position >= length)
+    {
+        return false;
+    }
+    
+    size_t userDataLength = pdu[position++];
+    const uint8_t* userData = pdu + position;
+    size_t userDataOctets = eightBit ? userDataLength : (userDataLength * 7 + 7) / 8;
+    if (position + userDataOctets > length || userDataLength > (eightBit ? SMS_MAX_USER_DATA : SMS_MAX_SEPTETS))
+    {
+        return false;
+    }
+    
+    // A header takes whole octets from the start, and 7-bit text then starts at the next septet boundary
+    size_t headerOctets = 0;
+    if (firstOctet & SMS_USER_DATA_HEADER)
+    {
+        headerOctets = 1 + userData[0];
+        if (headerOctets > userDataOctets)
+        {
+            return false;
+        }
+    }
+    
+    if (eightBit)
+    {
+        message.length = userDataLength - headerOctets;
+        memcpy(message.data, userData + headerOctets, message.length);
+        return true;
+    }
+    
+    // A header can claim more of the user data than its length in septets leaves room for
+    size_t headerSeptets = (headerOctets * 8 + 6) / 7;
+    if (headerSeptets > userDataLength)
+    {
+        return false;
+    }
+    size_t septetCount = userDataLength - headerSeptets;
+    uint8_t septets[SMS_MAX_SEPTETS];
+    unpackSeptets(userData + headerOctets, septetCount, septets, headerSeptets * 7 - headerOctets * 8);
+    
+    size_t characters = 0;
+    for (size_t i = 0; i < septetCount; i++)
+    {
+        bool escaped = septets[i] == GSM_ESCAPE && i + 1 < septetCount;
+        if (escaped)
+        {
+            i++;
+        }
+        message.data[characters++] = (uint8_t)asciiFromGsm(septets[i], escaped);
+    }
+    message.data[characters] = '\0';
+    message.length = characters;
+    return true;
+}
+
+void smsHexFromOctets(const uint8_t* octets, size_t length, char* destination)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    for (size_t i = 0; i < length; i++)
+    {
+        *destination++ = digits[octets[i] >> 4];
+        *destination++ = digits[octets[i] & 0x0F];
+    }
+    *destination = '\0';
+}
+
+// The value of a hex digit, or -1 if it is not one
+static int8_t hexValue(char character)
+{
+    if (character >= '0' && character <= '9')
+    {
+        return character - '0';
+    }
+    if (character >= 'A' && character <= 'F')
+    {
+        return character - 'A' + 10;
+    }
+    if (character >= 'a' && character <= 'f')
+    {
+        return character - 'a' + 10;
+    }
+    return -1;
+}
+
+size_t smsOctetsFromHex(const char* hex, size_t hexLength, uint8_t* octets, size_t maxOctets)
+{
+    if (hexLength % 2 || hexLength / 2 > maxOctets)
+    {
+        return 0;
+    }
+    for (size_t i = 0; i < hexLength / 2; i++)
+    {
+        int8_t high = hexValue(hex[2 * i]);
+        int8_t low = hexValue(hex[2 * i + 1]);
+        if (high == -1 || low == -1)
+        {
+            return 0;
+        }
+        octets[i] = (uint8_t)(high << 4 | low);
+    }
+    return hexLength / 2;
+}
@@ -0,0 +1,70 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef SMS_PDU
+#define SMS_PDU
+
+// The most a text message carries: 140 octets, which is 160 characters packed at 7 bits each
+#define SMS_MAX_USER_DATA 140
+#define SMS_MAX_SEPTETS 160
+
+// The longest phone number, in digits
+#define SMS_MAX_ADDRESS_DIGITS 20
+
+// The longest PDU: service centre, first octet, reference, address, protocol, coding,
+// validity or timestamp, length, and the user data
+#define SMS_MAX_PDU_OCTETS (12 + 1 + 1 + 2 + SMS_MAX_ADDRESS_DIGITS / 2 + 1 + 1 + 7 + 1 + SMS_MAX_USER_DATA)
+
+// How the user data of a text message is coded, as it is given in the data coding scheme
+enum SmsEncoding
+{
+    // The GSM default alphabet, packed at 7 bits a character
+    SMS_ENCODING_7BIT = 0x00,
+    // Raw octets, for binary messages
+    SMS_ENCODING_8BIT = 0x04
+};
+
+// A text message taken apart
+struct SmsMessage
+{
+    // The phone number it came from (SMS-DELIVER) or is going to (SMS-SUBMIT),
+    // with a + in front if it is international
+    char address[SMS_MAX_ADDRESS_DIGITS + 2];
+    
+    SmsEncoding encoding;
+    
+    // The characters, null terminated, for SMS_ENCODING_7BIT,
+    // or the octets for SMS_ENCODING_8BIT
+    uint8_t data[SMS_MAX_SEPTETS + 1];
+    size_t length;
+};
+
+// Builds an SMS-SUBMIT PDU that sends the given text, packed at 7 bits a character.
+// Characters not in the GSM alphabet are sent as ?, and those in its extension table,
+// such as ^ [ ] { } take two characters' room. Text past 160 characters' room is cut off.
+// The PDU starts with an empty service centre address, so the module uses its own.
+// Returns the length of the PDU in octets, or 0 if the recipient is not a phone number.
+size_t encodeSmsText(uint8_t* pdu, const char* recipientPhoneNumber, const char* text);
+
+// Builds an SMS-SUBMIT PDU that sends the given octets as a binary message, like encodeSmsText.
+// Data past 140 octets is cut off.
+size_t encodeSmsBinary(uint8_t* pdu, const char* recipientPhoneNumber, const uint8_t* data, size_t length);
+
+// The length AT+CMGS wants for a PDU, which leaves out the service centre address
+size_t smsTransferLength(const uint8_t* pdu, size_t length);
+
+// Takes apart an SMS-DELIVER PDU, as a module gives a received message in PDU mode,
+// or an SMS-SUBMIT PDU, as the encoders build. Both start with the service centre address.
+// A user data header, as concatenated messages have, is skipped.
+// Returns false if the PDU is malformed or its coding is not supported.
+bool decodeSms(const uint8_t* pdu, size_t length, SmsMessage& message);
+
+// Writes octets as pairs of upper case hex digits, the way PDUs go over the AT interface.
+// destination gets 2 * length characters and a null.
+void smsHexFromOctets(const uint8_t* octets, size_t length, char* destination);
+
+// Reads pairs of hex digits into octets
+// Returns the number of octets, or 0 if the text is not hex
+size_t smsOctetsFromHex(const char* hex, size_t hexLength, uint8_t* octets, size_t maxOctets);
+
+#endif
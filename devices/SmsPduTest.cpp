@@ -0,0 +1,99 @@
+// Checks the PDU encoders and decoder against known PDUs and each other,
+// and shows how much telemetry each way of sending fits in one text message.
+// Build and run on a host:
+//     g++ -I. SmsPduTest.cpp SmsPdu.cpp TelemetryRecord.cpp -o smspdutest
+//     ./smspdutest
+#include "SmsPdu.h"
+#include "TelemetryRecord.h"
+#include "HostTest.h"
+#include <stdio.h>
+#include <string.h>
+
+// Decodes a PDU given in hex
+static bool decodeHex(const char* hex, SmsMessage& message)
+{
+    uint8_t pdu[SMS_MAX_PDU_OCTETS];
+    size_t length = smsOctetsFromHex(hex, strlen(hex), pdu, sizeof(pdu));
+    return length > 0 && decodeSms(pdu, length, message);
+}
+
+int main()
+{
+    uint8_t pdu[SMS_MAX_PDU_OCTETS];
+    char hex[2 * SMS_MAX_PDU_OCTETS + 1];
+    SmsMessage message;
+    
+    // The usual example of 7-bit packing, with a day's validity
+    size_t length = encodeSmsText(pdu, "+46708251358", "hellohello");
+    smsHexFromOctets(pdu, length, hex);
+    check(strcmp(hex, "0011000B916407281553F80000A70AE8329BFD4697D9EC37") == 0, "encode hellohello");
+    check(smsTransferLength(pdu, length) == 23, "transfer length leaves out the service centre");
+    
+    // The same text, received through a service centre
+    check(decodeHex("07917283010010F5040B917238880900F10000993092516195800AE8329BFD4697D9EC37", message)
+        && strcmp(message.address, "+27838890001") == 0 && message.encoding == SMS_ENCODING_7BIT
+        && strcmp((const char*)message.data, "hellohello") == 0, "decode a received hellohello");
+    
+    // Everything that is in the GSM alphabet comes back, and what is not becomes ?
+    const char* text = "AKP tags: MC^310:A5 LA^41.310:3F {[|]} ~\\ @$_ 100%";
+    length = encodeSmsText(pdu, "12033470933", text);
+    check(decodeSms(pdu, length, message) && strcmp(message.address, "12033470933") == 0
+        && strcmp((const char*)message.data, text) == 0, "round trip with the extension table");
+    check(decodeSms(pdu, encodeSmsText(pdu, "12033470933", "back`tick"), message)
+        && strcmp((const char*)message.data, "back?tick") == 0, "characters outside the alphabet");
+    
+    // 160 characters fit, and the 161st is cut off
+    char longText[200];
+    memset(longText, 'x', sizeof(longText) - 1);
+    longText[sizeof(longText) - 1] = '\0';
+    length = encodeSmsText(pdu, "12033470933", longText);
+    check(decodeSms(pdu, length, message) && message.length == SMS_MAX_SEPTETS, "160 characters");
+    
+    // A received concatenated message part, whose header pushes the text to a septet boundary
+    check(decodeHex("00400B915121551532F40000" "00000000000000" "0C" "050003010201" "906536FB0D", message)
+        && strcmp((const char*)message.data, "Hello") == 0, "skip a user data header");
+    check(!decodeHex("00400B915121551532F40000" "00000000000000" "01" "00", message),
+        "refuse a user data header longer than the user data");
+    
+    check(encodeSmsText(pdu, "not a number", "x") == 0, "refuse a recipient that is not a number");
+    
+    // Telemetry records
+    TelemetryRecord records[TELEMETRY_MAX_RECORDS];
+    for (int i = 0; i < TELEMETRY_MAX_RECORDS; i++)
+    {
+        TelemetryRecord& record = records[i];
+        record.time = 3600 + 120 * i;
+        record.latitude = 41310 + i;
+        record.longitude = -72920 - i;
+        record.altitude = 18200000 + 1000 * i;
+        record.mcc = 310;
+        record.mnc = 410;
+        record.mncDigits = 3;
+        record.lac = 0x1395;
+        record.cid = 0xD7D4;
+        record.secondsToDeath = -5 + i;
+        record.alive = i % 2;
+    }
+    uint8_t packed[SMS_MAX_USER_DATA];
+    size_t packedLength = packTelemetry(records, TELEMETRY_MAX_RECORDS, packed);
+    length = encodeSmsBinary(pdu, "+12033470933", packed, packedLength);
+    TelemetryRecord unpacked[TELEMETRY_MAX_RECORDS];
+    check(decodeSms(pdu, length, message) && message.encoding == SMS_ENCODING_8BIT
+        && unpackTelemetry(message.data, message.length, unpacked, TELEMETRY_MAX_RECORDS) == TELEMETRY_MAX_RECORDS
+        && memcmp(&unpacked[3].latitude, &records[3].latitude, sizeof(int32_t) * 3) == 0
+        && unpacked[2].mnc == 410 && unpacked[2].mncDigits == 3 && unpacked[3].cid == 0xD7D4 && unpacked[0].secondsToDeath == -5 && unpacked[1].alive,
+        "binary telemetry round trip");
+    
+    // How much each way of sending fits in a message
+    const char* textual = "Lat: 41.310\nLong: -72.920\nALIVE!\nT- 1800 seconds.\nMC: 310MN: 410LC: 1395CD: D7D4\n";
+    const char* tags = "MC^310:A5MN^410:1FLC^1395:C2CD^D7D4:09LA^41.310:3FLO^-72.920:E8DT^1800:4CLV^1:7A";
+    printf("\n%-40s %3s %s\n", "one report as", "", "reports per message");
+    printf("%-40s %3u %u\n", "text mode, textual", (unsigned)strlen(textual), (unsigned)(160 / strlen(textual)));
+    printf("%-40s %3u %u\n", "text mode or 7-bit PDU, tags (^ is two)", (unsigned)(strlen(tags) + 8),
+        (unsigned)(160 / (strlen(tags) + 8)));
+    printf("%-40s %3u %u\n", "8-bit PDU, tags", (unsigned)strlen(tags), (unsigned)(140 / strlen(tags)));
+    printf("%-40s %3u %u\n", "8-bit PDU, telemetry records", TELEMETRY_RECORD_SIZE, TELEMETRY_MAX_RECORDS);
+    
+    printf("\n%d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,79 @@
+#include "TelemetryRecord.h"
+
+// Writes a value in the given number of octets, most significant first
+// Returns the position after it
+static uint8_t* putValue(uint8_t* destination, uint32_t value, size_t octets)
+{
+    for (size_t i = octets; i > 0; i--)
+    {
+        *destination++ = (uint8_t)(value >> (8 * (i - 1)));
+    }
+    return destination;
+}
+
+// Reads a value of the given number of octets, most significant first, moving source past it
+static uint32_t getValue(const uint8_t*& source, size_t octets)
+{
+    uint32_t value = 0;
+    for (size_t i = 0; i < octets; i++)
+    {
+        value = value << 8 | *source++;
+    }
+    return value;
+}
+
+size_t packTelemetry(const TelemetryRecord* records, size_t count, uint8_t* destination)
+{
+    if (count > TELEMETRY_MAX_RECORDS)
+    {
+        count = TELEMETRY_MAX_RECORDS;
+    }
+    uint8_t* position = destination;
+    *position++ = TELEMETRY_VERSION;
+    for (size_t i = 0; i < count; i++)
+    {
+        const TelemetryRecord& record = records[i];
+        position = putValue(position, record.time, 4);
+        position = putValue(position, (uint32_t)record.latitude, 4);
+        position = putValue(position, (uint32_t)record.longitude, 4);
+        position = putValue(position, (uint32_t)record.altitude, 4);
+        position = putValue(position, record.mcc, 2);
+        position = putValue(position, record.mnc, 2);
+        *position++ = record.mncDigits;
+        position = putValue(position, record.lac, 2);
+        position = putValue(position, record.cid, 2);
+        position = putValue(position, (uint32_t)record.secondsToDeath, 4);
+        *position++ = record.alive ? 1 : 0;
+    }
+    return position - destination;
+}
+
+int32_t unpackTelemetry(const uint8_t* data, size_t length, TelemetryRecord* records, size_t maxRecords)
+{
+    if (length == 0 || data[0] != TELEMETRY_VERSION || (length - 1) % TELEMETRY_RECORD_SIZE)
+    {
+        return -1;
+    }
+    size_t count = (length - 1) / TELEMETRY_RECORD_SIZE;
+    if (count > maxRecords)
+    {
+        count = maxRecords;
+    }
+    const uint8_t* position = data + 1;
+    for (size_t i = 0; i < count; i++)
+    {
+        TelemetryRecord& record = records[i];
+        record.time = getValue(position, 4);
+        record.latitude = (int32_t)getValue(position, 4);
+        record.longitude = (int32_t)getValue(position, 4);
+        record.altitude = (int32_t)getValue(position, 4);
+        record.mcc = (uint16_t)getValue(position, 2);
+        record.mnc = (uint16_t)getValue(position, 2);
+        record.mncDigits = *position++;
+        record.lac = (uint16_t)getValue(position, 2);
+        record.cid = (uint16_t)getValue(position, 2);
+        record.secondsToDeath = (int32_t)getValue(position, 4);
+        record.alive = *position++ != 0;
+    }
+    return (int32_t)count;
+}
@@ -0,0 +1,51 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef TELEMETRY_RECORD
+#define TELEMETRY_RECORD
+
+// The version of the packing, sent first so the ground can tell if it has changed
+#define TELEMETRY_VERSION 2
+
+// A packed record, and the most that fit in a binary text message after the version
+#define TELEMETRY_RECORD_SIZE 30
+#define TELEMETRY_MAX_RECORDS 4
+
+// Where the balloon is and how it is doing, as sent to the ground in binary text messages
+// in place of the textual information or tags
+struct TelemetryRecord
+{
+    // Seconds since the flight started, so records in one message can be told apart
+    uint32_t time;
+    
+    // Degrees, with the decimal point fixed at the 1000s place, as GPSDecoder gives them
+    int32_t latitude;
+    int32_t longitude;
+    
+    // Millimeters, as GPSDecoder gives it
+    int32_t altitude;
+    
+    // The cell the module is on
+    uint16_t mcc;
+    uint16_t mnc;
+    // The number of digits the mnc is written with, 2 or 3
+    uint8_t mncDigits;
+    uint16_t lac;
+    uint16_t cid;
+    
+    // Seconds until the balloon is cut down
+    int32_t secondsToDeath;
+    
+    bool alive;
+};
+
+// Packs up to TELEMETRY_MAX_RECORDS records for a binary text message:
+// the version, then each record's fields in order, most significant octet first.
+// Returns the number of octets, at most 1 + TELEMETRY_MAX_RECORDS * TELEMETRY_RECORD_SIZE
+size_t packTelemetry(const TelemetryRecord* records, size_t count, uint8_t* destination);
+
+// Unpacks records packed by packTelemetry
+// Returns the number of records, or -1 if the data is not packed telemetry of this version
+int32_t unpackTelemetry(const uint8_t* data, size_t length, TelemetryRecord* records, size_t maxRecords);
+
+#endif
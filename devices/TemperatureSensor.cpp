@@ -1,16 +1,140 @@
 #include "TemperatureSensor.h"
 
-TemperatureSensor::TemperatureSensor()
+// DS18B20 function commands
+#define DS18B20_CONVERT 0x44
+#define DS18B20_WRITE_SCRATCHPAD 0x4E
+#define DS18B20_READ_SCRATCHPAD 0xBE
+
+// The scratchpad: temperature (2 bytes, least significant first), alarm high and low,
+// configuration, 3 reserved bytes, and the CRC
+#define DS18B20_SCRATCHPAD_SIZE 9
+#define DS18B20_CONFIGURATION 4
+
+// Alarm limits that never trip, since nothing here searches for alarms
+#define DS18B20_ALARM_HIGH 0x7F
+#define DS18B20_ALARM_LOW 0x80
+
+TemperatureSensor::TemperatureSensor(IOneWireBus& bus, const uint8_t* address, uint32_t (*millisecondsNow)(),
+    uint8_t resolutionBits)
+    : bus(bus),
+      address(address),
+      millisecondsNow(millisecondsNow),
+      resolutionBits(resolutionBits < 9 ? 9 : resolutionBits > 12 ? 12 : resolutionBits),
+      conversionMilliseconds(0),
+      configured(false),
+      converting(false),
+      conversionDeadline(0),
+      temperature(Fixed1000::missing()),
+      newTemperature(false)
 {
-    
+    // 93.75ms at 9 bits, rounded up
+    conversionMilliseconds = ((TEMPERATURE_CONVERSION_MILLISECONDS << 2 >> (12 - this->resolutionBits)) + 3) / 4
+        + TEMPERATURE_CONVERSION_MARGIN_MILLISECONDS;
 }
 
-TemperatureSensor::int32_t getTemperature() const
+Fixed1000 TemperatureSensor::getTemperature() const
 {
-    
+    return temperature;
+}
+
+Fixed1000 TemperatureSensor::readTemperature()
+{
+    uint32_t now = millisecondsNow();
+    if (converting)
+    {
+        if ((int32_t)(now - conversionDeadline) < 0)
+        {
+            // Still converting, so there is nothing to say to the probe
+            return temperature;
+        }
+        converting = false;
+        if (readConversion())
+        {
+            newTemperature = true;
+        }
+        else
+        {
+            temperature = Fixed1000::missing();
+        }
+    }
+    if (!startConversion())
+    {
+        temperature = Fixed1000::missing();
+    }
+    return temperature;
+}
+
+bool TemperatureSensor::hasNewTemperature()
+{
+    bool hasNew = newTemperature;
+    newTemperature = false;
+    return hasNew;
+}
+
+bool TemperatureSensor::isConverting() const
+{
+    return converting;
 }
 
-TemperatureSensor::int32_t readTemperature()
+bool TemperatureSensor::startConversion()
 {
+    if (!configured)
+    {
+        if (!bus.reset())
+        {
+            return false;
+        }
+        bus.select(address);
+        bus.writeByte(DS18B20_WRITE_SCRATCHPAD);
+        bus.writeByte(DS18B20_ALARM_HIGH);
+        bus.writeByte(DS18B20_ALARM_LOW);
+        bus.writeByte((uint8_t)((resolutionBits - 9) << 5 | 0x1F));
+        configured = true;
+    }
+    if (!bus.reset())
+    {
+        // The probe may have been unplugged, and will want its resolution again when it is back
+        configured = false;
+        return false;
+    }
+    bus.select(address);
+    bus.writeByte(DS18B20_CONVERT);
+    converting = true;
+    // From when the probe was told, since talking to it takes a few milliseconds of its own
+    conversionDeadline = millisecondsNow() + conversionMilliseconds;
+    return true;
+}
+
+bool TemperatureSensor::readConversion()
+{
+    if (!bus.reset())
+    {
+        configured = false;
+        return false;
+    }
+    bus.select(address);
+    bus.writeByte(DS18B20_READ_SCRATCHPAD);
+    uint8_t scratchpad[DS18B20_SCRATCHPAD_SIZE];
+    bool allZeros = true;
+    for (uint8_t i = 0; i < DS18B20_SCRATCHPAD_SIZE; i++)
+    {
+        scratchpad[i] = bus.readByte();
+        allZeros = allZeros && scratchpad[i] == 0;
+    }
+    // A bus held low reads all zeros, which pass the CRC
+    if (allZeros || oneWireCrc8(scratchpad, DS18B20_SCRATCHPAD_SIZE) != 0)
+    {
+        return false;
+    }
+    if ((scratchpad[DS18B20_CONFIGURATION] >> 5 & 0x03) != resolutionBits - 9)
+    {
+        // The probe lost power and came back at its default, so set it again for the next conversion
+        configured = false;
+    }
     
-}
\ No newline at end of file
+    // Sixteenths of a degree, with the bits below the resolution undefined
+    int16_t raw = (int16_t)(scratchpad[1] << 8 | scratchpad[0]);
+    raw &= (int16_t)~((1 << (12 - resolutionBits)) - 1);
+    temperature = Fixed1000::fromRatio(raw, 16);
+    return true;
+}
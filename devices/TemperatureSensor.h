@@ -1,37 +1,77 @@
+#include "IOneWireBus.h"
+#include "FixedPoint.h"
+
 #ifndef TEMPERATURE_SENSOR
 #define TEMPERATURE_SENSOR
 
-// Takes measurements from a physical temperature sensor device.
+// How long a DS18B20 takes to convert at 12 bits, halving with each bit less
+#define TEMPERATURE_CONVERSION_MILLISECONDS 750
+
+// Extra time allowed past the datasheet's conversion time before reading,
+// since a millisecond clock may tick over just after a conversion starts
+#define TEMPERATURE_CONVERSION_MARGIN_MILLISECONDS 10
+
+// Takes measurements from a DS18B20 temperature probe on a 1-Wire bus.
+// Conversions run on the probe while the caller gets on with other work: readTemperature never waits,
+// but starts a conversion, or reads one whose time is up, and otherwise returns the last temperature.
+// Several probes can share a bus, each converting on its own schedule.
 class TemperatureSensor
 {
     public:
-
+    
     /*
     Make use of int32_t, int16_t, int8_t (32-bits, 16-bits, or 8-bits) 
     instead of int, short, or char.
     This will ensure that the length of the integer is always the same on different platforms.
     */
     
-    // You will likely want to give this constructor parameters that distinguish this specific sensor
-    // from any other one.
-    TemperatureSensor();
+    // address is the probe's ROM code, which is kept by reference and so must outlive the sensor.
+    // resolutionBits is from 9 to 12, trading precision for conversion time.
+    // Nothing is sent to the probe until the first read.
+    TemperatureSensor(IOneWireBus& bus, const uint8_t* address, uint32_t (*millisecondsNow)(),
+        uint8_t resolutionBits = 12);
     
     // Value returned has the decimal point fixed at the 1000s place.
     // Value is in degrees celsius.
-    // Returns the last temperature value read by the sensor.
-    int32_t getTemperature() const;
+    // Returns the last temperature value read by the sensor,
+    // or missing if there has not been one, or the last read failed.
+    Fixed1000 getTemperature() const;
     
     // Value returned has the decimal point fixed at the 1000s place.
     // Value is in degrees celsius.
-    // Queries the sensor to determine its current temperature.
-    // If the query is taking too long, the query should be cut off,
-    // and INT32_MIN returned.
-    int32_t readTemperature();
-
+    // Reads the probe's conversion if its time is up and starts the next one,
+    // or starts one if none is running, without waiting on either.
+    // Returns the newest temperature, which is the last one read while a conversion is running.
+    // If the probe does not answer, or its reading is garbled, missing (INT32_MIN) is returned
+    // until a later conversion reads cleanly.
+    Fixed1000 readTemperature();
+    
+    // Returns true if a new temperature has been read since the last call
+    bool hasNewTemperature();
+    
+    // Returns true while the probe is converting
+    bool isConverting() const;
+    
     private:
-
-    // Your code here
-
+    
+    // Sets the probe's resolution and has it start converting
+    bool startConversion();
+    
+    // Reads the finished conversion from the probe's scratchpad
+    bool readConversion();
+    
+    IOneWireBus& bus;
+    const uint8_t* address;
+    uint32_t (*millisecondsNow)();
+    uint8_t resolutionBits;
+    uint32_t conversionMilliseconds;
+    
+    bool configured;
+    bool converting;
+    uint32_t conversionDeadline;
+    
+    Fixed1000 temperature;
+    bool newTemperature;
 };
 
 #endif
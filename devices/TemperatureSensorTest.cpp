@@ -0,0 +1,317 @@
+// Checks TemperatureSensor against simulated DS18B20 probes on a 1-Wire bus,
+// and shows how much of each second reading two probes takes compared with waiting on their conversions.
+// Build and run on a host:
+//     g++ -I. TemperatureSensorTest.cpp TemperatureSensor.cpp -o temperaturesensortest
+//     ./temperaturesensortest
+#include "TemperatureSensor.h"
+#include "HostTest.h"
+#include <stdio.h>
+#include <string.h>
+
+// Time on the bus at standard speed: a reset and presence pulse, and the 8 slots of a byte
+#define RESET_MICROSECONDS 960
+#define BYTE_MICROSECONDS 560
+
+#define PROBE_COUNT 2
+
+static uint32_t simulatedMicroseconds = 0;
+
+static uint32_t millisecondsNow()
+{
+    return simulatedMicroseconds / 1000;
+}
+
+static const uint8_t insideAddress[ONE_WIRE_ADDRESS_SIZE] = { 0x28, 0x5B, 0xD3, 0x49, 0x03, 0x00, 0x00, 0x4F };
+static const uint8_t outsideAddress[ONE_WIRE_ADDRESS_SIZE] = { 0x28, 0xE8, 0xAC, 0x49, 0x03, 0x00, 0x00, 0x13 };
+
+// DS18B20 probes on a bus, which take as long as the datasheet says to convert,
+// and keep the clock moving for the time each reset and byte takes
+class SimulatedOneWireBus : public IOneWireBus
+{
+    public:
+    
+    struct Probe
+    {
+        const uint8_t* address;
+        bool present;
+        // In sixteenths of a degree
+        int16_t temperature;
+        uint8_t scratchpad[9];
+        bool converting;
+        uint32_t conversionDone;
+    };
+    
+    SimulatedOneWireBus()
+        : selected(-1),
+          everyProbe(false),
+          command(0),
+          index(0),
+          corruptNextRead(false),
+          busMicroseconds(0)
+    {
+        const uint8_t* addresses[PROBE_COUNT] = { insideAddress, outsideAddress };
+        for (int i = 0; i < PROBE_COUNT; i++)
+        {
+            Probe& probe = probes[i];
+            probe.address = addresses[i];
+            probe.present = true;
+            probe.temperature = 0;
+            probe.converting = false;
+            powerUp(probe);
+        }
+    }
+    
+    // Probes come up at 12 bits, reading 85 degrees
+    void powerUp(Probe& probe)
+    {
+        uint8_t scratchpad[9] = { 0x50, 0x05, 0x4B, 0x46, 0x7F, 0xFF, 0x0C, 0x10, 0 };
+        memcpy(probe.scratchpad, scratchpad, sizeof(scratchpad));
+    }
+    
+    bool reset()
+    {
+        spend(RESET_MICROSECONDS);
+        finishConversions();
+        selected = -1;
+        everyProbe = false;
+        command = 0;
+        for (int i = 0; i < PROBE_COUNT; i++)
+        {
+            if (probes[i].present)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    void select(const uint8_t* address)
+    {
+        if (!address)
+        {
+            spend(BYTE_MICROSECONDS);
+            everyProbe = true;
+            return;
+        }
+        spend(9 * BYTE_MICROSECONDS);
+        for (int i = 0; i < PROBE_COUNT; i++)
+        {
+            if (probes[i].present && memcmp(probes[i].address, address, ONE_WIRE_ADDRESS_SIZE) == 0)
+            {
+                selected = i;
+            }
+        }
+    }
+    
+    void writeByte(uint8_t value)
+    {
+        spend(BYTE_MICROSECONDS);
+        if (command == 0x4E)
+        {
+            // Alarm high and low, then the configuration
+            if (selected >= 0 && index < 3)
+            {
+                probes[selected].scratchpad[2 + index++] = value;
+            }
+            return;
+        }
+        command = value;
+        index = 0;
+        if (command == 0x44)
+        {
+            for (int i = 0; i < PROBE_COUNT; i++)
+            {
+                if (probes[i].present && (everyProbe || selected == i))
+                {
+                    uint8_t bits = 9 + (probes[i].scratchpad[4] >> 5 & 0x03);
+                    probes[i].converting = true;
+                    probes[i].conversionDone = millisecondsNow() + (750 >> (12 - bits)) + 1;
+                }
+            }
+        }
+    }
+    
+    uint8_t readByte()
+    {
+        spend(BYTE_MICROSECONDS);
+        if (command != 0xBE || selected < 0 || index >= 9)
+        {
+            return 0xFF;
+        }
+        Probe& probe = probes[selected];
+        probe.scratchpad[8] = oneWireCrc8(probe.scratchpad, 8);
+        uint8_t value = probe.scratchpad[index++];
+        if (corruptNextRead && index == 1)
+        {
+            corruptNextRead = false;
+            value ^= 0x10;
+        }
+        return value;
+    }
+    
+    Probe probes[PROBE_COUNT];
+    int selected;
+    bool everyProbe;
+    uint8_t command;
+    uint8_t index;
+    bool corruptNextRead;
+    uint32_t busMicroseconds;
+    
+    private:
+    
+    void spend(uint32_t microseconds)
+    {
+        simulatedMicroseconds += microseconds;
+        busMicroseconds += microseconds;
+    }
+    
+    // A probe only puts its new temperature in the scratchpad once it is done converting
+    void finishConversions()
+    {
+        for (int i = 0; i < PROBE_COUNT; i++)
+        {
+            Probe& probe = probes[i];
+            if (probe.converting && (int32_t)(millisecondsNow() - probe.conversionDone) >= 0)
+            {
+                probe.converting = false;
+                probe.scratchpad[0] = (uint8_t)probe.temperature;
+                probe.scratchpad[1] = (uint8_t)(probe.temperature >> 8);
+            }
+        }
+    }
+};
+
+// Moves the clock on to the given time
+static void waitUntil(uint32_t milliseconds)
+{
+    if (simulatedMicroseconds < milliseconds * 1000)
+    {
+        simulatedMicroseconds = milliseconds * 1000;
+    }
+}
+
+static void testConversions()
+{
+    simulatedMicroseconds = 0;
+    SimulatedOneWireBus bus;
+    bus.probes[0].temperature = 21 * 16 + 9;
+    TemperatureSensor sensor(bus, insideAddress, millisecondsNow);
+    
+    check(sensor.readTemperature().isMissing(), "nothing to give before the first conversion");
+    check(sensor.isConverting() && bus.probes[0].converting, "the first read starts a conversion");
+    check((bus.probes[0].scratchpad[4] >> 5 & 0x03) == 3, "the probe is set to 12 bits");
+    
+    uint32_t started = millisecondsNow();
+    uint32_t busBefore = bus.busMicroseconds;
+    waitUntil(started + 500);
+    check(sensor.readTemperature().isMissing(), "nothing read while converting");
+    check(bus.busMicroseconds == busBefore, "no bus traffic while converting");
+    
+    waitUntil(started + TEMPERATURE_CONVERSION_MILLISECONDS + TEMPERATURE_CONVERSION_MARGIN_MILLISECONDS);
+    check(sensor.readTemperature().getRaw() == 21563, "the conversion is read once its time is up");
+    check(sensor.hasNewTemperature() && !sensor.hasNewTemperature(), "a new temperature is told of once");
+    check(sensor.isConverting(), "the next conversion starts right away");
+    check(sensor.getTemperature().getRaw() == 21563, "the last temperature is kept");
+    
+    bus.probes[0].temperature = -(10 * 16 + 2);
+    waitUntil(millisecondsNow() + 1000);
+    check(sensor.readTemperature().getRaw() == -10125, "temperatures below freezing");
+}
+
+static void testResolution()
+{
+    simulatedMicroseconds = 0;
+    SimulatedOneWireBus bus;
+    bus.probes[1].temperature = 21 * 16 + 9;
+    TemperatureSensor sensor(bus, outsideAddress, millisecondsNow, 9);
+    
+    sensor.readTemperature();
+    check((bus.probes[1].scratchpad[4] >> 5 & 0x03) == 0, "the probe is set to 9 bits");
+    waitUntil(millisecondsNow() + 100);
+    check(sensor.readTemperature().isMissing(), "a 9 bit conversion is still given its margin");
+    waitUntil(millisecondsNow() + 10);
+    check(sensor.readTemperature().getRaw() == 21500, "a 9 bit conversion is read by 104ms, to half a degree");
+}
+
+static void testFailures()
+{
+    simulatedMicroseconds = 0;
+    SimulatedOneWireBus bus;
+    bus.probes[0].temperature = 5 * 16;
+    TemperatureSensor sensor(bus, insideAddress, millisecondsNow);
+    sensor.readTemperature();
+    waitUntil(millisecondsNow() + 1000);
+    check(sensor.readTemperature().getRaw() == 5000, "a reading before the trouble");
+    
+    sensor.hasNewTemperature();
+    bus.corruptNextRead = true;
+    waitUntil(millisecondsNow() + 1000);
+    check(sensor.readTemperature().isMissing(), "a garbled scratchpad is not believed");
+    check(!sensor.hasNewTemperature(), "a garbled scratchpad is not a new temperature");
+    waitUntil(millisecondsNow() + 1000);
+    check(sensor.readTemperature().getRaw() == 5000, "the next conversion is believed again");
+    
+    bus.probes[0].present = false;
+    bus.probes[1].present = false;
+    waitUntil(millisecondsNow() + 1000);
+    check(sensor.readTemperature().isMissing(), "an unplugged probe gives a missing temperature");
+    check(!sensor.isConverting(), "nothing is converting with no probe to answer");
+    
+    // Plugged back in, having lost its setting
+    bus.probes[0].present = true;
+    bus.powerUp(bus.probes[0]);
+    sensor.readTemperature();
+    check((bus.probes[0].scratchpad[4] >> 5 & 0x03) == 3, "a probe plugged back in is set again");
+    waitUntil(millisecondsNow() + 1000);
+    check(sensor.readTemperature().getRaw() == 5000, "a probe plugged back in reads again");
+}
+
+// Runs two probes for a minute the way the sketch's loop does, reading whenever it passes by,
+// and compares the time spent with waiting on each conversion as the sketch used to
+static void testSharedBus()
+{
+    simulatedMicroseconds = 0;
+    SimulatedOneWireBus bus;
+    bus.probes[0].temperature = 20 * 16;
+    bus.probes[1].temperature = -40 * 16;
+    TemperatureSensor inside(bus, insideAddress, millisecondsNow);
+    TemperatureSensor outside(bus, outsideAddress, millisecondsNow);
+    
+    uint32_t insideReadings = 0;
+    uint32_t outsideReadings = 0;
+    uint32_t longestCall = 0;
+    while (millisecondsNow() < 60000)
+    {
+        TemperatureSensor* sensors[] = { &inside, &outside };
+        for (int i = 0; i < PROBE_COUNT; i++)
+        {
+            uint32_t before = simulatedMicroseconds;
+            sensors[i]->readTemperature();
+            if (simulatedMicroseconds - before > longestCall)
+            {
+                longestCall = simulatedMicroseconds - before;
+            }
+        }
+        insideReadings += inside.hasNewTemperature() && inside.getTemperature().getRaw() == 20000;
+        outsideReadings += outside.hasNewTemperature() && outside.getTemperature().getRaw() == -40000;
+        // The rest of the loop, draining serial links
+        simulatedMicroseconds += 1000;
+    }
+    
+    printf("two probes for a minute: %u and %u readings, %.2f%% of the time on the bus, at most %.2fms a call\n",
+        (unsigned)insideReadings, (unsigned)outsideReadings, bus.busMicroseconds / 600000.0, longestCall / 1000.0);
+    printf("waiting on the conversions each second took up to %dms of it\n", TEMPERATURE_CONVERSION_MILLISECONDS);
+    // A read and the next conversion's start is about 18ms of bus traffic, bit by bit, with no waiting
+    check(insideReadings >= 75 && outsideReadings >= 75, "both probes read every conversion on a shared bus");
+    check(longestCall < 20000, "no call waits on a conversion");
+}
+
+int main()
+{
+    testConversions();
+    testResolution();
+    testFailures();
+    testSharedBus();
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -1,74 +1,112 @@
 #include "GeneralPurposeIO.h"
 
-// Requests the kernel to export the given gpio pin,
-// which may already have been exported
-// Returns zero on success, or non-zero on failure
-int gpioOpen(const char* pin)
+// All of the backends, ending with NULL
+const GpioBackend* const gpioBackends[] = {
+    &gpioMemoryBackend,
+    &gpioChardevBackend,
+    &gpioSysfsBackend,
+    &gpioMockBackend,
+    &gpioSimBackend,
+    NULL
+};
+
+// The backend whose clock the pins are driven by.
+// The scheduler thread reads it while the application may be setting it.
+static const GpioBackend* clockBackend = &gpioSysfsBackend;
+
+// Returns the fastest backend that drives real pins and is available on this host,
+// or NULL if there is none
+const GpioBackend* gpioBackendFastest(void)
 {
-    return openWriteClose("/sys/class/gpio/export", pin);
+    // The mock and the simulator are always there, but they are not real pins
+    const GpioBackend* hardwareBackends[] = { &gpioMemoryBackend, &gpioChardevBackend, &gpioSysfsBackend };
+    
+    const GpioBackend* fastest = NULL;
+    for (int i = 0; i < (int)(sizeof(hardwareBackends) / sizeof(hardwareBackends[0])); i++)
+    {
+        const GpioBackend* backend = hardwareBackends[i];
+        if (backend->available() && (!fastest || backend->accessNanoseconds < fastest->accessNanoseconds))
+        {
+            fastest = backend;
+        }
+    }
+    return fastest;
 }
 
-// Requests the kernel to unexport the given gpio pin
-// Returns zero on success, or non-zero on failure
-int gpioClose(const char* pin)
+// Returns the backend with the given name, or NULL if there is none
+const GpioBackend* gpioBackendNamed(const char* name)
 {
-    return openWriteClose("/sys/class/gpio/unexport", pin);
+    for (int i = 0; gpioBackends[i]; i++)
+    {
+        if (strcmp(gpioBackends[i]->name, name) == 0)
+        {
+            return gpioBackends[i];
+        }
+    }
+    return NULL;
 }
 
-// Sets the given pin to input mode.
-// This will fail if the kernel does not support
-// changing the direction of the given pin
-// Returns zero on success, or non-zero on failure
-int gpioSetInput(const char* pin)
+// Drives the gpio clock, and with it the shared scheduler, from the clock of the given backend
+void gpioUseClock(const GpioBackend* backend)
 {
-    char* string = formattedString("/sys/class/gpio/gpio%s/direction", pin);
-    int result = openWriteClose(string, "in");
-    free(string);
-    return result;
+    __atomic_store_n(&clockBackend, backend, __ATOMIC_RELEASE);
 }
 
-// Sets the given pin to output mode with an initial value of high
-// This will fail if the kernel does not support
-// changing the direction of the given pin
-// Returns zero on success, or non-zero on failure
-int gpioSetOutputHigh(const char* pin){
-    char* string = formattedString("/sys/class/gpio/gpio%s/direction", pin);
-    int result = openWriteClose(string, "high");
-    free(string);
-    return result;
+// Gets the current time of the clock the pins are driven by
+void gpioClockNow(struct timespec* time)
+{
+    __atomic_load_n(&clockBackend, __ATOMIC_ACQUIRE)->clockNow(time);
 }
 
-// Sets the given pin to output mode with an initial value of high
-// This will fail if the kernel does not support
-// changing the direction of the given pin
-// Returns zero on success, or non-zero on failure
-int gpioSetOutputLow(const char* pin)
+// Sleeps until the given absolute time of the clock the pins are driven by
+// Returns zero on success, or an error number on failure
+int gpioClockSleepUntil(const struct timespec* time)
 {
-    char* string = formattedString("/sys/class/gpio/gpio%s/direction", pin);
-    int result = openWriteClose(string, "low");
-    free(string);
-    return result;
+    return __atomic_load_n(&clockBackend, __ATOMIC_ACQUIRE)->clockSleepUntil(time);
 }
 
-// Writes a new output value to the given pin
-// Returns zero on success, or non-zero on failure
-int gpioWrite(const char* pin, bool value)
+// Returns true if the clock the pins are driven by is CLOCK_MONOTONIC
+bool gpioClockIsMonotonic(void)
 {
-    char* string = formattedString("/sys/class/gpio/gpio%s/value", pin);
-    int result = openWriteClose(string, value ? "1" : "0");
-    free(string);
-    return result;
+    return __atomic_load_n(&clockBackend, __ATOMIC_ACQUIRE)->clockSleepUntil == &gpioMonotonicSleepUntil;
 }
 
-// Reads a new input value from the given pin
-// Returns zero on success, or non-zero on failure
-int gpioRead(const char* pin, bool* value)
+// Gets the current time of CLOCK_MONOTONIC, which real pins are driven by
+void gpioMonotonicNow(struct timespec* time)
 {
-    char readCharacter;
-    
-    char* string = formattedString("/sys/class/gpio/gpio%s/value", pin);
-    int result = openReadClose(string, &readCharacter, sizeof(readCharacter));
-    free(string);
+    clock_gettime(CLOCK_MONOTONIC, time);
+}
+
+// Sleeps until the given absolute time of CLOCK_MONOTONIC
+// Returns zero on success, or an error number on failure
+int gpioMonotonicSleepUntil(const struct timespec* time)
+{
+    return clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, time, NULL);
+}
+
+// Reads a burst by spinning on CLOCK_MONOTONIC between single reads.
+// A read that comes late is taken late rather than skipped, so the samples stay in order.
+// Returns count on success, or -2 if a read fails
+int gpioReadBurstSpinning(int (*readPin)(const char* pin, bool* value), const char* pin,
+                          bool* values, int count, long intervalNanoseconds)
+{
+    struct timespec startTime;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
     
-    return readCharacter == '1';
+    for (int i = 0; i < count; i++)
+    {
+        // Spin until the sample is due
+        long dueNanoseconds = i * intervalNanoseconds;
+        struct timespec currentTime;
+        do
+        {
+            clock_gettime(CLOCK_MONOTONIC, &currentTime);
+        } while ((currentTime.tv_sec - startTime.tv_sec) * 1000000000L + (currentTime.tv_nsec - startTime.tv_nsec) < dueNanoseconds);
+        
+        if (readPin(pin, &values[i]))
+        {
+            return -2;
+        }
+    }
+    return count;
 }
\ No newline at end of file
@@ -2,44 +2,104 @@
 #include "formattedstring.h"
 
 #include <stdbool.h>
+#include <time.h>
 
 #ifndef GENERAL_PURPOSE_IO
 #define GENERAL_PURPOSE_IO
 
-// Requests the kernel to export the given gpio pin,
-// which may already have been exported
-// Returns zero on success, or non-zero on failure
-int gpioOpen(const char* pin);
-
-// Requests the kernel to unexport the given gpio pin
-// Returns zero on success, or non-zero on failure
-
-int gpioClose(const char* pin);
-
-// Sets the given pin to input mode.
-// This will fail if the kernel does not support
-// changing the direction of the given pin
-// Returns zero on success, or non-zero on failure
-int gpioSetInput(const char* pin);
-
-// Sets the given pin to output mode with an initial value of high
-// This will fail if the kernel does not support
-// changing the direction of the given pin
-// Returns zero on success, or non-zero on failure
-int gpioSetOutputHigh(const char* pin);
-
-// Sets the given pin to output mode with an initial value of high
-// This will fail if the kernel does not support
-// changing the direction of the given pin
-// Returns zero on success, or non-zero on failure
-int gpioSetOutputLow(const char* pin);
-
-// Writes a new output value to the given pin
-// Returns zero on success, or non-zero on failure
-int gpioWrite(const char* pin, bool value);
-
-// Reads a new input value from the given pin
-// Returns zero on success, or non-zero on failure
-int gpioRead(const char* pin, bool* value);
+// A way of getting at the gpio pins, chosen at runtime.
+// Pins are named by their number, as a string, and every operation that returns an int
+// returns zero on success, or non-zero on failure, unless it says otherwise.
+typedef struct
+{
+    // A short name for the backend, such as "sysfs"
+    const char* name;
+    
+    // Roughly how long a single read or write of a pin takes, which the fastest backend is picked by
+    long accessNanoseconds;
+    
+    // Returns true if the backend can be used on this host
+    bool (*available)(void);
+    
+    // Gets the given pin ready for use, and lets it go again
+    int (*openPin)(const char* pin);
+    int (*closePin)(const char* pin);
+    
+    // Sets the given pin to input mode, or to output mode with an initial value of high or low.
+    // These will fail if the backend does not support changing the direction of the given pin
+    int (*setInput)(const char* pin);
+    int (*setOutputHigh)(const char* pin);
+    int (*setOutputLow)(const char* pin);
+    
+    // Writes a new output value to the given pin
+    int (*writePin)(const char* pin, bool value);
+    
+    // Reads a new input value from the given pin
+    int (*readPin)(const char* pin, bool* value);
+    
+    // Reads count values from the given pin, intervalNanoseconds apart on the gpio clock,
+    // in one go, for backends fast enough to time samples closer together than a scheduler can.
+    // Returns count on success, -1 if the backend cannot read in bursts (at least not that quickly),
+    // or another negative number on failure
+    int (*readBurst)(const char* pin, bool* values, int count, long intervalNanoseconds);
+    
+    // The clock the pins are driven by (see gpioUseClock)
+    void (*clockNow)(struct timespec* time);
+    int (*clockSleepUntil)(const struct timespec* time);
+} GpioBackend;
+
+// Exports pins through /sys/class/gpio, which works on any kernel with it
+// but takes a few system calls, and tens of microseconds, for every read and write
+extern const GpioBackend gpioSysfsBackend;
+
+// Requests lines from the gpio character device /dev/gpiochip0, where the pin is the line offset.
+// A read or write is a single ioctl on a file kept open, of around a microsecond.
+extern const GpioBackend gpioChardevBackend;
+
+// Maps the BCM2835 (Raspberry Pi) gpio registers from /dev/gpiomem into the process,
+// so a read or write is a single memory access of well under a microsecond
+extern const GpioBackend gpioMemoryBackend;
+
+// Every pin is the same single value, as last written, for testing without any hardware
+extern const GpioBackend gpioMockBackend;
+
+// Pins are wires on a virtual clock (see GeneralPurposeIOSim.h)
+extern const GpioBackend gpioSimBackend;
+
+// All of the backends above, ending with NULL
+extern const GpioBackend* const gpioBackends[];
+
+// Returns the fastest backend that drives real pins and is available on this host,
+// or NULL if there is none
+const GpioBackend* gpioBackendFastest(void);
+
+// Returns the backend with the given name, or NULL if there is none
+const GpioBackend* gpioBackendNamed(const char* name);
+
+// Drives the gpio clock below, and with it the shared scheduler, from the clock of the given backend.
+// Every backend for real pins uses CLOCK_MONOTONIC, which is the clock until set otherwise.
+// Should only be changed while nothing is waiting on the clock.
+void gpioUseClock(const GpioBackend* backend);
+
+// Gets the current time of the clock the pins are driven by
+void gpioClockNow(struct timespec* time);
+
+// Sleeps until the given absolute time of the clock the pins are driven by
+// Returns zero on success, or an error number on failure
+int gpioClockSleepUntil(const struct timespec* time);
+
+// Returns true if the clock the pins are driven by is CLOCK_MONOTONIC,
+// so that it may be waited on by other means, such as a condition variable
+bool gpioClockIsMonotonic(void);
+
+// For backends: the clock of real pins, on CLOCK_MONOTONIC
+void gpioMonotonicNow(struct timespec* time);
+int gpioMonotonicSleepUntil(const struct timespec* time);
+
+// For backends: reads a burst by spinning on CLOCK_MONOTONIC between single reads,
+// which is as good as a burst gets for backends that read quickly enough
+// Returns count on success, or -2 if a read fails
+int gpioReadBurstSpinning(int (*readPin)(const char* pin, bool* value), const char* pin,
+                          bool* values, int count, long intervalNanoseconds);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,235 @@
+#define _GNU_SOURCE
+
+#include "GeneralPurposeIO.h"
+#include <linux/gpio.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+
+// The gpio chip whose lines the pins are
+#define CHARDEV_CHIP_PATH "/dev/gpiochip0"
+
+// A line handle ioctl is a single system call on a file kept open
+#define CHARDEV_ACCESS_NANOSECONDS 1000L
+
+// The most pins that may be open at once
+#define CHARDEV_MAX_PINS 32
+
+// A line requested from the chip. The kernel only lets its direction be chosen when it is requested,
+// so changing direction gives the handle back and requests the line again.
+typedef struct
+{
+    char name[16];
+    // The line handle, or -1 until a direction has been set
+    int handleFd;
+} ChardevPin;
+
+static struct
+{
+    // Guards the pin table, and the handles in it while they are used
+    pthread_mutex_t lock;
+    
+    // The chip, or -1 until the first pin is opened
+    int chipFd;
+    
+    ChardevPin pins[CHARDEV_MAX_PINS];
+    int pinCount;
+} chardev = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .chipFd = -1,
+    .pinCount = 0
+};
+
+// Finds the open pin with the given name, or NULL if it is not open
+static ChardevPin* chardevPin(const char* name)
+{
+    for (int i = 0; i < chardev.pinCount; i++)
+    {
+        if (strcmp(chardev.pins[i].name, name) == 0)
+        {
+            return &chardev.pins[i];
+        }
+    }
+    return NULL;
+}
+
+// The chip is there, and we may use it
+static bool chardevAvailable(void)
+{
+    return access(CHARDEV_CHIP_PATH, R_OK | W_OK) == 0;
+}
+
+// Opens the chip, if it is not already, and makes room for the pin
+// Returns zero on success, or non-zero on failure
+static int chardevOpen(const char* pin)
+{
+    pthread_mutex_lock(&chardev.lock);
+    int result = 0;
+    if (chardev.chipFd == -1)
+    {
+        chardev.chipFd = open(CHARDEV_CHIP_PATH, O_RDWR | O_CLOEXEC);
+        if (chardev.chipFd == -1)
+        {
+            fprintf(stderr, "GPIO chardev: %s: %s\n", CHARDEV_CHIP_PATH, strerror(errno));
+            result = -1;
+        }
+    }
+    
+    if (result == 0 && !chardevPin(pin))
+    {
+        if (chardev.pinCount == CHARDEV_MAX_PINS || strlen(pin) >= sizeof(chardev.pins[0].name))
+        {
+            fprintf(stderr, "GPIO chardev: cannot open pin %s\n", pin);
+            result = -1;
+        }
+        else
+        {
+            ChardevPin* newPin = &chardev.pins[chardev.pinCount];
+            strcpy(newPin->name, pin);
+            newPin->handleFd = -1;
+            chardev.pinCount++;
+        }
+    }
+    pthread_mutex_unlock(&chardev.lock);
+    return result;
+}
+
+// Gives the line back to the kernel
+// Returns zero on success, or non-zero on failure
+static int chardevClose(const char* pin)
+{
+    pthread_mutex_lock(&chardev.lock);
+    ChardevPin* closing = chardevPin(pin);
+    if (closing)
+    {
+        if (closing->handleFd != -1)
+        {
+            close(closing->handleFd);
+        }
+        // Fill the gap with the last pin
+        *closing = chardev.pins[chardev.pinCount - 1];
+        chardev.pinCount--;
+    }
+    pthread_mutex_unlock(&chardev.lock);
+    return closing ? 0 : -1;
+}
+
+// Requests the line of the pin again with the given flags and initial value
+// Returns zero on success, or non-zero on failure
+static int chardevRequest(const char* pin, unsigned long flags, bool value)
+{
+    pthread_mutex_lock(&chardev.lock);
+    ChardevPin* requesting = chardevPin(pin);
+    int result = -1;
+    if (requesting)
+    {
+        if (requesting->handleFd != -1)
+        {
+            close(requesting->handleFd);
+            requesting->handleFd = -1;
+        }
+        
+        struct gpiohandle_request request;
+        memset(&request, 0, sizeof(request));
+        request.lineoffsets[0] = strtoul(pin, NULL, 10);
+        request.flags = flags;
+        request.default_values[0] = value;
+        strcpy(request.consumer_label, "gpioSoftwareSerial");
+        request.lines = 1;
+        if (ioctl(chardev.chipFd, GPIO_GET_LINEHANDLE_IOCTL, &request) == -1)
+        {
+            fprintf(stderr, "GPIO chardev: cannot request line %s: %s\n", pin, strerror(errno));
+        }
+        else
+        {
+            requesting->handleFd = request.fd;
+            result = 0;
+        }
+    }
+    pthread_mutex_unlock(&chardev.lock);
+    return result;
+}
+
+// Sets the given pin to input mode
+// Returns zero on success, or non-zero on failure
+static int chardevSetInput(const char* pin)
+{
+    return chardevRequest(pin, GPIOHANDLE_REQUEST_INPUT, false);
+}
+
+// Sets the given pin to output mode with an initial value of high
+// Returns zero on success, or non-zero on failure
+static int chardevSetOutputHigh(const char* pin)
+{
+    return chardevRequest(pin, GPIOHANDLE_REQUEST_OUTPUT, true);
+}
+
+// Sets the given pin to output mode with an initial value of low
+// Returns zero on success, or non-zero on failure
+static int chardevSetOutputLow(const char* pin)
+{
+    return chardevRequest(pin, GPIOHANDLE_REQUEST_OUTPUT, false);
+}
+
+// Gets or sets the values of the pin's line with the given ioctl.
+// The lock is held throughout, since other uarts may be opening, closing or requesting
+// their pins meanwhile, which moves entries in the pin table and closes their handles.
+// Returns zero on success, or non-zero on failure, including when the pin has no direction yet
+static int chardevLineValues(const char* pin, unsigned long request, struct gpiohandle_data* data)
+{
+    pthread_mutex_lock(&chardev.lock);
+    ChardevPin* found = chardevPin(pin);
+    int result = (found && found->handleFd != -1 && ioctl(found->handleFd, request, data) != -1) ? 0 : -1;
+    pthread_mutex_unlock(&chardev.lock);
+    return result;
+}
+
+// Writes a new output value to the given pin
+// Returns zero on success, or non-zero on failure
+static int chardevWrite(const char* pin, bool value)
+{
+    struct gpiohandle_data data;
+    memset(&data, 0, sizeof(data));
+    data.values[0] = value;
+    return chardevLineValues(pin, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data);
+}
+
+// Reads a new input value from the given pin
+// Returns zero on success, or non-zero on failure
+static int chardevRead(const char* pin, bool* value)
+{
+    struct gpiohandle_data data;
+    if (chardevLineValues(pin, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data))
+    {
+        return -1;
+    }
+    *value = data.values[0];
+    return 0;
+}
+
+// Reads a burst of samples, as long as they are not due closer together than an ioctl takes
+// Returns count on success, -1 if the samples are too close together, or -2 if a read fails
+static int chardevReadBurst(const char* pin, bool* values, int count, long intervalNanoseconds)
+{
+    if (intervalNanoseconds < CHARDEV_ACCESS_NANOSECONDS)
+    {
+        return -1;
+    }
+    return gpioReadBurstSpinning(chardevRead, pin, values, count, intervalNanoseconds);
+}
+
+const GpioBackend gpioChardevBackend = {
+    .name = "chardev",
+    .accessNanoseconds = CHARDEV_ACCESS_NANOSECONDS,
+    .available = chardevAvailable,
+    .openPin = chardevOpen,
+    .closePin = chardevClose,
+    .setInput = chardevSetInput,
+    .setOutputHigh = chardevSetOutputHigh,
+    .setOutputLow = chardevSetOutputLow,
+    .writePin = chardevWrite,
+    .readPin = chardevRead,
+    .readBurst = chardevReadBurst,
+    .clockNow = gpioMonotonicNow,
+    .clockSleepUntil = gpioMonotonicSleepUntil
+};
\ No newline at end of file
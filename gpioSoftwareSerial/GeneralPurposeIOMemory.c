@@ -0,0 +1,204 @@
+#define _GNU_SOURCE
+
+#include "GeneralPurposeIO.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+// The gpio registers, as mapped by the kernel for unprivileged users
+#define MEMORY_DEVICE_PATH "/dev/gpiomem"
+#define MEMORY_MAP_SIZE 4096
+
+// A read or write is one uncached access over the peripheral bus
+#define MEMORY_ACCESS_NANOSECONDS 100L
+
+// The pins the BCM2835 (and the BCM2711 after it) has
+#define MEMORY_PIN_COUNT 54
+
+// Where the registers are, counted in 32-bit words from the start of the map.
+// Each function select register holds the mode of 10 pins, 3 bits each,
+// and the rest hold a bit for each of 32 pins.
+#define MEMORY_GPFSEL0 0
+#define MEMORY_GPSET0 7
+#define MEMORY_GPCLR0 10
+#define MEMORY_GPLEV0 13
+
+// The function select modes we use
+#define MEMORY_MODE_INPUT 0
+#define MEMORY_MODE_OUTPUT 1
+
+static struct
+{
+    // Guards mapping the registers
+    pthread_mutex_t lock;
+    
+    // The registers, or NULL until the first pin is opened.
+    // They stay mapped until the process ends.
+    volatile uint32_t* registers;
+} memory = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .registers = NULL
+};
+
+// Turns the name of a pin into its number
+// Returns the number, or -1 if the name is not a pin
+static int memoryPinNumber(const char* pin)
+{
+    char* end;
+    long number = strtol(pin, &end, 10);
+    if (end == pin || *end != '\0' || number < 0 || number >= MEMORY_PIN_COUNT)
+    {
+        return -1;
+    }
+    return (int)number;
+}
+
+// The registers are there, and we may map them
+static bool memoryAvailable(void)
+{
+    return access(MEMORY_DEVICE_PATH, R_OK | W_OK) == 0;
+}
+
+// Maps the registers, if they are not already
+// Returns zero on success, or non-zero on failure
+static int memoryOpen(const char* pin)
+{
+    if (memoryPinNumber(pin) == -1)
+    {
+        fprintf(stderr, "GPIO memory: there is no pin %s\n", pin);
+        return -1;
+    }
+    
+    pthread_mutex_lock(&memory.lock);
+    if (!memory.registers)
+    {
+        int file = open(MEMORY_DEVICE_PATH, O_RDWR | O_SYNC | O_CLOEXEC);
+        if (file == -1)
+        {
+            fprintf(stderr, "GPIO memory: %s: %s\n", MEMORY_DEVICE_PATH, strerror(errno));
+        }
+        else
+        {
+            void* map = mmap(NULL, MEMORY_MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+            if (map == MAP_FAILED)
+            {
+                fprintf(stderr, "GPIO memory: cannot map %s: %s\n", MEMORY_DEVICE_PATH, strerror(errno));
+            }
+            else
+            {
+                memory.registers = map;
+            }
+            // The map outlives the file
+            close(file);
+        }
+    }
+    int result = memory.registers ? 0 : -1;
+    pthread_mutex_unlock(&memory.lock);
+    return result;
+}
+
+// The registers stay mapped for the other pins
+// Returns zero
+static int memoryClose(const char* pin)
+{
+    return 0;
+}
+
+// Sets the function select mode of the pin.
+// The register is shared with 9 other pins, and nothing stops another process changing it
+// between our read and write, so modes should be set up before anything else runs on those pins.
+static void memorySetMode(int number, uint32_t mode)
+{
+    volatile uint32_t* select = memory.registers + MEMORY_GPFSEL0 + number / 10;
+    int shift = (number % 10) * 3;
+    *select = (*select & ~(7u << shift)) | (mode << shift);
+}
+
+// Writes a new output value to the given pin, by setting or clearing its bit.
+// Neither register needs a read first, so this is safe against anything else writing other pins.
+// Returns zero on success, or non-zero on failure
+static int memoryWrite(const char* pin, bool value)
+{
+    int number = memoryPinNumber(pin);
+    if (number == -1 || !memory.registers)
+    {
+        return -1;
+    }
+    memory.registers[(value ? MEMORY_GPSET0 : MEMORY_GPCLR0) + number / 32] = 1u << (number % 32);
+    return 0;
+}
+
+// Reads a new input value from the given pin
+// Returns zero on success, or non-zero on failure
+static int memoryRead(const char* pin, bool* value)
+{
+    int number = memoryPinNumber(pin);
+    if (number == -1 || !memory.registers)
+    {
+        return -1;
+    }
+    *value = (memory.registers[MEMORY_GPLEV0 + number / 32] >> (number % 32)) & 1;
+    return 0;
+}
+
+// Sets the given pin to input mode
+// Returns zero on success, or non-zero on failure
+static int memorySetInput(const char* pin)
+{
+    int number = memoryPinNumber(pin);
+    if (number == -1 || !memory.registers)
+    {
+        return -1;
+    }
+    memorySetMode(number, MEMORY_MODE_INPUT);
+    return 0;
+}
+
+// Sets the given pin to output mode with an initial value of high,
+// setting the value first so the pin never glitches low
+// Returns zero on success, or non-zero on failure
+static int memorySetOutputHigh(const char* pin)
+{
+    if (memoryWrite(pin, true))
+    {
+        return -1;
+    }
+    memorySetMode(memoryPinNumber(pin), MEMORY_MODE_OUTPUT);
+    return 0;
+}
+
+// Sets the given pin to output mode with an initial value of low
+// Returns zero on success, or non-zero on failure
+static int memorySetOutputLow(const char* pin)
+{
+    if (memoryWrite(pin, false))
+    {
+        return -1;
+    }
+    memorySetMode(memoryPinNumber(pin), MEMORY_MODE_OUTPUT);
+    return 0;
+}
+
+// Register reads are quick enough to time a burst by spinning on the clock between them
+// Returns count on success, or -2 if a read fails
+static int memoryReadBurst(const char* pin, bool* values, int count, long intervalNanoseconds)
+{
+    return gpioReadBurstSpinning(memoryRead, pin, values, count, intervalNanoseconds);
+}
+
+const GpioBackend gpioMemoryBackend = {
+    .name = "gpiomem",
+    .accessNanoseconds = MEMORY_ACCESS_NANOSECONDS,
+    .available = memoryAvailable,
+    .openPin = memoryOpen,
+    .closePin = memoryClose,
+    .setInput = memorySetInput,
+    .setOutputHigh = memorySetOutputHigh,
+    .setOutputLow = memorySetOutputLow,
+    .writePin = memoryWrite,
+    .readPin = memoryRead,
+    .readBurst = memoryReadBurst,
+    .clockNow = gpioMonotonicNow,
+    .clockSleepUntil = gpioMonotonicSleepUntil
+};
\ No newline at end of file
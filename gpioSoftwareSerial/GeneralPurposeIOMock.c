@@ -2,17 +2,23 @@
 
 volatile bool gpioValue;
 
+// The mock is always there
+static bool mockAvailable(void)
+{
+    return true;
+}
+
 // Requests the kernel to export the given gpio pin,
 // which may already have been exported
 // Returns zero on success, or non-zero on failure
-int gpioOpen(const char* pin)
+static int mockOpen(const char* pin)
 {
     return 0;
 }
 
 // Requests the kernel to unexport the given gpio pin
 // Returns zero on success, or non-zero on failure
-int gpioClose(const char* pin)
+static int mockClose(const char* pin)
 {
     return 0;
 }
@@ -21,7 +27,7 @@ int gpioClose(const char* pin)
 // This will fail if the kernel does not support
 // changing the direction of the given pin
 // Returns zero on success, or non-zero on failure
-int gpioSetInput(const char* pin)
+static int mockSetInput(const char* pin)
 {
     return 0;
 }
@@ -30,7 +36,7 @@ int gpioSetInput(const char* pin)
 // This will fail if the kernel does not support
 // changing the direction of the given pin
 // Returns zero on success, or non-zero on failure
-int gpioSetOutputHigh(const char* pin)
+static int mockSetOutputHigh(const char* pin)
 {
     gpioValue = true;
     return 0;
@@ -40,7 +46,7 @@ int gpioSetOutputHigh(const char* pin)
 // This will fail if the kernel does not support
 // changing the direction of the given pin
 // Returns zero on success, or non-zero on failure
-int gpioSetOutputLow(const char* pin)
+static int mockSetOutputLow(const char* pin)
 {
     gpioValue = false;
     return 0;
@@ -48,7 +54,7 @@ int gpioSetOutputLow(const char* pin)
 
 // Writes a new output value to the given pin
 // Returns zero on success, or non-zero on failure
-int gpioWrite(const char* pin, bool value)
+static int mockWrite(const char* pin, bool value)
 {
     //printf("%d", value);
     gpioValue = value;
@@ -57,9 +63,36 @@ int gpioWrite(const char* pin, bool value)
 
 // Reads a new input value from the given pin
 // Returns zero on success, or non-zero on failure
-int gpioRead(const char* pin, bool* value)
+static int mockRead(const char* pin, bool* value)
 {
     //printf("%d", gpioValue);
     *value = gpioValue;
     return 0;
-}
\ No newline at end of file
+}
+
+// Reads the mocked value count times over, without waiting between them
+// Returns count
+static int mockReadBurst(const char* pin, bool* values, int count, long intervalNanoseconds)
+{
+    for (int i = 0; i < count; i++)
+    {
+        values[i] = gpioValue;
+    }
+    return count;
+}
+
+const GpioBackend gpioMockBackend = {
+    .name = "mock",
+    .accessNanoseconds = 0,
+    .available = mockAvailable,
+    .openPin = mockOpen,
+    .closePin = mockClose,
+    .setInput = mockSetInput,
+    .setOutputHigh = mockSetOutputHigh,
+    .setOutputLow = mockSetOutputLow,
+    .writePin = mockWrite,
+    .readPin = mockRead,
+    .readBurst = mockReadBurst,
+    .clockNow = gpioMonotonicNow,
+    .clockSleepUntil = gpioMonotonicSleepUntil
+};
\ No newline at end of file
@@ -0,0 +1,373 @@
+#define _GNU_SOURCE
+
+#include "GeneralPurposeIOSim.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+// The wire changes to value at time
+typedef struct
+{
+    struct timespec time;
+    bool value;
+} GpioSimEdge;
+
+typedef struct
+{
+    char name[16];
+    
+    // The index of the pin whose wire this pin reads
+    int source;
+    
+    // The value the wire has settled on, and the edges that are still to come after it
+    bool value;
+    GpioSimEdge pendingEdges[GPIO_SIM_MAX_PENDING_EDGES];
+    int pendingStart;
+    int pendingCount;
+    
+    // The last value written, which is where the wire ends up once all the edges have happened
+    bool writtenValue;
+    
+    // New edges cannot happen before the latest edge, or before anyone last looked at the wire
+    struct timespec lastEdgeTime;
+    struct timespec lastReadTime;
+    
+    // Where the skew of the writing clock was last measured from
+    struct timespec skewAnchor;
+} GpioSimPin;
+
+static struct
+{
+    // Guards everything, since the scheduler thread and the application both use the pins
+    pthread_mutex_t lock;
+    
+    GpioSimPin pins[GPIO_SIM_MAX_PINS];
+    int pinCount;
+    
+    // The virtual clock, and when it started
+    struct timespec now;
+    struct timespec startTime;
+    
+    GpioSimConfig config;
+    unsigned int random;
+} sim = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .pinCount = 0,
+    .now = { .tv_sec = 1, .tv_nsec = 0 },
+    .startTime = { .tv_sec = 1, .tv_nsec = 0 },
+    .random = 1
+};
+
+// Adds nanoseconds to the given time
+static void simAddTime(struct timespec* time, long long nanoseconds)
+{
+    long long total = time->tv_nsec + nanoseconds;
+    time->tv_sec += total / 1000000000LL;
+    time->tv_nsec = total % 1000000000LL;
+    if (time->tv_nsec < 0)
+    {
+        time->tv_sec--;
+        time->tv_nsec += 1000000000L;
+    }
+}
+
+static long long simTimeDifference(const struct timespec* currentTime, const struct timespec* oldTime)
+{
+    return (currentTime->tv_sec - oldTime->tv_sec) * 1000000000LL + (currentTime->tv_nsec - oldTime->tv_nsec);
+}
+
+// A xorshift generator, so the noise does not depend on the C library
+static unsigned int simRandom(void)
+{
+    sim.random ^= sim.random << 13;
+    sim.random ^= sim.random >> 17;
+    sim.random ^= sim.random << 5;
+    return sim.random;
+}
+
+// Every call into the pins takes a little virtual time
+static void simAdvance(void)
+{
+    simAddTime(&sim.now, sim.config.callNanoseconds);
+}
+
+// Finds the pin with the given name, adding it if it has never been used
+// Returns NULL if there is no room for another pin
+static GpioSimPin* simPin(const char* name)
+{
+    for (int i = 0; i < sim.pinCount; i++)
+    {
+        if (strcmp(sim.pins[i].name, name) == 0)
+        {
+            return &sim.pins[i];
+        }
+    }
+    
+    if (sim.pinCount == GPIO_SIM_MAX_PINS || strlen(name) >= sizeof(sim.pins[0].name))
+    {
+        fprintf(stderr, "GPIO simulator warning: cannot simulate pin %s\n", name);
+        return NULL;
+    }
+    
+    GpioSimPin* pin = &sim.pins[sim.pinCount];
+    memset(pin, 0, sizeof(*pin));
+    strcpy(pin->name, name);
+    pin->source = sim.pinCount;
+    pin->value = true;
+    pin->writtenValue = true;
+    pin->lastEdgeTime = sim.now;
+    pin->lastReadTime = sim.now;
+    pin->skewAnchor = sim.now;
+    sim.pinCount++;
+    return pin;
+}
+
+// Lets every edge of the wire up to the given time happen
+static void simSettle(GpioSimPin* wire, const struct timespec* time)
+{
+    while (wire->pendingCount > 0 &&
+           simTimeDifference(time, &wire->pendingEdges[wire->pendingStart].time) >= 0)
+    {
+        wire->value = wire->pendingEdges[wire->pendingStart].value;
+        wire->pendingStart = (wire->pendingStart + 1) % GPIO_SIM_MAX_PENDING_EDGES;
+        wire->pendingCount--;
+    }
+}
+
+// Drives the wire of the pin to the value, as seen through the skew of the writing clock
+static void simDrive(GpioSimPin* wire, bool value)
+{
+    if (value == wire->writtenValue)
+    {
+        return;
+    }
+    wire->writtenValue = value;
+    
+    struct timespec edgeTime = sim.now;
+    if (sim.config.skewPartsPerMillion != 0)
+    {
+        if (value)
+        {
+            // A fast clock gets to its edges early, and a slow one late
+            long long elapsed = simTimeDifference(&sim.now, &wire->skewAnchor);
+            simAddTime(&edgeTime, -elapsed * sim.config.skewPartsPerMillion / 1000000LL);
+        }
+        else
+        {
+            // Falling edges (start bits among them) are where the receiver catches up again
+            wire->skewAnchor = sim.now;
+        }
+    }
+    
+    // The past cannot be changed, and edges stay in order
+    if (simTimeDifference(&edgeTime, &wire->lastEdgeTime) < 0)
+    {
+        edgeTime = wire->lastEdgeTime;
+    }
+    if (simTimeDifference(&edgeTime, &wire->lastReadTime) < 0)
+    {
+        edgeTime = wire->lastReadTime;
+    }
+    wire->lastEdgeTime = edgeTime;
+    
+    // Out of room, so the oldest edge has to happen now
+    if (wire->pendingCount == GPIO_SIM_MAX_PENDING_EDGES)
+    {
+        simSettle(wire, &wire->pendingEdges[wire->pendingStart].time);
+    }
+    
+    int index = (wire->pendingStart + wire->pendingCount) % GPIO_SIM_MAX_PENDING_EDGES;
+    wire->pendingEdges[index].time = edgeTime;
+    wire->pendingEdges[index].value = value;
+    wire->pendingCount++;
+}
+
+// Sets how the simulated wires and clock behave from now on
+void gpioSimConfigure(const GpioSimConfig* config)
+{
+    pthread_mutex_lock(&sim.lock);
+    sim.config = *config;
+    // xorshift never leaves zero
+    sim.random = config->seed ? config->seed : 1;
+    pthread_mutex_unlock(&sim.lock);
+}
+
+// Connects inputPin to the wire driven by outputPin, so it reads what outputPin writes.
+// Returns zero on success, or non-zero on failure
+int gpioSimConnect(const char* outputPin, const char* inputPin)
+{
+    pthread_mutex_lock(&sim.lock);
+    GpioSimPin* output = simPin(outputPin);
+    GpioSimPin* input = simPin(inputPin);
+    if (output && input)
+    {
+        input->source = output - sim.pins;
+    }
+    pthread_mutex_unlock(&sim.lock);
+    return (output && input) ? 0 : -1;
+}
+
+// Returns the number of nanoseconds of virtual time since the simulation started
+long long gpioSimElapsed(void)
+{
+    pthread_mutex_lock(&sim.lock);
+    long long elapsed = simTimeDifference(&sim.now, &sim.startTime);
+    pthread_mutex_unlock(&sim.lock);
+    return elapsed;
+}
+
+// The simulator is always there
+static bool simAvailable(void)
+{
+    return true;
+}
+
+// Simulated pins are always there to be exported
+// Returns zero on success, or non-zero on failure
+static int simOpen(const char* pin)
+{
+    pthread_mutex_lock(&sim.lock);
+    int result = simPin(pin) ? 0 : -1;
+    pthread_mutex_unlock(&sim.lock);
+    return result;
+}
+
+// Simulated pins keep their wires, and their connections, once unexported
+// Returns zero on success, or non-zero on failure
+static int simClose(const char* pin)
+{
+    return 0;
+}
+
+// Sets the given pin to input mode.
+// Returns zero on success, or non-zero on failure
+static int simSetInput(const char* pin)
+{
+    return 0;
+}
+
+// Writes a new output value to the wire of the given pin at the current virtual time
+// Returns zero on success, or non-zero on failure
+static int simWrite(const char* pin, bool value)
+{
+    pthread_mutex_lock(&sim.lock);
+    simAdvance();
+    GpioSimPin* wire = simPin(pin);
+    if (wire)
+    {
+        simDrive(wire, value);
+    }
+    pthread_mutex_unlock(&sim.lock);
+    return wire ? 0 : -1;
+}
+
+// Sets the given pin to output mode with an initial value of high
+// Returns zero on success, or non-zero on failure
+static int simSetOutputHigh(const char* pin)
+{
+    return simWrite(pin, true);
+}
+
+// Sets the given pin to output mode with an initial value of low
+// Returns zero on success, or non-zero on failure
+static int simSetOutputLow(const char* pin)
+{
+    return simWrite(pin, false);
+}
+
+// Reads the value of the wire the given pin is connected to at the current virtual time
+// Returns zero on success, or non-zero on failure
+static int simRead(const char* pin, bool* value)
+{
+    pthread_mutex_lock(&sim.lock);
+    simAdvance();
+    GpioSimPin* input = simPin(pin);
+    if (input)
+    {
+        GpioSimPin* wire = &sim.pins[input->source];
+        simSettle(wire, &sim.now);
+        wire->lastReadTime = sim.now;
+        
+        *value = wire->value;
+        if (sim.config.noiseProbability > 0 && simRandom() < sim.config.noiseProbability * 4294967296.0)
+        {
+            *value = !*value;
+        }
+    }
+    pthread_mutex_unlock(&sim.lock);
+    return input ? 0 : -1;
+}
+
+// Reads the wire the given pin is connected to count times, intervalNanoseconds of virtual time apart,
+// each with its own chance of noise
+// Returns count on success, or -2 if the pin cannot be simulated
+static int simReadBurst(const char* pin, bool* values, int count, long intervalNanoseconds)
+{
+    pthread_mutex_lock(&sim.lock);
+    simAdvance();
+    GpioSimPin* input = simPin(pin);
+    if (input)
+    {
+        GpioSimPin* wire = &sim.pins[input->source];
+        for (int i = 0; i < count; i++)
+        {
+            if (i > 0)
+            {
+                simAddTime(&sim.now, intervalNanoseconds);
+            }
+            simSettle(wire, &sim.now);
+            wire->lastReadTime = sim.now;
+            
+            values[i] = wire->value;
+            if (sim.config.noiseProbability > 0 && simRandom() < sim.config.noiseProbability * 4294967296.0)
+            {
+                values[i] = !values[i];
+            }
+        }
+    }
+    pthread_mutex_unlock(&sim.lock);
+    return input ? count : -2;
+}
+
+// Gets the current virtual time
+static void simClockNow(struct timespec* time)
+{
+    pthread_mutex_lock(&sim.lock);
+    simAdvance();
+    *time = sim.now;
+    pthread_mutex_unlock(&sim.lock);
+}
+
+// Moves the virtual clock forward to the given time, plus some jitter.
+// No real time is spent sleeping at all.
+// Returns zero on success, or an error number on failure
+static int simClockSleepUntil(const struct timespec* time)
+{
+    pthread_mutex_lock(&sim.lock);
+    if (simTimeDifference(time, &sim.now) > 0)
+    {
+        sim.now = *time;
+    }
+    if (sim.config.jitterNanoseconds > 0)
+    {
+        simAddTime(&sim.now, simRandom() % (sim.config.jitterNanoseconds + 1));
+    }
+    pthread_mutex_unlock(&sim.lock);
+    return 0;
+}
+
+const GpioBackend gpioSimBackend = {
+    .name = "sim",
+    .accessNanoseconds = 0,
+    .available = simAvailable,
+    .openPin = simOpen,
+    .closePin = simClose,
+    .setInput = simSetInput,
+    .setOutputHigh = simSetOutputHigh,
+    .setOutputLow = simSetOutputLow,
+    .writePin = simWrite,
+    .readPin = simRead,
+    .readBurst = simReadBurst,
+    .clockNow = simClockNow,
+    .clockSleepUntil = simClockSleepUntil
+};
\ No newline at end of file
@@ -0,0 +1,51 @@
+#include "GeneralPurposeIO.h"
+
+#ifndef GENERAL_PURPOSE_IO_SIM
+#define GENERAL_PURPOSE_IO_SIM
+
+// The gpioSimBackend simulates the pins as wires on a virtual clock. Once the gpio clock
+// is the virtual one (see gpioUseClock, which starting a uart on the backend does),
+// sleeping on it just moves the virtual clock forward, so a uart runs as fast as the host
+// can compute it, whatever its baud rate, and the same calls give the same waveform every time.
+
+// The most pins that may be simulated at once
+#define GPIO_SIM_MAX_PINS 32
+
+// The most edges a wire can hold that were written ahead of the time they happen at
+// (which a slow transmitting clock does)
+#define GPIO_SIM_MAX_PENDING_EDGES 64
+
+// How the simulated wires and clock misbehave. A zeroed config is a perfect wire on a perfect clock.
+typedef struct
+{
+    // Each sleep wakes up late by a random amount of up to this many nanoseconds
+    long jitterNanoseconds;
+    
+    // The virtual time each read, write and look at the clock takes
+    long callNanoseconds;
+    
+    // How much faster (positive) or slower (negative) than the receiver the clock writing
+    // to the wires runs, in parts per million. The skew is measured from each falling edge,
+    // so it squeezes or stretches each frame after its start bit like a mismatched clock would,
+    // without the whole stream drifting away from the receiver.
+    long skewPartsPerMillion;
+    
+    // The chance (0 to 1) that each read sees the wrong value
+    double noiseProbability;
+    
+    // Seeds the random jitter and noise, so that runs can be repeated
+    unsigned int seed;
+} GpioSimConfig;
+
+// Sets how the simulated wires and clock behave from now on
+void gpioSimConfigure(const GpioSimConfig* config);
+
+// Connects inputPin to the wire driven by outputPin, so it reads what outputPin writes.
+// A pin that is not connected reads back its own wire.
+// Returns zero on success, or non-zero on failure
+int gpioSimConnect(const char* outputPin, const char* inputPin);
+
+// Returns the number of nanoseconds of virtual time that have passed since the simulation started
+long long gpioSimElapsed(void);
+
+#endif
\ No newline at end of file
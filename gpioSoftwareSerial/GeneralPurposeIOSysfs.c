@@ -0,0 +1,112 @@
+#include "GeneralPurposeIO.h"
+
+// A sysfs read or write opens, reads or writes, and closes a file: a few system calls each
+#define SYSFS_ACCESS_NANOSECONDS 20000L
+
+// The gpio class is there to export pins with
+static bool sysfsAvailable(void)
+{
+    return access("/sys/class/gpio/export", W_OK) == 0;
+}
+
+// Requests the kernel to export the given gpio pin,
+// which may already have been exported
+// Returns zero on success, or non-zero on failure
+static int sysfsOpen(const char* pin)
+{
+    return openWriteClose("/sys/class/gpio/export", pin);
+}
+
+// Requests the kernel to unexport the given gpio pin
+// Returns zero on success, or non-zero on failure
+static int sysfsClose(const char* pin)
+{
+    return openWriteClose("/sys/class/gpio/unexport", pin);
+}
+
+// Sets the given pin to input mode.
+// This will fail if the kernel does not support
+// changing the direction of the given pin
+// Returns zero on success, or non-zero on failure
+static int sysfsSetInput(const char* pin)
+{
+    char* string = formattedString("/sys/class/gpio/gpio%s/direction", pin);
+    int result = openWriteClose(string, "in");
+    free(string);
+    return result;
+}
+
+// Sets the given pin to output mode with an initial value of high
+// This will fail if the kernel does not support
+// changing the direction of the given pin
+// Returns zero on success, or non-zero on failure
+static int sysfsSetOutputHigh(const char* pin){
+    char* string = formattedString("/sys/class/gpio/gpio%s/direction", pin);
+    int result = openWriteClose(string, "high");
+    free(string);
+    return result;
+}
+
+// Sets the given pin to output mode with an initial value of high
+// This will fail if the kernel does not support
+// changing the direction of the given pin
+// Returns zero on success, or non-zero on failure
+static int sysfsSetOutputLow(const char* pin)
+{
+    char* string = formattedString("/sys/class/gpio/gpio%s/direction", pin);
+    int result = openWriteClose(string, "low");
+    free(string);
+    return result;
+}
+
+// Writes a new output value to the given pin
+// Returns zero on success, or non-zero on failure
+static int sysfsWrite(const char* pin, bool value)
+{
+    char* string = formattedString("/sys/class/gpio/gpio%s/value", pin);
+    int result = openWriteClose(string, value ? "1" : "0");
+    free(string);
+    return result;
+}
+
+// Reads a new input value from the given pin
+// Returns zero on success, or non-zero on failure
+static int sysfsRead(const char* pin, bool* value)
+{
+    char readCharacter;
+    
+    char* string = formattedString("/sys/class/gpio/gpio%s/value", pin);
+    int result = openReadClose(string, &readCharacter, sizeof(readCharacter));
+    free(string);
+    
+    // openReadClose gives the number of bytes read
+    if (result != sizeof(readCharacter))
+    {
+        return -1;
+    }
+    *value = (readCharacter == '1');
+    return 0;
+}
+
+// Each sysfs read is a few microseconds of system calls, too slow and uneven to time a burst with
+// Returns -1, since the backend cannot read in bursts
+static int sysfsReadBurst(const char* pin, bool* values, int count, long intervalNanoseconds)
+{
+    return -1;
+}
+
+const GpioBackend gpioSysfsBackend = {
+    .name = "sysfs",
+    .accessNanoseconds = SYSFS_ACCESS_NANOSECONDS,
+    .available = sysfsAvailable,
+    .openPin = sysfsOpen,
+    .closePin = sysfsClose,
+    .setInput = sysfsSetInput,
+    .setOutputHigh = sysfsSetOutputHigh,
+    .setOutputLow = sysfsSetOutputLow,
+    .writePin = sysfsWrite,
+    .readPin = sysfsRead,
+    .readBurst = sysfsReadBurst,
+    .clockNow = gpioMonotonicNow,
+    .clockSleepUntil = gpioMonotonicSleepUntil
+};
\ No newline at end of file
@@ -0,0 +1,130 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "GeneralPurposeIO.h"
+#include "GeneralPurposeIOSim.h"
+
+// The number of reads timed for each backend
+#define BACKEND_TIMED_READS 10000
+
+// The number of samples in the test burst, and how far apart they are
+#define BACKEND_BURST_SAMPLES 8
+#define BACKEND_BURST_INTERVAL_NANOSECONDS 2000L
+
+// Writes values out of one pin and reads them back in through the other,
+// times single reads, and tries a burst.
+// Returns the number of failures
+int testBackend(const GpioBackend* gpio, const char* outputPin, const char* inputPin)
+{
+    int failures = 0;
+    if (gpio->openPin(outputPin) || gpio->openPin(inputPin))
+    {
+        printf("  could not open pins %s and %s\n", outputPin, inputPin);
+        return 1;
+    }
+    
+    if (gpio->setOutputHigh(outputPin) || gpio->setInput(inputPin))
+    {
+        printf("  could not set the pin directions\n");
+        failures++;
+    }
+    
+    bool pattern[] = { true, false, true, false, false, true };
+    for (int i = 0; i < sizeof(pattern) / sizeof(pattern[0]); i++)
+    {
+        bool value;
+        if (gpio->writePin(outputPin, pattern[i]) || gpio->readPin(inputPin, &value) || value != pattern[i])
+        {
+            printf("  wrote %d but did not read it back\n", pattern[i]);
+            failures++;
+        }
+    }
+    
+    struct timespec startTime;
+    struct timespec endTime;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+    for (int i = 0; i < BACKEND_TIMED_READS; i++)
+    {
+        bool value;
+        gpio->readPin(inputPin, &value);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &endTime);
+    long elapsed = (endTime.tv_sec - startTime.tv_sec) * 1000000000L + (endTime.tv_nsec - startTime.tv_nsec);
+    printf("  %ld ns per read (%ld expected)\n", elapsed / BACKEND_TIMED_READS, gpio->accessNanoseconds);
+    
+    gpio->writePin(outputPin, false);
+    bool samples[BACKEND_BURST_SAMPLES];
+    int result = gpio->readBurst(inputPin, samples, BACKEND_BURST_SAMPLES, BACKEND_BURST_INTERVAL_NANOSECONDS);
+    if (result == -1)
+    {
+        printf("  cannot read in bursts\n");
+    }
+    else if (result != BACKEND_BURST_SAMPLES)
+    {
+        printf("  burst read failed\n");
+        failures++;
+    }
+    else
+    {
+        for (int i = 0; i < BACKEND_BURST_SAMPLES; i++)
+        {
+            if (samples[i])
+            {
+                printf("  burst read sample %d wrong\n", i);
+                failures++;
+                break;
+            }
+        }
+        printf("  reads in bursts\n");
+    }
+    
+    gpio->writePin(outputPin, true);
+    gpio->closePin(outputPin);
+    gpio->closePin(inputPin);
+    return failures;
+}
+
+// Runs every backend available on the host through the same test in one go.
+// The mock and simulator always run. The backends for real pins only run if given
+// an output pin and an input pin that are wired together.
+// Usage: gpioBackendTest [output pin] [input pin]
+int main(int argc, char* argv[])
+{
+    const char* outputPin = (argc > 2) ? argv[1] : NULL;
+    const char* inputPin = (argc > 2) ? argv[2] : NULL;
+    
+    // The simulated input pin reads the simulated output pin
+    gpioSimConnect("1", "2");
+    
+    int failures = 0;
+    for (int i = 0; gpioBackends[i]; i++)
+    {
+        const GpioBackend* gpio = gpioBackends[i];
+        bool virtualPins = (gpio == &gpioMockBackend || gpio == &gpioSimBackend);
+        printf("%s:\n", gpio->name);
+        if (!gpio->available())
+        {
+            printf("  unavailable on this host\n");
+        }
+        else if (virtualPins)
+        {
+            failures += testBackend(gpio, "1", "2");
+        }
+        else if (outputPin)
+        {
+            failures += testBackend(gpio, outputPin, inputPin);
+        }
+        else
+        {
+            printf("  available, but no pins given to test with\n");
+        }
+    }
+    
+    const GpioBackend* fastest = gpioBackendFastest();
+    printf("fastest backend for real pins: %s\n", fastest ? fastest->name : "none");
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
\ No newline at end of file
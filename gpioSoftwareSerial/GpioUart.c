@@ -2,314 +2,391 @@
 
 #include "GpioUart.h"
 #include <time.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
 
-
-void addTime(struct timespec* time, long nanoseconds)
+// Returns the number of bytes in the receive buffer.
+// No locking is done here; the rxBufferLock should already be held.
+int receiveBufferCount(GpioUart* uart)
 {
-    time->tv_nsec += nanoseconds;
-    if (time->tv_nsec < 0)
+    if (uart->rxBufferStart == uart->rxBufferTail)
     {
-        time->tv_sec += time->tv_nsec / 1000000000L - 1;
-        time->tv_nsec %= 1000000000L;
-        time->tv_nsec += 1000000000L;
+        return uart->rxBufferFull ? uart->rxBufferSize : 0;
     }
-    else if (time->tv_nsec >= 1000000000L)
+    return (uart->rxBufferTail - uart->rxBufferStart + uart->rxBufferSize) % uart->rxBufferSize;
+}
+
+// Returns the number of bytes in the transfer buffer.
+// No locking is done here; the txBufferLock should already be held.
+int transferBufferCount(GpioUart* uart)
+{
+    if (uart->txBufferStart == uart->txBufferTail)
     {
-        time->tv_sec += time->tv_nsec / 1000000000L;
-        time->tv_nsec %= 1000000000L;
+        return uart->txBufferFull ? uart->txBufferSize : 0;
     }
+    return (uart->txBufferTail - uart->txBufferStart + uart->txBufferSize) % uart->txBufferSize;
 }
 
-void addTimeAndWait(struct timespec* time, long nanoseconds)
+// Makes the rx eventfd readable, if it is not already.
+// The rxBufferLock should already be held.
+void signalReceiveEvent(GpioUart* uart)
 {
-    // Since the operating system cannot get back to us quickly enough when we use something
-    // like clock_nanosleep and can in fact get to us up to 2.5 milliseconds late,
-    // We will instead try a spin-wait
-    
-    // Trying a half os wait first...
-    /*addTime(time, nanoseconds / 4);
-    int errorValue = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, time, NULL);
-    if (errorValue)
+    if (!uart->rxEventSignaled)
     {
-        fprintf(stderr, "GPIO UART warning: sleep failed or was interrupted: %s\n", strerror(errorValue));
+        uint64_t increment = 1;
+        if (write(uart->rxEventFd, &increment, sizeof(increment)) != sizeof(increment))
+        {
+            fprintf(stderr, "GPIO UART warning: rx event signal failed: %s\n", strerror(errno));
+            return;
+        }
+        uart->rxEventSignaled = true;
     }
-    
-    // Then using the spin-wait for precision
-    addTime(time, nanoseconds * 3 / 4);
-    
-    struct timespec actualTime;
-    do
-    {
-        clock_gettime(CLOCK_MONOTONIC, &actualTime);
-    } while (actualTime.tv_sec < time->tv_sec || (actualTime.tv_sec == time->tv_sec && actualTime.tv_nsec < time->tv_nsec));*/
-    
-    
-    addTime(time, nanoseconds);
-    // We use an absolute sleep end-time to ensure error does not accumulate
-    int errorValue = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, time, NULL);
-    if (errorValue)
+}
+
+// Clears the rx eventfd once a reader has emptied the receive buffer.
+// The rxBufferLock should already be held.
+void consumeReceiveEvent(GpioUart* uart)
+{
+    if (uart->rxEventSignaled && receiveBufferCount(uart) == 0)
     {
-        fprintf(stderr, "GPIO UART warning: sleep failed or was interrupted: %s\n", strerror(errorValue));
+        uint64_t count;
+        // The eventfd is non-blocking, so this cannot stall even if it was never written
+        if (read(uart->rxEventFd, &count, sizeof(count)) == sizeof(count) || errno == EAGAIN)
+        {
+            uart->rxEventSignaled = false;
+        }
     }
 }
 
-// Pushes value onto the receive buffer. If it is full, the oldest value is removed.
+// Pushes value onto the receive buffer. If it is full, the overflow policy decides
+// whether the oldest value or the new one is dropped.
 void pushReceivedByte(GpioUart* uart, unsigned char value)
 {
     sem_wait(&uart->rxBufferLock);
     
     if (uart->rxBufferStart == uart->rxBufferTail && uart->rxBufferFull)
     {
-        uart->rxBuffer[uart->rxBufferTail] = value;
-        uart->rxBufferTail = (uart->rxBufferTail + 1) % UART_BUFFER_SIZE;
-        uart->rxBufferStart = uart->rxBufferTail;
+        statIncrement(&uart->stats.rxOverflows);
+        statIncrement(&uart->stats.bytesDropped);
+        
+        // The line cannot be made to wait, so blocking drops the new byte too
+        if (uart->overflowPolicy == GPIO_UART_DROP_OLDEST)
+        {
+            uart->rxBuffer[uart->rxBufferTail] = value;
+            uart->rxBufferTail = (uart->rxBufferTail + 1) % uart->rxBufferSize;
+            uart->rxBufferStart = uart->rxBufferTail;
+        }
     }
     else
     {
         uart->rxBuffer[uart->rxBufferTail] = value;
-        uart->rxBufferTail = (uart->rxBufferTail + 1) % UART_BUFFER_SIZE;
+        uart->rxBufferTail = (uart->rxBufferTail + 1) % uart->rxBufferSize;
         uart->rxBufferFull = (uart->rxBufferStart == uart->rxBufferTail);
     }
+    
+    // Let any waiting reader know once enough has arrived
+    if (receiveBufferCount(uart) >= uart->rxNotifyThreshold)
+    {
+        signalReceiveEvent(uart);
+    }
     sem_post(&uart->rxBufferLock);
 }
 
-// Reads a bit from the given pin by sampling it at least 32 times and sychronizing to changing values.
-bool receiveGpioBit(const char* pin, struct timespec* lastBitTime, long nanosecondsBitLength, int bitOn)
+// Signals received data that has sat below the notify threshold once the line has been
+// idle for the configured number of bit times.
+void checkReceiveIdleGap(GpioUart* uart, int idleBitCount)
 {
-    // The number of times to sample the bit value
-    int samplingTimes = 2;
-    int samplingMajority = samplingTimes / 2;
-    
-    // We will sample the bit that many times
-    long nanosecondsPerPart = nanosecondsBitLength / samplingTimes;
-    
-    // Get the very first bit
-    addTimeAndWait(lastBitTime, nanosecondsPerPart);
-    bool firstBitValue;
-    if (gpioRead(pin, &firstBitValue))
+    if (uart->rxNotifyIdleBits > 0 && idleBitCount == uart->rxNotifyIdleBits)
     {
-        fprintf(stderr, "GPIO UART warning: individual rx pin read failed\n");
+        sem_wait(&uart->rxBufferLock);
+        if (receiveBufferCount(uart) > 0)
+        {
+            signalReceiveEvent(uart);
+        }
+        sem_post(&uart->rxBufferLock);
     }
+}
+
+// A burst read spans this fraction of a bit, in the middle of it once the bit clock is found
+#define RX_BURST_WINDOW_DIVISOR 4
+
+// Takes a received bit and shifts it into the bit buffer, looking for a complete frame.
+// We want to sychronize to the incoming data even when we start in the middle of an incoming transmission.
+// Therefore, we read in bits and do bit sychonization independently of synchonizing and reading in frames.
+void receiveBit(GpioUart* uart, bool bitValue)
+{
+    // What is the size of a valid frame for us?
+    int frameSize = 10 + (uart->secondStopBit ? 1 : 0) + (uart->parityBit ? 1 : 0);
     
-    // And start keeping track of what values we have gotten
-    bool lastBitValue;
+    // Shift in a new bit
+    uart->rxBitBuffer >>= 1;
+    if (bitValue)
+    {
+        // Set the highest bit for our frame size
+        uart->rxBitBuffer |= 1 << (frameSize - 1);
+    }
+    uart->rxBitBufferCount++;
+    uart->rxIdleBitCount++;
     
-    // These are the bits with the same value as the first bit
-    int consecutiveFirstBits = 1;
-    // These are the bits the opposite value
-    int consecutiveSecondBits = 0;
+    int bitBuffer = uart->rxBitBuffer;
     
-    bool bitValue = firstBitValue;
-    // Tend to the remaining samples
-    for (int i = 0; i < samplingTimes - 1; i++)
+    // Do we have enough bits yet?
+    if (uart->rxBitBufferCount >= frameSize)
     {
-        lastBitValue = bitValue;
-        
-        addTimeAndWait(lastBitTime, nanosecondsPerPart);
-        /*if (true)
-        {
-            struct timespec actualTime;
-            clock_gettime(CLOCK_MONOTONIC, &actualTime);
-            long nanosecondsOff = (actualTime.tv_sec - lastBitTime->tv_sec) * 1000000000L + (actualTime.tv_nsec - lastBitTime->tv_nsec);
-            printf("We are %ld nanoseconds off (our wait is %ld)\n", nanosecondsOff, nanosecondsPerPart);
-        }*/
-        if (gpioRead(pin, &bitValue))
+        // Are the stop bit(s) and start bit in position?
+        // Start bit is bit 0, stop bit(s) are the highest bits
+        // This mask selects all these bits
+        int startStopBitmask = 1 | (1 << (frameSize - 1));
+        if (uart->secondStopBit)
         {
-            fprintf(stderr, "GPIO UART warning: individual rx pin read failed\n");
+            startStopBitmask |= (1 << (frameSize - 2));
         }
+        // Are these bits where a frame ought to be, right after the last one?
+        // Only there do we count failures, rather than while hunting for frames.
+        bool isExpectedFrame = (uart->rxBitBufferCount == frameSize) && !(bitBuffer & 1);
         
-        // Are we consecutive?
-        if (bitValue == lastBitValue)
-        {
-            if (bitValue == firstBitValue)
-            {
-                consecutiveFirstBits++;
-            }
-            else
-            {
-                consecutiveSecondBits++;
-            }
-        }
-        else
+        // Now, looking at just these specific bits, is the start bit low and the rest high?
+        if ((bitBuffer & startStopBitmask) == (startStopBitmask - 1))
         {
-            // Is this the first bit switch?
-            if (bitValue != firstBitValue)
+            // If we have a parity bit, is it correct?
+            if (uart->parityBit)
             {
-                //printf("Bit %d: first bit switch to %d after %d read(s)\n", bitOn, bitValue, consecutiveFirstBits);
-                // Is the value still mostly the first value? We need 50%
-                if (consecutiveFirstBits >= samplingMajority)
+                int parityBitValue = 0;
+                if (bitBuffer & (1 << (frameSize - 2 - (uart->secondStopBit ? 1 : 0))))
                 {
-                    // Good, we count that as the value and set the time back to the last reading of it
-                    addTime(lastBitTime, -nanosecondsPerPart);
-                    return firstBitValue;
+                    parityBitValue = 1;
                 }
-                else
+                
+                // The data are bits 1 through 8
+                int bits = bitBuffer >> 1;
+                int parity = 0;
+                for (int i = 0;i < 8; i++)
                 {
-                    // Well, let us try instead seeing if we can get something from this different value!
-                    consecutiveSecondBits = 1;
-                    // Sync up to the change of value by discounting the time of the first-valued bits
-                    i -= consecutiveFirstBits;
+                    parity ^= (bits & 1);
+                    bits >>= 1;
                 }
-            }
-            else
-            {
-                //printf("Bit %d: second bit switch to %d after %d read(s)\n", bitOn, bitValue, consecutiveSecondBits);
-                // Have we managed to get a decent amount (50%) of this second value?
-                if (consecutiveSecondBits >= samplingMajority)
+                
+                if (parityBitValue == parity)
                 {
-                    // Good, we count that as the value and set the time back to the last reading of it
-                    addTime(lastBitTime, -nanosecondsPerPart);
-                    return !firstBitValue;
+                    // We have a byte!
+                    statIncrement(&uart->stats.framesAccepted);
+                    pushReceivedByte(uart, bitBuffer >> 1);
+                    uart->rxBitBufferCount = 0;
+                    uart->rxIdleBitCount = 0;
                 }
-                else
+                else if (isExpectedFrame)
                 {
-                    //printf("Bit %d: collosal mess!\n", bitOn);
-                    // We just have a big collosal mess...
-                    // Let us return a high bit, as continuous high indicates no communication
-                    return true;
+                    statIncrement(&uart->stats.parityErrors);
                 }
             }
+            else
+            {
+                statIncrement(&uart->stats.framesAccepted);
+                pushReceivedByte(uart, bitBuffer >> 1);
+                uart->rxBitBufferCount = 0;
+                uart->rxIdleBitCount = 0;
+            }
+        }
+        else if (isExpectedFrame)
+        {
+            statIncrement(&uart->stats.framingErrors);
         }
     }
     
-    if (consecutiveSecondBits)
-    {
-        //printf("Bit %d: strong salvaged read of %d with %d reads\n", bitOn, bitValue, consecutiveSecondBits);
-    }
-    // If we have gotten here, we have maintained solidly on our recent value
-    return bitValue;
+    checkReceiveIdleGap(uart, uart->rxIdleBitCount);
 }
 
-void* gpioUartReceiveMain(void* arg)
+// Reads a whole bit in one burst of samples across the middle of it on behalf of the scheduler.
+// The bit is whichever value most of the samples have. If a single clean edge shows among them,
+// the bit clock was off by enough to see the neighbouring bit, and it is moved to line up with the edge.
+bool receiveBurst(GpioUart* uart, GpioTimer* timer)
 {
-    GpioUart* uart = (GpioUart*)arg;
+    long bitDelay = 1000000000L / uart->baudRate;
+    int samplesPerBit = uart->rxSamplesPerBit;
+    long interval = bitDelay / RX_BURST_WINDOW_DIVISOR / samplesPerBit;
     
-    // We open then initialize the receive pin
-    if (gpioOpen(uart->rxPin))
+    bool samples[GPIO_UART_MAX_SAMPLES_PER_BIT];
+    if (uart->gpio->readBurst(uart->rxPin, samples, samplesPerBit, interval) != samplesPerBit)
     {
-        fprintf(stderr, "GPIO UART fatal error: rx pin failed to open\n");
-        return NULL;
+        // Carry on a sample at a time, starting right away
+        fprintf(stderr, "GPIO UART warning: rx pin cannot be read in bursts, sampling it a read at a time\n");
+        uart->rxBurstReads = false;
+        uart->rxSampleOn = -1;
+        return true;
     }
     
-    if (gpioSetInput(uart->rxPin))
+    int highSamples = 0;
+    int edges = 0;
+    int edgeIndex = 0;
+    for (int i = 0; i < samplesPerBit; i++)
     {
-        fprintf(stderr, "GPIO UART warning: rx pin failed to set pin direction to input\n");
+        highSamples += samples[i];
+        if (i > 0 && samples[i] != samples[i - 1])
+        {
+            edges++;
+            edgeIndex = i;
+        }
     }
     
-    // Make sure we can read the pin
-    bool testValue;
-    if (gpioRead(uart->rxPin, &testValue))
+    // Noise shows up as short runs, so an edge needs enough samples on either side to be believed,
+    // where there are enough samples to tell
+    int minimumRun = (samplesPerBit >= 8) ? samplesPerBit / 4 : (samplesPerBit >= 4) ? 2 : 1;
+    // A tie goes to high, which is what an idle line reads
+    bool bitValue = highSamples * 2 >= samplesPerBit;
+    long correction = 0;
+    if (edges == 1 && edgeIndex >= minimumRun && samplesPerBit - edgeIndex >= minimumRun)
     {
-        fprintf(stderr, "GPIO UART fatal error: rx pin failed to be read\n");
-        return NULL;
+        // Measured from the first sample, the edge is where the bit starts if it is before the middle,
+        // and where the next one starts if it is after
+        long edgeTime = edgeIndex * interval - interval / 2;
+        long middle = (samplesPerBit - 1) * interval / 2;
+        correction = edgeTime - ((edgeTime < middle) ? middle - bitDelay / 2 : middle + bitDelay / 2);
+        uart->rxBurstInPhase = true;
+    }
+    else if (!uart->rxBurstInPhase && edges == 0 && bitValue != uart->rxLastSampleValue)
+    {
+        // The value changed somewhere in the gap since the last burst, and we cannot tell where.
+        // A burst right up against an edge misses bits sent a little late (such as our own, held up
+        // behind the burst on the scheduler thread), so slide half the gap along, once, to get clear of it.
+        correction = (bitDelay - samplesPerBit * interval) / 2;
+        uart->rxBurstInPhase = true;
     }
+    uart->rxLastSampleValue = bitValue;
+    addTime(&timer->deadline, bitDelay + correction);
     
-    // Get the initial time to time ourselves relative to
-    struct timespec startTime;
-    if (clock_gettime(CLOCK_MONOTONIC, &startTime))
+    receiveBit(uart, bitValue);
+    return true;
+}
+
+// Takes a single sample of the rx pin on behalf of the scheduler.
+// A bit is read by sampling it several times and sychronizing to changing values,
+// one sample per step, so that many uarts can share the scheduler thread.
+bool gpioUartReceiveStep(GpioTimer* timer)
+{
+    GpioUart* uart = (GpioUart*)timer->context;
+    
+    if (uart->rxBurstReads)
     {
-        perror("GPIO UART fatal error: failed to get time");
-        return NULL;
+        return receiveBurst(uart, timer);
     }
     
-    // The time that the last bit being read finished
-    struct timespec lastBitTime = startTime;
+    int samplesPerBit = uart->rxSamplesPerBit;
+    int samplingMajority = samplesPerBit / 2;
     
-    // We want to sychronize to the incoming data even when we start in the middle of an incoming transmission.
-    // Therefore, we read in bits and do bit sychonization independently of synchonizing and reading in frames.
-    // We use a bit buffer that we shift bits into from bit 9 (or 10) to the right to help us do this.
-    int bitBuffer = 0;
-    // The number of bits shifted into the buffer so far.
-    int bitBufferCount = 0;
+    // We will sample the bit that many times
+    long nanosecondsPerPart = 1000000000L / uart->baudRate / samplesPerBit;
     
-    while (uart->shouldExecute)
+    bool bitValue;
+    if (uart->gpio->readPin(uart->rxPin, &bitValue))
     {
-        // What is the delay for a bit in nanoseconds?
-        long bitDelay = 1000000000L / uart->baudRate;
-        
-        // What is the size of a valid frame for us?
-        int frameSize = 10 + (uart->secondStopBit ? 1 : 0) + (uart->parityBit ? 1 : 0);
+        fprintf(stderr, "GPIO UART warning: individual rx pin read failed\n");
+    }
+    
+    // Is this the very first sample of the bit?
+    if (uart->rxSampleOn == -1)
+    {
+        // Start keeping track of what values we have gotten
+        uart->rxFirstSampleValue = bitValue;
+        uart->rxLastSampleValue = bitValue;
+        // These are the samples with the same value as the first sample
+        uart->rxConsecutiveFirstSamples = 1;
+        // These are the samples with the opposite value
+        uart->rxConsecutiveSecondSamples = 0;
+        uart->rxSampleOn = 0;
+    }
+    else
+    {
+        bool lastBitValue = uart->rxLastSampleValue;
+        uart->rxLastSampleValue = bitValue;
         
-        // Shift in a new bit
-        bitBuffer >>= 1;
-        if (receiveGpioBit(uart->rxPin, &lastBitTime, bitDelay, bitBufferCount))
+        // Are we consecutive?
+        if (bitValue == lastBitValue)
         {
-            // Set the highest bit for our frame size
-            bitBuffer |= 1 << (frameSize - 1);
+            if (bitValue == uart->rxFirstSampleValue)
+            {
+                uart->rxConsecutiveFirstSamples++;
+            }
+            else
+            {
+                uart->rxConsecutiveSecondSamples++;
+            }
         }
-        bitBufferCount++;
-        
-        // Do we have enough bits yet?
-        if (bitBufferCount >= frameSize)
+        else
         {
-            // Are the stop bit(s) and start bit in position?
-            // Start bit is bit 0, stop bit(s) are the highest bits
-            // This mask selects all these bits
-            int startStopBitmask = 1 | (1 << (frameSize - 1));
-            if (uart->secondStopBit)
+            // Is this the first bit switch?
+            if (bitValue != uart->rxFirstSampleValue)
             {
-                startStopBitmask |= (1 << (frameSize - 2));
+                // Is the value still mostly the first value? We need 50%
+                if (uart->rxConsecutiveFirstSamples >= samplingMajority)
+                {
+                    // Good, we count that as the value, and the time of this reading
+                    // becomes the time of the first reading of the next bit
+                    uart->rxSampleOn = -1;
+                    receiveBit(uart, uart->rxFirstSampleValue);
+                    return true;
+                }
+                else
+                {
+                    // Well, let us try instead seeing if we can get something from this different value!
+                    uart->rxConsecutiveSecondSamples = 1;
+                    // Sync up to the change of value by discounting the time of the first-valued samples
+                    uart->rxSampleOn -= uart->rxConsecutiveFirstSamples;
+                }
             }
-            // Now, looking at just these specific bits, is the start bit low and the rest high?
-            if ((bitBuffer & startStopBitmask) == (startStopBitmask - 1))
+            else
             {
-                // If we have a parity bit, is it correct?
-                if (uart->parityBit)
+                // Have we managed to get a decent amount (50%) of this second value?
+                if (uart->rxConsecutiveSecondSamples >= samplingMajority)
                 {
-                    int parityBitValue = 0;
-                    if (bitBuffer & (1 << (frameSize - 2 - (uart->secondStopBit ? 1 : 0))))
-                    {
-                        parityBitValue = 1;
-                    }
-                    
-                    // The data are bits 1 through 8
-                    int bits = bitBuffer >> 1;
-                    int parity = 0;
-                    for (int i = 0;i < 8; i++)
-                    {
-                        parity ^= (bits & 1);
-                        bits >>= 1;
-                    }
-                    
-                    if (parityBitValue == parity)
-                    {
-                        // We have a byte!
-                        pushReceivedByte(uart, bitBuffer >> 1);
-                        bitBufferCount = 0;
-                    }
-                    else
-                    {
-                        //printf("Parity failed: %d\n", bitBuffer);
-                    }
+                    // Good, we count that as the value, and resync on this reading as well
+                    uart->rxSampleOn = -1;
+                    receiveBit(uart, !uart->rxFirstSampleValue);
+                    return true;
                 }
                 else
                 {
-                    pushReceivedByte(uart, bitBuffer >> 1);
-                    bitBufferCount = 0;
+                    // We just have a big collosal mess...
+                    // Let us take a high bit, as continuous high indicates no communication
+                    uart->rxSampleOn = -1;
+                    addTime(&timer->deadline, nanosecondsPerPart);
+                    receiveBit(uart, true);
+                    return true;
                 }
             }
         }
+        
+        uart->rxSampleOn++;
+    }
+    
+    // The next sample is a part later
+    addTime(&timer->deadline, nanosecondsPerPart);
+    
+    // Have we tended to all of the samples?
+    if (uart->rxSampleOn >= samplesPerBit - 1)
+    {
+        // If we have gotten here, we have maintained solidly on our recent value
+        uart->rxSampleOn = -1;
+        receiveBit(uart, bitValue);
     }
     
-    return NULL;
+    return true;
 }
 
-// Holds a GPIO pin to its old value until the needed time has past.
-// Then sets the gpio to a new value and updates the lastBitTime value.
-void holdAndSetGpio(const char* pin, bool value, struct timespec* lastBitTime, long nanosecondsNeeded)
+// Wakes a sender waiting for room in the transfer buffer, if there is one.
+// The txBufferLock should already be held.
+void signalTransferSpace(GpioUart* uart)
 {
-    addTimeAndWait(lastBitTime, nanosecondsNeeded);
-    /*if (true)
+    if (uart->txSpaceWaiting)
     {
-        struct timespec actualTime;
-        clock_gettime(CLOCK_MONOTONIC, &actualTime);
-        long nanosecondsOff = (actualTime.tv_sec - lastBitTime->tv_sec) * 1000000000L + (actualTime.tv_nsec - lastBitTime->tv_nsec);
-        printf("Setter is %ld nanoseconds off (%ld long pulse)\n", nanosecondsOff, nanosecondsNeeded);
-    }*/
-    
-    if (gpioWrite(pin, value))
-    {
-        fprintf(stderr, "GPIO UART warning: individual tx pin write failed\n");
+        uint64_t increment = 1;
+        if (write(uart->txSpaceFd, &increment, sizeof(increment)) != sizeof(increment))
+        {
+            fprintf(stderr, "GPIO UART warning: tx space signal failed: %s\n", strerror(errno));
+            return;
+        }
+        uart->txSpaceWaiting = false;
     }
 }
 
@@ -329,109 +406,112 @@ int popTransferByte(GpioUart* uart)
         int value = uart->txBuffer[uart->txBufferStart];
         
         // Move the position, and we cannot be full
-        uart->txBufferStart = (uart->txBufferStart + 1) % UART_BUFFER_SIZE;
+        uart->txBufferStart = (uart->txBufferStart + 1) % uart->txBufferSize;
         uart->txBufferFull = false;
         
+        // A sender may be waiting for the room we just made
+        signalTransferSpace(uart);
+        
         sem_post(&uart->txBufferLock);
         return value;
     }
 }
 
-void* gpioUartSendMain(void* arg)
+// Sets the tx pin for the next run of equal bits of the frame being sent on behalf of the scheduler,
+// starting on a new frame if the last one is finished. Nothing changes on the line within a run,
+// so the pin is only written, and the scheduler only woken, at each edge.
+// Returns false to leave the scheduler when there is nothing left to send.
+bool gpioUartTransferStep(GpioTimer* timer)
 {
-    GpioUart* uart = (GpioUart*)arg;
-    
-    // Non-sending UART state is to hold a pin high.
-    // We open then initialize the transfer pin that way
-    if (gpioOpen(uart->txPin))
-    {
-        fprintf(stderr, "GPIO UART fatal error: tx pin failed to open\n");
-        return NULL;
-    }
-    
-    if (gpioSetOutputHigh(uart->txPin))
-    {
-        fprintf(stderr, "GPIO UART warning: tx pin failed to set pin direction to output\n");
-    }
-    
-    // Make sure we can write to the pin!
-    if (gpioWrite(uart->txPin, true))
-    {
-        fprintf(stderr, "GPIO UART fatal error: tx pin failed to be written to\n");
-        return NULL;
-    }
-    
-    // Get the initial time to time ourselves relative to
-    struct timespec startTime;
-    if (clock_gettime(CLOCK_MONOTONIC, &startTime))
-    {
-        perror("GPIO UART fatal error: failed to get time");
-        return NULL;
-    }
+    GpioUart* uart = (GpioUart*)timer->context;
     
-    // The time that the last bit was finished being held
-    struct timespec lastBitTime = startTime;
+    // What is the delay for a bit in nanoseconds?
+    // We recalculate this for every run in case the setting changes
+    long bitDelay = 1000000000L / uart->baudRate;
     
-    // The number of nanoseconds needed by the last stop bit before another gpio value can be set.
-    long stopBitNanoseconds;
-    
-    // Ensure contrast for the first start bit for the high value set above
-    stopBitNanoseconds = 1000000000L / uart->baudRate;
-    
-    while (uart->shouldExecute)
+    // Is it time for a new frame?
+    if (uart->txFrameBitOn >= uart->txFrameSize)
     {
         // Have we a byte to send?
         int byteToSend = popTransferByte(uart);
-        if (byteToSend != -1)
+        if (byteToSend == -1)
         {
-            // What is the delay for a bit in nanoseconds?
-            // We recalculate this for every byte in case the setting changes
-            long bitDelay = 1000000000L / uart->baudRate;
-            
-            // Start bit
-            //holdGpio(uart->txPin, false, &lastBitTime, bitDelay);
-            holdAndSetGpio(uart->txPin, false, &lastBitTime, stopBitNanoseconds);
-            
-            int bits = byteToSend;
-            int parity = 0;
-            // UART is Least Significant Bit first
-            for (int i = 0;i < 8; i++)
-            {
-                // Keep track of parity
-                parity ^= (bits & 1);
-                
-                // Send the value of the lowest bit
-                holdAndSetGpio(uart->txPin, bits & 1, &lastBitTime, bitDelay);
-                // Shift out the just-transmitted bit
-                bits >>= 1;
-            }
-            
-            // Parity bit
-            if (uart->parityBit)
-            {
-                holdAndSetGpio(uart->txPin, parity, &lastBitTime, bitDelay);
-            }
-            
-            // Stop bit(s)
-            holdAndSetGpio(uart->txPin, true, &lastBitTime, bitDelay);
-            stopBitNanoseconds = bitDelay + (uart->secondStopBit ? bitDelay : 0);
+            // The line rests high until gpioUartSend wakes us again.
+            // Our deadline stays at the end of the stop bit(s) so that they are honored.
+            return false;
         }
-        else
+        
+        // Start bit is low, then the data bits
+        // UART is Least Significant Bit first
+        int frame = byteToSend << 1;
+        int frameSize = 9;
+        
+        // Parity bit
+        if (uart->parityBit)
         {
-            // Get some good waiting in!
-            addTimeAndWait(&lastBitTime, 1000000);
+            // Quicker parity calculation from http://graphics.stanford.edu/~seander/bithacks.html#ParityParallel
+            int parity = byteToSend;
+            parity ^= parity >> 4;
+            parity &= 0xf;
+            parity = (0x6996 >> parity) & 1;
+            
+            frame |= parity << frameSize;
+            frameSize++;
         }
+        
+        // Stop bit(s)
+        frame |= (uart->secondStopBit ? 3 : 1) << frameSize;
+        frameSize += uart->secondStopBit ? 2 : 1;
+        
+        uart->txFrame = frame;
+        uart->txFrameSize = frameSize;
+        uart->txFrameBitOn = 0;
+        statIncrement(&uart->stats.txBytes);
     }
     
-    return NULL;
+    // The bits beyond the frame are all 0, so a run of 1s always ends with the frame,
+    // and a run of 0s always ends by the stop bit
+    unsigned int bitsLeft = (unsigned int)uart->txFrame >> uart->txFrameBitOn;
+    bool value = bitsLeft & 1;
+    int run = __builtin_ctz(value ? ~bitsLeft : bitsLeft);
+    
+    if (uart->gpio->writePin(uart->txPin, value))
+    {
+        fprintf(stderr, "GPIO UART warning: individual tx pin write failed\n");
+    }
+    statIncrement(&uart->stats.txEdges);
+    uart->txFrameBitOn += run;
+    
+    // Hold this value until the next edge, or the end of the stop bit(s)
+    addTime(&timer->deadline, run * bitDelay);
+    return true;
+}
+
+// Starts the GPIO UART operation on the given pins at the given baud rate
+// through the fastest gpio backend on the host, like gpioUartStartOn.
+// Returns 0 on success, non-zero on failure.
+int gpioUartStart(GpioUart* uart, const char* rxPin, const char* txPin, int baudRate, const GpioTimingProfile* profile)
+{
+    const GpioBackend* gpio = gpioBackendFastest();
+    if (!gpio)
+    {
+        fprintf(stderr, "GPIO UART fatal error: no gpio backend is available\n");
+        return -1;
+    }
+    return gpioUartStartOn(uart, gpio, rxPin, txPin, baudRate, profile);
 }
 
 // Starts the GPIO UART operation on the given pins at the given baud rate
-// by starting up two threads to manage the receiving and transfering ends
-// and setting up related resources.
+// by opening the pins through the given gpio backend and adding the receiving
+// and transfering ends to the scheduler thread shared by all uarts, and setting up related resources.
+// The scheduler runs on the clock of the backend from then on.
+// If profile is not NULL, the shared scheduler thread is run with it from then on
+// (see GpioTimingProfile); otherwise the thread keeps whatever profile it has.
 // Returns 0 on success, non-zero on failure.
-int gpioUartStart(GpioUart* uart, const char* rxPin, const char* txPin, int baudRate)
+int gpioUartStartOn(GpioUart* uart, const GpioBackend* gpio, const char* rxPin, const char* txPin, int baudRate,
+                    const GpioTimingProfile* profile)
 {
+    uart->gpio = gpio;
     uart->rxPin = rxPin;
     uart->txPin = txPin;
     uart->baudRate = baudRate;
@@ -440,147 +520,367 @@ int gpioUartStart(GpioUart* uart, const char* rxPin, const char* txPin, int baud
     uart->invertingLogic = false;
     uart->parityBit = false;
     uart->secondStopBit = false;
+    uart->rxBuffer = NULL;
+    uart->txBuffer = NULL;
+    uart->rxBufferSize = UART_BUFFER_SIZE;
+    uart->txBufferSize = UART_BUFFER_SIZE;
     uart->rxBufferStart = 0;
     uart->txBufferStart = 0;
     uart->rxBufferTail = 0;
     uart->txBufferTail = 0;
     uart->rxBufferFull = false;
     uart->txBufferFull = false;
+    uart->overflowPolicy = GPIO_UART_DROP_OLDEST;
+    uart->txSpaceWaiting = false;
     
-    // Keep our threads alive once they start
-    uart->shouldExecute = true;
+    // Signal readers as soon as any data arrives, until told otherwise
+    uart->rxNotifyThreshold = 1;
+    uart->rxNotifyIdleBits = 0;
+    uart->rxEventSignaled = false;
     
-    // Start our threads!
-    // Error if they fail!
-    if (pthread_create(&uart->rxThread, NULL, &gpioUartReceiveMain, uart) != 0)
+    uart->rxSamplesPerBit = GPIO_UART_DEFAULT_SAMPLES_PER_BIT;
+    uart->rxBurstReads = false;
+    uart->rxBurstInPhase = false;
+    uart->rxSampleOn = -1;
+    uart->rxBitBuffer = 0;
+    uart->rxBitBufferCount = 0;
+    uart->rxIdleBitCount = 0;
+    
+    uart->txFrame = 0;
+    uart->txFrameSize = 0;
+    uart->txFrameBitOn = 0;
+    
+    // We open then initialize the receive pin
+    if (uart->gpio->openPin(uart->rxPin))
     {
+        fprintf(stderr, "GPIO UART fatal error: rx pin failed to open\n");
         return -1;
     }
     
-    if (pthread_create(&uart->txThread, NULL, &gpioUartSendMain, uart) != 0)
+    if (uart->gpio->setInput(uart->rxPin))
     {
-        // One has managed to live, but should now apoptosize
-        uart->shouldExecute = false;
-        return -1;
+        fprintf(stderr, "GPIO UART warning: rx pin failed to set pin direction to input\n");
+    }
+    
+    // Make sure we can read the pin
+    bool testValue;
+    if (uart->gpio->readPin(uart->rxPin, &testValue))
+    {
+        fprintf(stderr, "GPIO UART fatal error: rx pin failed to be read\n");
+        goto closeRxPin;
+    }
+    
+    // Non-sending UART state is to hold a pin high.
+    // We open then initialize the transfer pin that way
+    if (uart->gpio->openPin(uart->txPin))
+    {
+        fprintf(stderr, "GPIO UART fatal error: tx pin failed to open\n");
+        goto closeRxPin;
+    }
+    
+    if (uart->gpio->setOutputHigh(uart->txPin))
+    {
+        fprintf(stderr, "GPIO UART warning: tx pin failed to set pin direction to output\n");
+    }
+    
+    // Make sure we can write to the pin!
+    if (uart->gpio->writePin(uart->txPin, true))
+    {
+        fprintf(stderr, "GPIO UART fatal error: tx pin failed to be written to\n");
+        goto closeTxPin;
     }
     
-    // Initialize our locks
+    // Initialize our locks and the rx event before the scheduler can use them
     if (sem_init(&uart->rxBufferLock, 0, 1) != 0)
     {
-        uart->shouldExecute = false;
-        return -1;
+        goto closeTxPin;
     }
     
     if (sem_init(&uart->txBufferLock, 0, 1) != 0)
     {
-        uart->shouldExecute = false;
-        // And destroy the lock that managed to be created successfully
-        sem_destroy(&uart->rxBufferLock);
-        return -1;
+        goto destroyRxLock;
+    }
+    
+    uart->rxEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (uart->rxEventFd == -1)
+    {
+        goto destroyTxLock;
+    }
+    
+    uart->txSpaceFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (uart->txSpaceFd == -1)
+    {
+        goto closeRxEvent;
+    }
+    
+    uart->rxBuffer = malloc(uart->rxBufferSize);
+    uart->txBuffer = malloc(uart->txBufferSize);
+    if (!uart->rxBuffer || !uart->txBuffer)
+    {
+        goto freeBuffers;
+    }
+    
+    // Get the initial time to time ourselves relative to,
+    // on the clock the pins are driven by
+    gpioUseClock(uart->gpio);
+    struct timespec startTime;
+    gpioClockNow(&startTime);
+    
+    gpioTimerInit(&uart->rxTimer, &gpioUartReceiveStep, uart);
+    gpioTimerInit(&uart->txTimer, &gpioUartTransferStep, uart);
+    
+    memset(&uart->stats, 0, sizeof(uart->stats));
+    uart->rxTimer.latenessHistogram = uart->stats.latenessHistogram;
+    uart->txTimer.latenessHistogram = uart->stats.latenessHistogram;
+    
+    // Ensure contrast for the first start bit for the high value set above
+    uart->rxTimer.deadline = startTime;
+    uart->txTimer.deadline = startTime;
+    addTime(&uart->txTimer.deadline, 1000000000L / uart->baudRate);
+    
+    // Start our timers!
+    // Error if they fail!
+    // The tx timer is only added when there is something to send
+    if (gpioSchedulerAcquire(profile) != 0)
+    {
+        goto freeBuffers;
+    }
+    
+    if (gpioSchedulerAdd(&uart->rxTimer) != 0)
+    {
+        goto releaseScheduler;
     }
     
     // Everything is going great!
     return 0;
+    
+    // Undo whatever was set up, in the reverse order, from where it failed
+releaseScheduler:
+    gpioSchedulerRelease();
+freeBuffers:
+    free(uart->rxBuffer);
+    free(uart->txBuffer);
+    uart->rxBuffer = NULL;
+    uart->txBuffer = NULL;
+    close(uart->txSpaceFd);
+closeRxEvent:
+    close(uart->rxEventFd);
+destroyTxLock:
+    sem_destroy(&uart->txBufferLock);
+destroyRxLock:
+    sem_destroy(&uart->rxBufferLock);
+closeTxPin:
+    uart->gpio->closePin(uart->txPin);
+closeRxPin:
+    uart->gpio->closePin(uart->rxPin);
+    return -1;
 }
 
-// Stops the GPIO UART operation by requesting the management threads to end
-// and releasing related resources. Waits on the threads to die.
-// The same structure may still be started again with gpioUartStart.
+// Stops the GPIO UART operation by removing it from the scheduler thread
+// and releasing related resources.
+// The same structure may still be started again with gpioUartStart or gpioUartStartOn.
 void gpioUartStop(GpioUart* uart)
 {
-    // Signal the threads to stop executing
-    uart->shouldExecute = false;
+    // Once removed, the scheduler will not touch the uart again
+    gpioSchedulerRemove(&uart->rxTimer);
+    gpioSchedulerRemove(&uart->txTimer);
+    gpioSchedulerRelease();
     
-    pthread_join(uart->rxThread, NULL);
-    pthread_join(uart->txThread, NULL);
+    free(uart->rxBuffer);
+    free(uart->txBuffer);
+    uart->rxBuffer = NULL;
+    uart->txBuffer = NULL;
     
     sem_destroy(&uart->rxBufferLock);
     sem_destroy(&uart->txBufferLock);
+    close(uart->rxEventFd);
+    close(uart->txSpaceFd);
+    
+    uart->gpio->closePin(uart->txPin);
+    uart->gpio->closePin(uart->rxPin);
 }
 
-// Adds a single byte to the transfer buffer to be sent out the UART
-// If the buffer is full, the oldest value is removed.
-void gpioUartSendByte(GpioUart* uart, unsigned char value)
+int min(int a, int b)
 {
-    sem_wait(&uart->txBufferLock);
+    return (a < b) ? a : b;
+}
+
+// Moves the contents of a circular buffer into newBuffer, of newSize bytes, and frees the old one.
+// As many of the oldest bytes are kept as fit.
+// Returns the number of bytes that did not fit.
+int moveBuffer(unsigned char** buffer, int* size, int* start, int* tail, bool* full, unsigned char* newBuffer, int newSize)
+{
+    int count = (*start == *tail) ? (*full ? *size : 0) : (*tail - *start + *size) % *size;
+    int kept = min(count, newSize);
     
-    if (uart->txBufferStart == uart->txBufferTail && uart->txBufferFull)
+    // The kept bytes run from the start to the physical end of the old buffer, then on from its beginning
+    int bytesToCopy = min(kept, *size - *start);
+    memcpy(newBuffer, *buffer + *start, bytesToCopy);
+    memcpy(newBuffer + bytesToCopy, *buffer, kept - bytesToCopy);
+    
+    free(*buffer);
+    *buffer = newBuffer;
+    *size = newSize;
+    *start = 0;
+    *tail = kept % newSize;
+    *full = (kept == newSize);
+    return count - kept;
+}
+
+// Resizes the receive and transfer buffers of a started uart to rxSize and txSize bytes
+// and sets what happens when either is full. Buffered data is kept, except for the newest
+// bytes that no longer fit in a smaller buffer, which are counted as dropped.
+// Returns 0 on success, non-zero if a size is not positive or the buffers cannot be allocated.
+int gpioUartSetBuffers(GpioUart* uart, int rxSize, int txSize, GpioUartOverflowPolicy policy)
+{
+    if (rxSize < 1 || txSize < 1)
     {
-        uart->txBuffer[uart->txBufferTail] = value;
-        uart->txBufferTail = (uart->txBufferTail + 1) % UART_BUFFER_SIZE;
-        uart->txBufferStart = uart->txBufferTail;
+        return -1;
     }
-    else
+    
+    // Allocate up front, so that failing leaves the uart as it was
+    unsigned char* rxBuffer = malloc(rxSize);
+    unsigned char* txBuffer = malloc(txSize);
+    if (!rxBuffer || !txBuffer)
     {
-        uart->txBuffer[uart->txBufferTail] = value;
-        uart->txBufferTail = (uart->txBufferTail + 1) % UART_BUFFER_SIZE;
-        uart->txBufferFull = (uart->txBufferStart == uart->txBufferTail);
+        free(rxBuffer);
+        free(txBuffer);
+        return -1;
     }
+    
+    sem_wait(&uart->rxBufferLock);
+    sem_wait(&uart->txBufferLock);
+    
+    int dropped = moveBuffer(&uart->rxBuffer, &uart->rxBufferSize, &uart->rxBufferStart,
+                             &uart->rxBufferTail, &uart->rxBufferFull, rxBuffer, rxSize);
+    dropped += moveBuffer(&uart->txBuffer, &uart->txBufferSize, &uart->txBufferStart,
+                          &uart->txBufferTail, &uart->txBufferFull, txBuffer, txSize);
+    statAdd(&uart->stats.bytesDropped, dropped);
+    
+    uart->overflowPolicy = policy;
+    
+    // A blocked sender may now have room, or no longer be meant to wait
+    signalTransferSpace(uart);
+    
     sem_post(&uart->txBufferLock);
+    sem_post(&uart->rxBufferLock);
+    return 0;
 }
 
-int min(int a, int b)
+// Adds a single byte to the transfer buffer to be sent out the UART
+// If the buffer is full, the overflow policy decides what happens (see gpioUartSend).
+void gpioUartSendByte(GpioUart* uart, unsigned char value)
 {
-    return (a < b) ? a : b;
+    gpioUartSend(uart, &value, 1);
 }
 
-// Adds up to n bytes from the given buffer to the transfer buffer to be sent out the UART.
-// Only adds up until the buffer is filled.
-// Returns the actual number of bytes added.
-int gpioUartSend(GpioUart* uart, unsigned char* buffer, size_t n)
+// Copies count bytes onto the tail of the transfer buffer, which must have room for them.
+// No locking is done here; the txBufferLock should already be held.
+void copyIntoTransferBuffer(GpioUart* uart, const unsigned char* buffer, int count)
 {
-    // Nothing to do if we are sending nothing...
-    if (n == 0)
+    if (count == 0)
     {
-        return 0;
+        return;
     }
     
-    sem_wait(&uart->txBufferLock);
+    // First copy over those bytes from the tail to the physical end of the buffer,
+    // then the remainder from the physical beginning
+    int bytesToCopy = min(count, uart->txBufferSize - uart->txBufferTail);
+    memcpy(uart->txBuffer + uart->txBufferTail, buffer, bytesToCopy);
+    memcpy(uart->txBuffer, buffer + bytesToCopy, count - bytesToCopy);
     
-    // Early opt-out if we are already full!
-    if (uart->txBufferStart == uart->txBufferTail && uart->txBufferFull)
+    uart->txBufferTail = (uart->txBufferTail + count) % uart->txBufferSize;
+    uart->txBufferFull = (uart->txBufferStart == uart->txBufferTail);
+}
+
+// Waits for the tx timer to signal that it has made room in the transfer buffer
+void waitForTransferSpace(GpioUart* uart)
+{
+    struct pollfd spacePoll;
+    spacePoll.fd = uart->txSpaceFd;
+    spacePoll.events = POLLIN;
+    if (poll(&spacePoll, 1, -1) == 1)
     {
-        sem_post(&uart->txBufferLock);
-        return 0;
+        uint64_t count;
+        // Another blocked sender may have taken the signal first, which is fine
+        if (read(uart->txSpaceFd, &count, sizeof(count)) != sizeof(count) && errno != EAGAIN)
+        {
+            fprintf(stderr, "GPIO UART warning: tx space wait failed: %s\n", strerror(errno));
+        }
     }
-    
-    if (uart->txBufferStart > uart->txBufferTail)
+}
+
+// Adds n bytes from the given buffer to the transfer buffer to be sent out the UART.
+// Once the buffer is full, GPIO_UART_DROP_OLDEST drops the oldest bytes still to be sent,
+// GPIO_UART_DROP_NEWEST drops the rest of the given bytes, and GPIO_UART_BLOCK waits
+// for the uart to send enough to make room for them.
+// Returns the number of given bytes that were not dropped by GPIO_UART_DROP_NEWEST,
+// which is n under the other policies, or -1 if the tx timer could not be scheduled to send them,
+// in which case any bytes already taken wait in the buffer for a later send to schedule it.
+int gpioUartSend(GpioUart* uart, unsigned char* buffer, size_t n)
+{
+    size_t bytesTaken = 0;
+    while (bytesTaken < n)
     {
-        // We have one section of the buffer to copy to, between the tail and the start
-        int bytesToCopy = min(n, uart->txBufferStart - uart->txBufferTail);
-        memcpy(uart->txBuffer + uart->txBufferTail, buffer, bytesToCopy);
-        
-        // Update tail
-        uart->txBufferTail += bytesToCopy;
-        
-        // And are we full now?
-        uart->txBufferFull = (uart->txBufferStart == uart->txBufferTail);
+        sem_wait(&uart->txBufferLock);
         
-        sem_post(&uart->txBufferLock);
-        return bytesToCopy;
-    }
-    else
-    {
-        // We have two sections of the buffer to copy to, from the tail to the end
-        // and from the beginning to the start
+        int room = uart->txBufferSize - transferBufferCount(uart);
+        int bytesToCopy = (n - bytesTaken < (size_t)room) ? (int)(n - bytesTaken) : room;
+        bool overflowing = ((size_t)bytesToCopy < n - bytesTaken);
         
-        // First copy over those bytes from the tail to the physical end of the buffer
-        int bytesToCopy = min(n, UART_BUFFER_SIZE - uart->txBufferTail);
-        memcpy(uart->txBuffer + uart->txBufferTail, buffer, bytesToCopy);
+        if (overflowing && uart->overflowPolicy == GPIO_UART_DROP_OLDEST)
+        {
+            statIncrement(&uart->stats.txOverflows);
+            
+            // Given bytes that could never all fit are as good as the oldest, so they go first
+            if (n - bytesTaken > (size_t)uart->txBufferSize)
+            {
+                size_t skipped = n - bytesTaken - uart->txBufferSize;
+                statAdd(&uart->stats.bytesDropped, skipped);
+                bytesTaken += skipped;
+            }
+            
+            // Then the oldest buffered bytes make room for the rest
+            int dropping = (int)(n - bytesTaken) - room;
+            uart->txBufferStart = (uart->txBufferStart + dropping) % uart->txBufferSize;
+            uart->txBufferFull = false;
+            statAdd(&uart->stats.bytesDropped, dropping);
+            bytesToCopy = n - bytesTaken;
+            overflowing = false;
+        }
+        else if (overflowing && uart->overflowPolicy == GPIO_UART_BLOCK && room == 0)
+        {
+            // Wait for the tx timer to make room, which it never will if it cannot be scheduled
+            uart->txSpaceWaiting = true;
+            sem_post(&uart->txBufferLock);
+            if (gpioSchedulerWake(&uart->txTimer))
+            {
+                return -1;
+            }
+            waitForTransferSpace(uart);
+            continue;
+        }
         
-        // Then copy the remainder of the bytes from the beginning of the buffer to the start index
-        int furtherBytesToCopy = min(n - bytesToCopy, uart->txBufferStart);
-        memcpy(uart->txBuffer, buffer + bytesToCopy, furtherBytesToCopy);
+        copyIntoTransferBuffer(uart, buffer + bytesTaken, bytesToCopy);
+        bytesTaken += bytesToCopy;
         
-        // Update tail
-        uart->txBufferTail = (uart->txBufferTail + bytesToCopy + furtherBytesToCopy) % UART_BUFFER_SIZE;
+        sem_post(&uart->txBufferLock);
         
-        // And are we full now?
-        uart->txBufferFull = (uart->txBufferStart == uart->txBufferTail);
+        // Have the transfering end start up again if it has gone idle
+        if (gpioSchedulerWake(&uart->txTimer))
+        {
+            return -1;
+        }
         
-        sem_post(&uart->txBufferLock);
-        return bytesToCopy + furtherBytesToCopy;
+        if (overflowing && uart->overflowPolicy == GPIO_UART_DROP_NEWEST)
+        {
+            statIncrement(&uart->stats.txOverflows);
+            statAdd(&uart->stats.bytesDropped, n - bytesTaken);
+            break;
+        }
     }
+    
+    return bytesTaken;
 }
 
 // Retrieves a single byte from the receive buffer, or returns -1 if it is currently empty
@@ -597,8 +897,9 @@ int gpioUartReceiveByte(GpioUart* uart)
     else
     {
         int value = uart->rxBuffer[uart->rxBufferStart];
-        uart->rxBufferStart = (uart->rxBufferStart + 1) % UART_BUFFER_SIZE;
+        uart->rxBufferStart = (uart->rxBufferStart + 1) % uart->rxBufferSize;
         uart->rxBufferFull = false;
+        consumeReceiveEvent(uart);
         
         sem_post(&uart->rxBufferLock);
         return value;
@@ -633,8 +934,9 @@ int gpioUartReceive(GpioUart* uart, unsigned char* buffer, size_t n)
             memcpy(buffer, uart->rxBuffer + uart->rxBufferStart, bytesToCopy);
             
             // And advance the buffer start, which cannot now be full any longer
-            uart->rxBufferStart = (uart->rxBufferStart + bytesToCopy) % UART_BUFFER_SIZE;
+            uart->rxBufferStart = (uart->rxBufferStart + bytesToCopy) % uart->rxBufferSize;
             uart->rxBufferFull = false;
+            consumeReceiveEvent(uart);
             
             sem_post(&uart->rxBufferLock);
             return bytesToCopy;
@@ -642,15 +944,16 @@ int gpioUartReceive(GpioUart* uart, unsigned char* buffer, size_t n)
         else
         {
             // If not, we first copy until the physical end of the buffer
-            int bytesToCopy = min(n, UART_BUFFER_SIZE - uart->rxBufferTail);
-            memcpy(buffer, uart->rxBuffer + uart->rxBufferTail, bytesToCopy);
+            int bytesToCopy = min(n, uart->rxBufferSize - uart->rxBufferStart);
+            memcpy(buffer, uart->rxBuffer + uart->rxBufferStart, bytesToCopy);
             
             // and then copy the remainder, from the physical beginning.
-            int furtherBytesToCopy = min(n - bytesToCopy, uart->rxBufferStart);
+            int furtherBytesToCopy = min(n - bytesToCopy, uart->rxBufferTail);
             memcpy(buffer + bytesToCopy, uart->rxBuffer, furtherBytesToCopy);
             
-            uart->rxBufferStart = (uart->rxBufferStart + bytesToCopy + furtherBytesToCopy) % UART_BUFFER_SIZE;
+            uart->rxBufferStart = (uart->rxBufferStart + bytesToCopy + furtherBytesToCopy) % uart->rxBufferSize;
             uart->rxBufferFull = false;
+            consumeReceiveEvent(uart);
             
             sem_post(&uart->rxBufferLock);
             return bytesToCopy + furtherBytesToCopy;
@@ -662,24 +965,125 @@ int gpioUartReceive(GpioUart* uart, unsigned char* buffer, size_t n)
 int gpioUartAvailable(GpioUart* uart)
 {
     sem_wait(&uart->rxBufferLock);
+    int count = receiveBufferCount(uart);
+    sem_post(&uart->rxBufferLock);
+    return count;
+}
+
+// Copies the uart's current statistics. This takes no locks and may be called at any time.
+void gpioUartGetStats(GpioUart* uart, GpioUartStats* stats)
+{
+    for (int i = 0; i < GPIO_LATENESS_BUCKETS; i++)
+    {
+        stats->latenessHistogram[i] = statRead(&uart->stats.latenessHistogram[i]);
+    }
+    stats->framesAccepted = statRead(&uart->stats.framesAccepted);
+    stats->framingErrors = statRead(&uart->stats.framingErrors);
+    stats->parityErrors = statRead(&uart->stats.parityErrors);
+    stats->rxOverflows = statRead(&uart->stats.rxOverflows);
+    stats->txOverflows = statRead(&uart->stats.txOverflows);
+    stats->bytesDropped = statRead(&uart->stats.bytesDropped);
+    stats->txBytes = statRead(&uart->stats.txBytes);
+    stats->txEdges = statRead(&uart->stats.txEdges);
+}
+
+// Returns a file descriptor that polls as readable (POLLIN) whenever received data is ready,
+// so that the uart may be multiplexed with other descriptors in poll, select or epoll.
+// The descriptor is owned by the uart and must not be read or closed by the caller.
+int gpioUartFd(GpioUart* uart)
+{
+    return uart->rxEventFd;
+}
+
+// Sets when the uart signals that received data is ready: once threshold bytes are buffered,
+// or once the rx line has been idle for idleBits bit times after a byte (0 for never).
+void gpioUartSetReceiveNotify(GpioUart* uart, int threshold, int idleBits)
+{
+    sem_wait(&uart->rxBufferLock);
+    uart->rxNotifyThreshold = (threshold < 1) ? 1 : threshold;
+    uart->rxNotifyIdleBits = (idleBits < 0) ? 0 : idleBits;
     
-    // Are we empty?
-    if (uart->rxBufferStart == uart->rxBufferTail && !uart->rxBufferFull)
+    // Data already waiting may satisfy the new threshold
+    if (receiveBufferCount(uart) >= uart->rxNotifyThreshold)
     {
-        sem_post(&uart->rxBufferLock);
-        return 0;
+        signalReceiveEvent(uart);
     }
-    else
+    sem_post(&uart->rxBufferLock);
+}
+
+// Sets how many times each received bit is sampled, and whether in one burst read per bit.
+// The rx timer is taken off the scheduler while the settings change, since its steps use them,
+// and put back on to start a new bit.
+// Returns 0 on success, non-zero if samplesPerBit is out of range or the rx timer could not be put back.
+int gpioUartSetSampling(GpioUart* uart, int samplesPerBit, bool burstReads)
+{
+    if (samplesPerBit < 1 || samplesPerBit > GPIO_UART_MAX_SAMPLES_PER_BIT)
     {
-        if (uart->rxBufferStart < uart->rxBufferTail)
+        return -1;
+    }
+    
+    // Once removed, the rx step is not running and will not run until the timer is back
+    gpioSchedulerRemove(&uart->rxTimer);
+    
+    uart->rxSamplesPerBit = samplesPerBit;
+    uart->rxBurstReads = burstReads;
+    // Samples of a bit taken at the old rate do not count toward the new one
+    uart->rxSampleOn = -1;
+    // The bit clock has to be found again from the edges the bursts see,
+    // starting from the high of an idle line
+    uart->rxBurstInPhase = false;
+    uart->rxLastSampleValue = true;
+    
+    return gpioSchedulerWake(&uart->rxTimer);
+}
+
+// Waits up to timeoutMilliseconds (or forever, if negative) for received data to be ready,
+// then receives up to n bytes into the given buffer like gpioUartReceive.
+// Returns the number of bytes received, 0 on timeout, or -1 on error.
+int gpioUartReceiveTimeout(GpioUart* uart, unsigned char* buffer, size_t n, int timeoutMilliseconds)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    // Whole seconds go straight to tv_sec, so the nanoseconds added fit in a 32-bit long
+    deadline.tv_sec += timeoutMilliseconds / 1000;
+    addTime(&deadline, (timeoutMilliseconds % 1000) * 1000000L);
+    
+    while (true)
+    {
+        // How long is left for us to wait?
+        int waitMilliseconds = -1;
+        if (timeoutMilliseconds >= 0)
         {
-            sem_post(&uart->rxBufferLock);
-            return uart->rxBufferTail - uart->rxBufferStart;
+            struct timespec currentTime;
+            clock_gettime(CLOCK_MONOTONIC, &currentTime);
+            int64_t nanosecondsLeft = (int64_t)(deadline.tv_sec - currentTime.tv_sec) * 1000000000 + (deadline.tv_nsec - currentTime.tv_nsec);
+            waitMilliseconds = (nanosecondsLeft > 0) ? (nanosecondsLeft + 999999) / 1000000 : 0;
         }
-        else
+        
+        struct pollfd rxPoll;
+        rxPoll.fd = uart->rxEventFd;
+        rxPoll.events = POLLIN;
+        int result = poll(&rxPoll, 1, waitMilliseconds);
+        if (result == -1)
         {
-            sem_post(&uart->rxBufferLock);
-            return UART_BUFFER_SIZE - uart->rxBufferTail + uart->rxBufferStart;
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        
+        if (result == 0)
+        {
+            // Timed out
+            return 0;
+        }
+        
+        // Another reader may have beaten us to the data, in which case we wait again
+        int received = gpioUartReceive(uart, buffer, n);
+        if (received > 0 || n == 0)
+        {
+            return received;
         }
     }
-}
\ No newline at end of file
+}
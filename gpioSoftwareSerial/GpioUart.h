@@ -1,15 +1,62 @@
 #include "GeneralPurposeIO.h"
-#include <pthread.h>
+#include "GpioUartScheduler.h"
 #include <semaphore.h>
 
 #ifndef GPIO_UART
 #define GPIO_UART
 
+// The size of each buffer, until set otherwise with gpioUartSetBuffers
 #define UART_BUFFER_SIZE 4096
 
+// The most times each received bit may be sampled
+#define GPIO_UART_MAX_SAMPLES_PER_BIT 32
+
+// How many times each received bit is sampled, until set otherwise with gpioUartSetSampling
+#define GPIO_UART_DEFAULT_SAMPLES_PER_BIT 2
+
+// What happens to a byte that arrives for a full buffer
+typedef enum
+{
+    // The oldest byte in the buffer is dropped to make room for it (the default)
+    GPIO_UART_DROP_OLDEST,
+    // The new byte is dropped
+    GPIO_UART_DROP_NEWEST,
+    // Senders wait until the uart has sent enough to make room.
+    // The rx line cannot be made to wait, so received bytes are dropped as with GPIO_UART_DROP_NEWEST.
+    GPIO_UART_BLOCK
+} GpioUartOverflowPolicy;
+
+// Counters of how well the uart is doing. They are kept up to date without any locking
+// and are read with gpioUartGetStats.
+typedef struct
+{
+    // How late the scheduler ran the uart's rx samples and tx bits (see GPIO_LATENESS_BUCKETS)
+    unsigned long latenessHistogram[GPIO_LATENESS_BUCKETS];
+    
+    // Received frames that were complete and correct
+    unsigned long framesAccepted;
+    // Received frames that began with a start bit but did not end with their stop bit(s)
+    unsigned long framingErrors;
+    // Received frames with good start and stop bits but the wrong parity
+    unsigned long parityErrors;
+    
+    // The number of times bytes arrived for a full buffer and some had to be dropped
+    // (a sender waiting under GPIO_UART_BLOCK is not an overflow)
+    unsigned long rxOverflows;
+    unsigned long txOverflows;
+    // The number of bytes lost to those overflows, and to shrinking the buffers
+    unsigned long bytesDropped;
+    
+    // Bytes sent, and the pin writes it took, one for each run of equal bits
+    unsigned long txBytes;
+    unsigned long txEdges;
+} GpioUartStats;
+
 // Structure that contains all the state that governs how the GPIO UART works
 typedef struct
 {
+    // The backend the pins are driven through
+    const GpioBackend* gpio;
     const char* rxPin;
     const char* txPin;
     
@@ -18,9 +65,13 @@ typedef struct
     bool parityBit;
     bool secondStopBit;
     
-    // We have two circular buffers for data
-    unsigned char rxBuffer[UART_BUFFER_SIZE];
-    unsigned char txBuffer[UART_BUFFER_SIZE];
+    // We have two circular buffers for data, allocated when the uart is started
+    unsigned char* rxBuffer;
+    unsigned char* txBuffer;
+    
+    // The number of bytes each buffer holds
+    int rxBufferSize;
+    int txBufferSize;
     
     // The index of the first byte of data in the buffer
     int rxBufferStart;
@@ -40,30 +91,105 @@ typedef struct
     sem_t rxBufferLock;
     sem_t txBufferLock;
     
-    pthread_t rxThread;
-    pthread_t txThread;
+    // What happens when either buffer is full, changed under both locks
+    GpioUartOverflowPolicy overflowPolicy;
+    
+    // An eventfd signaled when the tx timer makes room for a sender blocked on a full buffer
+    int txSpaceFd;
+    // Whether a sender is blocked waiting for txSpaceFd
+    bool txSpaceWaiting;
+    
+    // An eventfd that becomes readable when received data is ready for the application
+    int rxEventFd;
+    
+    // The number of buffered bytes at which the rx event is signaled (default 1)
+    int rxNotifyThreshold;
+    // The number of idle bit times after the last received byte at which the rx event is signaled
+    // even if the threshold has not been reached. Zero disables the idle gap (default 0).
+    int rxNotifyIdleBits;
+    // Whether the rx event has been signaled and not yet consumed by a reader
+    bool rxEventSignaled;
     
-    // A flag that tells the threads whether they should continue to execute
-    bool shouldExecute;
+    // How many times each received bit is sampled,
+    // and whether those samples are all taken in one burst read (see gpioUartSetSampling)
+    int rxSamplesPerBit;
+    bool rxBurstReads;
     
+    // Timers that run the receiving and transfering ends on the shared scheduler thread.
+    // Each step of the rx timer takes a single sample of the rx pin (or a burst of them),
+    // and each step of the tx timer sets the tx pin for a run of equal bits.
+    GpioTimer rxTimer;
+    GpioTimer txTimer;
+    
+    // Receive state, kept between samples
+    // The sample being taken within the current bit
+    int rxSampleOn;
+    // The value of the first and the most recent samples of the current bit
+    bool rxFirstSampleValue;
+    bool rxLastSampleValue;
+    // The number of consecutive samples with the first value, and then with the opposite value
+    int rxConsecutiveFirstSamples;
+    int rxConsecutiveSecondSamples;
+    // Whether the bursts have been lined up with the bits, by an edge seen among their samples
+    // or by sliding clear of the first edge that fell between them
+    bool rxBurstInPhase;
+    // Bits are shifted into this buffer from bit 9 (or 10) to the right to find frames in them
+    int rxBitBuffer;
+    // The number of bits shifted into the buffer so far.
+    int rxBitBufferCount;
+    // The number of bits read since the last complete byte, for idle gap detection.
+    int rxIdleBitCount;
+    
+    // Updated with statIncrement as things happen
+    GpioUartStats stats;
+    
+    // Transfer state, kept between runs of bits
+    // The frame being sent, least significant (first sent) bit first, stop bit(s) included
+    int txFrame;
+    // The number of bits in the frame, and the number already sent
+    int txFrameSize;
+    int txFrameBitOn;
+
 } GpioUart;
 
 // Starts the GPIO UART operation on the given pins at the given baud rate
-// by starting up two threads to manage the receiving and transfering ends
-// and setting up related resources.
+// through the fastest gpio backend on the host (see gpioBackendFastest), like gpioUartStartOn.
+// Returns 0 on success, non-zero on failure.
+int gpioUartStart(GpioUart* uart, const char* rxPin, const char* txPin, int baudRate, const GpioTimingProfile* profile);
+
+// Starts the GPIO UART operation on the given pins at the given baud rate
+// by opening the pins through the given gpio backend and adding the receiving
+// and transfering ends to the scheduler thread shared by all uarts, and setting up related resources.
+// The scheduler runs on the clock of the backend from then on (see gpioUseClock),
+// so uarts on the simulator cannot run alongside uarts on real pins.
+// If profile is not NULL, the shared scheduler thread is run with it from then on
+// (see GpioTimingProfile); otherwise the thread keeps whatever profile it has.
 // Returns 0 on success, non-zero on failure.
-int gpioUartStart(GpioUart* uart, const char* rxPin, const char* txPin, int baudRate);
+int gpioUartStartOn(GpioUart* uart, const GpioBackend* gpio, const char* rxPin, const char* txPin, int baudRate,
+                    const GpioTimingProfile* profile);
 
-// Stops the GPIO UART operation by requesting the management threads to end
-// and releasing related resources. Waits on the threads to die.
-// The same structure may still be started again with gpioUartStart.
+// Stops the GPIO UART operation by removing it from the scheduler thread
+// and releasing related resources.
+// The same structure may still be started again with gpioUartStart or gpioUartStartOn.
 void gpioUartStop(GpioUart* uart);
 
+// Resizes the receive and transfer buffers of a started uart to rxSize and txSize bytes
+// and sets what happens when either is full. Buffered data is kept, except for the newest
+// bytes that no longer fit in a smaller buffer, which are counted as dropped.
+// Returns 0 on success, non-zero if a size is not positive or the buffers cannot be allocated.
+int gpioUartSetBuffers(GpioUart* uart, int rxSize, int txSize, GpioUartOverflowPolicy policy);
+
 // Adds a single byte to the transfer buffer to be sent out the UART
-// If the buffer is full, the oldest value is removed.
+// If the buffer is full, the overflow policy decides what happens (see gpioUartSend).
 void gpioUartSendByte(GpioUart* uart, unsigned char value);
 
-// Adds n bytes from the given buffer to the transfer buffer to be sent out the UART
+// Adds n bytes from the given buffer to the transfer buffer to be sent out the UART.
+// Once the buffer is full, GPIO_UART_DROP_OLDEST drops the oldest bytes still to be sent,
+// GPIO_UART_DROP_NEWEST drops the rest of the given bytes, and GPIO_UART_BLOCK waits
+// for the uart to send enough to make room for them.
+// Returns the number of given bytes that were not dropped by GPIO_UART_DROP_NEWEST,
+// which is n under the other policies, or -1 if the tx timer could not be scheduled to send them,
+// in which case any bytes already taken wait in the buffer for a later send to schedule it.
 int gpioUartSend(GpioUart* uart, unsigned char* buffer, size_t n);
 
 // Retrieves a single byte from the receive buffer, or returns -1 if it is currently empty
@@ -76,4 +202,32 @@ int gpioUartReceive(GpioUart* uart, unsigned char* buffer, size_t n);
 // Returns the number of bytes currently available in the receive buffer.
 int gpioUartAvailable(GpioUart* uart);
 
+// Copies the uart's current statistics. This takes no locks and may be called at any time.
+void gpioUartGetStats(GpioUart* uart, GpioUartStats* stats);
+
+// Returns a file descriptor that polls as readable (POLLIN) whenever received data is ready,
+// so that the uart may be multiplexed with other descriptors in poll, select or epoll.
+// The descriptor is owned by the uart and must not be read or closed by the caller.
+int gpioUartFd(GpioUart* uart);
+
+// Sets when the uart signals that received data is ready: once threshold bytes are buffered,
+// or once the rx line has been idle for idleBits bit times after a byte (0 for never).
+void gpioUartSetReceiveNotify(GpioUart* uart, int threshold, int idleBits);
+
+// Sets how many times each received bit is sampled, from 1 to GPIO_UART_MAX_SAMPLES_PER_BIT.
+// More samples take more cpu time, but ride out more noise on the line.
+// With burstReads, each bit is read in one burst of samples across the middle quarter of the bit,
+// which are majority-voted, and an edge among them re-aligns the bit clock. Otherwise each sample
+// is a step of the scheduler. Backends that cannot read in bursts (sysfs) fall back to the latter.
+// The first frame after bursts begin may be lost while the bit clock is found, as may a frame
+// being received when the settings change.
+// The uart must be started, and this must not be called from within a timer step.
+// Returns 0 on success, non-zero if samplesPerBit is out of range or the rx timer could not be put back.
+int gpioUartSetSampling(GpioUart* uart, int samplesPerBit, bool burstReads);
+
+// Waits up to timeoutMilliseconds (or forever, if negative) for received data to be ready,
+// then receives up to n bytes into the given buffer like gpioUartReceive.
+// Returns the number of bytes received, 0 on timeout, or -1 on error.
+int gpioUartReceiveTimeout(GpioUart* uart, unsigned char* buffer, size_t n, int timeoutMilliseconds);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,593 @@
+#define _GNU_SOURCE
+
+#include "GpioUartScheduler.h"
+#include "GeneralPurposeIO.h"
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+// All of the timers for all of the uart channels are kept in a single min-heap
+// ordered by deadline, and are served by a single thread. Every time the thread
+// wakes up it runs all the timers that are due, so channels with the same baud rate
+// share their wake-ups instead of each thread paying for its own.
+typedef struct
+{
+    // The heap itself, with the earliest deadline at index 0
+    GpioTimer* heap[GPIO_SCHEDULER_MAX_TIMERS];
+    int count;
+    
+    // Guards the heap, and is held while timer steps run
+    pthread_mutex_t lock;
+    
+    // Signalled when the earliest deadline moves sooner, or the thread should stop,
+    // to cut short a sleep on CLOCK_MONOTONIC
+    pthread_cond_t wakeUp;
+    
+    pthread_t thread;
+    
+    // The number of users (uart channels) of the scheduler
+    int users;
+    
+    // A flag that tells the thread whether it should continue to execute
+    bool shouldExecute;
+    
+    // How close to a deadline the thread stops sleeping and starts spin-waiting
+    long spinNanoseconds;
+} GpioScheduler;
+
+static GpioScheduler scheduler = {
+    .count = 0,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .users = 0,
+    .shouldExecute = false,
+    .spinNanoseconds = 0
+};
+
+// Serializes starting and stopping the scheduler thread
+static pthread_mutex_t lifetimeLock = PTHREAD_MUTEX_INITIALIZER;
+
+void addTime(struct timespec* time, long nanoseconds)
+{
+    time->tv_nsec += nanoseconds;
+    if (time->tv_nsec < 0)
+    {
+        time->tv_sec += time->tv_nsec / 1000000000L - 1;
+        time->tv_nsec %= 1000000000L;
+        time->tv_nsec += 1000000000L;
+    }
+    else if (time->tv_nsec >= 1000000000L)
+    {
+        time->tv_sec += time->tv_nsec / 1000000000L;
+        time->tv_nsec %= 1000000000L;
+    }
+}
+
+int64_t timeDifference(const struct timespec* currentTime, const struct timespec* oldTime)
+{
+    return  ((int64_t)(currentTime->tv_sec - oldTime->tv_sec) * 1000000000 +
+             (currentTime->tv_nsec - oldTime->tv_nsec));
+}
+
+int timeCompare(const struct timespec* a, const struct timespec* b)
+{
+    if (a->tv_sec != b->tv_sec)
+    {
+        return (a->tv_sec < b->tv_sec) ? -1 : 1;
+    }
+    if (a->tv_nsec != b->tv_nsec)
+    {
+        return (a->tv_nsec < b->tv_nsec) ? -1 : 1;
+    }
+    return 0;
+}
+
+void gpioTimerInit(GpioTimer* timer, bool (*step)(GpioTimer* timer), void* context)
+{
+    timer->deadline.tv_sec = 0;
+    timer->deadline.tv_nsec = 0;
+    timer->step = step;
+    timer->context = context;
+    timer->latenessHistogram = NULL;
+    timer->heapIndex = -1;
+}
+
+// Counts how late the timer is being run at the given time in its histogram
+static void countLateness(GpioTimer* timer, const struct timespec* currentTime)
+{
+    int64_t lateness = timeDifference(currentTime, &timer->deadline);
+    int bucket = 0;
+    if (lateness > 0)
+    {
+        // The number of significant bits is the log2 bucket
+        bucket = 64 - __builtin_clzll((unsigned long long)lateness);
+        if (bucket >= GPIO_LATENESS_BUCKETS)
+        {
+            bucket = GPIO_LATENESS_BUCKETS - 1;
+        }
+    }
+    statIncrement(&timer->latenessHistogram[bucket]);
+}
+
+// Places the timer at the heap index and records the index in the timer
+static void heapSet(int index, GpioTimer* timer)
+{
+    scheduler.heap[index] = timer;
+    timer->heapIndex = index;
+}
+
+// Moves the timer at index towards the root until its parent is earlier
+static void heapSiftUp(int index)
+{
+    GpioTimer* timer = scheduler.heap[index];
+    while (index > 0)
+    {
+        int parent = (index - 1) / 2;
+        if (timeCompare(&scheduler.heap[parent]->deadline, &timer->deadline) <= 0)
+        {
+            break;
+        }
+        heapSet(index, scheduler.heap[parent]);
+        index = parent;
+    }
+    heapSet(index, timer);
+}
+
+// Moves the timer at index towards the leaves until its children are later
+static void heapSiftDown(int index)
+{
+    GpioTimer* timer = scheduler.heap[index];
+    while (true)
+    {
+        int child = 2 * index + 1;
+        if (child >= scheduler.count)
+        {
+            break;
+        }
+        // Pick the earlier of the two children
+        if (child + 1 < scheduler.count &&
+            timeCompare(&scheduler.heap[child + 1]->deadline, &scheduler.heap[child]->deadline) < 0)
+        {
+            child++;
+        }
+        if (timeCompare(&timer->deadline, &scheduler.heap[child]->deadline) <= 0)
+        {
+            break;
+        }
+        heapSet(index, scheduler.heap[child]);
+        index = child;
+    }
+    heapSet(index, timer);
+}
+
+// Removes the timer at index from the heap
+static void heapRemoveAt(int index)
+{
+    GpioTimer* removed = scheduler.heap[index];
+    scheduler.count--;
+    if (index != scheduler.count)
+    {
+        // Fill the hole with the last timer and let it find its place
+        GpioTimer* moved = scheduler.heap[scheduler.count];
+        heapSet(index, moved);
+        heapSiftDown(index);
+        heapSiftUp(moved->heapIndex);
+    }
+    removed->heapIndex = -1;
+}
+
+// Sleeps until the given absolute time.
+// Since the operating system cannot get back to us quickly enough when we use something
+// like clock_nanosleep and can get to us up to a few milliseconds late on a busy host,
+// we may instead sleep only until spinNanoseconds before the time, and spin-wait the rest.
+// Time is kept by the gpio clock, so that simulated pins can run on simulated time.
+static void waitUntil(const struct timespec* time, long spinNanoseconds)
+{
+    struct timespec sleepTime = *time;
+    addTime(&sleepTime, -spinNanoseconds);
+    
+    // We use an absolute sleep end-time to ensure error does not accumulate
+    int errorValue = gpioClockSleepUntil(&sleepTime);
+    if (errorValue)
+    {
+        fprintf(stderr, "GPIO UART warning: sleep failed or was interrupted: %s\n", strerror(errorValue));
+    }
+    
+    // Then using the spin-wait for precision
+    if (spinNanoseconds > 0)
+    {
+        struct timespec actualTime;
+        do
+        {
+            gpioClockNow(&actualTime);
+        } while (timeCompare(&actualTime, time) < 0);
+    }
+}
+
+// Applies the profile to the given thread
+// Returns 0 on success, or an error number on failure.
+static int applyTimingProfile(pthread_t thread, const GpioTimingProfile* profile)
+{
+    if (profile->lockMemory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        int errorValue = errno;
+        fprintf(stderr, "GPIO UART warning: failed to lock memory: %s\n", strerror(errorValue));
+        return errorValue;
+    }
+    
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    if (profile->cpu >= 0)
+    {
+        CPU_SET(profile->cpu, &cpus);
+    }
+    else
+    {
+        // Any cpu we are allowed to run on at all
+        sched_getaffinity(0, sizeof(cpus), &cpus);
+    }
+    int errorValue = pthread_setaffinity_np(thread, sizeof(cpus), &cpus);
+    if (errorValue)
+    {
+        fprintf(stderr, "GPIO UART warning: failed to pin to cpu %d: %s\n", profile->cpu, strerror(errorValue));
+        return errorValue;
+    }
+    
+    struct sched_param parameters;
+    memset(&parameters, 0, sizeof(parameters));
+    parameters.sched_priority = profile->realtimePriority;
+    errorValue = pthread_setschedparam(thread, (profile->realtimePriority > 0) ? SCHED_FIFO : SCHED_OTHER, &parameters);
+    if (errorValue)
+    {
+        fprintf(stderr, "GPIO UART warning: failed to set priority %d: %s\n", profile->realtimePriority, strerror(errorValue));
+        return errorValue;
+    }
+    
+    return 0;
+}
+
+// Signals the thread if the timer just scheduled is now the first due
+static void wakeIfEarliest(GpioTimer* timer)
+{
+    if (timer->heapIndex == 0)
+    {
+        pthread_cond_signal(&scheduler.wakeUp);
+    }
+}
+
+// Sleeps like waitUntil, but with the scheduler lock held, and returns early if woken.
+// Only a sleep on CLOCK_MONOTONIC can be woken, which is the clock of every backend for
+// real pins; the others sleep at most GPIO_SCHEDULER_MAX_SLEEP_NANOSECONDS at a time instead.
+static void schedulerWaitUntil(const struct timespec* time, long spinNanoseconds)
+{
+    if (gpioClockIsMonotonic())
+    {
+        struct timespec sleepTime = *time;
+        addTime(&sleepTime, -spinNanoseconds);
+        if (pthread_cond_timedwait(&scheduler.wakeUp, &scheduler.lock, &sleepTime) != ETIMEDOUT || spinNanoseconds == 0)
+        {
+            return;
+        }
+    }
+    
+    pthread_mutex_unlock(&scheduler.lock);
+    waitUntil(time, spinNanoseconds);
+    pthread_mutex_lock(&scheduler.lock);
+}
+
+static void* gpioSchedulerMain(void* arg)
+{
+    pthread_mutex_lock(&scheduler.lock);
+    
+    while (scheduler.shouldExecute)
+    {
+        struct timespec currentTime;
+        gpioClockNow(&currentTime);
+        
+        if (scheduler.count == 0 || timeCompare(&scheduler.heap[0]->deadline, &currentTime) > 0)
+        {
+            // Nothing is due yet, so sleep until something is, but not so long
+            // that newly added timers are left waiting if they cannot wake us.
+            // Only waits for real deadlines are worth spinning for,
+            // and waits too short to sleep for are spun all the way.
+            struct timespec wakeTime = currentTime;
+            addTime(&wakeTime, GPIO_SCHEDULER_MAX_SLEEP_NANOSECONDS);
+            long spinNanoseconds = 0;
+            if (scheduler.count > 0 && timeCompare(&scheduler.heap[0]->deadline, &wakeTime) < 0)
+            {
+                wakeTime = scheduler.heap[0]->deadline;
+                spinNanoseconds = scheduler.spinNanoseconds;
+                if (timeDifference(&wakeTime, &currentTime) <= GPIO_SCHEDULER_BATCH_NANOSECONDS)
+                {
+                    spinNanoseconds = GPIO_SCHEDULER_BATCH_NANOSECONDS;
+                }
+            }
+            
+            schedulerWaitUntil(&wakeTime, spinNanoseconds);
+            continue;
+        }
+        
+        // Run every timer that is due. A timer that is behind
+        // may well run again in this same wake-up to catch up.
+        while (scheduler.count > 0 && timeCompare(&scheduler.heap[0]->deadline, &currentTime) <= 0)
+        {
+            GpioTimer* timer = scheduler.heap[0];
+            if (timer->latenessHistogram)
+            {
+                countLateness(timer, &currentTime);
+            }
+            if (timer->step(timer))
+            {
+                heapSiftDown(0);
+            }
+            else
+            {
+                heapRemoveAt(0);
+            }
+        }
+    }
+    
+    pthread_mutex_unlock(&scheduler.lock);
+    return NULL;
+}
+
+int gpioSchedulerAcquire(const GpioTimingProfile* profile)
+{
+    pthread_mutex_lock(&lifetimeLock);
+    if (scheduler.users == 0)
+    {
+        // Deadlines are on CLOCK_MONOTONIC whenever the condition is waited on
+        pthread_condattr_t wakeUpAttributes;
+        pthread_condattr_init(&wakeUpAttributes);
+        pthread_condattr_setclock(&wakeUpAttributes, CLOCK_MONOTONIC);
+        pthread_cond_init(&scheduler.wakeUp, &wakeUpAttributes);
+        pthread_condattr_destroy(&wakeUpAttributes);
+        
+        scheduler.shouldExecute = true;
+        if (pthread_create(&scheduler.thread, NULL, &gpioSchedulerMain, NULL) != 0)
+        {
+            scheduler.shouldExecute = false;
+            pthread_cond_destroy(&scheduler.wakeUp);
+            pthread_mutex_unlock(&lifetimeLock);
+            return -1;
+        }
+    }
+    
+    if (profile)
+    {
+        if (applyTimingProfile(scheduler.thread, profile) != 0)
+        {
+            // Let the thread go again if it was only started for us
+            if (scheduler.users == 0)
+            {
+                pthread_mutex_lock(&scheduler.lock);
+                scheduler.shouldExecute = false;
+                pthread_cond_signal(&scheduler.wakeUp);
+                pthread_mutex_unlock(&scheduler.lock);
+                pthread_join(scheduler.thread, NULL);
+                pthread_cond_destroy(&scheduler.wakeUp);
+            }
+            pthread_mutex_unlock(&lifetimeLock);
+            return -1;
+        }
+        
+        pthread_mutex_lock(&scheduler.lock);
+        scheduler.spinNanoseconds = profile->spinNanoseconds;
+        pthread_mutex_unlock(&scheduler.lock);
+    }
+    scheduler.users++;
+    pthread_mutex_unlock(&lifetimeLock);
+    return 0;
+}
+
+void gpioSchedulerRelease(void)
+{
+    pthread_mutex_lock(&lifetimeLock);
+    scheduler.users--;
+    if (scheduler.users == 0)
+    {
+        pthread_mutex_lock(&scheduler.lock);
+        scheduler.shouldExecute = false;
+        pthread_cond_signal(&scheduler.wakeUp);
+        pthread_mutex_unlock(&scheduler.lock);
+        
+        pthread_join(scheduler.thread, NULL);
+        pthread_cond_destroy(&scheduler.wakeUp);
+    }
+    pthread_mutex_unlock(&lifetimeLock);
+}
+
+int gpioSchedulerAdd(GpioTimer* timer)
+{
+    pthread_mutex_lock(&scheduler.lock);
+    if (timer->heapIndex == -1)
+    {
+        if (scheduler.count == GPIO_SCHEDULER_MAX_TIMERS)
+        {
+            pthread_mutex_unlock(&scheduler.lock);
+            return -1;
+        }
+        heapSet(scheduler.count, timer);
+        scheduler.count++;
+        heapSiftUp(timer->heapIndex);
+        wakeIfEarliest(timer);
+    }
+    pthread_mutex_unlock(&scheduler.lock);
+    return 0;
+}
+
+int gpioSchedulerWake(GpioTimer* timer)
+{
+    pthread_mutex_lock(&scheduler.lock);
+    if (timer->heapIndex == -1)
+    {
+        if (scheduler.count == GPIO_SCHEDULER_MAX_TIMERS)
+        {
+            pthread_mutex_unlock(&scheduler.lock);
+            return -1;
+        }
+        
+        // Do not try to catch up on time that passed while unscheduled
+        struct timespec currentTime;
+        gpioClockNow(&currentTime);
+        if (timeCompare(&timer->deadline, &currentTime) < 0)
+        {
+            timer->deadline = currentTime;
+        }
+        
+        heapSet(scheduler.count, timer);
+        scheduler.count++;
+        heapSiftUp(timer->heapIndex);
+        wakeIfEarliest(timer);
+    }
+    pthread_mutex_unlock(&scheduler.lock);
+    return 0;
+}
+
+void gpioSchedulerRemove(GpioTimer* timer)
+{
+    pthread_mutex_lock(&scheduler.lock);
+    if (timer->heapIndex != -1)
+    {
+        heapRemoveAt(timer->heapIndex);
+    }
+    pthread_mutex_unlock(&scheduler.lock);
+}
+
+// What a timing measurement thread is given to work with
+typedef struct
+{
+    long periodNanoseconds;
+    long spinNanoseconds;
+    int wakeUps;
+    // How late each wake-up was
+    long* lateness;
+    // The cpu time used by the thread, and the wall time it took
+    int64_t cpuNanoseconds;
+    int64_t wallNanoseconds;
+} TimingMeasurement;
+
+static void* gpioTimingMeasureMain(void* arg)
+{
+    TimingMeasurement* measurement = (TimingMeasurement*)arg;
+    
+    struct timespec startTime;
+    struct timespec startCpuTime;
+    gpioClockNow(&startTime);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &startCpuTime);
+    
+    // Wait on deadlines just like the scheduler does
+    struct timespec deadline = startTime;
+    struct timespec actualTime;
+    for (int i = 0; i < measurement->wakeUps; i++)
+    {
+        addTime(&deadline, measurement->periodNanoseconds);
+        waitUntil(&deadline, measurement->spinNanoseconds);
+        gpioClockNow(&actualTime);
+        measurement->lateness[i] = timeDifference(&actualTime, &deadline);
+    }
+    
+    struct timespec endCpuTime;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &endCpuTime);
+    measurement->cpuNanoseconds = timeDifference(&endCpuTime, &startCpuTime);
+    measurement->wallNanoseconds = timeDifference(&actualTime, &startTime);
+    return NULL;
+}
+
+static int compareLong(const void* a, const void* b)
+{
+    long first = *(const long*)a;
+    long second = *(const long*)b;
+    return (first > second) - (first < second);
+}
+
+// Measures how late a thread run with the given profile wakes up when it waits for deadlines
+// periodNanoseconds apart, over the given number of wake-ups, and fills in the report.
+// Returns 0 on success, or non-zero if the profile could not be applied or measured.
+int gpioTimingMeasure(const GpioTimingProfile* profile, long periodNanoseconds, int wakeUps, GpioTimingReport* report)
+{
+    if (wakeUps <= 0)
+    {
+        return -1;
+    }
+    
+    TimingMeasurement measurement;
+    measurement.periodNanoseconds = periodNanoseconds;
+    measurement.spinNanoseconds = profile->spinNanoseconds;
+    measurement.wakeUps = wakeUps;
+    measurement.lateness = malloc(sizeof(long) * wakeUps);
+    if (!measurement.lateness)
+    {
+        return -1;
+    }
+    
+    // The profile is given through the thread attributes,
+    // so that it is in effect from the very first wake-up.
+    pthread_t thread;
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setinheritsched(&attributes, PTHREAD_EXPLICIT_SCHED);
+    struct sched_param parameters;
+    memset(&parameters, 0, sizeof(parameters));
+    parameters.sched_priority = profile->realtimePriority;
+    pthread_attr_setschedpolicy(&attributes, (profile->realtimePriority > 0) ? SCHED_FIFO : SCHED_OTHER);
+    pthread_attr_setschedparam(&attributes, &parameters);
+    if (profile->cpu >= 0)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(profile->cpu, &cpus);
+        pthread_attr_setaffinity_np(&attributes, sizeof(cpus), &cpus);
+    }
+    
+    if (profile->lockMemory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        perror("GPIO UART warning: failed to lock memory");
+        pthread_attr_destroy(&attributes);
+        free(measurement.lateness);
+        return -1;
+    }
+    
+    int errorValue = pthread_create(&thread, &attributes, &gpioTimingMeasureMain, &measurement);
+    pthread_attr_destroy(&attributes);
+    if (errorValue)
+    {
+        fprintf(stderr, "GPIO UART warning: failed to start timing measurement: %s\n", strerror(errorValue));
+        if (profile->lockMemory)
+        {
+            munlockall();
+        }
+        free(measurement.lateness);
+        return -1;
+    }
+    pthread_join(thread, NULL);
+    
+    if (profile->lockMemory)
+    {
+        munlockall();
+    }
+    
+    // Work out the statistics from the sorted latenesses
+    qsort(measurement.lateness, wakeUps, sizeof(long), &compareLong);
+    int64_t total = 0;
+    for (int i = 0; i < wakeUps; i++)
+    {
+        total += measurement.lateness[i];
+    }
+    report->meanLatenessNanoseconds = total / wakeUps;
+    report->medianLatenessNanoseconds = measurement.lateness[wakeUps / 2];
+    report->p99LatenessNanoseconds = measurement.lateness[(long)wakeUps * 99 / 100];
+    report->p999LatenessNanoseconds = measurement.lateness[(long)wakeUps * 999 / 1000];
+    report->maxLatenessNanoseconds = measurement.lateness[wakeUps - 1];
+    report->cpuPercent = (measurement.wallNanoseconds > 0) ? (int)(measurement.cpuNanoseconds * 100 / measurement.wallNanoseconds) : 0;
+    
+    // A bit lasts four times the lateness we can tolerate
+    long tolerableLateness = (report->p999LatenessNanoseconds > 1) ? report->p999LatenessNanoseconds : 1;
+    report->achievableBaudRate = 1000000000L / (tolerableLateness * 4);
+    
+    free(measurement.lateness);
+    return 0;
+}
@@ -0,0 +1,145 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifndef GPIO_UART_SCHEDULER
+#define GPIO_UART_SCHEDULER
+
+// The most timers that may be scheduled at once.
+// Each GPIO UART channel uses two: one for rx and one for tx.
+#define GPIO_SCHEDULER_MAX_TIMERS 64
+
+// Deadlines closer than this many nanoseconds are spin-waited for instead of slept for,
+// so timers due close together are run in the same wake-up, each at its own deadline
+#define GPIO_SCHEDULER_BATCH_NANOSECONDS 5000L
+
+// The longest the scheduler thread sleeps before checking for newly added timers,
+// on clocks other than CLOCK_MONOTONIC, where adding a timer cannot wake it up early
+#define GPIO_SCHEDULER_MAX_SLEEP_NANOSECONDS 1000000L
+
+// How the scheduler thread is run to get the most precise timing out of the host.
+// A zeroed profile (with cpu -1) is the operating system default.
+typedef struct
+{
+    // SCHED_FIFO priority (1 to 99) for the scheduler thread, or 0 for normal scheduling
+    int realtimePriority;
+    
+    // The cpu to pin the scheduler thread to, or -1 to let it run on any cpu
+    int cpu;
+    
+    // Whether to lock all the memory of the process with mlockall,
+    // so that page faults never delay the scheduler thread
+    bool lockMemory;
+    
+    // The scheduler sleeps until this many nanoseconds before a deadline and then spin-waits
+    // the rest of the way, trading cpu time for precision. 0 sleeps all the way.
+    long spinNanoseconds;
+} GpioTimingProfile;
+
+// The results of measuring how late a timing profile wakes up on this host
+typedef struct
+{
+    long meanLatenessNanoseconds;
+    long medianLatenessNanoseconds;
+    long p99LatenessNanoseconds;
+    long p999LatenessNanoseconds;
+    long maxLatenessNanoseconds;
+    
+    // The percentage of the measurement the thread spent running on a cpu
+    int cpuPercent;
+    
+    // The highest baud rate at which 99.9% of wake-ups land within a quarter of a bit
+    long achievableBaudRate;
+} GpioTimingReport;
+
+// The number of buckets in a lateness histogram. Bucket 0 counts timers run on time (or early),
+// and bucket k counts those run from 2^(k-1) up to 2^k nanoseconds late.
+// The last bucket also counts anything later than that.
+#define GPIO_LATENESS_BUCKETS 32
+
+typedef struct GpioTimer GpioTimer;
+
+// A recurring timed task run by the shared scheduler thread.
+struct GpioTimer
+{
+    // When step should next be called
+    struct timespec deadline;
+    
+    // Called from the scheduler thread once the deadline has passed.
+    // It should move the deadline forward and return true to stay scheduled,
+    // or return false to be removed from the scheduler.
+    bool (*step)(GpioTimer* timer);
+    
+    // For use by the owner of the timer
+    void* context;
+    
+    // If not NULL, the scheduler counts how late each step runs into this histogram
+    // of GPIO_LATENESS_BUCKETS buckets.
+    unsigned long* latenessHistogram;
+    
+    // Position in the scheduler's heap, or -1 if not scheduled. Used by the scheduler only.
+    int heapIndex;
+};
+
+// Adds nanoseconds (which may be negative) to the given time
+void addTime(struct timespec* time, long nanoseconds);
+
+// Returns the number of nanoseconds from oldTime to currentTime,
+// which needs 64 bits once they are more than about 2 seconds apart
+int64_t timeDifference(const struct timespec* currentTime, const struct timespec* oldTime);
+
+// Returns negative, zero or positive as a is before, the same as or after b
+int timeCompare(const struct timespec* a, const struct timespec* b);
+
+// Adds one to a statistics counter without any locking.
+// Readers on other threads see either the old or the new value.
+static inline void statIncrement(unsigned long* counter)
+{
+    __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+}
+
+// Adds amount to a statistics counter, like statIncrement
+static inline void statAdd(unsigned long* counter, unsigned long amount)
+{
+    __atomic_fetch_add(counter, amount, __ATOMIC_RELAXED);
+}
+
+// Reads a statistics counter written with statIncrement
+static inline unsigned long statRead(const unsigned long* counter)
+{
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+// Initializes a timer that is not yet scheduled
+void gpioTimerInit(GpioTimer* timer, bool (*step)(GpioTimer* timer), void* context);
+
+// Registers a user of the shared scheduler, starting its thread for the first user.
+// If profile is not NULL, it is applied to the scheduler thread, replacing any profile
+// given by earlier users.
+// Returns 0 on success, non-zero on failure.
+int gpioSchedulerAcquire(const GpioTimingProfile* profile);
+
+// Unregisters a user of the shared scheduler, stopping its thread after the last user.
+// All of the user's timers must already be removed.
+void gpioSchedulerRelease(void);
+
+// Schedules the timer at its deadline. Does nothing if it is already scheduled.
+// Must not be called from within a timer step.
+// Returns 0 on success, non-zero if there is no room for the timer.
+int gpioSchedulerAdd(GpioTimer* timer);
+
+// Schedules the timer at its deadline or now, whichever is later,
+// if it is not already scheduled. Must not be called from within a timer step.
+// Returns 0 on success, non-zero if there is no room for the timer.
+int gpioSchedulerWake(GpioTimer* timer);
+
+// Unschedules the timer. Once this returns, its step is not running and will not be called again.
+// Must not be called from within a timer step.
+void gpioSchedulerRemove(GpioTimer* timer);
+
+// Measures how late a thread run with the given profile wakes up when it waits for deadlines
+// periodNanoseconds apart, over the given number of wake-ups, and fills in the report.
+// Returns 0 on success, or non-zero if the profile could not be applied or measured.
+int gpioTimingMeasure(const GpioTimingProfile* profile, long periodNanoseconds, int wakeUps, GpioTimingReport* report);
+
+#endif
@@ -0,0 +1,199 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "GpioUart.h"
+#include "GeneralPurposeIOSim.h"
+
+// The number of bytes sent before waiting for them to come back
+#define SOAK_CHUNK_SIZE 1024
+
+// How long to wait for a chunk to come back before counting what is missing as lost
+#define SOAK_RECEIVE_TIMEOUT_MILLISECONDS 2000
+
+// How far ahead to look for where the received bytes line up with the sent ones again
+// after a byte has been lost or made up out of noise
+#define SOAK_RESYNC_WINDOW 8
+
+// The number of bytes in a row that have to match for the streams to count as lined up
+#define SOAK_RESYNC_MATCH 3
+
+// Finds the fewest sent and received bytes to skip for the two to line up again,
+// trying the smallest skips first. Returns false if they do not line up within the window.
+bool findResync(const unsigned char* sent, int sentCount, const unsigned char* received, int receivedCount,
+                int* sentSkip, int* receivedSkip)
+{
+    for (int total = 1; total <= 2 * SOAK_RESYNC_WINDOW; total++)
+    {
+        for (int i = 0; i <= total && i <= SOAK_RESYNC_WINDOW; i++)
+        {
+            int j = total - i;
+            if (j > SOAK_RESYNC_WINDOW || i + SOAK_RESYNC_MATCH > sentCount || j + SOAK_RESYNC_MATCH > receivedCount)
+            {
+                continue;
+            }
+            if (memcmp(sent + i, received + j, SOAK_RESYNC_MATCH) == 0)
+            {
+                *sentSkip = i;
+                *receivedSkip = j;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Sends frames through a uart looped back over a simulated wire on a virtual clock
+// and reports the bit error rate.
+// Usage: gpioUartSoakTest [frames] [baud rate] [jitter in ns] [skew in ppm] [noise probability] [seed]
+//                         [samples per bit] [burst reads, 0 or 1]
+int main(int argc, char* argv[])
+{
+    long frames = (argc > 1) ? atol(argv[1]) : 1000000;
+    int baudRate = (argc > 2) ? atoi(argv[2]) : 115200;
+    
+    GpioSimConfig config;
+    config.jitterNanoseconds = (argc > 3) ? atol(argv[3]) : 500;
+    // About what looking at the clock or a memory-mapped pin costs on a small board
+    config.callNanoseconds = 250;
+    config.skewPartsPerMillion = (argc > 4) ? atol(argv[4]) : 0;
+    config.noiseProbability = (argc > 5) ? atof(argv[5]) : 0;
+    config.seed = (argc > 6) ? (unsigned int)atol(argv[6]) : 1;
+    int samplesPerBit = (argc > 7) ? atoi(argv[7]) : GPIO_UART_DEFAULT_SAMPLES_PER_BIT;
+    bool burstReads = (argc > 8) ? atoi(argv[8]) != 0 : false;
+    gpioSimConfigure(&config);
+    
+    // The rx pin reads what the tx pin writes
+    gpioSimConnect("2", "1");
+    
+    GpioUart uart;
+    if (gpioUartStartOn(&uart, &gpioSimBackend, "1", "2", baudRate, NULL))
+    {
+        fprintf(stderr, "Could not start the uart\n");
+        return 1;
+    }
+    
+    // A transfer buffer smaller than a chunk has every send wait for the uart to catch up,
+    // while the receive buffer keeps room for a whole chunk and any noise until it is read back
+    if (gpioUartSetBuffers(&uart, UART_BUFFER_SIZE, SOAK_CHUNK_SIZE / 4, GPIO_UART_BLOCK))
+    {
+        fprintf(stderr, "Could not set the uart buffers\n");
+        gpioUartStop(&uart);
+        return 1;
+    }
+    
+    if (gpioUartSetSampling(&uart, samplesPerBit, burstReads))
+    {
+        fprintf(stderr, "Cannot sample %d times per bit\n", samplesPerBit);
+        gpioUartStop(&uart);
+        return 1;
+    }
+    
+    struct timespec startTime;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+    
+    unsigned int random = config.seed ? config.seed : 1;
+    unsigned char sent[SOAK_CHUNK_SIZE];
+    // Room for bytes made up out of noise as well as the chunk
+    unsigned char received[2 * SOAK_CHUNK_SIZE];
+    long bitErrors = 0;
+    long bytesLost = 0;
+    long bytesExtra = 0;
+    for (long done = 0; done < frames; )
+    {
+        int chunkSize = (frames - done < SOAK_CHUNK_SIZE) ? (int)(frames - done) : SOAK_CHUNK_SIZE;
+        for (int i = 0; i < chunkSize; i++)
+        {
+            random = random * 1103515245 + 12345;
+            sent[i] = random >> 16;
+        }
+        
+        for (int queued = 0; queued < chunkSize; )
+        {
+            int taken = gpioUartSend(&uart, sent + queued, chunkSize - queued);
+            if (taken < 0)
+            {
+                fprintf(stderr, "Could not schedule the tx timer\n");
+                gpioUartStop(&uart);
+                return 1;
+            }
+            queued += taken;
+        }
+        
+        int receivedCount = 0;
+        while (receivedCount < chunkSize)
+        {
+            int count = gpioUartReceiveTimeout(&uart, received + receivedCount, chunkSize - receivedCount, SOAK_RECEIVE_TIMEOUT_MILLISECONDS);
+            if (count <= 0)
+            {
+                break;
+            }
+            receivedCount += count;
+        }
+        
+        // Bytes made up out of noise may have pushed the end of the chunk out
+        receivedCount += gpioUartReceive(&uart, received + receivedCount, sizeof(received) - receivedCount);
+        
+        // Compare byte for byte, lining the two up again wherever a byte was lost or made up,
+        // so that a single slip does not count the rest of the chunk as wrong.
+        // Lost bytes count as 8 bit errors each.
+        int sentOn = 0;
+        int receivedOn = 0;
+        while (sentOn < chunkSize && receivedOn < receivedCount)
+        {
+            int sentSkip = 1;
+            int receivedSkip = 1;
+            if (sent[sentOn] == received[receivedOn] ||
+                !findResync(sent + sentOn, chunkSize - sentOn, received + receivedOn, receivedCount - receivedOn, &sentSkip, &receivedSkip))
+            {
+                // Matching, or at worst wrong, bytes
+                bitErrors += __builtin_popcount(sent[sentOn] ^ received[receivedOn]);
+                sentOn++;
+                receivedOn++;
+                continue;
+            }
+            
+            // Skipped bytes on both sides pair up as wrong bytes, and the rest were lost or made up
+            int paired = (sentSkip < receivedSkip) ? sentSkip : receivedSkip;
+            for (int i = 0; i < paired; i++)
+            {
+                bitErrors += __builtin_popcount(sent[sentOn + i] ^ received[receivedOn + i]);
+            }
+            bytesLost += sentSkip - paired;
+            bitErrors += 8 * (sentSkip - paired);
+            bytesExtra += receivedSkip - paired;
+            sentOn += sentSkip;
+            receivedOn += receivedSkip;
+        }
+        bytesLost += chunkSize - sentOn;
+        bitErrors += 8 * (chunkSize - sentOn);
+        bytesExtra += receivedCount - receivedOn;
+        
+        done += chunkSize;
+    }
+    
+    struct timespec endTime;
+    clock_gettime(CLOCK_MONOTONIC, &endTime);
+    double realSeconds = (endTime.tv_sec - startTime.tv_sec) + (endTime.tv_nsec - startTime.tv_nsec) / 1e9;
+    
+    GpioUartStats stats;
+    gpioUartGetStats(&uart, &stats);
+    gpioUartStop(&uart);
+    
+    printf("%ld frames at %d baud, jitter %ld ns, skew %ld ppm, noise %g\n",
+        frames, baudRate, config.jitterNanoseconds, config.skewPartsPerMillion, config.noiseProbability);
+    printf("%d samples per bit, %s\n", samplesPerBit, burstReads ? "burst reads" : "a read per step");
+    printf("virtual time %.3f s, real time %.3f s\n", gpioSimElapsed() / 1e9, realSeconds);
+    printf("bit errors %ld, bytes lost %ld, extra bytes %ld\n", bitErrors, bytesLost, bytesExtra);
+    printf("frames accepted %lu, framing errors %lu, parity errors %lu\n",
+        stats.framesAccepted, stats.framingErrors, stats.parityErrors);
+    printf("rx overflows %lu, tx overflows %lu, bytes dropped %lu\n",
+        stats.rxOverflows, stats.txOverflows, stats.bytesDropped);
+    printf("tx bytes %lu, tx pin writes %lu (%.2f per byte)\n",
+        stats.txBytes, stats.txEdges, stats.txBytes ? (double)stats.txEdges / stats.txBytes : 0.0);
+    printf("bit error rate %.3e\n", frames ? (double)bitErrors / (frames * 8.0) : 0.0);
+    return 0;
+}
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <string.h>
 #include <termios.h>
 #include <time.h>
+#include <poll.h>
 
 #include "GpioUart.h"
 
@@ -39,11 +40,23 @@ int main(int argc, char* argv[])
     }
     
     GpioUart uart;
-    gpioUartStart(&uart, "1", "2", 60);
+    gpioUartStartOn(&uart, &gpioMockBackend, "1", "2", 60, NULL);
+    
+    // Wait on both the terminal and the uart instead of polling them
+    struct pollfd pollers[2];
+    pollers[0].fd = 0;
+    pollers[0].events = POLLIN;
+    pollers[1].fd = gpioUartFd(&uart);
+    pollers[1].events = POLLIN;
     
     // We can only exit by Ctrl-C
     while (true)
     {
+        if (poll(pollers, 2, -1) == -1)
+        {
+            perror("Error waiting on input");
+        }
+        
         int terminalByte;
         // Do we have characters from the terminal?
         while ((terminalByte = getchar()) != -1)
@@ -53,10 +66,29 @@ int main(int argc, char* argv[])
             {
                 // Set terminal settings back
                 tcsetattr(0, TCSANOW, &oldSettings);
+                
+                // Let us know how it went
+                GpioUartStats stats;
+                gpioUartGetStats(&uart, &stats);
+                fprintf(stderr, "\nFrames: %lu accepted, %lu framing errors, %lu parity errors\n",
+                    stats.framesAccepted, stats.framingErrors, stats.parityErrors);
+                fprintf(stderr, "Overflows: %lu rx, %lu tx, %lu bytes dropped\n",
+                    stats.rxOverflows, stats.txOverflows, stats.bytesDropped);
+                fprintf(stderr, "Lateness (ns): ");
+                for (int i = 0; i < GPIO_LATENESS_BUCKETS; i++)
+                {
+                    if (stats.latenessHistogram[i])
+                    {
+                        fprintf(stderr, "<%ld: %lu  ", 1L << i, stats.latenessHistogram[i]);
+                    }
+                }
+                fprintf(stderr, "\n");
                 return 0;
             }
             gpioUartSendByte(&uart, terminalByte);
         }
+        // getchar remembers hitting the end of input, but the terminal may give us more
+        clearerr(stdin);
         
         int uartByte;
         // Do we have characters from the uart?
@@ -65,12 +97,6 @@ int main(int argc, char* argv[])
             //printf("%c=%d", uartByte, uartByte);
             putchar(uartByte);
         }
-        
-        // Give them some time to rest...
-        struct timespec sleepTime;
-        sleepTime.tv_sec = 0;
-        sleepTime.tv_nsec = 1000000; // a millisecond
-        nanosleep(&sleepTime, NULL);
     }
     return 0;
 }
\ No newline at end of file
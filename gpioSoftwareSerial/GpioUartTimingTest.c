@@ -0,0 +1,48 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "GpioUartScheduler.h"
+
+// Measures how each timing profile changes wake-up lateness
+// and the achievable baud rate on this host.
+// Usage: gpioUartTimingTest [wake-ups per profile] [period in nanoseconds]
+int main(int argc, char* argv[])
+{
+    int wakeUps = (argc > 1) ? atoi(argv[1]) : 20000;
+    // Defaults to the sampling period of a 9600 baud uart
+    long periodNanoseconds = (argc > 2) ? atol(argv[2]) : 1000000000L / 9600 / 2;
+    
+    const char* names[] = {
+        "default",
+        "spin 50us",
+        "fifo 50",
+        "fifo 50, cpu 0, mlock",
+        "fifo 50, cpu 0, mlock, spin 50us"
+    };
+    const GpioTimingProfile profiles[] = {
+        { .realtimePriority = 0, .cpu = -1, .lockMemory = false, .spinNanoseconds = 0 },
+        { .realtimePriority = 0, .cpu = -1, .lockMemory = false, .spinNanoseconds = 50000 },
+        { .realtimePriority = 50, .cpu = -1, .lockMemory = false, .spinNanoseconds = 0 },
+        { .realtimePriority = 50, .cpu = 0, .lockMemory = true, .spinNanoseconds = 0 },
+        { .realtimePriority = 50, .cpu = 0, .lockMemory = true, .spinNanoseconds = 50000 }
+    };
+    
+    printf("%d wake-ups every %ld ns per profile; lateness in ns\n", wakeUps, periodNanoseconds);
+    printf("%-34s %8s %8s %8s %8s %9s %5s %10s\n", "profile", "mean", "median", "p99", "p99.9", "max", "cpu%", "max baud");
+    for (int i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++)
+    {
+        GpioTimingReport report;
+        if (gpioTimingMeasure(&profiles[i], periodNanoseconds, wakeUps, &report))
+        {
+            printf("%-34s unavailable on this host\n", names[i]);
+            continue;
+        }
+        printf("%-34s %8ld %8ld %8ld %8ld %9ld %5d %10ld\n", names[i],
+            report.meanLatenessNanoseconds, report.medianLatenessNanoseconds,
+            report.p99LatenessNanoseconds, report.p999LatenessNanoseconds,
+            report.maxLatenessNanoseconds, report.cpuPercent, report.achievableBaudRate);
+    }
+    return 0;
+}
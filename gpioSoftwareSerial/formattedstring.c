@@ -1,4 +1,5 @@
 #include "formattedstring.h"
+#include <stdarg.h>
 
 //Mallocs a formatted string based on printf
 //Uses exitmalloc for fail-safe memory operations
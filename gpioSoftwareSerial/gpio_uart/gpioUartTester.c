@@ -7,6 +7,7 @@
 #include <termios.h>
 #include <time.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
 #include "gpio_uart.h"
@@ -41,38 +42,67 @@ int main(int argc, char* argv[])
         perror("Error setting terminal settings");
     }
     
-    // Open up the uart simulator
-    int uart = open("/dev/gpio_uart", O_RDWR);
+    // Open up the uart simulator, the first one unless we are told otherwise
+    const char* device = (argc > 1) ? argv[1] : "/dev/gpio_uart0";
+    int uart = open(device, O_RDWR);
     if (uart == -1)
     {
-        perror("Opening /dev/gpio_uart");
+        perror(device);
         return -1;
     }
-    // Configure it
-    if (ioctl(uart, GPIO_UART_IOC_SETBAUD, 9600))
+    // A tty (/dev/ttyGU<minor>) is set up with termios, and gets its pins when the module is loaded
+    if (isatty(uart))
     {
-        perror("Uart setting baud");
-        return -1;
-    }
-    if (ioctl(uart, GPIO_UART_IOC_SETRX, 8))
-    {
-        perror("Uart setting rx pin");
-        return -1;
-    }
-    if (ioctl(uart, GPIO_UART_IOC_SETTX, 11))
-    {
-        perror("Uart setting tx pin");
-        return -1;
+        struct termios uartSettings;
+        if (tcgetattr(uart, &uartSettings) < 0)
+        {
+            perror("Uart getting tty settings");
+            return -1;
+        }
+        cfmakeraw(&uartSettings);
+        cfsetspeed(&uartSettings, B9600);
+        if (tcsetattr(uart, TCSANOW, &uartSettings) < 0)
+        {
+            perror("Uart setting tty settings");
+            return -1;
+        }
     }
-    if (ioctl(uart, GPIO_UART_IOC_START))
+    // Otherwise configure it, unless it was already started when the module was loaded
+    else if (ioctl(uart, GPIO_UART_IOC_GETRX) == -1)
     {
-        perror("Uart starting");
-        return -1;
+        if (ioctl(uart, GPIO_UART_IOC_SETBAUD, 9600))
+        {
+            perror("Uart setting baud");
+            return -1;
+        }
+        if (ioctl(uart, GPIO_UART_IOC_SETRX, 8))
+        {
+            perror("Uart setting rx pin");
+            return -1;
+        }
+        if (ioctl(uart, GPIO_UART_IOC_SETTX, 11))
+        {
+            perror("Uart setting tx pin");
+            return -1;
+        }
+        if (ioctl(uart, GPIO_UART_IOC_START))
+        {
+            perror("Uart starting");
+            return -1;
+        }
     }
     
     // We can only exit by Ctrl-C or escape
     while (1)
     {
+        // Sleep until there is something from the terminal or the uart
+        struct pollfd waitingFor[2];
+        waitingFor[0].fd = 0;
+        waitingFor[0].events = POLLIN;
+        waitingFor[1].fd = uart;
+        waitingFor[1].events = POLLIN;
+        poll(waitingFor, 2, -1);
+        
         int terminalByte;
         // Do we have characters from the terminal?
         while ((terminalByte = getchar()) != -1)
@@ -90,20 +120,20 @@ int main(int argc, char* argv[])
             write(uart, &terminalByte, 1);
             //gpioUartSendByte(&uart, terminalByte);
         }
+        // getchar remembers hitting the end of input, but the terminal may give us more
+        clearerr(stdin);
         
-        unsigned char uartByte;
         // Do we have characters from the uart?
-        while (read(uart, &uartByte, 1) == 1)
+        if (waitingFor[1].revents & POLLIN)
         {
-            //printf("%c=%d", uartByte, uartByte);
-            putchar(uartByte);
+            // Reads would block once the data runs out, so take what is there in one go
+            unsigned char uartBytes[256];
+            int count = read(uart, uartBytes, sizeof(uartBytes));
+            if (count > 0)
+            {
+                fwrite(uartBytes, 1, count, stdout);
+            }
         }
-        
-        // Give them some time to rest...
-        struct timespec sleepTime;
-        sleepTime.tv_sec = 0;
-        sleepTime.tv_nsec = 1000000; // a millisecond
-        nanosleep(&sleepTime, NULL);
     }
     return 0;
 }
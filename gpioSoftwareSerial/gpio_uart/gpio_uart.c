@@ -16,31 +16,148 @@
 #include <linux/interrupt.h>
 #include <linux/irq.h>
 #include <linux/gpio.h>
-#include <asm/system.h> /* cli(), *_flags */
-#include <asm/uaccess.h> /* copy_from/to_user */
+#include <linux/uaccess.h> /* copy_from/to_user */
 #include <linux/errno.h>
 #include <linux/timer.h>
 #include <linux/jiffies.h>
 #include <linux/spinlock.h>
 #include <linux/time.h>
 #include <linux/delay.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/bitops.h>
+#include <linux/kfifo.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
+#include <linux/sched.h>
+#include <linux/mutex.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/moduleparam.h>
+#include <linux/math64.h>
+#include <linux/device.h>
+#include <linux/tty.h>
+#include <linux/tty_driver.h>
+#include <linux/tty_flip.h>
 
 #include "gpio_uart.h"
 
+#define CREATE_TRACE_POINTS
+#include "gpio_uart_trace.h"
+
 MODULE_LICENSE("Dual BSD/GPL");
 
+// The old tx sender busy-waits through whole frames from a jiffies timer.
+// It is kept so its cpu time per byte can be compared with the hrtimer sender.
+bool busyWaitTx = false;
+module_param(busyWaitTx, bool, S_IRUGO);
+MODULE_PARM_DESC(busyWaitTx, "Send with the old busy-waiting sender instead of the hrtimer one");
+
+// The most uarts (and so minor numbers) the module can run
+#define MAX_UARTS 16
+
+// The uarts to create at load, one per minor number, each given as rx:tx or rx:tx:baud,
+// for example: insmod gpio_uart.ko uarts=8:11:9600,23:24:115200
+// Each is started straight away. With none given, a single uart is created
+// to be set up and started through ioctls.
+char* uarts[MAX_UARTS];
+int uartsGiven = 0;
+module_param_array(uarts, charp, &uartsGiven, S_IRUGO);
+MODULE_PARM_DESC(uarts, "The uarts to run, as rx:tx[:baud] for each minor number");
+
+// The size of each fifo until set otherwise with an ioctl.
+// Sizes are rounded up to a power of 2 for kfifo.
 #define UART_BUFFER_SIZE 4096
+// The largest a fifo may be set to
+#define MAX_UART_BUFFER_SIZE (1 << 20)
 
 //#define BIT_BUFFER_SIZE 192
 #define BIT_BUFFER_SIZE 22
 
+// The bit values are kept packed in a single 64-bit word
+#if BIT_BUFFER_SIZE > 64
+#error BIT_BUFFER_SIZE must fit the 64-bit bit history
+#endif
+
+// Where the bits of a frame are in the bit history, for one frame configuration.
+// A frame here begins with the stop bit(s) of the frame before it,
+// and bit 0 is the oldest bit of the frame.
+typedef struct
+{
+    // The number of bits, including the leading stop bit(s)
+    int frameSize;
+    // Just the stop (high) bits, at the beginning and end of the frame
+    unsigned int stopBitmask;
+    // The start and stop bits together
+    unsigned int startStopBitmask;
+    // Where the lowest data bit and the parity bit (if any) are
+    int dataShift;
+    int parityShift;
+} FrameLayout;
+
+// The frame layouts, indexed by [secondStopBit][parityBit]
+const FrameLayout frameLayouts[2][2] = {
+    {
+        // One stop bit: stop, start, 8 data, (parity,) stop
+        { 11, 0x401, 0x403, 2, 0 },
+        { 12, 0x801, 0x803, 2, 10 }
+    },
+    {
+        // Two stop bits: stop, stop, start, 8 data, (parity,) stop, stop
+        { 13, 0x1803, 0x1807, 3, 0 },
+        { 14, 0x3003, 0x3007, 3, 11 }
+    }
+};
+
 // Make this buffer fairly small, so that values do not get
-// stuck in here for too int64_t, but big enough to allow some interesting
+// stuck in here for too long, but big enough to allow some interesting
 // moving around of the time values.
 #define BIT_SPAN_BUFFER_SIZE 5
 
 #define RAW_BIT_BUFFER_SIZE 16
 
+// The number of buckets in the lateness histogram. Bucket 0 counts bits sent on time,
+// and bucket k counts those sent from 2^(k-1) up to 2^k nanoseconds late.
+// The last bucket also counts anything later than that.
+#define LATENESS_BUCKETS 32
+
+// Counters of how well a uart is doing. Each counter is only written from one context
+// (interrupt, tasklet or timer), and they are read through debugfs without any locking.
+typedef struct
+{
+    // How late each tx bit was sent
+    unsigned long latenessHistogram[LATENESS_BUCKETS];
+    
+    // The bytes sent, and the cpu time the sender took to send them
+    unsigned long txBytes;
+    unsigned long txBusyNanoseconds;
+    
+    // Interrupts received on the rx pin, and those that saw the same value as the last one
+    // (meaning an edge was missed)
+    unsigned long rxInterrupts;
+    unsigned long rxMissedEdges;
+    
+    // The spans the rx tasklet processed, the bits it divided them into,
+    // and the cpu time it took to do so
+    unsigned long rxSpans;
+    unsigned long rxBits;
+    unsigned long rxBusyNanoseconds;
+    
+    // Received frames that were complete and correct
+    unsigned long framesAccepted;
+    // Frames expected right after a good frame that began with a start bit but did not end with their stop bit(s)
+    unsigned long framingErrors;
+    // Frames expected right after a good frame with good start and stop bits but the wrong parity
+    unsigned long parityErrors;
+    
+    // The number of times bytes arrived for a full buffer and some had to be dropped.
+    // Under GPIO_UART_BLOCK writers wait for room instead, so only the rx buffer can overflow.
+    unsigned long rxOverflows;
+    unsigned long txOverflows;
+    // The number of bytes lost to those overflows
+    unsigned long bytesDropped;
+} GpioUartStats;
+
 // Atomic GCC primitive function
 // Sets variable to newValue if it is still equal to oldValue
 // (type* variable, type oldValue, type newValue)
@@ -61,22 +178,34 @@ typedef struct
     // imperfect oscillator timings on the remote device
     int modifiedBaudRate;
     
-    // We have two circular buffers for data
-    unsigned char rxBuffer[UART_BUFFER_SIZE];
-    unsigned char txBuffer[UART_BUFFER_SIZE];
-    
-    // The index of the first byte of data in the buffer
-    int rxBufferStart;
-    int txBufferStart;
-    
-    // The index of the byte following the last byte of data in the buffer
-    // The buffer is considered full when this points to the the bufferStart - 1
-    // Thus, one byte of the buffer between the start and tail is unused when full.
-    int rxBufferTail;
-    int txBufferTail;
-    
-    // Circular buffer for bit values and scores
-    bool bitValueBuffer[BIT_BUFFER_SIZE];
+    // We have two fifos for data. Each has a single producer and a single consumer,
+    // which kfifo lets run concurrently without any locking:
+    // the rx tasklet fills rxFifo for uart_read, and uart_write fills txFifo for txSender.
+    // Under GPIO_UART_DROP_OLDEST the producers take bytes out too, so then the consumers
+    // take turns with them under rxFifoLock and txLock.
+    struct kfifo rxFifo;
+    struct kfifo txFifo;
+    spinlock_t rxFifoLock;
+    
+    // What happens to bytes that arrive for a full fifo, one of the GPIO_UART_* policies.
+    // Only changed while the uart is stopped.
+    int overflowPolicy;
+    
+    // Since processes may share the file, readers and writers each take turns,
+    // to keep to one consumer of rxFifo and one producer of txFifo.
+    struct mutex readLock;
+    struct mutex writeLock;
+    
+    // Readers sleep here until there is received data,
+    // and writers until there is room to send more
+    wait_queue_head_t rxWait;
+    wait_queue_head_t txWait;
+    
+    // The last BIT_BUFFER_SIZE bit values, packed so that the bit at index i is bit i of the word,
+    // with the oldest at index 0. A whole frame can then be taken out with one shift and mask.
+    u64 bitHistory;
+    
+    // Circular buffer for bit scores, which lines up with the bit history
     int bitScoreBuffer[BIT_BUFFER_SIZE];
     // Since this buffer will never be explicitly removed from,
     // we will only have a tail for it. It will always be "full".
@@ -114,16 +243,40 @@ typedef struct
     // The value of the rx pin at the time of the last interrupt
     bool rxLastValue;
     
-    // This timer will schedule the transfer of bytes
+    // This timer will schedule the transfer of bytes for the busy-waiting sender
     // That is, a byte or two will be sent every time the timer hits
     struct timer_list txTimer;
     
+    // Otherwise, this timer fires at each edge of the tx line and sets the pin
+    struct hrtimer txEdgeTimer;
+    // The bits of the frame being sent that are still to go, oldest in bit 0, and how many there are
+    unsigned int txFrame;
+    int txFrameBits;
+    // Whether txEdgeTimer is running, which is decided under txLock
+    // so that writers and the timer agree on who starts it again
+    bool txActive;
+    spinlock_t txLock;
+    
     // A flag that tells whether the uart is currently operating
     bool isRunning;
     
-    // For TESTING
-    int interruptsReceived;
-    int interruptErrors;
+    GpioUartStats stats;
+    
+    // This uart's directory in debugfs, which holds its stats
+    struct dentry* debugDirectory;
+    
+    // The uart is also a tty, /dev/ttyGU<minor>, for tools that expect a serial port.
+    // While the tty is open, received bytes go to its flip buffer instead of rxFifo,
+    // and the char device cannot be opened (nor the tty while the char device is open).
+    struct tty_port ttyPort;
+    bool ttyActive;
+    // Whether the rx tasklet has put bytes in the flip buffer that are still to be pushed
+    bool rxFlipPending;
+    // Serializes the tty's writers, which unlike the char device's may not sleep
+    spinlock_t ttyWriteLock;
+    
+    // The number of open files of the char device, guarded by openLock
+    int openFiles;
 } GpioUart;
 
 // Adds a bit with the value and a score of 0 to the circular bit buffer.
@@ -133,7 +286,8 @@ void addBitWithValue(GpioUart* uart, bool bitValue)
 {
     int nextTail = (uart->bitBufferTail + 1) % BIT_BUFFER_SIZE;
     
-    uart->bitValueBuffer[nextTail] = bitValue;
+    // Every bit moves one index older, and the oldest falls out
+    uart->bitHistory = (uart->bitHistory >> 1) | ((u64)bitValue << (BIT_BUFFER_SIZE - 1));
     uart->bitScoreBuffer[nextTail] = 0;
     uart->bitBufferTail = nextTail;
 }
@@ -142,8 +296,7 @@ void addBitWithValue(GpioUart* uart, bool bitValue)
 // Where 0 will retrieve the oldest element.
 bool getBitValueAt(GpioUart* uart, int index)
 {
-    // The tail + 1 is the next element to be overwritten, hence the oldest. They get slowly newer from there.
-    return uart->bitValueBuffer[(uart->bitBufferTail + 1 + index) % BIT_BUFFER_SIZE];
+    return (uart->bitHistory >> index) & 1;
 }
 
 // Index may range from 0 to BIT_BUFFER_SIZE - 1
@@ -225,7 +378,7 @@ void addRawBitTimeAndValue(GpioUart* uart, int64_t time, bool value)
         // if it has already, then that is ok
         // (then the buffer is not really full and this reduces to the else case)
         // (the byte we were going to remove to make more room has already been sent).
-        int nextStart = (nextTail + 1) % UART_BUFFER_SIZE;
+        int nextStart = (nextTail + 1) % RAW_BIT_BUFFER_SIZE;
         __sync_bool_compare_and_swap(&uart->rawBitBufferStart, nextTail, nextStart);
         
         // We set the tail after the start so that the buffer never appears empty (tail == start)
@@ -272,124 +425,83 @@ int64_t removeRawBitTimeAndValue(GpioUart* uart, bool* bitValue)
     }
 }
 
-// Adds a byte to the circular tx buffer. This method is quasi-thread safe.
-// It is ok for this method and the corresponding removeTxByte method to execute
-// concurrently, but it is not safe multiple instances of this method to execute concurrently.
-void addTxByte(GpioUart* uart, unsigned char value)
+// Adds a received byte to the rx fifo, and wakes up anyone waiting to read it.
+// Only the rx tasklet may call this, since it is the only producer for the fifo.
+// If the fifo is full, the oldest byte is dropped under GPIO_UART_DROP_OLDEST,
+// and otherwise the new byte is.
+// An open tty takes the byte in its flip buffer instead, which the tasklet pushes once it is done.
+void addRxByte(GpioUart* uart, unsigned char value)
 {
-    int nextTail = (uart->txBufferTail + 1) % UART_BUFFER_SIZE;
-    
-    // Are we full?
-    if (uart->txBufferStart == nextTail)
+    if (uart->ttyActive)
     {
-        // It is safe to set this value, because this byte spot is unused.
-        uart->txBuffer[uart->txBufferTail] = value;
-        
-        // Attempt to set the new start value if it hasn't changed
-        // if it has already, then that is ok
-        // (then the buffer is not really full and this reduces to the else case)
-        // (the byte we were going to remove to make more room has already been sent).
-        int nextStart = (nextTail + 1) % UART_BUFFER_SIZE;
-        __sync_bool_compare_and_swap(&uart->txBufferStart, nextTail, nextStart);
-        
-        // We set the tail after the start so that the buffer never appears empty (tail == start)
-        // This is safe because the remove function does not modify the tail.
-        uart->txBufferTail = nextTail;
+        if (tty_insert_flip_char(&uart->ttyPort, value, TTY_NORMAL))
+        {
+            uart->rxFlipPending = true;
+        }
+        else
+        {
+            uart->stats.rxOverflows++;
+            uart->stats.bytesDropped++;
+        }
+        return;
     }
-    else
+    
+    if (kfifo_is_full(&uart->rxFifo))
     {
-        uart->txBuffer[uart->txBufferTail] = value;
-        uart->txBufferTail = nextTail;
+        uart->stats.rxOverflows++;
+        uart->stats.bytesDropped++;
+        if (uart->overflowPolicy != GPIO_UART_DROP_OLDEST)
+        {
+            return;
+        }
+        
+        // Readers take bytes out under the same lock with this policy
+        spin_lock(&uart->rxFifoLock);
+        kfifo_skip(&uart->rxFifo);
+        spin_unlock(&uart->rxFifoLock);
     }
+    
+    kfifo_put(&uart->rxFifo, value);
+    wake_up_interruptible(&uart->rxWait);
 }
 
-// Removes and returns a byte from the circular tx buffer. This method is thread safe.
-// Returns -1 for no more bytes
-int removeTxByte(GpioUart* uart)
-{    
-    // Are we empty?
-    if (uart->txBufferStart == uart->txBufferTail)
-    {
-        return -1;
-    }
-    else
+// Tells an open tty about a frame that went wrong by giving it a NUL byte flagged with the error,
+// which the line discipline then drops, marks or passes on as IGNPAR and PARMRK say.
+// The char device only counts them.
+void addRxError(GpioUart* uart, char flag)
+{
+    if (uart->ttyActive && tty_insert_flip_char(&uart->ttyPort, 0, flag))
     {
-        // Loop until we succeed in popping a value.
-        while (true)
-        {
-            int start = uart->txBufferStart;
-            int value = uart->txBuffer[start];
-            
-            int nextStart = (start + 1) % UART_BUFFER_SIZE;
-            
-            // Attempt to update start
-            if (__sync_bool_compare_and_swap(&uart->txBufferStart, start, nextStart))
-            {
-                // Start did not get changed in the interim, so our value is correct.
-                return value;
-            }
-        }
+        uart->rxFlipPending = true;
     }
 }
 
-// Adds a byte to the circular rx buffer. This method is quasi-thread safe.
-// It is ok for this method and the corresponding removeRxByte method to execute
-// concurrently, but it is not safe multiple instances of this method to execute concurrently.
-void addRxByte(GpioUart* uart, unsigned char value)
+// Lets writers know a byte has left the tx fifo
+void wakeTxWriters(GpioUart* uart)
 {
-    int nextTail = (uart->rxBufferTail + 1) % UART_BUFFER_SIZE;
+    wake_up_interruptible(&uart->txWait);
     
-    // Are we full?
-    if (uart->rxBufferStart == nextTail)
-    {
-        // It is safe to set this value, because this byte spot is unused.
-        uart->rxBuffer[uart->rxBufferTail] = value;
-        
-        // Attempt to set the new start value if it hasn't changed
-        // if it has already, then that is ok
-        // (then the buffer is not really full and this reduces to the else case)
-        // (the byte we were going to remove to make more room has already been sent).
-        int nextStart = (nextTail + 1) % UART_BUFFER_SIZE;
-        __sync_bool_compare_and_swap(&uart->rxBufferStart, nextTail, nextStart);
-        
-        // We set the tail after the start so that the buffer never appears empty (tail == start)
-        // This is safe because the remove function does not modify the tail.
-        uart->rxBufferTail = nextTail;
-    }
-    else
+    // The tty's line discipline only needs waking once there is a fair amount of room
+    if (uart->ttyActive && kfifo_len(&uart->txFifo) < WAKEUP_CHARS)
     {
-        uart->rxBuffer[uart->rxBufferTail] = value;
-        uart->rxBufferTail = nextTail;
+        tty_port_tty_wakeup(&uart->ttyPort);
     }
 }
 
-// Removes and returns a byte from the circular rx buffer. This method is thread safe.
-// Returns -1 for no more bytes.
-int removeRxByte(GpioUart* uart)
-{    
-    // Are we empty?
-    if (uart->rxBufferStart == uart->rxBufferTail)
-    {
-        return -1;
-    }
-    else
+// Takes the next byte to send out of the tx fifo, returning false if it is empty.
+// Under GPIO_UART_DROP_OLDEST writers drop bytes from the fifo too, so then we take turns under txLock.
+bool getTxByte(GpioUart* uart, unsigned char* value)
+{
+    if (uart->overflowPolicy != GPIO_UART_DROP_OLDEST)
     {
-        // Loop until we succeed in popping a value.
-        while (true)
-        {
-            int start = uart->rxBufferStart;
-            int value = uart->rxBuffer[start];
-            
-            int nextStart = (start + 1) % UART_BUFFER_SIZE;
-            
-            // Attempt to update start
-            if (__sync_bool_compare_and_swap(&uart->rxBufferStart, start, nextStart))
-            {
-                // Start did not get changed in the interim, so our value is correct.
-                return value;
-            }
-        }
+        return kfifo_get(&uart->txFifo, value);
     }
+    
+    unsigned long flags;
+    spin_lock_irqsave(&uart->txLock, flags);
+    bool gotByte = kfifo_get(&uart->txFifo, value);
+    spin_unlock_irqrestore(&uart->txLock, flags);
+    return gotByte;
 }
 
 int uart_init(void);
@@ -399,7 +511,11 @@ int uart_open(struct inode* inode, struct file* filePointer);
 int uart_release(struct inode* inode, struct file* filePointer);
 ssize_t uart_read(struct file* filePointer, char* dataBuffer, size_t dataLength, loff_t* filePosition);
 ssize_t uart_write(struct file* filePointer, const char* dataBuffer, size_t dataLength, loff_t* filePosition);
-int64_t uart_ioctl(struct file* filePointer, unsigned int cmd, unsigned int64_t arg);
+unsigned int uart_poll(struct file* filePointer, poll_table* wait);
+long uart_ioctl(struct file* filePointer, unsigned int cmd, unsigned long arg);
+
+int registerTtyDriver(void);
+extern const struct tty_port_operations ttyPortOperations;
 
 module_init(uart_init)
 module_exit(uart_exit)
@@ -410,15 +526,26 @@ struct file_operations uart_operations = {
     .write = uart_write,
     .open = uart_open,
     .release = uart_release,
+    .poll = uart_poll,
     .unlocked_ioctl = uart_ioctl
 };
 
 //Major Number of the driver, used for linking to a file by linux.
 int majorNumber = 441;
 
-//The number of times this device has been opened
-//Use to keep track of interrupt enabling/disabling
-int deviceOpens = 0;
+// The uart for each minor number. Each has its own pins, irq, tasklet, timers and buffers,
+// and nothing in the rx and tx paths is shared between them.
+GpioUart* uartDevices[MAX_UARTS];
+int uartDeviceCount = 0;
+
+// Gives each uart its /dev/gpio_uart<minor> node
+struct class* uartClass;
+
+// Gives each uart its /dev/ttyGU<minor> node
+struct tty_driver* ttyDriver;
+
+// Keeps a uart to either its char device or its tty at a time
+DEFINE_MUTEX(openLock);
 
 void addTime(struct timespec* time, int64_t nanoseconds)
 {
@@ -438,11 +565,18 @@ void addTime(struct timespec* time, int64_t nanoseconds)
 
 int64_t timeDifference(const struct timespec* currentTime, const struct timespec* oldTime)
 {
-    return  ((currentTime->tv_sec - oldTime->tv_sec) * 1000000000L +
+    return  ((int64_t)(currentTime->tv_sec - oldTime->tv_sec) * 1000000000L +
              (currentTime->tv_nsec - oldTime->tv_nsec));
 }
 
-void addTimeAndBusyWait(struct timespec* time, int64_t nanoseconds)
+// Counts the lateness into the log2 histogram
+void countLateness(unsigned long* latenessHistogram, int64_t lateness)
+{
+    int bucket = (lateness > 0) ? fls64(lateness) : 0;
+    latenessHistogram[(bucket < LATENESS_BUCKETS) ? bucket : LATENESS_BUCKETS - 1]++;
+}
+
+void addTimeAndBusyWait(struct timespec* time, int64_t nanoseconds, unsigned long* latenessHistogram)
 {
     addTime(time, nanoseconds);
     struct timespec actualTime;
@@ -450,6 +584,8 @@ void addTimeAndBusyWait(struct timespec* time, int64_t nanoseconds)
     {
         get_monotonic_boottime(&actualTime);
     } while (timespec_compare(time, &actualTime) > 0);
+    
+    countLateness(latenessHistogram, timeDifference(&actualTime, time));
 }
 
 irqreturn_t rxIsr(int irq, void* dev_id, struct pt_regs* regs);
@@ -459,11 +595,11 @@ irqreturn_t rxIsr(int irq, void* dev_id, struct pt_regs* regs);
 // Also takes inverting logic into account
 void holdAndSetTx(GpioUart* uart, bool value, struct timespec* lastBitTime, int64_t nanosecondsNeeded)
 {
-    addTimeAndBusyWait(lastBitTime, nanosecondsNeeded);
+    addTimeAndBusyWait(lastBitTime, nanosecondsNeeded, uart->stats.latenessHistogram);
     gpio_set_value(uart->txPin, uart->invertingLogic ? !value : value);
 }
 
-void txSender(unsigned int64_t argument)
+void txSender(unsigned long argument)
 {
     GpioUart* uart = (GpioUart*)argument;
     
@@ -474,22 +610,28 @@ void txSender(unsigned int64_t argument)
     get_monotonic_boottime(&lastBitTime);
     
     // What is the delay for a bit in nanoseconds?
-    int64_t bitDelay = 1000000000L / uart->baudRate;
+    long bitDelay = 1000000000L / uart->baudRate;
     
-    // We can send multiple bytes at once, if it will not take too int64_t.
+    // We can send multiple bytes at once, if it will not take too long.
     // Let us take up to half a millisecond if our first byte will take less than that
-    // (so we will go as int64_t as necessary to get one byte out)
+    // (so we will go as long as necessary to get one byte out)
     int bitsFrame = 10 + (uart->secondStopBit ? 1 : 0) + (uart->parityBit ? 1 : 0);
     int bytesToDo = 500000 / bitDelay / bitsFrame;
     // But at least one byte...
     bytesToDo = (bytesToDo == 0) ? 1 : bytesToDo;
     
+    ktime_t startTime = ktime_get();
+    int bytesSent = 0;
     for (int i = 0;i < bytesToDo; i++)
     {
         // Have we a byte to send?
-        int byteToSend = removeTxByte(uart);
-        if (byteToSend != -1)
+        unsigned char byteToSend;
+        if (getTxByte(uart, &byteToSend))
         {
+            bytesSent++;
+            // There is room for writers again
+            wakeTxWriters(uart);
+            
             // We use the spinlock to disable interrupts so that we can busy-wait exact timing
             // TESTING
             //spin_lock_irqsave(&locker, savedFlags);
@@ -512,7 +654,7 @@ void txSender(unsigned int64_t argument)
                 // Send the value of the lowest bit
                 holdAndSetTx(uart, bits & 1, &lastBitTime, bitDelay);
                 // Shift out the just-transmitted bit
-
+                
                 bits >>= 1;
             }
             
@@ -532,6 +674,12 @@ void txSender(unsigned int64_t argument)
         }
     }
     
+    if (bytesSent > 0)
+    {
+        uart->stats.txBytes += bytesSent;
+        uart->stats.txBusyNanoseconds += ktime_to_ns(ktime_sub(ktime_get(), startTime));
+    }
+    
     // Have it trigger again in a jiffie! =]
     uart->txTimer.expires = jiffies + 1;
     add_timer(&uart->txTimer);
@@ -542,100 +690,121 @@ void txSender(unsigned int64_t argument)
     //TESTING rxIsr(uart->rxPin, uart, NULL);
 }
 
-// Check whether the bit buffer currently holds a valid byte at the location index.
-// If so, we return the value. If not, we return -1.
-int getByteInBitBufferAt(GpioUart* uart, int index)
+// Builds the frame for a byte, to be sent from bit 0 up:
+// the start bit, 8 data bits, the parity bit if any, and the stop bit(s)
+void buildTxFrame(GpioUart* uart, unsigned char value)
 {
-    // What is the size of a valid frame for us?
-    // We start with at least one stop bit, then a start bit, then 8 data bits, 1 possible parity, then 1 or 2 stop bits
-    int frameSize = 11 + (uart->secondStopBit ? 2 : 0) + (uart->parityBit ? 1 : 0);
+    uart->txFrame = value << 1;
+    uart->txFrameBits = 9;
+    if (uart->parityBit)
+    {
+        uart->txFrame |= (hweight8(value) & 1) << uart->txFrameBits;
+        uart->txFrameBits++;
+    }
+    uart->txFrame |= (uart->secondStopBit ? 3 : 1) << uart->txFrameBits;
+    uart->txFrameBits += uart->secondStopBit ? 2 : 1;
+}
+
+// Fires at each edge of the tx line. Rather than waiting through the bits,
+// it sets the pin for a whole run of identical bits and comes back at the end of the run.
+enum hrtimer_restart txEdgeTimerFunction(struct hrtimer* timer)
+{
+    GpioUart* uart = container_of(timer, GpioUart, txEdgeTimer);
+    ktime_t startTime = ktime_get();
+    countLateness(uart->stats.latenessHistogram, ktime_to_ns(ktime_sub(startTime, hrtimer_get_expires(timer))));
     
-    // The very first thing we do is extract the desired bits from the bit buffer
-    // The bit at index is the oldest (chronoligically) of the bits in the buffer being checked.
-    // We want the oldest bit at bit 0 of targetBits, since we want the data bytes to be already in the right order.
-    // The bits come in least significant first time-wise, so we want the oldest data bits in the least significant bits of targetBits.
-    int targetBits = 0;
-    // Go from newest to oldest
-    for (int i = frameSize; i-- > 0;)
+    if (uart->txFrameBits == 0)
     {
-        // Shift existing bits
-        targetBits <<= 1;
-        if (getBitValueAt(uart, index + i))
+        // The last frame is done, so on to the next, if there is one
+        unsigned char byteToSend;
+        if (!getTxByte(uart, &byteToSend))
         {
-            // This bit is on!
-            targetBits |= 1;
+            // A writer may have just added more without starting us, since we were active
+            spin_lock(&uart->txLock);
+            if (kfifo_is_empty(&uart->txFifo))
+            {
+                uart->txActive = false;
+                spin_unlock(&uart->txLock);
+                return HRTIMER_NORESTART;
+            }
+            spin_unlock(&uart->txLock);
+            getTxByte(uart, &byteToSend);
         }
+        
+        // There is room for writers again
+        wakeTxWriters(uart);
+        buildTxFrame(uart, byteToSend);
+        uart->stats.txBytes++;
     }
-    //printk(KERN_INFO "Checking target bits with value of %d\n", targetBits);
     
-    // Are the stop bit(s) and start bit in position?
+    // The bits beyond the frame are all 0, so the run of 1s always ends within the frame,
+    // and the run of 0s always ends by the stop bit.
+    bool value = uart->txFrame & 1;
+    int run = __ffs(value ? ~uart->txFrame : uart->txFrame);
+    gpio_set_value(uart->txPin, uart->invertingLogic ? !value : value);
     
-    // This is the mask of just the stop (high) bits, depending on frame configuration
-    // With one stop bit, we have stop bits at the beginning and end of the frame
-    int stopBitmask = 1 | (1 << (frameSize - 1));
+    uart->txFrame >>= run;
+    uart->txFrameBits -= run;
     
-    // This mask selects all the start and stop bits, depending on frame configuration
-    int startStopBitmask = 0;
+    // Time the next edge from when this one should have been, so error does not accumulate
+    hrtimer_set_expires(timer, ktime_add_ns(hrtimer_get_expires(timer), run * (1000000000L / uart->baudRate)));
     
-    if (uart->secondStopBit)
+    uart->stats.txBusyNanoseconds += ktime_to_ns(ktime_sub(ktime_get(), startTime));
+    return HRTIMER_RESTART;
+}
+
+// Starts the tx edge timer, if it has stopped for lack of data
+void kickTxEdgeTimer(GpioUart* uart)
+{
+    unsigned long flags;
+    spin_lock_irqsave(&uart->txLock, flags);
+    if (uart->isRunning && !uart->txActive)
     {
-        // The second and second to last bits are stop bits
-        stopBitmask |= 2 | (1 << (frameSize - 2));
-        // The third bit will be the start bit if there are two stop bits
-        startStopBitmask |= stopBitmask | 4;
+        uart->txActive = true;
+        hrtimer_start(&uart->txEdgeTimer, ktime_get(), HRTIMER_MODE_ABS);
     }
-    else
+    spin_unlock_irqrestore(&uart->txLock, flags);
+}
+
+// Check whether the bit buffer currently holds a valid byte at the location index.
+// If so, we return the value. If not, we return -1, or -2 if only the parity was wrong.
+int getByteInBitBufferAt(GpioUart* uart, int index)
+{
+    // What does a valid frame look like for us?
+    const FrameLayout* layout = &frameLayouts[uart->secondStopBit][uart->parityBit];
+    
+    // The very first thing we do is extract the desired bits from the bit history
+    // The bit at index is the oldest (chronoligically) of the bits in the buffer being checked,
+    // and it lands at bit 0 of targetBits, so the data bits are already in the right order.
+    unsigned int targetBits = (uart->bitHistory >> index) & ((1u << layout->frameSize) - 1);
+    
+    // Looking at just the start and stop bits, are all (and only) the stop bits high?
+    if ((targetBits & layout->startStopBitmask) != layout->stopBitmask)
     {
-        // The second bit is the start bit
-        startStopBitmask = stopBitmask | 2;
+        // No byte for us!
+        return -1;
     }
     
-    // Now, looking at just these specific bits, are all (and only) the stop bits high?
-    if ((targetBits & startStopBitmask) == stopBitmask)
+    int dataByte = (targetBits >> layout->dataShift) & 0xff;
+    
+    // If we have a parity bit, is it correct?
+    if (uart->parityBit)
     {
-        // The data are bits 2 through 9 or 3 through 10 
-        int dataByte = (targetBits >> (2 + (uart->secondStopBit ? 1 : 0))) & 0xff;
+        // Quicker parity calculation from http://graphics.stanford.edu/~seander/bithacks.html#ParityParallel
+        // 0x6996 is a table of the parities of the 16 nibbles
+        int parity = dataByte;
+        parity ^= parity >> 4;
+        parity &= 0xf;
+        parity = (0x6996 >> parity) & 1;
         
-        // If we have a parity bit, is it correct?
-        if (uart->parityBit)
-        {
-            int parityBitValue = 0;
-            // Parity bit is the second or third to last
-            if (targetBits & (1 << (frameSize - 2 - (uart->secondStopBit ? 1 : 0))))
-            {
-                parityBitValue = 1;
-            }
-            
-            //int bits = dataByte;
-            //int parity = 0;
-            //for (int i = 0;i < 8; i++)
-            //{
-            //    parity ^= (bits & 1);
-            //    bits >>= 1;
-            //}
-            // Quicker parity calculation from http://graphics.stanford.edu/~seander/bithacks.html#ParityParallel
-            int parity = dataByte;
-            parity ^= parity >> 4;
-            parity &= 0xf;
-            parity = (0x6996 >> parity) & 1;
-            
-            if (parityBitValue == parity)
-            {
-                // We have a byte!
-                return dataByte;
-            }
-            else
-            {
-                //printf("Parity failed: %d\n", bitBuffer);
-            }
-        }
-        else
+        if (((targetBits >> layout->parityShift) & 1) != parity)
         {
-            return dataByte;
+            return -2;
         }
     }
-    // No byte for us!
-    return -1;
+    
+    // We have a byte!
+    return dataByte;
 }
 
 void processSpanTimeAndValue(GpioUart* uart, int64_t spanTime, int64_t originalSpanTime, bool spanValue)
@@ -643,16 +812,16 @@ void processSpanTimeAndValue(GpioUart* uart, int64_t spanTime, int64_t originalS
     // Divide it into bits...
     
     // The length of time a single bit should occupy ideally.
-    int64_t bitDelay = 1000000000L / uart->baudRate;
+    long bitDelay = 1000000000L / uart->baudRate;
     
     // How many bit times have there been?
     // We round this up to help with slight misalignment, so 0.5 -> 1, 1.5 -> 2
-    int64_t bitNumber = (spanTime + bitDelay / 2) / bitDelay;
-                    
+    int64_t bitNumber = div_s64(spanTime + bitDelay / 2, bitDelay);
+    
     // What is the size of a valid frame for us?
     // We start with one or two stop bits (not technically in the frame), then a start bit, then 8 data bits, 1 possible parity, then 1 or 2 stop bits
-    int frameSize = 11 + (uart->secondStopBit ? 2 : 0) + (uart->parityBit ? 1 : 0);
-    // The base frame size does not include the beginning stop bits, which do not technically beint64_t to the frame.
+    int frameSize = frameLayouts[uart->secondStopBit][uart->parityBit].frameSize;
+    // The base frame size does not include the beginning stop bits, which do not technically belong to the frame.
     // This base frame size makes more sense to use, if say, you want to go up to the next frame; this is the number of bits away it is.
     int baseFrameSize = 10 + (uart->secondStopBit ? 1 : 0) + (uart->parityBit ? 1 : 0);
     
@@ -660,7 +829,9 @@ void processSpanTimeAndValue(GpioUart* uart, int64_t spanTime, int64_t originalS
     bitNumber = (bitNumber > BIT_BUFFER_SIZE) ? BIT_BUFFER_SIZE : bitNumber;
     
     // Give out our numbers!
-    printk(KERN_INFO "Processed time: %ld (was %ld) at value: %d -- %d bits\n", spanTime, originalSpanTime, (int)spanValue, (int)bitNumber);
+    trace_gpio_uart_span(uart->rxPin, spanTime, originalSpanTime, spanValue, bitNumber);
+    uart->stats.rxSpans++;
+    uart->stats.rxBits += bitNumber;
     
     // We add in each one at a time...
     for (int i = 0; i < bitNumber; i++)
@@ -671,17 +842,37 @@ void processSpanTimeAndValue(GpioUart* uart, int64_t spanTime, int64_t originalS
         // There will now be another bit whose UART frame this new bit may have just completed.
         int newlyCompletedFrameBitIndex = BIT_BUFFER_SIZE - frameSize;
         // But we must make sure it is a valid bit (score of 0, not -1)
-        if (getBitScoreAt(uart, newlyCompletedFrameBitIndex) == 0 &&
-            getByteInBitBufferAt(uart, newlyCompletedFrameBitIndex) != -1)
+        if (getBitScoreAt(uart, newlyCompletedFrameBitIndex) == 0)
         {
-            // The score of this bit is 1 plus the score of the bit preceding it by exactly one frame
-            // This score gauges how "sure" we can be that a real byte is contained in the frame starting at this bit.
-            // Of course, if the previous frame bit has a score of -1 (meaning invalid) we don't add that
-            int previousFrameBitScore = getBitScoreAt(uart, newlyCompletedFrameBitIndex - baseFrameSize);
-            int newBitScore = 1 + ((previousFrameBitScore != -1) ? previousFrameBitScore : 0);
-            
-            setBitScoreAt(uart, newlyCompletedFrameBitIndex, newBitScore);
-            printk(KERN_INFO "We got a valid frame at %d, scored at %d\n", newlyCompletedFrameBitIndex, newBitScore);
+            int frameByte = getByteInBitBufferAt(uart, newlyCompletedFrameBitIndex);
+            if (frameByte >= 0)
+            {
+                // The score of this bit is 1 plus the score of the bit preceding it by exactly one frame
+                // This score gauges how "sure" we can be that a real byte is contained in the frame starting at this bit.
+                // Of course, if the previous frame bit has a score of -1 (meaning invalid) we don't add that
+                int previousFrameBitScore = getBitScoreAt(uart, newlyCompletedFrameBitIndex - baseFrameSize);
+                int newBitScore = 1 + ((previousFrameBitScore != -1) ? previousFrameBitScore : 0);
+                
+                setBitScoreAt(uart, newlyCompletedFrameBitIndex, newBitScore);
+                trace_gpio_uart_frame(uart->rxPin, newlyCompletedFrameBitIndex, newBitScore);
+            }
+            // A frame that starts right where a good frame ended, with a start bit, ought to have been good too.
+            // We only count errors there, since everywhere else we are just hunting for frames.
+            else if (newlyCompletedFrameBitIndex >= baseFrameSize &&
+                     getBitScoreAt(uart, newlyCompletedFrameBitIndex - baseFrameSize) >= 1 &&
+                     !getBitValueAt(uart, newlyCompletedFrameBitIndex + 1 + (uart->secondStopBit ? 1 : 0)))
+            {
+                if (frameByte == -2)
+                {
+                    uart->stats.parityErrors++;
+                    addRxError(uart, TTY_PARITY);
+                }
+                else
+                {
+                    uart->stats.framingErrors++;
+                    addRxError(uart, TTY_FRAME);
+                }
+            }
         }
         
         // Only check for a byte at the end of the buffer if we do not have any bits marked with a score of -1
@@ -706,12 +897,13 @@ void processSpanTimeAndValue(GpioUart* uart, int64_t spanTime, int64_t originalS
             if (bestScore >= 1)
             {
                 int dataByte = getByteInBitBufferAt(uart, bestScoreIndex);
-                if (dataByte == -1)
+                if (dataByte < 0)
                 {
-                    printk(KERN_ERR "Something has gone terribly wrong! Bit buffer corrupt!\n");
+                    printk_ratelimited(KERN_ERR "Something has gone terribly wrong! Bit buffer corrupt!\n");
                 }
                 else
                 {
+                    uart->stats.framesAccepted++;
                     addRxByte(uart, dataByte);
                 }
                 
@@ -733,7 +925,7 @@ void processSpanTimeAndValue(GpioUart* uart, int64_t spanTime, int64_t originalS
 void relaxSpanTimesAtLevel(GpioUart* uart, int level)
 {
     // The length of time a single bit should occupy ideally.
-    int64_t bitDelay = 1000000000L / uart->baudRate;
+    long bitDelay = 1000000000L / uart->baudRate;
     
     // printk(KERN_INFO "Now at level %d", level);
     
@@ -744,7 +936,7 @@ void relaxSpanTimesAtLevel(GpioUart* uart, int level)
     for (int i = BIT_SPAN_BUFFER_SIZE; i-- > 1;)
     {
         int64_t spanTime = getSpanTimeAt(uart, i);
-        // Do not bother trying to give time to the span if it is very int64_t (> 12 bits worth, the maximum uart frame size)
+        // Do not bother trying to give time to the span if it is very long (> 12 bits worth, the maximum uart frame size)
         if (spanTime > bitDelay * 12)
         {
             continue;
@@ -771,12 +963,13 @@ void relaxSpanTimesAtLevel(GpioUart* uart, int level)
                 //printk(KERN_INFO "Thief timespan end: %ld", getSpanTimeAt(uart, i));
             }
             // Does this span have more than a single bit, but only level% or more of the last bit?
-            else if (spanTime % bitDelay > bitDelay * level / 100)
+            // Spans this short fit in a long, which keeps the remainder a 32-bit division.
+            else if ((long)spanTime % bitDelay > bitDelay * level / 100)
             {
                 //printk(KERN_INFO "Victim timespan start: %ld", getSpanTimeAt(uart, i - 1));
                 //printk(KERN_INFO "Thief timespan start: %ld", getSpanTimeAt(uart, i));
                 
-                int missing = bitDelay - (spanTime % bitDelay);
+                int missing = bitDelay - ((long)spanTime % bitDelay);
                 setSpanTimeAt(uart, i - 1, getSpanTimeAt(uart, i - 1) - missing);
                 setSpanTimeAt(uart, i, spanTime + missing);
                 
@@ -814,12 +1007,13 @@ void relaxSpanTimes(GpioUart* uart)
 
 // The bottom half of the px pin interrupt handler
 // This bottom half is implemented as a tasklet
-void rxIsrBottomHalfFunction(unsigned int64_t data)
+void rxIsrBottomHalfFunction(unsigned long data)
 {
     GpioUart* uart = (GpioUart*)data;
     
     // We do not want two of these bottom halves to run concurrently
     spin_lock(&uart->rxProcessingLock);
+    ktime_t startTime = ktime_get();
     
     // Process all raw value pairs from the interrupts
     bool rawBitValue;
@@ -831,23 +1025,22 @@ void rxIsrBottomHalfFunction(unsigned int64_t data)
         // Every time we get a single bit timing in the range of 75% to 125% of the current modified baud rate,
         // then we slightly modify our modified baud rate value to incorporate the new timing. The single timing
         // has a low relative weight to insure that changes happen only "slowly"
-        int64_t bitDelay = 1000000000L / uart->modifiedBaudRate;
+        long bitDelay = 1000000000L / uart->modifiedBaudRate;
         if (rawBitTime >= bitDelay * 75 / 100 && rawBitTime <= bitDelay * 125 / 100)
         {
-            int64_t modifiedBitDelay = (bitDelay * 63 + rawBitTime) / 64;
+            // Within 125% of a bit, the time fits in a long too
+            long modifiedBitDelay = (bitDelay * 63 + (long)rawBitTime) / 64;
             uart->modifiedBaudRate = 1000000000L / modifiedBitDelay;
         }
         
         // To keep use of this modified baud rate local, we will normalize our times using it to be
         // in terms of the original baud rate again. This way the times we record for testing will not
         // be based on different baud rates over time.
-        printk(KERN_INFO "Raw time (original): %ld at value: %d\n", rawBitTime, (int)rawBitValue);
-        // For some reason 64-bit division doesn't compile/link right on a raspberry pi...
-        rawBitTime = (int64_t)((float)rawBitTime * uart->modifiedBaudRate / uart->baudRate);
-        printk(KERN_INFO "Raw time (modified): %ld at value: %d\n", rawBitTime, (int)rawBitValue);
-        
-        //printk(KERN_INFO "Raw time: %ld at value: %d\n", rawBitTime, (int)rawBitValue);
-        
+        // 64-bit division doesn't link on a raspberry pi without div_s64,
+        // and floating point is not ours to use in a tasklet.
+        int64_t originalRawBitTime = rawBitTime;
+        rawBitTime = div_s64(rawBitTime * uart->modifiedBaudRate, uart->baudRate);
+        trace_gpio_uart_raw_span(uart->rxPin, originalRawBitTime, rawBitTime, rawBitValue);
         
         // We read out time spans when they are in the second-to-last position.
         // We do this because when the last position time spans are in the "relaxing" process,
@@ -869,6 +1062,14 @@ void rxIsrBottomHalfFunction(unsigned int64_t data)
         }
     }
     
+    // Hand an open tty everything from this run in one batch
+    if (uart->rxFlipPending)
+    {
+        uart->rxFlipPending = false;
+        tty_flip_buffer_push(&uart->ttyPort);
+    }
+    
+    uart->stats.rxBusyNanoseconds += ktime_to_ns(ktime_sub(ktime_get(), startTime));
     spin_unlock(&uart->rxProcessingLock);
 }
 
@@ -881,16 +1082,15 @@ irqreturn_t rxIsr(int irq, void* dev_id, struct pt_regs* regs)
     int rxPinValue = gpio_get_value(uart->rxPin);
     // invert the value if need be.
     rxPinValue = uart->invertingLogic ? !rxPinValue : rxPinValue;
-
-    // TESTING
-    uart->interruptsReceived++;
+    
+    uart->stats.rxInterrupts++;
     if (rxPinValue == uart->rxLastValue)
     {
-        uart->interruptErrors++;
+        uart->stats.rxMissedEdges++;
     }
     //uart->rxLastValue = rxPinValue;
     //return IRQ_HANDLED; 
-
+    
     // Get current time
     struct timespec currentTime;
     get_monotonic_boottime(&currentTime);
@@ -901,7 +1101,7 @@ irqreturn_t rxIsr(int irq, void* dev_id, struct pt_regs* regs)
     // How many bit times have there been on the old value? (since the last interrupt)
     // We round this up to help with slight misalignment, so 0.5 -> 1, 1.5 -> 2
     int bitNumber = (timeDifference(&currentTime, &uart->rxLastInterruptTime) + bitDelay / 2) / bitDelay;
-                    
+    
     // What is the size of a valid frame for us?
     // We start with at least one stop bit, then a start bit, then 8 data bits, 1 possible parity, then 1 or 2 stop bits
     int frameSize = 11 + (uart->secondStopBit ? 2 : 0) + (uart->parityBit ? 1 : 0);
@@ -911,10 +1111,10 @@ irqreturn_t rxIsr(int irq, void* dev_id, struct pt_regs* regs)
     
     // TESTING
    //printk(KERN_INFO "We got %d bits of %d and our value is %d\n", bitNumber, uart->rxLastValue, rxPinValue); 
-
+    
     // Then update the stored time
     uart->rxLastInterruptTime = currentTime;
-                    
+    
     for (int i = 0;i < bitNumber; i++)
     {
         // Shift existing bits
@@ -952,8 +1152,37 @@ irqreturn_t rxIsr(int irq, void* dev_id, struct pt_regs* regs)
     return IRQ_HANDLED;
 }
 
+// Requests a GPIO pin, sets its direction (an output starts high) and exports it.
+// Returns 0 on success, or a negative error number with the pin left unclaimed.
+int claimPin(int pin, const char* label, bool output)
+{
+    int result = gpio_request(pin, label);
+    if (result)
+    {
+        return result;
+    }
+    result = output ? gpio_direction_output(pin, 1) : gpio_direction_input(pin);
+    if (!result)
+    {
+        result = gpio_export(pin, 0);
+    }
+    if (result)
+    {
+        gpio_free(pin);
+    }
+    return result;
+}
+
+// Undoes claimPin
+void releasePin(int pin)
+{
+    gpio_unexport(pin);
+    gpio_free(pin);
+}
+
 // Opens and configures the needed GPIO pins
-// And sets up the appropraite interrupts on them
+// And sets up the appropraite interrupts on them.
+// Returns 0 on success, or a negative error number with nothing left claimed.
 int startUart(GpioUart* uart)
 {
     // Do not allow start if we are already going
@@ -969,43 +1198,53 @@ int startUart(GpioUart* uart)
     }
     
     // Get the GPIOs for our interrupt handler
-    if (gpio_request(uart->rxPin, "GPIO UART rx") ||
-        gpio_direction_input(uart->rxPin) ||
-        gpio_export(uart->rxPin, 0))
+    int result = claimPin(uart->rxPin, "GPIO UART rx", false);
+    if (result)
     {
         printk(KERN_ERR "Could not obtain rx GPIO UART pin\n");
-        return -1;
+        return result;
     }
     
     // Output initializes high
-    if (gpio_request(uart->txPin, "GPIO UART tx") ||
-        gpio_direction_output(uart->txPin, 1) ||
-        gpio_export(uart->txPin, 0))
+    result = claimPin(uart->txPin, "GPIO UART tx", true);
+    if (result)
     {
         printk(KERN_ERR "Could not obtain tx GPIO UART pin\n");
-        return -1;
+        releasePin(uart->rxPin);
+        return result;
     }
     
     // Register our interrupt handler
     // We want to get interrupts on both the rising and falling edges so we can get the full picture
     // of what the input signal is on the rx pin.
-    if(request_irq(gpio_to_irq(uart->rxPin),
+    result = request_irq(gpio_to_irq(uart->rxPin),
                          (irq_handler_t)rxIsr, //TESTING
-                         (1*IRQF_TRIGGER_RISING) | IRQF_TRIGGER_FALLING, "GPIO UART rx IRQ", uart))
+                         (1*IRQF_TRIGGER_RISING) | IRQF_TRIGGER_FALLING, "GPIO UART rx IRQ", uart);
+    if (result)
     {
         printk(KERN_ERR "Could not register irq for GPIO UART rx\n");
-        return -1;
+        releasePin(uart->txPin);
+        releasePin(uart->rxPin);
+        return result;
     }
-
-    // Register our timer, which will do the job of sending out tx bytes
-    // Have it trigger in a jiffie =]
-    uart->txTimer.expires = jiffies + 1;
-    add_timer(&uart->txTimer);
-    
-    printk(KERN_INFO "Uart Started\n");
     
     uart->isRunning = true;
     
+    if (busyWaitTx)
+    {
+        // Register our timer, which will do the job of sending out tx bytes
+        // Have it trigger in a jiffie =]
+        uart->txTimer.expires = jiffies + 1;
+        add_timer(&uart->txTimer);
+    }
+    else
+    {
+        // Send anything written before we started
+        kickTxEdgeTimer(uart);
+    }
+    
+    printk(KERN_INFO "Uart Started\n");
+    
     return 0;
 }
 
@@ -1013,19 +1252,61 @@ int stopUart(GpioUart* uart)
 {
     if (uart->isRunning)
     {
-        // Release everything!
-        gpio_free(uart->rxPin);
-        gpio_free(uart->txPin);
-        free_irq(gpio_to_irq(uart->rxPin), uart);
-        del_timer(&uart->txTimer);
-        
+        // Make sure writers do not start the edge timer again before stopping it
+        unsigned long flags;
+        spin_lock_irqsave(&uart->txLock, flags);
         uart->isRunning = false;
+        spin_unlock_irqrestore(&uart->txLock, flags);
+        
+        del_timer_sync(&uart->txTimer);
+        hrtimer_cancel(&uart->txEdgeTimer);
+        // Any frame part way through is abandoned
+        uart->txActive = false;
+        uart->txFrameBits = 0;
+        
+        // Release everything, in the reverse of the order startUart claimed it in
+        free_irq(gpio_to_irq(uart->rxPin), uart);
+        releasePin(uart->txPin);
+        releasePin(uart->rxPin);
     }
     
     return 0;
 }
 
-int64_t uart_ioctl(struct file* filePointer, unsigned int cmd, unsigned int64_t arg)
+// Replaces a fifo of a stopped uart with an empty one of at least size bytes,
+// holding lock (the readLock or writeLock) so that no reader or writer is using it meanwhile.
+// Returns 0 on success, or a negative error number on failure
+int resizeFifo(GpioUart* uart, struct kfifo* fifo, struct mutex* lock, unsigned long size)
+{
+    if (uart->isRunning)
+    {
+        return -EPERM;
+    }
+    
+    if (size < 2 || size > MAX_UART_BUFFER_SIZE)
+    {
+        return -EINVAL;
+    }
+    
+    // Allocate first, so that failing leaves the old fifo in place
+    struct kfifo newFifo;
+    if (kfifo_alloc(&newFifo, roundup_pow_of_two(size), GFP_KERNEL))
+    {
+        return -ENOMEM;
+    }
+    
+    if (mutex_lock_interruptible(lock))
+    {
+        kfifo_free(&newFifo);
+        return -ERESTARTSYS;
+    }
+    kfifo_free(fifo);
+    *fifo = newFifo;
+    mutex_unlock(lock);
+    return 0;
+}
+
+long uart_ioctl(struct file* filePointer, unsigned int cmd, unsigned long arg)
 {
     GpioUart* uart = (GpioUart*)filePointer->private_data;
     switch (cmd)
@@ -1079,45 +1360,121 @@ int64_t uart_ioctl(struct file* filePointer, unsigned int cmd, unsigned int64_t
             return startUart(uart);
         case GPIO_UART_IOC_STOP:
             return stopUart(uart);
+        case GPIO_UART_IOC_SETRXBUFFERSIZE:
+            return resizeFifo(uart, &uart->rxFifo, &uart->readLock, arg);
+        case GPIO_UART_IOC_GETRXBUFFERSIZE:
+            return kfifo_size(&uart->rxFifo);
+        case GPIO_UART_IOC_SETTXBUFFERSIZE:
+            return resizeFifo(uart, &uart->txFifo, &uart->writeLock, arg);
+        case GPIO_UART_IOC_GETTXBUFFERSIZE:
+            return kfifo_size(&uart->txFifo);
+        case GPIO_UART_IOC_SETOVERFLOWPOLICY:
+            if (uart->isRunning)
+            {
+                return -EPERM;
+            }
+            if (arg > GPIO_UART_BLOCK)
+            {
+                return -EINVAL;
+            }
+            uart->overflowPolicy = arg;
+            // Writers waiting for room may no longer need to
+            wake_up_interruptible(&uart->txWait);
+            return 0;
+        case GPIO_UART_IOC_GETOVERFLOWPOLICY:
+            return uart->overflowPolicy;
     }
     printk(KERN_ERR "Uart IOCTL unknown, not %d or similar\n", GPIO_UART_IOC_START);
     return -ENOTTY;
 }
 
-int uart_init(void) {
-    //Register the device
-    int result = register_chrdev(majorNumber, "gpio_uart", &uart_operations);
-    if (result < 0) {
-        printk(
-            KERN_ERR "GPIO UART Device: Cannot obtain major number %d\n", majorNumber);
-        return result;
+// The gpio_uart directory in debugfs, holding a directory for each opened uart
+struct dentry* debugDirectory;
+
+// Prints out the stats of the uart for its debugfs stats file
+int statsShow(struct seq_file* file, void* unused)
+{
+    GpioUart* uart = (GpioUart*)file->private;
+    
+    seq_printf(file, "baud_rate %d\n", uart->baudRate);
+    seq_printf(file, "modified_baud_rate %d\n", ACCESS_ONCE(uart->modifiedBaudRate));
+    seq_printf(file, "rx_interrupts %lu\n", ACCESS_ONCE(uart->stats.rxInterrupts));
+    seq_printf(file, "rx_missed_edges %lu\n", ACCESS_ONCE(uart->stats.rxMissedEdges));
+    seq_printf(file, "rx_spans %lu\n", ACCESS_ONCE(uart->stats.rxSpans));
+    seq_printf(file, "rx_bits %lu\n", ACCESS_ONCE(uart->stats.rxBits));
+    
+    // The cpu time the rx tasklet spends per edge, which is what tracing costs show up in
+    unsigned long rxInterrupts = ACCESS_ONCE(uart->stats.rxInterrupts);
+    unsigned long rxBusyNanoseconds = ACCESS_ONCE(uart->stats.rxBusyNanoseconds);
+    seq_printf(file, "rx_busy_ns %lu\n", rxBusyNanoseconds);
+    seq_printf(file, "rx_busy_ns_per_edge %lu\n", rxInterrupts ? rxBusyNanoseconds / rxInterrupts : 0);
+    seq_printf(file, "frames_accepted %lu\n", ACCESS_ONCE(uart->stats.framesAccepted));
+    seq_printf(file, "framing_errors %lu\n", ACCESS_ONCE(uart->stats.framingErrors));
+    seq_printf(file, "parity_errors %lu\n", ACCESS_ONCE(uart->stats.parityErrors));
+    
+    // How full buffers are handled, and how often they have been
+    static const char* policyNames[] = { "drop-oldest", "drop-newest", "block" };
+    seq_printf(file, "overflow_policy %s\n", policyNames[uart->overflowPolicy]);
+    seq_printf(file, "rx_buffer_size %u\n", kfifo_size(&uart->rxFifo));
+    seq_printf(file, "tx_buffer_size %u\n", kfifo_size(&uart->txFifo));
+    seq_printf(file, "rx_overflows %lu\n", ACCESS_ONCE(uart->stats.rxOverflows));
+    seq_printf(file, "tx_overflows %lu\n", ACCESS_ONCE(uart->stats.txOverflows));
+    seq_printf(file, "bytes_dropped %lu\n", ACCESS_ONCE(uart->stats.bytesDropped));
+    
+    // The cpu time the sender spends per byte, to compare the senders with
+    unsigned long txBytes = ACCESS_ONCE(uart->stats.txBytes);
+    unsigned long txBusyNanoseconds = ACCESS_ONCE(uart->stats.txBusyNanoseconds);
+    seq_printf(file, "tx_sender %s\n", busyWaitTx ? "busy-wait" : "hrtimer");
+    seq_printf(file, "tx_bytes %lu\n", txBytes);
+    seq_printf(file, "tx_busy_ns %lu\n", txBusyNanoseconds);
+    seq_printf(file, "tx_busy_ns_per_byte %lu\n", txBytes ? txBusyNanoseconds / txBytes : 0);
+    
+    // The histogram, with each bucket labelled by its upper bound
+    for (int i = 0; i < LATENESS_BUCKETS; i++)
+    {
+        seq_printf(file, "tx_lateness_below_%luns %lu\n", 1UL << i, ACCESS_ONCE(uart->stats.latenessHistogram[i]));
     }
-    
-    printk(KERN_INFO "Inserting gpio_uart module\n");
     return 0;
 }
 
-void uart_exit(void) {
-    //Unregister the device
-    unregister_chrdev(majorNumber, "gpio_uart");
-    
-    printk(KERN_INFO "Removing gpio_uart module\n");
+int statsOpen(struct inode* inode, struct file* filePointer)
+{
+    return single_open(filePointer, statsShow, inode->i_private);
 }
 
+struct file_operations statsOperations = {
+    .owner = THIS_MODULE,
+    .open = statsOpen,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release
+};
 
-int uart_open(struct inode* inode, struct file* filePointer)
+// Allocates a stopped uart with default settings for the minor number,
+// along with its debugfs stats, its device node and its tty device.
+// Returns an ERR_PTR of the negative error number if it cannot be made.
+GpioUart* createUart(int minor)
 {
-    // Allocate memory for the GpioUart structure
     // GFP_KERNEL for an allocation that can take its time
-    filePointer->private_data = kmalloc(sizeof(GpioUart), GFP_KERNEL);
-    if (!filePointer->private_data)
+    GpioUart* uart = kmalloc(sizeof(GpioUart), GFP_KERNEL);
+    if (!uart)
     {
-        // Failed to open the uart... No memory!
-        return -ENOMEM;
+        return ERR_PTR(-ENOMEM);
+    }
+    
+    if (kfifo_alloc(&uart->rxFifo, UART_BUFFER_SIZE, GFP_KERNEL))
+    {
+        kfree(uart);
+        return ERR_PTR(-ENOMEM);
+    }
+    if (kfifo_alloc(&uart->txFifo, UART_BUFFER_SIZE, GFP_KERNEL))
+    {
+        kfifo_free(&uart->rxFifo);
+        kfree(uart);
+        return ERR_PTR(-ENOMEM);
     }
     
     // SO MUCH INITIALIZATION!!!
-    GpioUart* uart = (GpioUart*)filePointer->private_data;
     // Defaults!
     uart->isRunning = false;
     uart->rxPin = -1;
@@ -1126,25 +1483,29 @@ int uart_open(struct inode* inode, struct file* filePointer)
     uart->invertingLogic = false;
     uart->parityBit = false;
     uart->secondStopBit = false;
-    uart->rxBufferStart = uart->rxBufferTail = 0;
-    uart->txBufferStart = uart->txBufferTail = 0;
+    spin_lock_init(&uart->rxFifoLock);
+    uart->overflowPolicy = GPIO_UART_BLOCK;
+    mutex_init(&uart->readLock);
+    mutex_init(&uart->writeLock);
+    init_waitqueue_head(&uart->rxWait);
+    init_waitqueue_head(&uart->txWait);
     
     uart->modifiedBaudRate = uart->baudRate;
     
     uart->bitBufferTail = 0;
     uart->bitSpanBufferTail = 0;
     uart->rawBitBufferStart = uart->rawBitBufferTail = 0;
-    tasklet_init(&uart->rxIsrBottomHalfTasklet, rxIsrBottomHalfFunction, (unsigned int64_t)uart);
+    tasklet_init(&uart->rxIsrBottomHalfTasklet, rxIsrBottomHalfFunction, (unsigned long)uart);
     spin_lock_init(&uart->rxProcessingLock);
     
     // Prefill the bitScoreBuffer with -1 values to indicate none of the bits in it are valid
-    // Also prefill the bitValueBuffer with 1/true values (since the line held high is inactive)
+    // Also prefill the bit history with 1/true values (since the line held high is inactive)
     // And just for fun (and prudence), the times to -1...
     for (int i = 0; i < BIT_BUFFER_SIZE; i++)
     {
         uart->bitScoreBuffer[i] = -1;
-        uart->bitValueBuffer[i] = true;
     }
+    uart->bitHistory = ~0ULL >> (64 - BIT_BUFFER_SIZE);
     
     // Prefill the bit span buffer times to -1, to indicate invalid.
     // The bools to "-1" not really a bool value, for debugging help
@@ -1167,75 +1528,566 @@ int uart_open(struct inode* inode, struct file* filePointer)
     
     init_timer(&uart->txTimer);
     uart->txTimer.function = txSender;
-    uart->txTimer.data = (unsigned int64_t)uart;
-   
-    // TESTING
-    uart->interruptsReceived = 0;
-    uart->interruptErrors = 0;
- 
-    printk(KERN_INFO "Uart opened");
+    uart->txTimer.data = (unsigned long)uart;
+    
+    hrtimer_init(&uart->txEdgeTimer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+    uart->txEdgeTimer.function = txEdgeTimerFunction;
+    uart->txFrameBits = 0;
+    uart->txActive = false;
+    spin_lock_init(&uart->txLock);
+    
+    uart->ttyActive = false;
+    uart->rxFlipPending = false;
+    spin_lock_init(&uart->ttyWriteLock);
+    uart->openFiles = 0;
+    tty_port_init(&uart->ttyPort);
+    uart->ttyPort.ops = &ttyPortOperations;
+    
+    memset(&uart->stats, 0, sizeof(uart->stats));
+    
+    // Each uart gets a debugfs directory with its stats, named by its minor number
+    char directoryName[16];
+    snprintf(directoryName, sizeof(directoryName), "%d", minor);
+    uart->debugDirectory = debugfs_create_dir(directoryName, debugDirectory);
+    debugfs_create_file("stats", S_IRUGO, uart->debugDirectory, uart, &statsOperations);
+    
+    // The node is nice to have, but can also be made by hand with mknod
+    device_create(uartClass, NULL, MKDEV(majorNumber, minor), NULL, "gpio_uart%d", minor);
+    
+    // Without its tty device the uart cannot be opened as a tty, so it is not made at all
+    struct device* ttyDevice = tty_port_register_device(&uart->ttyPort, ttyDriver, minor, NULL);
+    if (IS_ERR(ttyDevice))
+    {
+        printk(KERN_ERR "GPIO UART %d: could not register its tty device\n", minor);
+        device_destroy(uartClass, MKDEV(majorNumber, minor));
+        tty_port_destroy(&uart->ttyPort);
+        debugfs_remove_recursive(uart->debugDirectory);
+        kfifo_free(&uart->txFifo);
+        kfifo_free(&uart->rxFifo);
+        kfree(uart);
+        return ERR_CAST(ttyDevice);
+    }
+    
+    return uart;
+}
+
+// Stops and frees a uart made by createUart
+void destroyUart(GpioUart* uart, int minor)
+{
+    stopUart(uart);
+    tasklet_kill(&uart->rxIsrBottomHalfTasklet);
+    
+    device_destroy(uartClass, MKDEV(majorNumber, minor));
+    tty_unregister_device(ttyDriver, minor);
+    tty_port_destroy(&uart->ttyPort);
+    debugfs_remove_recursive(uart->debugDirectory);
+    kfifo_free(&uart->rxFifo);
+    kfifo_free(&uart->txFifo);
+    kfree(uart);
+}
+
+// Sets up and starts a uart from its module parameter, rx:tx or rx:tx:baud
+void startUartFromParameter(GpioUart* uart, int minor, const char* parameter)
+{
+    int baudRate = uart->baudRate;
+    if (sscanf(parameter, "%d:%d:%d", &uart->rxPin, &uart->txPin, &baudRate) < 2 || baudRate <= 0)
+    {
+        printk(KERN_ERR "GPIO UART %d: cannot understand \"%s\", expected rx:tx or rx:tx:baud\n", minor, parameter);
+        uart->rxPin = uart->txPin = -1;
+        return;
+    }
+    uart->baudRate = baudRate;
+    uart->modifiedBaudRate = baudRate;
+    
+    // A uart that fails to start can still be set up again through ioctls
+    if (startUart(uart))
+    {
+        printk(KERN_ERR "GPIO UART %d: could not start on rx %d, tx %d\n", minor, uart->rxPin, uart->txPin);
+    }
+}
+
+void uart_exit(void) {
+    for (int i = 0; i < uartDeviceCount; i++)
+    {
+        destroyUart(uartDevices[i], i);
+    }
+    uartDeviceCount = 0;
+    
+    if (ttyDriver)
+    {
+        tty_unregister_driver(ttyDriver);
+        put_tty_driver(ttyDriver);
+        ttyDriver = NULL;
+    }
+    
+    class_destroy(uartClass);
+    
+    //Unregister the device
+    unregister_chrdev(majorNumber, "gpio_uart");
+    debugfs_remove_recursive(debugDirectory);
+    
+    printk(KERN_INFO "Removing gpio_uart module\n");
+}
+
+int uart_init(void) {
+    //Register the device
+    int result = register_chrdev(majorNumber, "gpio_uart", &uart_operations);
+    if (result < 0) {
+        printk(
+            KERN_ERR "GPIO UART Device: Cannot obtain major number %d\n", majorNumber);
+        return result;
+    }
+    
+    uartClass = class_create(THIS_MODULE, "gpio_uart");
+    if (IS_ERR(uartClass))
+    {
+        unregister_chrdev(majorNumber, "gpio_uart");
+        return PTR_ERR(uartClass);
+    }
+    
+    result = registerTtyDriver();
+    if (result)
+    {
+        class_destroy(uartClass);
+        unregister_chrdev(majorNumber, "gpio_uart");
+        return result;
+    }
+    
+    // Stats are nice to have, but we can do without them
+    debugDirectory = debugfs_create_dir("gpio_uart", NULL);
+    
+    // At least one uart, for the ioctls to set up
+    int uartsWanted = (uartsGiven > 0) ? uartsGiven : 1;
+    for (int i = 0; i < uartsWanted; i++)
+    {
+        GpioUart* uart = createUart(i);
+        if (IS_ERR(uart))
+        {
+            uart_exit();
+            return PTR_ERR(uart);
+        }
+        uartDevices[i] = uart;
+        uartDeviceCount++;
+        
+        if (i < uartsGiven)
+        {
+            startUartFromParameter(uart, i, uarts[i]);
+        }
+    }
+    
+    printk(KERN_INFO "Inserting gpio_uart module with %d uarts\n", uartDeviceCount);
+    return 0;
+}
+
+// Each minor number opens its own uart. Any number of files may share it.
+int uart_open(struct inode* inode, struct file* filePointer)
+{
+    int minor = iminor(inode);
+    if (minor >= uartDeviceCount)
+    {
+        return -ENODEV;
+    }
     
+    GpioUart* uart = uartDevices[minor];
+    mutex_lock(&openLock);
+    if (uart->ttyActive)
+    {
+        mutex_unlock(&openLock);
+        return -EBUSY;
+    }
+    uart->openFiles++;
+    mutex_unlock(&openLock);
+    
+    filePointer->private_data = uart;
     return 0;
 }
 
+// The uart keeps running once closed, and is only stopped by an ioctl or by unloading
 int uart_release(struct inode* inode, struct file* filePointer)
 {
     GpioUart* uart = (GpioUart*)filePointer->private_data;
+    mutex_lock(&openLock);
+    uart->openFiles--;
+    mutex_unlock(&openLock);
     
-    // Make sure to stop it!
-    stopUart(uart);
-   
-    // TESTING
-    printk(KERN_INFO "Time per bit (original): %ld\n", 1000000000L / uart->baudRate);
-    printk(KERN_INFO "Time per bit (modified): %ld\n", 1000000000L / uart->modifiedBaudRate);
-    printk(KERN_INFO "We have %d interrupts at end!\n", uart->interruptsReceived);
-    printk(KERN_INFO "We have %d interrupt errors at end!\n",uart->interruptErrors);
- 
-    // Release the memory
-    kfree(filePointer->private_data);
-    // Just for extra safety...
     filePointer->private_data = NULL;
-    
-    printk(KERN_INFO "Uart closed");
-    
     return 0;
 }
 
+// Copies up to dataLength received bytes to the user under GPIO_UART_DROP_OLDEST.
+// The bytes are taken out under rxFifoLock, since the rx tasklet may drop them meanwhile,
+// so they go through a small buffer here rather than straight to the user.
+// Returns 0 on success, or a negative error number on failure
+int copyRxDroppingOldest(GpioUart* uart, char* dataBuffer, size_t dataLength, unsigned int* bytesCopied)
+{
+    unsigned char chunk[64];
+    *bytesCopied = 0;
+    while (*bytesCopied < dataLength)
+    {
+        unsigned int count = kfifo_out_spinlocked(&uart->rxFifo, chunk,
+            min_t(size_t, dataLength - *bytesCopied, sizeof(chunk)), &uart->rxFifoLock);
+        if (count == 0)
+        {
+            break;
+        }
+        if (copy_to_user(dataBuffer + *bytesCopied, chunk, count))
+        {
+            return -EFAULT;
+        }
+        *bytesCopied += count;
+    }
+    return 0;
+}
+
+// Reads as much received data as is available, up to dataLength.
+// Blocks until there is some, unless the file was opened with O_NONBLOCK.
 ssize_t uart_read(struct file* filePointer, char* dataBuffer, size_t dataLength, loff_t* filePosition)
 {
     GpioUart* uart = (GpioUart*)filePointer->private_data;
     
-    // Copy byte by byte
-    for (int i = 0;i < dataLength; i++)
+    if (mutex_lock_interruptible(&uart->readLock))
     {
-        int value = removeRxByte(uart);
-        if (value == -1)
+        return -ERESTARTSYS;
+    }
+    
+    while (kfifo_is_empty(&uart->rxFifo))
+    {
+        // Sleep without holding the lock, so other readers can still give up
+        mutex_unlock(&uart->readLock);
+        if (filePointer->f_flags & O_NONBLOCK)
         {
-            // No more bytes to copy...
-            return i;
+            return -EAGAIN;
+        }
+        if (wait_event_interruptible(uart->rxWait, !kfifo_is_empty(&uart->rxFifo)) ||
+            mutex_lock_interruptible(&uart->readLock))
+        {
+            return -ERESTARTSYS;
         }
-        unsigned char byteValue = value;
-        
-        printk(KERN_INFO "Byte %d transferred to user.\n", byteValue);
-        copy_to_user(dataBuffer + i, &byteValue, 1);
     }
     
-    return dataLength;
+    // Copy it all at once, unless the rx tasklet may be dropping the oldest bytes as we go
+    unsigned int bytesCopied;
+    int result;
+    if (uart->overflowPolicy == GPIO_UART_DROP_OLDEST)
+    {
+        result = copyRxDroppingOldest(uart, dataBuffer, dataLength, &bytesCopied);
+    }
+    else
+    {
+        result = kfifo_to_user(&uart->rxFifo, dataBuffer, dataLength, &bytesCopied);
+    }
+    mutex_unlock(&uart->readLock);
+    
+    return result ? result : bytesCopied;
+}
+
+// Drops the oldest bytes from the tx fifo to make room for dataLength more, as far as it can.
+// Only writers may call this, holding the writeLock.
+// Returns the number of bytes dropped.
+unsigned int dropOldestTxBytes(GpioUart* uart, size_t dataLength)
+{
+    unsigned long flags;
+    spin_lock_irqsave(&uart->txLock, flags);
+    unsigned int room = kfifo_avail(&uart->txFifo);
+    unsigned int dropping = (dataLength > room) ? min_t(size_t, dataLength - room, kfifo_len(&uart->txFifo)) : 0;
+    for (unsigned int i = 0; i < dropping; i++)
+    {
+        kfifo_skip(&uart->txFifo);
+    }
+    spin_unlock_irqrestore(&uart->txLock, flags);
+    return dropping;
 }
 
+// Queues the data to send. Once the fifo is full, GPIO_UART_BLOCK queues as much
+// as there is room for, blocking until there is some unless the file was opened with O_NONBLOCK.
+// GPIO_UART_DROP_OLDEST drops the oldest queued bytes to make room for it all,
+// and GPIO_UART_DROP_NEWEST drops what does not fit, both without blocking.
 ssize_t uart_write(struct file* filePointer, const char* dataBuffer, size_t dataLength, loff_t* filePosition)
 {
     GpioUart* uart = (GpioUart*)filePointer->private_data;
     
-    // Copy byte by byte
-    for (int i = 0;i < dataLength; i++)
+    if (mutex_lock_interruptible(&uart->writeLock))
+    {
+        return -ERESTARTSYS;
+    }
+    
+    while (uart->overflowPolicy == GPIO_UART_BLOCK && kfifo_is_full(&uart->txFifo))
+    {
+        mutex_unlock(&uart->writeLock);
+        if (filePointer->f_flags & O_NONBLOCK)
+        {
+            return -EAGAIN;
+        }
+        if (wait_event_interruptible(uart->txWait, uart->overflowPolicy != GPIO_UART_BLOCK || !kfifo_is_full(&uart->txFifo)) ||
+            mutex_lock_interruptible(&uart->writeLock))
+        {
+            return -ERESTARTSYS;
+        }
+    }
+    
+    // Only blocking writes may come up short
+    int policy = uart->overflowPolicy;
+    size_t bytesTaken = dataLength;
+    unsigned int bytesDropped = 0;
+    if (policy == GPIO_UART_DROP_OLDEST && dataLength > kfifo_avail(&uart->txFifo))
+    {
+        // Data that could never all fit is as good as the oldest, so it goes first
+        if (dataLength > kfifo_size(&uart->txFifo))
+        {
+            bytesDropped += dataLength - kfifo_size(&uart->txFifo);
+            dataBuffer += dataLength - kfifo_size(&uart->txFifo);
+            dataLength = kfifo_size(&uart->txFifo);
+        }
+        bytesDropped += dropOldestTxBytes(uart, dataLength);
+    }
+    
+    // Copy it all at once
+    unsigned int bytesCopied;
+    int result = kfifo_from_user(&uart->txFifo, dataBuffer, dataLength, &bytesCopied);
+    if (!result && policy != GPIO_UART_BLOCK)
+    {
+        bytesDropped += dataLength - bytesCopied;
+    }
+    else
+    {
+        bytesTaken = bytesCopied;
+    }
+    
+    if (bytesDropped > 0)
+    {
+        uart->stats.txOverflows++;
+        uart->stats.bytesDropped += bytesDropped;
+    }
+    mutex_unlock(&uart->writeLock);
+    
+    if (!busyWaitTx)
+    {
+        kickTxEdgeTimer(uart);
+    }
+    
+    return result ? result : bytesTaken;
+}
+
+// Tells poll and select whether there is data to read and room to write
+unsigned int uart_poll(struct file* filePointer, poll_table* wait)
+{
+    GpioUart* uart = (GpioUart*)filePointer->private_data;
+    unsigned int mask = 0;
+    
+    poll_wait(filePointer, &uart->rxWait, wait);
+    poll_wait(filePointer, &uart->txWait, wait);
+    
+    if (!kfifo_is_empty(&uart->rxFifo))
+    {
+        mask |= POLLIN | POLLRDNORM;
+    }
+    // Writes only wait for room under GPIO_UART_BLOCK
+    if (uart->overflowPolicy != GPIO_UART_BLOCK || !kfifo_is_full(&uart->txFifo))
+    {
+        mask |= POLLOUT | POLLWRNORM;
+    }
+    return mask;
+}
+
+// The tty front-end. Opening /dev/ttyGU<minor> starts the uart if it has its pins
+// (from the uarts module parameter, or the char device's ioctls), and termios then sets
+// its baud rate, parity and stop bits. Received bytes reach the line discipline
+// through the flip buffer a tasklet run at a time, so VMIN and VTIME batch them as usual.
+
+// Puts the uart's current settings into termios, so the tty starts out as the uart is
+void uartToTermios(GpioUart* uart, struct ktermios* termios)
+{
+    termios->c_cflag &= ~(CSIZE | PARENB | PARODD | CSTOPB);
+    termios->c_cflag |= CS8 | (uart->parityBit ? PARENB : 0) | (uart->secondStopBit ? CSTOPB : 0);
+    tty_termios_encode_baud_rate(termios, uart->baudRate, uart->baudRate);
+}
+
+int uartTtyInstall(struct tty_driver* driver, struct tty_struct* tty)
+{
+    if (tty->index >= uartDeviceCount)
+    {
+        return -ENODEV;
+    }
+    
+    GpioUart* uart = uartDevices[tty->index];
+    int result = tty_port_install(&uart->ttyPort, driver, tty);
+    if (result)
     {
-        unsigned char byteValue;
-        copy_from_user(&byteValue, dataBuffer, 1);
-        printk(KERN_INFO "Byte %d transferred from user.\n", byteValue);
-        addTxByte(uart, byteValue);
+        return result;
     }
     
-    return dataLength;
+    tty->driver_data = uart;
+    uartToTermios(uart, &tty->termios);
+    return 0;
+}
+
+int uartTtyOpen(struct tty_struct* tty, struct file* filePointer)
+{
+    GpioUart* uart = (GpioUart*)tty->driver_data;
+    return tty_port_open(&uart->ttyPort, tty, filePointer);
 }
 
+void uartTtyClose(struct tty_struct* tty, struct file* filePointer)
+{
+    GpioUart* uart = (GpioUart*)tty->driver_data;
+    tty_port_close(&uart->ttyPort, tty, filePointer);
+}
+
+void uartTtyHangup(struct tty_struct* tty)
+{
+    GpioUart* uart = (GpioUart*)tty->driver_data;
+    tty_port_hangup(&uart->ttyPort);
+}
+
+// Queues as much as there is room for. The line discipline does the waiting for room,
+// so the overflow policy does not apply to the tty.
+int uartTtyWrite(struct tty_struct* tty, const unsigned char* dataBuffer, int dataLength)
+{
+    GpioUart* uart = (GpioUart*)tty->driver_data;
+    int bytesQueued = kfifo_in_spinlocked(&uart->txFifo, dataBuffer, dataLength, &uart->ttyWriteLock);
+    
+    if (!busyWaitTx)
+    {
+        kickTxEdgeTimer(uart);
+    }
+    return bytesQueued;
+}
+
+int uartTtyWriteRoom(struct tty_struct* tty)
+{
+    GpioUart* uart = (GpioUart*)tty->driver_data;
+    return kfifo_avail(&uart->txFifo);
+}
+
+int uartTtyCharsInBuffer(struct tty_struct* tty)
+{
+    GpioUart* uart = (GpioUart*)tty->driver_data;
+    return kfifo_len(&uart->txFifo);
+}
+
+// Applies termios to the uart. Only 8 data bits, even parity and no flow control are supported,
+// so termios is changed to say so.
+// The rx and tx paths read the settings without a lock, so a running uart is stopped while
+// they change and started again after, as the ioctls expect of their callers.
+// A frame part way through being sent or received is lost.
+void uartTtySetTermios(struct tty_struct* tty, struct ktermios* oldTermios)
+{
+    GpioUart* uart = (GpioUart*)tty->driver_data;
+    struct ktermios* termios = &tty->termios;
+    
+    termios->c_cflag &= ~(CSIZE | PARODD | CMSPAR | CRTSCTS);
+    termios->c_cflag |= CS8 | CLOCAL;
+    
+    // B0 would hang up a modem line, which we do not have, so it keeps the old rate
+    int baudRate = tty_termios_baud_rate(termios);
+    if (baudRate <= 0)
+    {
+        baudRate = uart->baudRate;
+    }
+    
+    bool parityBit = termios->c_cflag & PARENB;
+    bool secondStopBit = termios->c_cflag & CSTOPB;
+    tty_termios_encode_baud_rate(termios, baudRate, baudRate);
+    if (baudRate == uart->baudRate && parityBit == uart->parityBit && secondStopBit == uart->secondStopBit)
+    {
+        return;
+    }
+    
+    bool wasRunning = uart->isRunning;
+    stopUart(uart);
+    uart->baudRate = baudRate;
+    uart->modifiedBaudRate = baudRate;
+    uart->parityBit = parityBit;
+    uart->secondStopBit = secondStopBit;
+    if (wasRunning && startUart(uart))
+    {
+        printk(KERN_ERR "Could not restart GPIO UART after changing its termios\n");
+    }
+}
+
+const struct tty_operations ttyOperations = {
+    .install = uartTtyInstall,
+    .open = uartTtyOpen,
+    .close = uartTtyClose,
+    .hangup = uartTtyHangup,
+    .write = uartTtyWrite,
+    .write_room = uartTtyWriteRoom,
+    .chars_in_buffer = uartTtyCharsInBuffer,
+    .set_termios = uartTtySetTermios
+};
+
+// Called for the first open of the tty, to take the uart from the char device and start it
+int uartTtyActivate(struct tty_port* port, struct tty_struct* tty)
+{
+    GpioUart* uart = container_of(port, GpioUart, ttyPort);
+    
+    mutex_lock(&openLock);
+    if (uart->openFiles > 0)
+    {
+        mutex_unlock(&openLock);
+        return -EBUSY;
+    }
+    uart->ttyActive = true;
+    mutex_unlock(&openLock);
+    
+    uartTtySetTermios(tty, NULL);
+    if (!uart->isRunning)
+    {
+        int result = startUart(uart);
+        if (result)
+        {
+            uart->ttyActive = false;
+            return result;
+        }
+    }
+    return 0;
+}
+
+// Called for the last close of the tty. The uart keeps running, as it does for the char device.
+void uartTtyShutdown(struct tty_port* port)
+{
+    GpioUart* uart = container_of(port, GpioUart, ttyPort);
+    
+    mutex_lock(&openLock);
+    uart->ttyActive = false;
+    mutex_unlock(&openLock);
+}
+
+const struct tty_port_operations ttyPortOperations = {
+    .activate = uartTtyActivate,
+    .shutdown = uartTtyShutdown
+};
+
+// Registers the tty driver, with a minor number for every uart the module can run
+// Returns 0 on success, or a negative error number on failure
+int registerTtyDriver(void)
+{
+    ttyDriver = alloc_tty_driver(MAX_UARTS);
+    if (!ttyDriver)
+    {
+        return -ENOMEM;
+    }
+    
+    ttyDriver->owner = THIS_MODULE;
+    ttyDriver->driver_name = "gpio_uart";
+    ttyDriver->name = "ttyGU";
+    // Any free major number will do
+    ttyDriver->major = 0;
+    ttyDriver->type = TTY_DRIVER_TYPE_SERIAL;
+    ttyDriver->subtype = SERIAL_TYPE_NORMAL;
+    // Nodes are made by createUart, for only the uarts there are
+    ttyDriver->flags = TTY_DRIVER_REAL_RAW | TTY_DRIVER_DYNAMIC_DEV;
+    ttyDriver->init_termios = tty_std_termios;
+    ttyDriver->init_termios.c_cflag = B9600 | CS8 | CREAD | HUPCL | CLOCAL;
+    ttyDriver->init_termios.c_ispeed = 9600;
+    ttyDriver->init_termios.c_ospeed = 9600;
+    tty_set_operations(ttyDriver, &ttyOperations);
+    
+    int result = tty_register_driver(ttyDriver);
+    if (result)
+    {
+        put_tty_driver(ttyDriver);
+        ttyDriver = NULL;
+    }
+    return result;
+}
\ No newline at end of file
@@ -42,5 +42,31 @@
 // Stops the uart, allowing settings to be changed
 #define GPIO_UART_IOC_STOP _IO(GPIO_UART_IOC_MAGIC, 13)
 
+// Set the size of the rx buffer in bytes, rounded up to a power of 2 (default 4096)
+// May only be set before uart has been started, and discards anything still buffered
+#define GPIO_UART_IOC_SETRXBUFFERSIZE _IO(GPIO_UART_IOC_MAGIC, 14)
+// Get the size of the rx buffer
+#define GPIO_UART_IOC_GETRXBUFFERSIZE _IO(GPIO_UART_IOC_MAGIC, 15)
+
+// Set the size of the tx buffer in bytes, rounded up to a power of 2 (default 4096)
+// May only be set before uart has been started, and discards anything still buffered
+#define GPIO_UART_IOC_SETTXBUFFERSIZE _IO(GPIO_UART_IOC_MAGIC, 16)
+// Get the size of the tx buffer
+#define GPIO_UART_IOC_GETTXBUFFERSIZE _IO(GPIO_UART_IOC_MAGIC, 17)
+
+// Set what happens to bytes that arrive for a full buffer, one of the policies below
+// May only be set before uart has been started
+#define GPIO_UART_IOC_SETOVERFLOWPOLICY _IO(GPIO_UART_IOC_MAGIC, 18)
+// Get the overflow policy
+#define GPIO_UART_IOC_GETOVERFLOWPOLICY _IO(GPIO_UART_IOC_MAGIC, 19)
+
+// The oldest buffered bytes are dropped to make room
+#define GPIO_UART_DROP_OLDEST 0
+// The new bytes are dropped
+#define GPIO_UART_DROP_NEWEST 1
+// Writers wait for room (the default). The rx line cannot be made to wait,
+// so received bytes are dropped as with GPIO_UART_DROP_NEWEST.
+#define GPIO_UART_BLOCK 2
+
 
 #endif
\ No newline at end of file
@@ -0,0 +1,82 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM gpio_uart
+
+#if !defined(GPIO_UART_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define GPIO_UART_TRACE_H
+
+#include <linux/tracepoint.h>
+
+// Tracepoints for the rx path, which used to printk for every span and frame.
+// They cost next to nothing until enabled, for example with
+// echo 1 > /sys/kernel/debug/tracing/events/gpio_uart/enable
+// Each event carries the rx pin, to tell the uarts apart.
+
+// A time span straight from the interrupt handler, before and after
+// being scaled by the baud rate we have calibrated against the remote device
+TRACE_EVENT(gpio_uart_raw_span,
+    TP_PROTO(int rxPin, s64 rawTime, s64 modifiedTime, bool value),
+    TP_ARGS(rxPin, rawTime, modifiedTime, value),
+    TP_STRUCT__entry(
+        __field(int, rxPin)
+        __field(s64, rawTime)
+        __field(s64, modifiedTime)
+        __field(bool, value)
+    ),
+    TP_fast_assign(
+        __entry->rxPin = rxPin;
+        __entry->rawTime = rawTime;
+        __entry->modifiedTime = modifiedTime;
+        __entry->value = value;
+    ),
+    TP_printk("rx %d: raw %lld ns, modified %lld ns at value %d",
+        __entry->rxPin, __entry->rawTime, __entry->modifiedTime, (int)__entry->value)
+);
+
+// A time span after relaxation, and the number of bits it was divided into
+TRACE_EVENT(gpio_uart_span,
+    TP_PROTO(int rxPin, s64 spanTime, s64 originalSpanTime, bool value, int bits),
+    TP_ARGS(rxPin, spanTime, originalSpanTime, value, bits),
+    TP_STRUCT__entry(
+        __field(int, rxPin)
+        __field(s64, spanTime)
+        __field(s64, originalSpanTime)
+        __field(bool, value)
+        __field(int, bits)
+    ),
+    TP_fast_assign(
+        __entry->rxPin = rxPin;
+        __entry->spanTime = spanTime;
+        __entry->originalSpanTime = originalSpanTime;
+        __entry->value = value;
+        __entry->bits = bits;
+    ),
+    TP_printk("rx %d: %lld ns (was %lld) at value %d -- %d bits",
+        __entry->rxPin, __entry->spanTime, __entry->originalSpanTime, (int)__entry->value, __entry->bits)
+);
+
+// A valid frame found in the bit buffer, and how sure we are of it
+TRACE_EVENT(gpio_uart_frame,
+    TP_PROTO(int rxPin, int index, int score),
+    TP_ARGS(rxPin, index, score),
+    TP_STRUCT__entry(
+        __field(int, rxPin)
+        __field(int, index)
+        __field(int, score)
+    ),
+    TP_fast_assign(
+        __entry->rxPin = rxPin;
+        __entry->index = index;
+        __entry->score = score;
+    ),
+    TP_printk("rx %d: valid frame at %d, scored at %d",
+        __entry->rxPin, __entry->index, __entry->score)
+);
+
+#endif
+
+// This header is not in the kernel's include path, so say where it is
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE gpio_uart_trace
+#include <trace/define_trace.h>
\ No newline at end of file
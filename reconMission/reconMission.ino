@@ -64,6 +64,9 @@ int cellStoredTagOn = 0;
 //Keep track of time, second by second
 unsigned long secondStartTime;
 
+//When the temperature sensors were last asked to convert
+unsigned long temperatureRequestTime;
+
 // What to current echo/output to the console - with flags!
 // 1 = CONSOLE
 // 2 = TRANSCEIVER
@@ -106,6 +109,7 @@ void setup()
     tempSensors.setWaitForConversion(false);
     //Request conversions to start
     tempSensors.requestTemperatures();
+    temperatureRequestTime = millis();
 
     //Configure stay-alive pin, start low
     //Preferably, this pin will have a resistor
@@ -364,42 +368,31 @@ void loop()
     char outsideTemperature[10];
     bool gottenInsideTemp = false;
     bool gottenOutsideTemp = false;
-    //Wait for temperatures to finish converting, then read the temperatures
+    //Read the temperatures only once their conversion has had its 750ms,
+    //rather than waiting on it while the serial links go unread.
+    //With a loop a second, that is every time around.
+    bool temperaturesConverted = millis() - temperatureRequestTime >= 750;
     //Don't depend on them actually being connected, though
-    if (tempSensors.isConnected(insideTempAdr))
+    if (temperaturesConverted && tempSensors.isConnected(insideTempAdr))
     {
-        //Do not let it take more than the max of 750ms
-        while (!tempSensors.isConversionAvailable(insideTempAdr) &&
-            secondStartTime + 750 > millis())
-        {
-        }
-        //Only if we didn't run out of time...
-        if (secondStartTime + 750 > millis())
-        {
-            float temp = tempSensors.getTempC(insideTempAdr);
-            //Make it into a string!
-            fmtDouble(temp, 1, insideTemperature, sizeof(insideTemperature));
-            gottenInsideTemp = true;
-        }
+        float temp = tempSensors.getTempC(insideTempAdr);
+        //Make it into a string!
+        fmtDouble(temp, 1, insideTemperature, sizeof(insideTemperature));
+        gottenInsideTemp = true;
     }
 
-    if (tempSensors.isConnected(outsideTempAdr))
+    if (temperaturesConverted && tempSensors.isConnected(outsideTempAdr))
     {
-        //Do not let it take more than the max of 750ms
-        while (!tempSensors.isConversionAvailable(outsideTempAdr) &&
-            secondStartTime + 750 > millis())
-        {
-        }
-        //Only if we didn't run out of time...
-        if (secondStartTime + 750 > millis())
-        {
-            float temp = tempSensors.getTempC(outsideTempAdr);
-            fmtDouble(temp, 1, outsideTemperature, sizeof(outsideTemperature));
-            gottenOutsideTemp = true;
-        }
+        float temp = tempSensors.getTempC(outsideTempAdr);
+        fmtDouble(temp, 1, outsideTemperature, sizeof(outsideTemperature));
+        gottenOutsideTemp = true;
+    }
+    if (temperaturesConverted)
+    {
+        //Request the temp sensors to begin another conversion
+        tempSensors.requestTemperatures();
+        temperatureRequestTime = millis();
     }
-    //Request the temp sensors to begin another conversion
-    tempSensors.requestTemperatures();
 
     //Keep track of what new data we have gotten
     bool gottenGps = false;